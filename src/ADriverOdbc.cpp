@@ -883,8 +883,13 @@ ADriverOdbc::ADriverOdbc(const QString &connInfo)
                 }
             }
 
-            if (promise.result->m_lastResultSet && --m_queueSize == 0) {
-                selfDriver.reset();
+            if (promise.result->m_lastResultSet) {
+                --m_queueSize;
+                // Queries waiting for room are queued before we might release ourself
+                wakeQueueWaiters();
+                if (m_queueSize == 0) {
+                    selfDriver.reset();
+                }
             }
         }
     }, Qt::QueuedConnection);
@@ -961,7 +966,10 @@ void ADriverOdbc::open(const std::shared_ptr<ADriver> &driver, QObject *receiver
 
         deliverOpenWaiters(isOpen, error);
 
-        if (--m_queueSize == 0) {
+        --m_queueSize;
+        // Queries waiting for room are queued before we might release ourself
+        wakeQueueWaiters();
+        if (m_queueSize == 0) {
             selfDriver.reset();
         }
     }, Qt::SingleShotConnection);
@@ -1152,7 +1160,7 @@ void ADriverOdbc::setLastQuerySingleRowMode()
 {
 }
 
-bool ADriverOdbc::enterPipelineMode(std::chrono::milliseconds)
+bool ADriverOdbc::enterPipelineMode(const APipelineSyncPolicy &)
 {
     return false;
 }
@@ -1235,11 +1243,6 @@ qint64 AResultOdbc::numRowsAffected() const
     return m_numRowsAffected;
 }
 
-int AResultOdbc::indexOfField(QLatin1String name) const
-{
-    return m_fields.indexOf(name);
-}
-
 QString AResultOdbc::fieldName(int column) const
 {
     return m_fields.at(column);
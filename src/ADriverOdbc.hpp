@@ -38,7 +38,6 @@ public:
     int fields() const override;
     qint64 numRowsAffected() const override;
 
-    int indexOfField(QLatin1String name) const override;
     QString fieldName(int column) const override;
     inline QVariant value(int row, int column) const override;
 
@@ -164,7 +163,7 @@ public:
 
     void setLastQuerySingleRowMode() override;
 
-    bool enterPipelineMode(std::chrono::milliseconds timeout) override;
+    bool enterPipelineMode(const APipelineSyncPolicy &policy) override;
 
     bool exitPipelineMode() override;
 
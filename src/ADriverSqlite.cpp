@@ -41,12 +41,17 @@ ADriverSqlite::ADriverSqlite(const QString &connInfo)
                 }
             }
 
-            if (promise.result->m_lastResultSet && --m_queueSize == 0) {
-                // This might not be needed if we only use coroutines
-                // since db object won't go out of scope when we are waiting for a reply
-                // unless ofc the user forget to co_await, in which case we
-                // should try to do some cleanup or prevent it if possible.
-                selfDriver.reset();
+            if (promise.result->m_lastResultSet) {
+                --m_queueSize;
+                // Queries waiting for room are queued before we might release ourself
+                wakeQueueWaiters();
+                if (m_queueSize == 0) {
+                    // This might not be needed if we only use coroutines
+                    // since db object won't go out of scope when we are waiting for a reply
+                    // unless ofc the user forget to co_await, in which case we
+                    // should try to do some cleanup or prevent it if possible.
+                    selfDriver.reset();
+                }
             }
         }
     }, Qt::QueuedConnection);
@@ -122,7 +127,10 @@ void ADriverSqlite::open(const std::shared_ptr<ADriver> &driver, QObject *receiv
 
         deliverOpenWaiters(isOpen, error);
 
-        if (--m_queueSize == 0) {
+        --m_queueSize;
+        // Queries waiting for room are queued before we might release ourself
+        wakeQueueWaiters();
+        if (m_queueSize == 0) {
             // This might not be needed if we only use coroutines
             // since db object won't go out of scope when we are waiting for a reply
             // unless ofc the user forget to co_await, in which case we
@@ -184,6 +192,7 @@ void ADriverSqlite::exec(const std::shared_ptr<ADriver> &db,
     if (receiver) {
         data.receiver = receiver;
     }
+    data.deadline = queryDeadline();
     data.result->m_query.setRawData(query.data(), query.size());
 
 #if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
@@ -210,6 +219,7 @@ void ADriverSqlite::exec(const std::shared_ptr<ADriver> &db,
     if (receiver) {
         data.receiver = receiver;
     }
+    data.deadline = queryDeadline();
     data.result->m_query = query.toUtf8();
 
 #if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
@@ -237,6 +247,7 @@ void ADriverSqlite::exec(const std::shared_ptr<ADriver> &db,
     if (receiver) {
         data.receiver = receiver;
     }
+    data.deadline = queryDeadline();
     data.result->m_query.setRawData(query.data(), query.size());
     data.result->m_queryArgs = params;
 
@@ -265,6 +276,7 @@ void ADriverSqlite::exec(const std::shared_ptr<ADriver> &db,
     if (receiver) {
         data.receiver = receiver;
     }
+    data.deadline = queryDeadline();
     data.result->m_query     = query.toUtf8();
     data.result->m_queryArgs = params;
 
@@ -294,6 +306,7 @@ void ADriverSqlite::exec(const std::shared_ptr<ADriver> &db,
     if (receiver) {
         data.receiver = receiver;
     }
+    data.deadline = queryDeadline();
     data.result->m_query     = query.query();
     data.result->m_queryArgs = params;
 
@@ -312,7 +325,7 @@ void ADriverSqlite::setLastQuerySingleRowMode()
 {
 }
 
-bool ADriverSqlite::enterPipelineMode(std::chrono::milliseconds timeout)
+bool ADriverSqlite::enterPipelineMode(const APipelineSyncPolicy &policy)
 {
     return false;
 }
@@ -553,6 +566,10 @@ void ASqliteThread::query(QueryPromise promise)
         Q_EMIT queryReady();
     });
 
+    if (!startDeadline(promise)) {
+        return;
+    }
+
     auto stmt = prepare(promise, 0x0);
     if (!stmt) {
         return;
@@ -576,9 +593,7 @@ void ASqliteThread::query(QueryPromise promise)
         int res = sqlite3_step(stmt.get());
         if (res != SQLITE_ROW) {
             if (res != SQLITE_DONE) {
-                const char *sqliteError = sqlite3_errmsg(m_db);
-                promise.result->m_error = u"Failed to execute query: '%2'"_s.arg(
-                    sqliteError ? QString::fromUtf8(sqliteError) : u"Unknown error"_s);
+                promise.result->m_error = stepError(res);
                 return;
             }
             break;
@@ -621,6 +636,10 @@ void ASqliteThread::queryPrepared(QueryPromise promise)
         }
     });
 
+    if (!startDeadline(promise)) {
+        return;
+    }
+
     auto it = m_preparedQueries.constFind(queryId);
     if (it != m_preparedQueries.constEnd()) {
         stmt = it.value();
@@ -651,9 +670,7 @@ void ASqliteThread::queryPrepared(QueryPromise promise)
         int res = sqlite3_step(stmt.get());
         if (res != SQLITE_ROW) {
             if (res != SQLITE_DONE) {
-                const char *sqliteError = sqlite3_errmsg(m_db);
-                promise.result->m_error = u"Failed to execute query: '%2'"_s.arg(
-                    sqliteError ? QString::fromUtf8(sqliteError) : u"Unknown error"_s);
+                promise.result->m_error = stepError(res);
                 return;
             }
             break;
@@ -682,6 +699,10 @@ void ASqliteThread::queryExec(QueryPromise promise)
         Q_EMIT queryReady();
     });
 
+    if (!startDeadline(promise)) {
+        return;
+    }
+
     int res                = SQLITE_OK;
     const QByteArray query = promise.result->m_query;
 
@@ -739,9 +760,7 @@ void ASqliteThread::queryExec(QueryPromise promise)
 
             if (res != SQLITE_ROW) {
                 if (res != SQLITE_DONE) {
-                    const char *sqliteError = sqlite3_errmsg(m_db);
-                    promise.result->m_error = u"Failed to execute query: '%2'"_s.arg(
-                        sqliteError ? QString::fromUtf8(sqliteError) : u"Unknown error"_s);
+                    promise.result->m_error = stepError(res);
                     return;
                 }
                 break;
@@ -761,6 +780,43 @@ void ASqliteThread::queryExec(QueryPromise promise)
     }
 }
 
+bool ASqliteThread::startDeadline(QueryPromise &promise)
+{
+    m_deadline = promise.deadline;
+    if (m_deadline.hasExpired()) {
+        // Timed out while waiting in the queue
+        promise.result->m_error = u"Query timed out"_s;
+        return false;
+    }
+
+    if (m_db) {
+        if (m_deadline.isForever()) {
+            sqlite3_progress_handler(m_db, 0, nullptr, nullptr);
+        } else {
+            sqlite3_progress_handler(m_db, 1000, progressHandler, this);
+        }
+    }
+    return true;
+}
+
+int ASqliteThread::progressHandler(void *data)
+{
+    // Unlike sqlite3_interrupt() this can't hit the next statement by accident
+    auto worker = static_cast<ASqliteThread *>(data);
+    return worker->m_deadline.hasExpired() ? 1 : 0;
+}
+
+QString ASqliteThread::stepError(int res) const
+{
+    if (res == SQLITE_INTERRUPT && m_deadline.hasExpired()) {
+        return u"Query timed out"_s;
+    }
+
+    const char *sqliteError = sqlite3_errmsg(m_db);
+    return u"Failed to execute query: '%2'"_s.arg(
+        sqliteError ? QString::fromUtf8(sqliteError) : u"Unknown error"_s);
+}
+
 std::shared_ptr<sqlite3_stmt> ASqliteThread::prepare(QueryPromise &promise, int flags)
 {
     const auto size = promise.result->m_query.size() + 1;
@@ -818,11 +874,6 @@ qint64 AResultSqlite::numRowsAffected() const
     return m_numRowsAffected;
 }
 
-int AResultSqlite::indexOfField(QLatin1String name) const
-{
-    return m_fields.indexOf(name);
-}
-
 QString AResultSqlite::fieldName(int column) const
 {
     return m_fields.at(column);
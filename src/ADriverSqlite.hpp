@@ -37,7 +37,6 @@ public:
     int fields() const override;
     qint64 numRowsAffected() const override;
 
-    int indexOfField(QLatin1String name) const override;
     QString fieldName(int column) const override;
     inline QVariant value(int row, int column) const override;
 
@@ -78,6 +77,7 @@ struct QueryPromise {
     ACoroDataRef cb;
     std::shared_ptr<AResultSqlite> result;
     std::optional<QPointer<QObject>> receiver;
+    QDeadlineTimer deadline{QDeadlineTimer::Forever};
 };
 
 class ASqliteThread final : public QThread
@@ -110,10 +110,14 @@ Q_SIGNALS:
 
 private:
     std::shared_ptr<sqlite3_stmt> prepare(QueryPromise &promise, int flags);
+    bool startDeadline(QueryPromise &promise);
+    QString stepError(int res) const;
     static int busyHandler(void *data, int retry_count);
+    static int progressHandler(void *data);
 
     QHash<int, std::shared_ptr<sqlite3_stmt>> m_preparedQueries;
     QString m_uri;
+    QDeadlineTimer m_deadline{QDeadlineTimer::Forever};
     sqlite3 *m_db                              = nullptr;
     std::chrono::milliseconds m_busyRetrySleep = 100ms;
     int m_busyRetries                          = 1;
@@ -167,7 +171,7 @@ public:
 
     void setLastQuerySingleRowMode() override;
 
-    bool enterPipelineMode(std::chrono::milliseconds timeout) override;
+    bool enterPipelineMode(const APipelineSyncPolicy &policy) override;
 
     bool exitPipelineMode() override;
 
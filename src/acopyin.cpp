@@ -0,0 +1,138 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "acopyin.h"
+
+#include "acoroexpected.h"
+#include "adriver.h"
+#include "aresult.h"
+
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(ASQL_COPY, "asql.copy", QtInfoMsg)
+
+using namespace Qt::StringLiterals;
+
+namespace ASql {
+
+class ACopyInPrivate
+{
+public:
+    ACopyInPrivate(std::shared_ptr<ADriver> _driver)
+        : driver(std::move(_driver))
+    {
+    }
+
+    ~ACopyInPrivate()
+    {
+        if (active && driver) {
+            qDebug(ASQL_COPY, "Aborting COPY");
+            driver->copyInEnd(driver, u"COPY aborted by the client"_s, nullptr, {});
+        }
+    }
+
+    std::shared_ptr<ADriver> driver;
+    bool active = true;
+};
+
+} // namespace ASql
+
+using namespace ASql;
+
+ACopyIn::ACopyIn() = default;
+
+ACopyIn::~ACopyIn() = default;
+
+ACopyIn::ACopyIn(std::shared_ptr<ADriver> driver)
+    : d(std::make_shared<ACopyInPrivate>(std::move(driver)))
+{
+}
+
+ACopyIn::ACopyIn(const ACopyIn &other)
+    : d(other.d)
+{
+}
+
+ACopyIn::ACopyIn(ACopyIn &&other) noexcept
+    : d(std::move(other.d))
+{
+}
+
+ACopyIn &ACopyIn::operator=(const ACopyIn &copy)
+{
+    d = copy.d;
+    return *this;
+}
+
+bool ACopyIn::write(QByteArrayView data)
+{
+    if (!d || !d->active) {
+        qWarning(ASQL_COPY, "COPY not active");
+        return false;
+    }
+    return d->driver->copyInData(data);
+}
+
+bool ACopyIn::writeRow(const QVariantList &row)
+{
+    if (!d || !d->active) {
+        qWarning(ASQL_COPY, "COPY not active");
+        return false;
+    }
+    return d->driver->copyInRow(row);
+}
+
+bool ACopyIn::writeBinaryRow(const QVariantList &row)
+{
+    if (!d || !d->active) {
+        qWarning(ASQL_COPY, "COPY not active");
+        return false;
+    }
+    return d->driver->copyInBinaryRow(row);
+}
+
+AExpectedResult ACopyIn::flush(QObject *receiver)
+{
+    AExpectedResult coro(receiver);
+    if (!d || !d->active) {
+        coro.m_data->deliverDirect(std::unexpected(u"COPY not active"_s));
+        return coro;
+    }
+
+    d->driver->copyInFlush(d->driver, receiver, coro.ref());
+    return coro;
+}
+
+AExpectedResult ACopyIn::finish(QObject *receiver)
+{
+    AExpectedResult coro(receiver);
+    if (!d || !d->active) {
+        coro.m_data->deliverDirect(std::unexpected(u"COPY not active"_s));
+        return coro;
+    }
+
+    d->active = false;
+    d->driver->copyInEnd(d->driver, {}, receiver, coro.ref());
+    return coro;
+}
+
+AExpectedResult ACopyIn::abort(const QString &reason, QObject *receiver)
+{
+    AExpectedResult coro(receiver);
+    if (!d || !d->active) {
+        coro.m_data->deliverDirect(std::unexpected(u"COPY not active"_s));
+        return coro;
+    }
+
+    d->active = false;
+    d->driver->copyInEnd(
+        d->driver, reason.isEmpty() ? u"COPY aborted by the client"_s : reason, receiver, coro.ref());
+    return coro;
+}
+
+bool ACopyIn::isActive() const
+{
+    return d && d->active;
+}
@@ -0,0 +1,100 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <adatabase.h>
+#include <asql_export.h>
+
+#include <QByteArrayView>
+
+namespace ASql {
+
+template <typename T>
+class ACoroExpected;
+using AExpectedResult = ACoroExpected<AResult>;
+
+class ACopyInPrivate;
+/*!
+ * \brief ACopyIn streams data to a running COPY ... FROM STDIN command
+ *
+ * Objects are obtained by co_awaiting ADatabase::copyIn(), the connection
+ * is reserved for the COPY until finish() or abort() is called, if the last
+ * copy of this object is destroyed before that the COPY is aborted.
+ *
+ * Data written is buffered by the driver and sent in the background, for large
+ * imports co_await flush() every few thousand rows so that memory usage stays
+ * bounded by the speed of the socket.
+ */
+class ASQL_EXPORT ACopyIn
+{
+public:
+    ACopyIn();
+    ~ACopyIn();
+    ACopyIn(const ACopyIn &other);
+    ACopyIn(ACopyIn &&other) noexcept;
+
+    ACopyIn &operator=(const ACopyIn &copy);
+    ACopyIn &operator=(ACopyIn &&other) noexcept
+    {
+        std::swap(d, other.d);
+        return *this;
+    }
+
+    /*!
+     * \brief write sends \p data that is already in the format the COPY command expects
+     *
+     * Data does not need to be aligned with rows.
+     * \return false if the COPY is no longer active or the data could not be queued
+     */
+    bool write(QByteArrayView data);
+
+    /*!
+     * \brief writeRow encodes \p row in the COPY text format and sends it
+     *
+     * Null values are sent as \c \\N, special characters are escaped.
+     * \return false if the COPY is no longer active or the data could not be queued
+     */
+    bool writeRow(const QVariantList &row);
+
+    /*!
+     * \brief writeBinaryRow encodes \p row in the COPY binary format and sends it
+     *
+     * The COPY command must use \c "(FORMAT binary)" and every row must be written
+     * with this method. Values are encoded with the same types used for query
+     * parameters, which must match the column types exactly, e.g. \c int for \c int4,
+     * \c qint64 for \c int8, \c double for \c float8 and QDateTime for \c timestamptz,
+     * or \c timestamp when in local time. Null values are sent as SQL NULL.
+     *
+     * Compared to writeRow() it avoids quoting and escaping on the client and parsing
+     * on the server, numeric columns in particular import much faster.
+     * \return false if the COPY is no longer active or the data could not be queued
+     */
+    bool writeBinaryRow(const QVariantList &row);
+
+    /*!
+     * \brief flush completes once all data written so far was handed to the socket
+     */
+    [[nodiscard]] AExpectedResult flush(QObject *receiver = nullptr);
+
+    /*!
+     * \brief finish ends the COPY, the result reports the number of rows
+     * imported by AResult::numRowsAffected()
+     */
+    [[nodiscard]] AExpectedResult finish(QObject *receiver = nullptr);
+
+    /*!
+     * \brief abort makes the COPY fail with \p reason, nothing is imported
+     */
+    [[nodiscard]] AExpectedResult abort(const QString &reason = {}, QObject *receiver = nullptr);
+
+    [[nodiscard]] bool isActive() const;
+
+private:
+    friend class ADatabase;
+    ACopyIn(std::shared_ptr<ADriver> driver);
+    std::shared_ptr<ACopyInPrivate> d;
+};
+
+} // namespace ASql
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <acopyin.h>
+#include <acursor.h>
 #include <adatabase.h>
+#include <apipeline.h>
 #include <aresult.h>
 #include <asql_coro_delivery.h>
 #include <atransaction.h>
@@ -187,6 +190,8 @@ protected:
     friend class ADatabase;
     friend class ACache;
     friend class ATransaction;
+    friend class ACopyIn;
+    friend class ACursor;
     friend class APool;
     friend class AMigrations;
     std::shared_ptr<ACoroData<T>> m_data;
@@ -0,0 +1,205 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "acursor.h"
+
+#include "acoroexpected.h"
+#include "adriver.h"
+#include "aresult.h"
+
+#include <optional>
+
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(ASQL_CURSOR, "asql.cursor", QtInfoMsg)
+
+using namespace Qt::StringLiterals;
+
+namespace ASql {
+
+class ACursorPrivate
+{
+public:
+    ACursorPrivate(std::shared_ptr<ADriver> _driver,
+                   const ATransaction &_transaction,
+                   bool _ownsTransaction,
+                   const QString &_name,
+                   int _pageSize)
+        : driver(std::move(_driver))
+        , name(_name)
+        , pageSize(_pageSize)
+        , ownsTransaction(_ownsTransaction)
+    {
+        if (ownsTransaction) {
+            transaction = _transaction;
+        } else {
+            callerTransaction = _transaction.d;
+        }
+    }
+
+    ~ACursorPrivate()
+    {
+        if (active && driver) {
+            qDebug(ASQL_CURSOR) << "Closing cursor" << name;
+            driver->cursorClose(driver, name, nullptr, {});
+        }
+    }
+
+    AExpectedResult request()
+    {
+        AExpectedResult coro(nullptr);
+        driver->cursorFetch(driver, name, pageSize, nullptr, coro.ref());
+        return coro;
+    }
+
+    ATransaction currentTransaction() const
+    {
+        if (ownsTransaction) {
+            return transaction;
+        }
+
+        ATransaction caller;
+        caller.d = callerTransaction.lock();
+        return caller;
+    }
+
+    std::shared_ptr<ADriver> driver;
+    // Started for this cursor, the transaction of the caller is only weakly
+    // referenced so that releasing the cursor never ends it
+    ATransaction transaction;
+    std::weak_ptr<ATransactionPrivate> callerTransaction;
+    QString name;
+    // The page requested while the current one is processed
+    std::optional<AExpectedResult> prefetched;
+    int pageSize;
+    bool ownsTransaction;
+    bool active = true;
+    bool atEnd  = false;
+};
+
+} // namespace ASql
+
+using namespace ASql;
+
+ACursor::ACursor() = default;
+
+ACursor::~ACursor() = default;
+
+ACursor::ACursor(std::shared_ptr<ADriver> driver,
+                 const ATransaction &transaction,
+                 bool ownsTransaction,
+                 const QString &name,
+                 int pageSize)
+    : d(std::make_shared<ACursorPrivate>(
+          std::move(driver), transaction, ownsTransaction, name, pageSize))
+{
+}
+
+ACursor::ACursor(const ACursor &other)
+    : d(other.d)
+{
+}
+
+ACursor::ACursor(ACursor &&other) noexcept
+    : d(std::move(other.d))
+{
+}
+
+ACursor &ACursor::operator=(const ACursor &copy)
+{
+    d = copy.d;
+    return *this;
+}
+
+AExpectedResult ACursor::fetch(QObject *receiver)
+{
+    AExpectedResult coro(receiver);
+    if (!d || !d->active) {
+        coro.m_data->deliverDirect(std::unexpected(u"Cursor not active"_s));
+        return coro;
+    }
+
+    if (d->atEnd) {
+        coro.m_data->deliverDirect(resultSuccess());
+        return coro;
+    }
+
+    AExpectedResult page = d->prefetched ? std::move(*d->prefetched) : d->request();
+    d->prefetched.reset();
+
+    [](auto chainData,
+       std::shared_ptr<ACursorPrivate> cursor,
+       AExpectedResult page) -> ACoroTerminator {
+        auto result = co_await page;
+        if (result) {
+            if (result->size() < cursor->pageSize) {
+                cursor->atEnd = true;
+            } else if (cursor->active && !cursor->prefetched) {
+                // Let the server produce the next page while this one is processed
+                cursor->prefetched = cursor->request();
+            }
+        }
+        chainData->deliverDirect(std::move(result));
+    }(coro.m_data, d, std::move(page));
+    return coro;
+}
+
+AExpectedResult ACursor::close(QObject *receiver)
+{
+    AExpectedResult coro(receiver);
+    if (!d || !d->active) {
+        coro.m_data->deliverDirect(std::unexpected(u"Cursor not active"_s));
+        return coro;
+    }
+
+    d->active = false;
+    d->prefetched.reset();
+
+    AExpectedResult closed(receiver);
+    d->driver->cursorClose(d->driver, d->name, receiver, closed.ref());
+
+    [](auto chainData,
+       ATransaction transaction,
+       AExpectedResult closed,
+       QObject *receiver) -> ACoroTerminator {
+        auto result = co_await closed;
+        if (!result) {
+            chainData->deliverDirect(std::move(result));
+            co_return;
+        }
+
+        if (transaction.isActive()) {
+            // Only set when the transaction was started for this cursor
+            result = co_await transaction.commit(receiver);
+        }
+        chainData->deliverDirect(std::move(result));
+    }(coro.m_data, std::move(d->transaction), std::move(closed), receiver);
+    return coro;
+}
+
+bool ACursor::atEnd() const
+{
+    return !d || d->atEnd;
+}
+
+bool ACursor::isActive() const
+{
+    return d && d->active;
+}
+
+int ACursor::pageSize() const
+{
+    return d ? d->pageSize : 0;
+}
+
+QString ACursor::name() const
+{
+    return d ? d->name : QString{};
+}
+
+ATransaction ACursor::transaction() const
+{
+    return d && d->active ? d->currentTransaction() : ATransaction{};
+}
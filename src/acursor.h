@@ -0,0 +1,103 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <adatabase.h>
+#include <asql_export.h>
+#include <atransaction.h>
+
+namespace ASql {
+
+template <typename T>
+class ACoroExpected;
+using AExpectedResult = ACoroExpected<AResult>;
+
+class ACursorPrivate;
+/*!
+ * \brief ACursor walks the rows of a query in pages using a server side cursor
+ *
+ * Objects are obtained by co_awaiting ADatabase::cursor(), only one page is
+ * kept on the client at a time plus the next one that is prefetched while the
+ * current page is processed, so memory usage does not depend on the number of
+ * rows the query returns.
+ *
+ * \code
+ * auto cursor = co_await db.cursor(u"SELECT id, name FROM big_table", {}, 10'000);
+ * while (cursor && !cursor->atEnd()) {
+ *     auto page = co_await cursor->fetch();
+ *     if (!page) {
+ *         break;
+ *     }
+ *     for (auto row : *page) { ... }
+ * }
+ * co_await cursor->close();
+ * \endcode
+ *
+ * The cursor lives in a transaction, if the last copy of this object is destroyed
+ * before close() the cursor is closed and the transaction it started rolled back,
+ * a transaction passed to ADatabase::cursor() is left to its owner.
+ *
+ * \note On Postgres the cursor is declared with \c DECLARE ... \c NO \c SCROLL \c CURSOR,
+ * on MySQL a prepared statement with a read only cursor is used instead.
+ */
+class ASQL_EXPORT ACursor
+{
+public:
+    ACursor();
+    ~ACursor();
+    ACursor(const ACursor &other);
+    ACursor(ACursor &&other) noexcept;
+
+    ACursor &operator=(const ACursor &copy);
+    ACursor &operator=(ACursor &&other) noexcept
+    {
+        std::swap(d, other.d);
+        return *this;
+    }
+
+    /*!
+     * \brief fetch returns the next page of at most pageSize() rows
+     *
+     * A page with less rows than pageSize() is the last one, after that atEnd()
+     * is true and fetching returns empty results.
+     */
+    [[nodiscard]] AExpectedResult fetch(QObject *receiver = nullptr);
+
+    /*!
+     * \brief close closes the cursor and commits the transaction if it was
+     * started by ADatabase::cursor()
+     */
+    [[nodiscard]] AExpectedResult close(QObject *receiver = nullptr);
+
+    /*!
+     * \brief atEnd returns true once the last page was fetched
+     */
+    [[nodiscard]] bool atEnd() const;
+
+    [[nodiscard]] bool isActive() const;
+
+    [[nodiscard]] int pageSize() const;
+
+    /*!
+     * \brief name returns the name of the cursor on the server
+     */
+    [[nodiscard]] QString name() const;
+
+    /*!
+     * \brief transaction returns the transaction the cursor lives in, until it is closed
+     */
+    [[nodiscard]] ATransaction transaction() const;
+
+private:
+    friend class ADatabase;
+    ACursor(std::shared_ptr<ADriver> driver,
+            const ATransaction &transaction,
+            bool ownsTransaction,
+            const QString &name,
+            int pageSize);
+    std::shared_ptr<ACursorPrivate> d;
+};
+
+} // namespace ASql
@@ -5,17 +5,66 @@
 
 #include "adatabase.h"
 
+#include "acopyin.h"
 #include "acoroexpected.h"
+#include "acursor.h"
 #include "adriver.h"
 #include "adriverfactory.h"
+#include "apipeline.h"
 #include "apreparedquery.h"
+#include "aresult.h"
 #include "atransaction.h"
 
+#include <algorithm>
+#include <atomic>
+
+#include <QIODevice>
 #include <QLoggingCategory>
+#include <QPointer>
 
 using namespace ASql;
 using namespace Qt::StringLiterals;
 
+namespace {
+
+/*!
+ * \brief overflowQuery fails the query of \p cb, or runs \p send once the queue of
+ * \p driver has room for it, depending on the overflow policy of the driver
+ *
+ * The driver is only weakly held while waiting, so that waiting queries don't keep
+ * it alive, if it's destroyed or loses the connection the query fails instead.
+ */
+void overflowQuery(const std::shared_ptr<ADriver> &driver,
+                   QObject *receiver,
+                   ACoroDataRef cb,
+                   std::function<void(std::shared_ptr<ADriver>, ACoroDataRef)> send)
+{
+    if (driver->queueOverflow() == ADatabase::QueueOverflow::Fail) {
+        AResult result = resultError(u"Query queue is full"_s);
+        cb.deliverResult(result);
+        return;
+    }
+
+    auto fail = [cb](const QString &error) {
+        AResult result = resultError(error);
+        cb.deliverResult(result);
+    };
+
+    driver->waitQueueRoom([weakDriver    = std::weak_ptr(driver),
+                           receiver      = QPointer<QObject>(receiver),
+                           checkReceiver = receiver != nullptr,
+                           cb            = std::move(cb),
+                           send          = std::move(send)] {
+        // Skipped if nobody is waiting for the result anymore
+        auto driver = weakDriver.lock();
+        if (driver && cb && (!checkReceiver || !receiver.isNull())) {
+            send(std::move(driver), cb);
+        }
+    }, std::move(fail));
+}
+
+} // namespace
+
 ADatabase::ADatabase() = default;
 
 ADatabase::ADatabase(std::shared_ptr<ADriver> driver)
@@ -107,6 +156,18 @@ AExpectedTransaction ADatabase::begin(QObject *receiver)
     return coro;
 }
 
+AExpectedTransaction ADatabase::begin(TransactionMode mode, QObject *receiver)
+{
+    Q_ASSERT(d);
+    if (mode == TransactionMode::Pipelined && d->beginPipelined(d)) {
+        // Failures are reported by the statements and the commit
+        AExpectedTransaction coro(receiver);
+        coro.m_data->deliverDirect(ATransaction(*this, true));
+        return coro;
+    }
+    return begin(receiver);
+}
+
 AExpectedResult ADatabase::commit(QObject *receiver)
 {
     Q_ASSERT(d);
@@ -127,6 +188,15 @@ AExpectedResult ADatabase::exec(QStringView query, QObject *receiver)
 {
     Q_ASSERT(d);
     AExpectedResult coro(receiver);
+    if (Q_UNLIKELY(d->queueFull())) {
+        overflowQuery(d,
+                      receiver,
+                      coro.ref(),
+                      [query = query.toString(), receiver](auto d, auto cb) {
+            d->exec(d, query, receiver, std::move(cb));
+        });
+        return coro;
+    }
     d->exec(d, query, receiver, coro.ref());
     return coro;
 }
@@ -135,6 +205,15 @@ AExpectedResult ADatabase::exec(QStringView query, const QVariantList &params, Q
 {
     Q_ASSERT(d);
     AExpectedResult coro(receiver);
+    if (Q_UNLIKELY(d->queueFull())) {
+        overflowQuery(d,
+                      receiver,
+                      coro.ref(),
+                      [query = query.toString(), params, receiver](auto d, auto cb) {
+            d->exec(d, query, params, receiver, std::move(cb));
+        });
+        return coro;
+    }
     d->exec(d, query, params, receiver, coro.ref());
     return coro;
 }
@@ -143,14 +222,77 @@ AExpectedMultiResult ADatabase::execMulti(QStringView query, QObject *receiver)
 {
     Q_ASSERT(d);
     AExpectedMultiResult coro(receiver);
+    if (Q_UNLIKELY(d->queueFull())) {
+        overflowQuery(d,
+                      receiver,
+                      coro.ref(),
+                      [query = query.toString(), receiver](auto d, auto cb) {
+            d->exec(d, query, receiver, std::move(cb));
+        });
+        return coro;
+    }
     d->exec(d, query, receiver, coro.ref());
     return coro;
 }
 
+AExpectedMultiResult ADatabase::execStream(QStringView query,
+                                           const QVariantList &params,
+                                           int chunkRows,
+                                           QObject *receiver)
+{
+    Q_ASSERT(d);
+    AExpectedMultiResult coro(receiver);
+    if (Q_UNLIKELY(d->queueFull())) {
+        overflowQuery(d,
+                      receiver,
+                      coro.ref(),
+                      [query = query.toString(), params, chunkRows, receiver](auto d, auto cb) {
+            d->exec(d, query, params, receiver, std::move(cb));
+            d->setLastQueryChunkedRowsMode(chunkRows);
+        });
+        return coro;
+    }
+    d->exec(d, query, params, receiver, coro.ref());
+    d->setLastQueryChunkedRowsMode(chunkRows);
+    return coro;
+}
+
+AExpectedMultiResult ADatabase::execStream(const APreparedQuery &query,
+                                           const QVariantList &params,
+                                           int chunkRows,
+                                           QObject *receiver)
+{
+    Q_ASSERT(d);
+    AExpectedMultiResult coro(receiver);
+    if (!query.isValid()) {
+        coro.m_data->results.enqueue(std::unexpected(QStringLiteral("Invalid prepared query")));
+        coro.m_data->status = AExpectedMultiResult::Done;
+        return coro;
+    }
+    if (Q_UNLIKELY(d->queueFull())) {
+        overflowQuery(
+            d, receiver, coro.ref(), [query, params, chunkRows, receiver](auto d, auto cb) {
+            d->exec(d, query, params, receiver, std::move(cb));
+            d->setLastQueryChunkedRowsMode(chunkRows);
+        });
+        return coro;
+    }
+    d->exec(d, query, params, receiver, coro.ref());
+    d->setLastQueryChunkedRowsMode(chunkRows);
+    return coro;
+}
+
 AExpectedMultiResult ADatabase::execMultiUtf8(QUtf8StringView query, QObject *receiver)
 {
     Q_ASSERT(d);
     AExpectedMultiResult coro(receiver);
+    if (Q_UNLIKELY(d->queueFull())) {
+        // String literals outlive the wait
+        overflowQuery(d, receiver, coro.ref(), [query, receiver](auto d, auto cb) {
+            d->exec(d, query, receiver, std::move(cb));
+        });
+        return coro;
+    }
     d->exec(d, query, receiver, coro.ref());
     return coro;
 }
@@ -159,6 +301,13 @@ AExpectedResult ADatabase::execUtf8(QUtf8StringView query, QObject *receiver)
 {
     Q_ASSERT(d);
     AExpectedResult coro(receiver);
+    if (Q_UNLIKELY(d->queueFull())) {
+        // String literals outlive the wait
+        overflowQuery(d, receiver, coro.ref(), [query, receiver](auto d, auto cb) {
+            d->exec(d, query, receiver, std::move(cb));
+        });
+        return coro;
+    }
     d->exec(d, query, receiver, coro.ref());
     return coro;
 }
@@ -168,6 +317,13 @@ AExpectedResult
 {
     Q_ASSERT(d);
     AExpectedResult coro(receiver);
+    if (Q_UNLIKELY(d->queueFull())) {
+        // String literals outlive the wait
+        overflowQuery(d, receiver, coro.ref(), [query, params, receiver](auto d, auto cb) {
+            d->exec(d, query, params, receiver, std::move(cb));
+        });
+        return coro;
+    }
     d->exec(d, query, params, receiver, coro.ref());
     return coro;
 }
@@ -180,6 +336,12 @@ AExpectedResult ADatabase::exec(const APreparedQuery &query, QObject *receiver)
         coro.m_data->deliverDirect(std::unexpected(QStringLiteral("Invalid prepared query")));
         return coro;
     }
+    if (Q_UNLIKELY(d->queueFull())) {
+        overflowQuery(d, receiver, coro.ref(), [query, receiver](auto d, auto cb) {
+            d->exec(d, query, QVariantList(), receiver, std::move(cb));
+        });
+        return coro;
+    }
     d->exec(d, query, QVariantList(), receiver, coro.ref());
     return coro;
 }
@@ -193,20 +355,307 @@ AExpectedResult
         coro.m_data->deliverDirect(std::unexpected(QStringLiteral("Invalid prepared query")));
         return coro;
     }
+    if (Q_UNLIKELY(d->queueFull())) {
+        overflowQuery(d, receiver, coro.ref(), [query, params, receiver](auto d, auto cb) {
+            d->exec(d, query, params, receiver, std::move(cb));
+        });
+        return coro;
+    }
     d->exec(d, query, params, receiver, coro.ref());
     return coro;
 }
 
+AExpectedPipeline ADatabase::exec(const APipeline &pipeline, QObject *receiver)
+{
+    Q_ASSERT(d);
+    AExpectedPipeline coro(receiver);
+    if (std::ranges::any_of(pipeline.m_statements, [](const auto &statement) {
+        return statement.preparedQuery && !statement.preparedQuery->isValid();
+    })) {
+        coro.m_data->deliverDirect(std::unexpected(QStringLiteral("Invalid prepared query")));
+        return coro;
+    }
+
+    if (pipeline.isEmpty()) {
+        coro.m_data->deliverDirect(APipelineResult{});
+        return coro;
+    }
+
+    auto send = [](const std::shared_ptr<ADriver> &driver,
+                   const APipeline &pipeline,
+                   QObject *receiver,
+                   auto pipelineData) {
+        // The driver sends the queries issued next with a single sync, if it can
+        auto batch = std::make_shared<APipelineBatch>();
+        driver->beginPipelineBatch(driver, batch, int(pipeline.size()));
+
+        std::vector<AExpectedResult> queries;
+        queries.reserve(pipeline.m_statements.size());
+        for (const auto &statement : pipeline.m_statements) {
+            const auto &query = queries.emplace_back(receiver);
+            if (statement.preparedQuery) {
+                driver->exec(
+                    driver, *statement.preparedQuery, statement.params, receiver, query.ref());
+            } else if (statement.params.isEmpty()) {
+                driver->exec(driver, QStringView{statement.query}, receiver, query.ref());
+            } else {
+                driver->exec(
+                    driver, QStringView{statement.query}, statement.params, receiver, query.ref());
+            }
+        }
+        // Queries issued next are not part of the batch
+        driver->endPipelineBatch(driver);
+
+        [](auto pipelineData,
+           std::vector<AExpectedResult> queries,
+           std::shared_ptr<APipelineBatch> batch) -> ACoroTerminator {
+            APipelineResult result;
+            result.m_results.reserve(queries.size());
+            for (auto &query : queries) {
+                const auto &queryResult = result.m_results.emplace_back(co_await query);
+                if (!queryResult && result.m_failedIndex == -1) {
+                    result.m_failedIndex = result.size() - 1;
+                }
+            }
+            // Every query was sent before its result arrived, so the batch is settled
+            result.m_synced = batch->synced;
+            pipelineData->deliverDirect(std::move(result));
+        }(std::move(pipelineData), std::move(queries), std::move(batch));
+    };
+
+    // Queued as a whole so nothing gets in between its queries, all of them
+    // take room in the queue and one larger than the queue never fits
+    const int statements = int(pipeline.size());
+    if (Q_UNLIKELY(d->queueFull(statements))) {
+        if (d->queueOverflow() == QueueOverflow::Fail || statements > d->maxQueueSize()) {
+            coro.m_data->deliverDirect(std::unexpected(u"Query queue is full"_s));
+            return coro;
+        }
+
+        auto fail = [weakData = std::weak_ptr(coro.m_data)](const QString &error) {
+            if (auto pipelineData = weakData.lock()) {
+                pipelineData->deliverDirect(std::unexpected(error));
+            }
+        };
+
+        d->waitQueueRoom([weakDriver    = std::weak_ptr(d),
+                          pipeline,
+                          receiver      = QPointer<QObject>(receiver),
+                          checkReceiver = receiver != nullptr,
+                          weakData      = std::weak_ptr(coro.m_data),
+                          send] {
+            // Skipped if nobody is waiting for the results anymore
+            auto driver       = weakDriver.lock();
+            auto pipelineData = weakData.lock();
+            if (driver && pipelineData && (!checkReceiver || !receiver.isNull())) {
+                send(driver, pipeline, receiver, std::move(pipelineData));
+            }
+        }, std::move(fail), statements);
+        return coro;
+    }
+
+    send(d, pipeline, receiver, coro.m_data);
+    return coro;
+}
+
+static AExpectedResult copyInHelper(const std::shared_ptr<ADriver> &d,
+                                    QStringView query,
+                                    QObject *receiver)
+{
+    AExpectedResult coro(receiver);
+    if (Q_UNLIKELY(d->queueFull())) {
+        overflowQuery(d,
+                      receiver,
+                      coro.ref(),
+                      [query = query.toString(), receiver](auto d, auto cb) {
+            d->copyIn(d, query, receiver, std::move(cb));
+        });
+        return coro;
+    }
+    d->copyIn(d, query, receiver, coro.ref());
+    return coro;
+}
+
+AExpectedCopyIn ADatabase::copyIn(QStringView query, QObject *receiver)
+{
+    Q_ASSERT(d);
+    AExpectedCopyIn coro(receiver);
+    [](auto chainData,
+       std::shared_ptr<ADriver> driver,
+       QString query,
+       QObject *receiver) -> ACoroTerminator {
+        auto result = co_await copyInHelper(driver, query, receiver);
+        if (result) {
+            chainData->deliverDirect(ACopyIn(driver));
+            co_return;
+        }
+        chainData->deliverDirect(std::unexpected(result.error()));
+    }(coro.m_data, d, query.toString(), receiver);
+    return coro;
+}
+
+static QString nextCursorName()
+{
+    static std::atomic<quint64> serial{0};
+    return u"asql_cursor_"_s + QString::number(++serial);
+}
+
+static AExpectedResult cursorHelper(const std::shared_ptr<ADriver> &d,
+                                    const QString &name,
+                                    QStringView query,
+                                    const QVariantList &params,
+                                    int pageSize,
+                                    QObject *receiver)
+{
+    AExpectedResult coro(receiver);
+    d->cursorDeclare(d, name, query, params, pageSize, receiver, coro.ref());
+    return coro;
+}
+
+AExpectedCursor ADatabase::cursor(QStringView query,
+                                  const QVariantList &params,
+                                  int pageSize,
+                                  QObject *receiver)
+{
+    Q_ASSERT(d);
+    AExpectedCursor coro(receiver);
+    if (pageSize < 1) {
+        coro.m_data->deliverDirect(std::unexpected(u"Invalid cursor page size"_s));
+        return coro;
+    }
+
+    // Both are queued before awaiting so they only cost one round trip
+    const QString name = nextCursorName();
+    auto started       = begin(receiver);
+    auto declared      = cursorHelper(d, name, query, params, pageSize, receiver);
+
+    [](auto chainData,
+       std::shared_ptr<ADriver> driver,
+       AExpectedTransaction started,
+       AExpectedResult declared,
+       QString name,
+       int pageSize) -> ACoroTerminator {
+        auto transaction = co_await started;
+        auto result      = co_await declared;
+        if (!transaction) {
+            chainData->deliverDirect(std::unexpected(transaction.error()));
+            co_return;
+        }
+
+        if (!result) {
+            // The transaction is rolled back once released
+            chainData->deliverDirect(std::unexpected(result.error()));
+            co_return;
+        }
+        chainData->deliverDirect(ACursor(driver, *transaction, true, name, pageSize));
+    }(coro.m_data, d, started, declared, name, pageSize);
+    return coro;
+}
+
+AExpectedCursor ADatabase::cursor(const ATransaction &transaction,
+                                  QStringView query,
+                                  const QVariantList &params,
+                                  int pageSize,
+                                  QObject *receiver)
+{
+    Q_ASSERT(d);
+    AExpectedCursor coro(receiver);
+    if (pageSize < 1) {
+        coro.m_data->deliverDirect(std::unexpected(u"Invalid cursor page size"_s));
+        return coro;
+    }
+
+    if (!transaction.isActive()) {
+        coro.m_data->deliverDirect(std::unexpected(u"Transaction not started"_s));
+        return coro;
+    }
+
+    const QString name = nextCursorName();
+    [](auto chainData,
+       std::shared_ptr<ADriver> driver,
+       ATransaction transaction,
+       AExpectedResult declared,
+       QString name,
+       int pageSize) -> ACoroTerminator {
+        auto result = co_await declared;
+        if (!result) {
+            chainData->deliverDirect(std::unexpected(result.error()));
+            co_return;
+        }
+        chainData->deliverDirect(ACursor(driver, transaction, false, name, pageSize));
+    }(coro.m_data,
+      d,
+      transaction,
+      cursorHelper(d, name, query, params, pageSize, receiver),
+      name,
+      pageSize);
+    return coro;
+}
+
+AExpectedResult ADatabase::copyOut(QStringView query, ACopyOutFn chunkCb, QObject *receiver)
+{
+    Q_ASSERT(d);
+    AExpectedResult coro(receiver);
+    if (Q_UNLIKELY(d->queueFull())) {
+        overflowQuery(d,
+                      receiver,
+                      coro.ref(),
+                      [query = query.toString(), chunkCb, receiver](auto d, auto cb) {
+            d->copyOut(d, query, chunkCb, receiver, std::move(cb));
+        });
+        return coro;
+    }
+    d->copyOut(d, query, std::move(chunkCb), receiver, coro.ref());
+    return coro;
+}
+
+AExpectedResult ADatabase::copyOut(QStringView query, QIODevice *device, QObject *receiver)
+{
+    auto writeChunk = [device = QPointer<QIODevice>(device)](QByteArrayView chunk) {
+        if (device) {
+            device->write(chunk.data(), chunk.size());
+        }
+    };
+    return copyOut(query, std::move(writeChunk), receiver);
+}
+
 void ADatabase::setLastQuerySingleRowMode()
 {
     Q_ASSERT(d);
     d->setLastQuerySingleRowMode();
 }
 
+void ADatabase::setLastQueryChunkedRowsMode(int rows)
+{
+    Q_ASSERT(d);
+    d->setLastQueryChunkedRowsMode(rows);
+}
+
+void ADatabase::setResultFormat(ResultFormat format)
+{
+    Q_ASSERT(d);
+    d->setResultFormat(format);
+}
+
+ADatabase::ResultFormat ADatabase::resultFormat() const
+{
+    Q_ASSERT(d);
+    return d->resultFormat();
+}
+
 bool ADatabase::enterPipelineMode(std::chrono::milliseconds timeout)
 {
     Q_ASSERT(d);
-    return d->enterPipelineMode(timeout);
+    return d->enterPipelineMode(APipelineSyncPolicy{
+        .latency      = timeout,
+        .syncWhenIdle = false,
+    });
+}
+
+bool ADatabase::enterPipelineModeWithPolicy(const APipelineSyncPolicy &policy)
+{
+    Q_ASSERT(d);
+    return d->enterPipelineMode(policy);
 }
 
 bool ADatabase::exitPipelineMode()
@@ -227,6 +676,48 @@ bool ADatabase::pipelineSync()
     return d->pipelineSync();
 }
 
+APipelineSyncStats ADatabase::pipelineSyncStats() const
+{
+    Q_ASSERT(d);
+    return d->pipelineSyncStats();
+}
+
+void ADatabase::setPreparedCacheCapacity(int capacity)
+{
+    Q_ASSERT(d);
+    d->setPreparedCacheCapacity(d, capacity);
+}
+
+APreparedCacheStats ADatabase::preparedCacheStats() const
+{
+    Q_ASSERT(d);
+    return d->preparedCacheStats();
+}
+
+void ADatabase::setAutoPipeline(bool enable)
+{
+    Q_ASSERT(d);
+    d->setAutoPipeline(enable);
+}
+
+bool ADatabase::autoPipeline() const
+{
+    Q_ASSERT(d);
+    return d->autoPipeline();
+}
+
+void ADatabase::setQueryTimeout(std::chrono::milliseconds timeout)
+{
+    Q_ASSERT(d);
+    d->setQueryTimeout(timeout);
+}
+
+std::chrono::milliseconds ADatabase::queryTimeout() const
+{
+    Q_ASSERT(d);
+    return d->queryTimeout();
+}
+
 void ADatabase::subscribeToNotification(const QString &channel,
                                         QObject *receiver,
                                         ANotificationFn cb)
@@ -247,6 +738,24 @@ void ADatabase::unsubscribeFromNotification(const QString &channel)
     d->unsubscribeFromNotification(d, channel);
 }
 
+void ADatabase::setMaxQueueSize(int max, QueueOverflow overflow)
+{
+    Q_ASSERT(d);
+    d->setMaxQueueSize(max, overflow);
+}
+
+int ADatabase::maxQueueSize() const
+{
+    Q_ASSERT(d);
+    return d->maxQueueSize();
+}
+
+ADatabase::QueueOverflow ADatabase::queueOverflow() const
+{
+    Q_ASSERT(d);
+    return d->queueOverflow();
+}
+
 int ADatabase::queueSize() const
 {
     Q_ASSERT(d);
@@ -10,15 +10,22 @@
 #include <cstddef>
 #include <functional>
 #include <memory>
+#include <ranges>
 
 #include <QObject>
 #include <QVariantList>
 
+class QIODevice;
+
 namespace ASql {
 
 class AResult;
 class ADatabase;
 class ATransaction;
+class ACopyIn;
+class ACursor;
+class APipeline;
+class APipelineResult;
 class ADriver;
 class ADriverFactory;
 
@@ -32,6 +39,85 @@ public:
 
 using ANotificationFn = std::function<void(const ADatabaseNotification &notification)>;
 
+/*!
+ * \brief APreparedCacheStats reports the usage of the prepared statements
+ * cache of a database connection
+ */
+class APreparedCacheStats
+{
+public:
+    quint64 hits      = 0;
+    quint64 misses    = 0;
+    quint64 evictions = 0;
+    int size          = 0;
+    int capacity      = 0;
+};
+
+/*!
+ * \brief APipelineSyncPolicy decides when queries sent in pipeline mode are
+ * followed by a sync, which makes the server send their results
+ *
+ * A batch is synced as soon as any of the enabled conditions is met, zero
+ * disables a limit.
+ */
+class APipelineSyncPolicy
+{
+public:
+    //! Maximum time the first query of a batch waits for the sync
+    std::chrono::milliseconds latency{0};
+    //! Number of queries that closes a batch
+    int maxQueries = 0;
+    //! Size of the queries, including parameters, that closes a batch
+    qsizetype maxBytes = 0;
+    //! Sync right away when no earlier batch is waiting for results, otherwise
+    //! queries are batched until the results arrive or a limit is reached
+    bool syncWhenIdle = true;
+};
+
+/*!
+ * \brief APipelineSyncStats reports the batches sent by a connection in pipeline mode
+ */
+class APipelineSyncStats
+{
+public:
+    //! Batches synced, followed by how many were closed by each condition,
+    //! the remaining ones were synced by pipelineSync()
+    quint64 syncs        = 0;
+    quint64 idleSyncs    = 0;
+    quint64 limitSyncs   = 0;
+    quint64 latencySyncs = 0;
+    //! Queries and bytes of all batches
+    quint64 queries = 0;
+    quint64 bytes   = 0;
+    int lastBatchQueries     = 0;
+    qsizetype lastBatchBytes = 0;
+    int maxBatchQueries      = 0;
+
+    [[nodiscard]] double averageBatchQueries() const
+    {
+        return syncs ? double(queries) / double(syncs) : 0;
+    }
+};
+
+using ACopyOutFn = std::function<void(QByteArrayView chunk)>;
+
+/*!
+ * \brief arrayParam returns a query parameter holding a copy of \p values that is sent as
+ * a native array, e.g. for \c "WHERE id = ANY($1)"
+ *
+ * QList<T> and std::vector<T> parameters are sent as arrays without this helper, views
+ * like std::span must be copied since queries might only be sent after the caller returns.
+ *
+ * \note Postgres supports arrays of int, qint64, qint16, bool, float, double, QString,
+ * QByteArray and QUuid.
+ */
+template <std::ranges::contiguous_range Range>
+QVariant arrayParam(const Range &values)
+{
+    using T = std::remove_cv_t<std::ranges::range_value_t<Range>>;
+    return QVariant::fromValue(QList<T>(std::ranges::begin(values), std::ranges::end(values)));
+}
+
 template <typename T>
 class ACoroExpected;
 
@@ -45,6 +131,9 @@ using AExpectedMultiResult = ACoroMultiExpected<AResult>;
 
 using AExpectedTransaction = ACoroExpected<ATransaction>;
 using AExpectedDatabase    = ACoroExpected<ADatabase>;
+using AExpectedCopyIn      = ACoroExpected<ACopyIn>;
+using AExpectedCursor      = ACoroExpected<ACursor>;
+using AExpectedPipeline    = ACoroExpected<APipelineResult>;
 
 class APreparedQuery;
 class ASQL_EXPORT ADatabase
@@ -139,6 +228,32 @@ public:
      */
     [[nodiscard]] AExpectedTransaction begin(QObject *receiver = nullptr);
 
+    enum class TransactionMode {
+        /*! BEGIN completes before the transaction is delivered */
+        Sequential,
+        /*! BEGIN is sent along with the statements and COMMIT in a single round trip */
+        Pipelined,
+    };
+    Q_ENUM(TransactionMode)
+
+    /*!
+     * \brief begin a transaction in the given \p mode
+     *
+     * A pipelined transaction is delivered right away, BEGIN is sent with the
+     * statements issued before ATransaction::commit() and the whole transaction
+     * completes in one round trip when they are not awaited in between. If a
+     * statement fails the following ones fail as well and the transaction is
+     * rolled back.
+     *
+     * Drivers without pipelining and connections in pipeline mode, where syncs are
+     * up to the caller, use the Sequential mode.
+     *
+     * \note Only supported by Postgres.
+     * \note The transaction must be ended with ATransaction::commit() or
+     * ATransaction::rollback(), statements issued before are part of it.
+     */
+    [[nodiscard]] AExpectedTransaction begin(TransactionMode mode, QObject *receiver = nullptr);
+
     /*!
      * \brief commit a transaction, this operation usually succeeds,
      * but one can hook up a callback to check it's result.
@@ -251,6 +366,24 @@ public:
     [[nodiscard]] AExpectedResult
         exec(const APreparedQuery &query, const QVariantList &params, QObject *receiver = nullptr);
 
+    /*!
+     * \brief exec sends the queries of \p pipeline together and delivers all their
+     * results at once
+     *
+     * The result is \c std::unexpected only if the pipeline could not be sent, errors
+     * of each query are in APipelineResult. On Postgres the queries are followed by a
+     * single sync, also in pipeline mode where it delimits the batch and ends an aborted
+     * pipeline. Inside a pipelined transaction the queries are statements of it instead.
+     *
+     * A pipeline is queued as a whole and takes room for all of its queries, if they
+     * don't fit it fails or waits for room as set by setMaxQueueSize(). A pipeline
+     * with more queries than the queue can hold always fails.
+     *
+     * \note Only Postgres sends the queries in a single round trip, other drivers send
+     * them one after the other.
+     */
+    [[nodiscard]] AExpectedPipeline exec(const APipeline &pipeline, QObject *receiver = nullptr);
+
     /*!
      * \brief exec executes a \param query against this database connection.
      * co_await the returned awaitable; on failure the result is \c std::unexpected with an
@@ -285,6 +418,119 @@ public:
     [[nodiscard]] AExpectedMultiResult execMulti(const char (&query)[N],
                                                  QObject *receiver = nullptr);
 
+    /*!
+     * \brief execStream executes \p query delivering its rows in batches of up to \p chunkRows
+     *
+     * co_await the returned awaitable repeatedly, each AResult holds the next batch
+     * of rows until AResult::lastResultSet() is true, so that huge result sets can be
+     * consumed without being buffered entirely in memory, and with far fewer coroutine
+     * resumes than single row mode.
+     *
+     * On PostgreSQL 17+ this uses libpq's chunked rows mode, on older versions rows
+     * are read in single row mode and batched by the driver. Drivers without
+     * streaming support deliver all rows in a single result.
+     *
+     * \param query
+     * \param params
+     * \param chunkRows maximum number of rows in each result, 1 enables single row mode
+     * \param receiver that tracks the lifetime of this query
+     */
+    [[nodiscard]] AExpectedMultiResult execStream(QStringView query,
+                                                  const QVariantList &params,
+                                                  int chunkRows,
+                                                  QObject *receiver = nullptr);
+
+    /*!
+     * \brief execStream executes a prepared \p query delivering its rows in batches
+     * of up to \p chunkRows
+     *
+     * \sa execStream
+     */
+    [[nodiscard]] AExpectedMultiResult execStream(const APreparedQuery &query,
+                                                  const QVariantList &params,
+                                                  int chunkRows,
+                                                  QObject *receiver = nullptr);
+
+    /*!
+     * \brief copyIn starts a \c COPY ... \c FROM \c STDIN \p query
+     *
+     * Once the server is ready to receive data the returned awaitable delivers an
+     * ACopyIn object used to stream data, the connection can not run other queries
+     * until ACopyIn::finish() or ACopyIn::abort() is called, queries sent in the mean
+     * time are queued.
+     *
+     * \code
+     * auto copy = co_await db.copyIn(u"COPY items (id, name) FROM STDIN"_s);
+     * for (const auto &item : items) {
+     *     copy->writeRow({item.id, item.name});
+     * }
+     * auto result = co_await copy->finish();
+     * qDebug() << "imported" << result->numRowsAffected();
+     * \endcode
+     *
+     * \note Only supported by Postgres.
+     *
+     * \param query the COPY command
+     * \param receiver that tracks the lifetime of this query
+     */
+    [[nodiscard]] AExpectedCopyIn copyIn(QStringView query, QObject *receiver = nullptr);
+
+    /*!
+     * \brief copyOut runs a \c COPY ... \c TO \c STDOUT \p query delivering the data
+     * to \p chunkCb as it arrives
+     *
+     * Each chunk is only valid during the callback, which allows exporting large
+     * tables without holding them in memory. Once all data was delivered the returned
+     * awaitable completes, AResult::numRowsAffected() has the number of rows exported.
+     *
+     * \note Only supported by Postgres.
+     *
+     * \param query the COPY command
+     * \param chunkCb called for every chunk, in text and CSV formats a chunk is a row
+     * \param receiver that tracks the lifetime of this query
+     */
+    [[nodiscard]] AExpectedResult
+        copyOut(QStringView query, ACopyOutFn chunkCb, QObject *receiver = nullptr);
+
+    /*!
+     * \brief copyOut runs a \c COPY ... \c TO \c STDOUT \p query writing the data
+     * straight to \p device
+     *
+     * \note Data is written with QIODevice::write(), devices that buffer writes
+     * (e.g. sockets) keep the data in memory until it is sent.
+     */
+    [[nodiscard]] AExpectedResult
+        copyOut(QStringView query, QIODevice *device, QObject *receiver = nullptr);
+
+    /*!
+     * \brief cursor starts a transaction and declares a server side cursor for \p query
+     * whose rows are fetched in pages of \p pageSize rows
+     *
+     * BEGIN and the cursor declaration are queued together, ACursor::close() commits
+     * the transaction.
+     *
+     * \note Supported by Postgres and MySQL.
+     *
+     * \param query a query returning rows
+     * \param params the query parameters
+     * \param pageSize the maximum number of rows ACursor::fetch() returns
+     * \param receiver that tracks the lifetime of this query
+     */
+    [[nodiscard]] AExpectedCursor cursor(QStringView query,
+                                         const QVariantList &params = {},
+                                         int pageSize               = 1000,
+                                         QObject *receiver          = nullptr);
+
+    /*!
+     * \brief cursor declares a server side cursor for \p query inside the running
+     * \p transaction, which is left untouched by ACursor::close()
+     */
+    [[nodiscard]] AExpectedCursor cursor(const ATransaction &transaction,
+                                         QStringView query,
+                                         const QVariantList &params = {},
+                                         int pageSize               = 1000,
+                                         QObject *receiver          = nullptr);
+
     /**
      * @brief setSingleRowMode
      *
@@ -292,17 +538,68 @@ public:
      */
     void setLastQuerySingleRowMode();
 
+    /*!
+     * \brief setLastQueryChunkedRowsMode
+     *
+     * Enables chunked rows mode only for the last sent or queued query, results
+     * are delivered with up to \p rows each, use execMulti() to receive them.
+     * \sa execStream
+     */
+    void setLastQueryChunkedRowsMode(int rows);
+
+    enum class ResultFormat {
+        Text,
+        Binary,
+    };
+    Q_ENUM(ResultFormat)
+
+    /*!
+     * \brief setResultFormat selects the format in which the server sends the
+     * columns of queries executed after this call.
+     *
+     * Binary results are decoded natively instead of parsing their text form,
+     * which is noticeably cheaper for numbers, dates, timestamps and UUIDs.
+     * The format is captured when a query is sent or queued, so it can be switched
+     * around a single exec() call or set once for the whole connection.
+     *
+     * Connections returned to APool are reset to Text, use APool::setReuseHook() to
+     * select Binary for every connection handed out.
+     *
+     * \note Only supported by Postgres, other drivers ignore it.
+     * \note Postgres does not allow multiple commands in one query with binary results,
+     * types without a native decoder are returned as their raw binary representation.
+     */
+    void setResultFormat(ResultFormat format);
+
+    /*!
+     * \brief resultFormat returns the format requested for the results of new queries
+     */
+    [[nodiscard]] ResultFormat resultFormat() const;
+
     /**
      * @brief enterPipelineMode will enable the pipeline mode on the driver, it's queue must be
      * empty and the connection must be open
      *
-     * \param autoSyncMS if greater than zero it will setup a timer to send pipeline sync at each
-     * ms.
+     * \param timeout if greater than zero queries are synced at most \p timeout after being
+     * sent, enterPipelineModeWithPolicy() also adapts the batches to the load.
      *
      * @return
      */
     bool enterPipelineMode(std::chrono::milliseconds timeout = std::chrono::milliseconds{0});
 
+    /*!
+     * \brief enterPipelineModeWithPolicy enables the pipeline mode syncing queries as set
+     * by \p policy
+     *
+     * The default policy adapts to the load: a query sent while the connection is
+     * idle is synced immediately, queries sent while results are pending are sent
+     * in a single batch once they arrive. Limits and a latency budget bound how
+     * large the batches grow.
+     *
+     * \sa pipelineSyncStats
+     */
+    bool enterPipelineModeWithPolicy(const APipelineSyncPolicy &policy);
+
     /**
      * @brief exitPipelineMode disables the pipeline mode on the driver, its queue must be
      * empty and the connection must be open
@@ -327,6 +624,113 @@ public:
      */
     bool pipelineSync();
 
+    /*!
+     * \brief pipelineSyncStats returns the number and sizes of the batches synced in
+     * pipeline mode by this connection, to tune APipelineSyncPolicy
+     */
+    [[nodiscard]] APipelineSyncStats pipelineSyncStats() const;
+
+    /*!
+     * \brief setPreparedCacheCapacity limits the number of prepared statements kept by the server
+     *
+     * Once \p capacity statements are prepared on this connection the least recently used
+     * one is deallocated before a new one is prepared, queries using it are transparently
+     * prepared again when needed. Zero, the default, means no limit.
+     *
+     * For connections from APool set it on APool::setSetupHook().
+     *
+     * \note Only supported by Postgres, other drivers ignore it.
+     */
+    void setPreparedCacheCapacity(int capacity);
+
+    /*!
+     * \brief preparedCacheStats returns the hits, misses and evictions of the prepared
+     * statements cache of this connection
+     */
+    [[nodiscard]] APreparedCacheStats preparedCacheStats() const;
+
+    /*!
+     * \brief setAutoPipeline sends queued queries back-to-back in pipeline mode
+     *
+     * When enabled and more than one query is waiting on this connection they
+     * are all sent at once in pipeline mode, each followed by its own sync so that
+     * a failing query does not affect the others, just like when they are sent one
+     * at a time. Queries issued while the pipeline is running join it. This turns N
+     * round trips into one without changes to the code issuing the queries.
+     *
+     * Queries with multiple commands, COPY, prepared queries that still need to
+     * be prepared and queries in single or chunked rows mode are not pipelined,
+     * they are sent once the running pipeline completes.
+     *
+     * \note Only supported by Postgres, other drivers ignore it.
+     * \note Single and chunked rows mode set after a query joined a running pipeline
+     * are ignored, the rows are delivered in a single result.
+     */
+    void setAutoPipeline(bool enable);
+
+    /*!
+     * \brief autoPipeline returns true if queued queries are automatically pipelined
+     */
+    [[nodiscard]] bool autoPipeline() const;
+
+    /*!
+     * \brief setQueryTimeout sets how long queries executed after this call may take
+     *
+     * Queries that do not complete within \p timeout from the moment they are sent or
+     * queued fail with a "Query timed out" error. A query still waiting in the queue is
+     * removed from it, a query already running is cancelled on the server so that the
+     * connection can be used by the queries after it. The timeout is captured when a
+     * query is sent or queued, so it can be set around a single exec() call or once for
+     * the whole connection. Zero, the default, disables it.
+     *
+     * For connections from APool use APool::setQueryTimeout().
+     *
+     * \note Supported by Postgres, SQLite and MySQL, other drivers ignore it.
+     * \note A running query is cancelled with a best effort request, if it completes
+     * right before the request arrives the server might cancel the query after it.
+     */
+    void setQueryTimeout(std::chrono::milliseconds timeout);
+
+    /*!
+     * \brief queryTimeout returns the timeout of new queries, zero means no timeout
+     */
+    [[nodiscard]] std::chrono::milliseconds queryTimeout() const;
+
+    enum class QueueOverflow {
+        /*! Queries that do not fit fail right away with a "Query queue is full" error */
+        Fail,
+        /*! Queries that do not fit are queued once earlier queries complete */
+        Wait,
+    };
+    Q_ENUM(QueueOverflow)
+
+    /*!
+     * \brief setMaxQueueSize limits how many queries can be queued on this connection
+     *
+     * A connection runs its queries one after the other, so under a traffic spike an
+     * unbounded queue only makes every query wait longer. Once \l queueSize() reaches
+     * \p max the \p overflow policy decides what happens to new queries, either they
+     * fail so that the load can be shed, or their awaitables wait until there is room.
+     *
+     * Transaction control, begin(), commit() and rollback(), is not limited so that
+     * transactions already started can always finish. Neither are the statements of a
+     * TransactionMode::Pipelined transaction, its COMMIT is queued right after them and
+     * could otherwise run first or commit part of it. Zero, the default, means unlimited.
+     *
+     * For connections from APool use APool::setMaxQueueSize().
+     */
+    void setMaxQueueSize(int max, QueueOverflow overflow = QueueOverflow::Fail);
+
+    /*!
+     * \brief maxQueueSize returns the maximum number of queued queries, zero means unlimited
+     */
+    [[nodiscard]] int maxQueueSize() const;
+
+    /*!
+     * \brief queueOverflow returns what happens to queries that do not fit in the queue
+     */
+    [[nodiscard]] QueueOverflow queueOverflow() const;
+
     /*!
      * \brief subscribeToNotification will start listening for notifications
      * described by name
@@ -366,6 +770,7 @@ public:
      * and sent to the database.
      *
      * In pipeline mode they are also queued but sent to the database immediately.
+     * Queries waiting for room in a full queue are not counted, see \l setMaxQueueSize().
      * \return
      */
     [[nodiscard]] int queueSize() const;
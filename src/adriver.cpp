@@ -8,6 +8,8 @@
 #include "aresult.h"
 #include "asql_connection_util.h"
 
+#include <utility>
+
 #include <QDate>
 #include <QJsonValue>
 #include <QUuid>
@@ -56,6 +58,11 @@ ADriver::ADriver(const QString &connectionInfo)
 {
 }
 
+ADriver::~ADriver()
+{
+    failQueueWaiters(u"Database connection destroyed"_s);
+}
+
 QString ADriver::connectionInfo() const
 {
     return m_info;
@@ -105,6 +112,31 @@ void ADriver::begin(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoro
     }
 }
 
+bool ADriver::beginPipelined(const std::shared_ptr<ADriver> &db)
+{
+    Q_UNUSED(db);
+    return false;
+}
+
+bool ADriver::pipelinedTransaction() const
+{
+    return false;
+}
+
+void ADriver::beginPipelineBatch(const std::shared_ptr<ADriver> &db,
+                                 const std::shared_ptr<APipelineBatch> &batch,
+                                 int queries)
+{
+    Q_UNUSED(db);
+    Q_UNUSED(batch);
+    Q_UNUSED(queries);
+}
+
+void ADriver::endPipelineBatch(const std::shared_ptr<ADriver> &db)
+{
+    Q_UNUSED(db);
+}
+
 void ADriver::commit(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoroDataRef cb)
 {
     Q_UNUSED(db);
@@ -189,13 +221,129 @@ void ADriver::exec(const std::shared_ptr<ADriver> &db,
     }
 }
 
+void ADriver::copyIn(const std::shared_ptr<ADriver> &driver,
+                     QStringView query,
+                     QObject *receiver,
+                     ACoroDataRef cb)
+{
+    Q_UNUSED(driver);
+    Q_UNUSED(query);
+    Q_UNUSED(receiver);
+    if (cb) {
+        AResult result(std::shared_ptr<AResultInvalid>(new AResultInvalid));
+        cb.deliverResult(result);
+    }
+}
+
+void ADriver::copyOut(const std::shared_ptr<ADriver> &driver,
+                      QStringView query,
+                      ACopyOutFn chunkCb,
+                      QObject *receiver,
+                      ACoroDataRef cb)
+{
+    Q_UNUSED(driver);
+    Q_UNUSED(query);
+    Q_UNUSED(chunkCb);
+    Q_UNUSED(receiver);
+    if (cb) {
+        AResult result(std::shared_ptr<AResultInvalid>(new AResultInvalid));
+        cb.deliverResult(result);
+    }
+}
+
+bool ADriver::copyInData(QByteArrayView data)
+{
+    Q_UNUSED(data);
+    return false;
+}
+
+bool ADriver::copyInRow(const QVariantList &row)
+{
+    Q_UNUSED(row);
+    return false;
+}
+
+bool ADriver::copyInBinaryRow(const QVariantList &row)
+{
+    Q_UNUSED(row);
+    return false;
+}
+
+void ADriver::copyInFlush(const std::shared_ptr<ADriver> &driver,
+                          QObject *receiver,
+                          ACoroDataRef cb)
+{
+    Q_UNUSED(driver);
+    Q_UNUSED(receiver);
+    if (cb) {
+        AResult result(std::shared_ptr<AResultInvalid>(new AResultInvalid));
+        cb.deliverResult(result);
+    }
+}
+
+void ADriver::copyInEnd(const std::shared_ptr<ADriver> &driver,
+                        const QString &error,
+                        QObject *receiver,
+                        ACoroDataRef cb)
+{
+    Q_UNUSED(driver);
+    Q_UNUSED(error);
+    Q_UNUSED(receiver);
+    if (cb) {
+        AResult result(std::shared_ptr<AResultInvalid>(new AResultInvalid));
+        cb.deliverResult(result);
+    }
+}
+
+void ADriver::cursorDeclare(const std::shared_ptr<ADriver> &driver,
+                            const QString &name,
+                            QStringView query,
+                            const QVariantList &params,
+                            int pageSize,
+                            QObject *receiver,
+                            ACoroDataRef cb)
+{
+    Q_UNUSED(pageSize);
+    exec(driver,
+         QString{u"DECLARE " + name + u" NO SCROLL CURSOR FOR " + query},
+         params,
+         receiver,
+         std::move(cb));
+}
+
+void ADriver::cursorFetch(const std::shared_ptr<ADriver> &driver,
+                          const QString &name,
+                          int count,
+                          QObject *receiver,
+                          ACoroDataRef cb)
+{
+    exec(driver,
+         QString{u"FETCH FORWARD " + QString::number(count) + u" FROM " + name},
+         QVariantList{},
+         receiver,
+         std::move(cb));
+}
+
+void ADriver::cursorClose(const std::shared_ptr<ADriver> &driver,
+                          const QString &name,
+                          QObject *receiver,
+                          ACoroDataRef cb)
+{
+    exec(driver, QString{u"CLOSE " + name}, QVariantList{}, receiver, std::move(cb));
+}
+
 void ADriver::setLastQuerySingleRowMode()
 {
 }
 
-bool ADriver::enterPipelineMode(std::chrono::milliseconds timeout)
+void ADriver::setLastQueryChunkedRowsMode(int rows)
+{
+    Q_UNUSED(rows);
+}
+
+bool ADriver::enterPipelineMode(const APipelineSyncPolicy &policy)
 {
-    Q_UNUSED(timeout);
+    Q_UNUSED(policy);
     return false;
 }
 
@@ -214,11 +362,115 @@ bool ADriver::pipelineSync()
     return false;
 }
 
+APipelineSyncStats ADriver::pipelineSyncStats() const
+{
+    return {};
+}
+
+void ADriver::setPreparedCacheCapacity(const std::shared_ptr<ADriver> &driver, int capacity)
+{
+    Q_UNUSED(driver);
+    Q_UNUSED(capacity);
+}
+
+APreparedCacheStats ADriver::preparedCacheStats() const
+{
+    return {};
+}
+
+void ADriver::setAutoPipeline(bool enable)
+{
+    Q_UNUSED(enable);
+}
+
+bool ADriver::autoPipeline() const
+{
+    return false;
+}
+
+void ADriver::setResultFormat(ADatabase::ResultFormat format)
+{
+    Q_UNUSED(format);
+}
+
+ADatabase::ResultFormat ADriver::resultFormat() const
+{
+    return ADatabase::ResultFormat::Text;
+}
+
 int ADriver::queueSize() const
 {
     return -1;
 }
 
+void ADriver::setQueryTimeout(std::chrono::milliseconds timeout)
+{
+    m_queryTimeout = timeout;
+}
+
+std::chrono::milliseconds ADriver::queryTimeout() const
+{
+    return m_queryTimeout;
+}
+
+void ADriver::setMaxQueueSize(int max, ADatabase::QueueOverflow overflow)
+{
+    m_maxQueueSize  = std::max(max, 0);
+    m_queueOverflow = overflow;
+    // A larger limit has room for queries already waiting
+    wakeQueueWaiters();
+}
+
+int ADriver::maxQueueSize() const
+{
+    return m_maxQueueSize;
+}
+
+ADatabase::QueueOverflow ADriver::queueOverflow() const
+{
+    return m_queueOverflow;
+}
+
+void ADriver::waitQueueRoom(std::function<void()> send,
+                            std::function<void(const QString &)> fail,
+                            int queries)
+{
+    m_queueWaiters.push_back({
+        .send    = std::move(send),
+        .fail    = std::move(fail),
+        .queries = queries,
+    });
+}
+
+void ADriver::failQueueWaiters(const QString &error)
+{
+    // Failing a query might queue new ones, those wait for the next failure or room
+    auto waiters = std::exchange(m_queueWaiters, {});
+    for (auto &waiter : waiters) {
+        waiter.fail(error);
+    }
+}
+
+void ADriver::sendQueueWaiters()
+{
+    // Each query sent takes room again, so only as many as fit are sent
+    while (!m_queueWaiters.empty() &&
+           (m_maxQueueSize == 0 ||
+            queueSize() + m_queueWaiters.front().queries <= m_maxQueueSize)) {
+        auto waiter = std::move(m_queueWaiters.front());
+        m_queueWaiters.pop_front();
+        waiter.send();
+    }
+}
+
+QDeadlineTimer ADriver::queryDeadline() const
+{
+    if (m_queryTimeout.count() > 0) {
+        return QDeadlineTimer{m_queryTimeout};
+    }
+    return QDeadlineTimer{QDeadlineTimer::Forever};
+}
+
 void ADriver::subscribeToNotification(const std::shared_ptr<ADriver> &db,
                                       const QString &name,
                                       QObject *receiver,
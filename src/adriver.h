@@ -8,6 +8,10 @@
 #include <asql_coro_delivery.h>
 #include <asql_export.h>
 
+#include <deque>
+#include <functional>
+
+#include <QDeadlineTimer>
 #include <QObject>
 #include <QSocketNotifier>
 #include <QString>
@@ -16,13 +20,24 @@ namespace ASql {
 
 class AResult;
 class APreparedQuery;
+
+/*!
+ * \brief APipelineBatch is shared by ADatabase and the driver sending the queries
+ * of a pipeline, the driver sets \c synced if they were all followed by a single sync
+ */
+class APipelineBatch
+{
+public:
+    bool synced = false;
+};
+
 class ASQL_EXPORT ADriver : public QObject
 {
     Q_OBJECT
 public:
     ADriver();
     ADriver(const QString &connectionInfo);
-    virtual ~ADriver() = default;
+    virtual ~ADriver();
 
     QString connectionInfo() const;
     QString redactedConnectionInfo() const;
@@ -36,6 +51,12 @@ public:
     virtual bool isOpen() const;
 
     virtual void begin(const std::shared_ptr<ADriver> &driver, QObject *receiver, ACoroDataRef cb);
+    virtual bool beginPipelined(const std::shared_ptr<ADriver> &driver);
+    virtual bool pipelinedTransaction() const;
+    virtual void beginPipelineBatch(const std::shared_ptr<ADriver> &driver,
+                                    const std::shared_ptr<APipelineBatch> &batch,
+                                    int queries);
+    virtual void endPipelineBatch(const std::shared_ptr<ADriver> &driver);
     virtual void commit(const std::shared_ptr<ADriver> &driver, QObject *receiver, ACoroDataRef cb);
     virtual void
         rollback(const std::shared_ptr<ADriver> &driver, QObject *receiver, ACoroDataRef cb);
@@ -68,9 +89,55 @@ public:
                       QObject *receiver,
                       ACoroDataRef cb);
 
+    virtual void copyIn(const std::shared_ptr<ADriver> &driver,
+                        QStringView query,
+                        QObject *receiver,
+                        ACoroDataRef cb);
+
+    virtual void copyOut(const std::shared_ptr<ADriver> &driver,
+                         QStringView query,
+                         ACopyOutFn chunkCb,
+                         QObject *receiver,
+                         ACoroDataRef cb);
+
+    virtual bool copyInData(QByteArrayView data);
+
+    virtual bool copyInRow(const QVariantList &row);
+
+    virtual bool copyInBinaryRow(const QVariantList &row);
+
+    virtual void
+        copyInFlush(const std::shared_ptr<ADriver> &driver, QObject *receiver, ACoroDataRef cb);
+
+    virtual void copyInEnd(const std::shared_ptr<ADriver> &driver,
+                           const QString &error,
+                           QObject *receiver,
+                           ACoroDataRef cb);
+
+    virtual void cursorDeclare(const std::shared_ptr<ADriver> &driver,
+                               const QString &name,
+                               QStringView query,
+                               const QVariantList &params,
+                               int pageSize,
+                               QObject *receiver,
+                               ACoroDataRef cb);
+
+    virtual void cursorFetch(const std::shared_ptr<ADriver> &driver,
+                             const QString &name,
+                             int count,
+                             QObject *receiver,
+                             ACoroDataRef cb);
+
+    virtual void cursorClose(const std::shared_ptr<ADriver> &driver,
+                             const QString &name,
+                             QObject *receiver,
+                             ACoroDataRef cb);
+
     virtual void setLastQuerySingleRowMode();
 
-    virtual bool enterPipelineMode(std::chrono::milliseconds timeout);
+    virtual void setLastQueryChunkedRowsMode(int rows);
+
+    virtual bool enterPipelineMode(const APipelineSyncPolicy &policy);
 
     virtual bool exitPipelineMode();
 
@@ -78,8 +145,54 @@ public:
 
     virtual bool pipelineSync();
 
+    virtual APipelineSyncStats pipelineSyncStats() const;
+
+    virtual void setPreparedCacheCapacity(const std::shared_ptr<ADriver> &driver, int capacity);
+
+    virtual APreparedCacheStats preparedCacheStats() const;
+
+    virtual void setAutoPipeline(bool enable);
+
+    virtual bool autoPipeline() const;
+
+    virtual void setResultFormat(ADatabase::ResultFormat format);
+
+    virtual ADatabase::ResultFormat resultFormat() const;
+
     virtual int queueSize() const;
 
+    void setQueryTimeout(std::chrono::milliseconds timeout);
+
+    std::chrono::milliseconds queryTimeout() const;
+
+    void setMaxQueueSize(int max, ADatabase::QueueOverflow overflow);
+
+    int maxQueueSize() const;
+
+    ADatabase::QueueOverflow queueOverflow() const;
+
+    /*!
+     * \brief queueFull returns true if \p queries queued now would not fit, or would
+     * jump ahead of queries already waiting for room
+     *
+     * Statements of an open pipelined transaction always fit, as its end is not limited
+     * and would otherwise run before them.
+     */
+    inline bool queueFull(int queries = 1) const
+    {
+        return m_maxQueueSize > 0 &&
+               (queueSize() + queries > m_maxQueueSize || !m_queueWaiters.empty()) &&
+               !pipelinedTransaction();
+    }
+
+    /*!
+     * \brief waitQueueRoom calls \p send once the queue has room for \p queries more,
+     * or \p fail if the connection is lost or destroyed before that
+     */
+    void waitQueueRoom(std::function<void()> send,
+                       std::function<void(const QString &)> fail,
+                       int queries = 1);
+
     virtual void subscribeToNotification(const std::shared_ptr<ADriver> &driver,
                                          const QString &name,
                                          QObject *receiver,
@@ -92,8 +205,43 @@ Q_SIGNALS:
     void stateChanged(ASql::ADatabase::State state, const QString &status);
     void notificationReceived(const ASql::ADatabaseNotification &notification);
 
+protected:
+    /*!
+     * \brief queryDeadline returns the deadline of a query sent or queued now
+     */
+    QDeadlineTimer queryDeadline() const;
+
+    /*!
+     * \brief wakeQueueWaiters sends the queries waiting for room in the queue,
+     * drivers call it after queries left their queue
+     */
+    inline void wakeQueueWaiters()
+    {
+        if (!m_queueWaiters.empty()) {
+            sendQueueWaiters();
+        }
+    }
+
+    /*!
+     * \brief failQueueWaiters fails the queries waiting for room in the queue with
+     * \p error, drivers call it when the connection is lost
+     */
+    void failQueueWaiters(const QString &error);
+
 private:
+    void sendQueueWaiters();
+
+    struct QueueWaiter {
+        std::function<void()> send;
+        std::function<void(const QString &)> fail;
+        int queries = 1;
+    };
+
     QString m_info;
+    std::deque<QueueWaiter> m_queueWaiters;
+    std::chrono::milliseconds m_queryTimeout{0};
+    int m_maxQueueSize                       = 0;
+    ADatabase::QueueOverflow m_queueOverflow = ADatabase::QueueOverflow::Fail;
 };
 
 } // namespace ASql
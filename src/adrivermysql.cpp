@@ -78,11 +78,6 @@ qint64 AResultMysql::numRowsAffected() const
     return m_numRowsAffected;
 }
 
-int AResultMysql::indexOfField(QLatin1String name) const
-{
-    return m_fields.indexOf(name);
-}
-
 QString AResultMysql::fieldName(int column) const
 {
     if (column >= 0 && column < m_fields.size()) {
@@ -367,6 +362,9 @@ static std::optional<QString> mysqlBindParams(MYSQL_STMT *stmt,
 /*!
  * \brief Fetches all rows from a prepared-statement result set into \a rows.
  *
+ * When \a maxRows is not negative at most that many rows are fetched, leaving
+ * the remaining ones for a later call, as needed by cursors.
+ *
  * Binds all result columns with a 256-byte initial buffer (large enough for
  * typical scalar values).  If a value is truncated, mysql_stmt_fetch_column()
  * is used to retrieve the full data.  Binary/BLOB columns are returned as
@@ -377,7 +375,8 @@ static std::optional<QString> mysqlBindParams(MYSQL_STMT *stmt,
 static std::optional<QString> mysqlFetchStmtRows(MYSQL_STMT *stmt,
                                                  unsigned int numFields,
                                                  MYSQL_FIELD *fields,
-                                                 QVariantList &rows)
+                                                 QVariantList &rows,
+                                                 int maxRows = -1)
 {
     // Initial buffer per column — covers nearly all scalar values without a
     // second fetch, but is small enough to avoid excessive allocation for
@@ -417,8 +416,11 @@ static std::optional<QString> mysqlFetchStmtRows(MYSQL_STMT *stmt,
         return QString::fromUtf8(mysql_stmt_error(stmt));
     }
 
-    int fetchRet;
-    while ((fetchRet = mysql_stmt_fetch(stmt)) == 0 || fetchRet == MYSQL_DATA_TRUNCATED) {
+    int fetchRet = MYSQL_NO_DATA;
+    int fetched  = 0;
+    while ((maxRows < 0 || fetched < maxRows) &&
+           ((fetchRet = mysql_stmt_fetch(stmt)) == 0 || fetchRet == MYSQL_DATA_TRUNCATED)) {
+        ++fetched;
         for (unsigned int i = 0; i < numFields; ++i) {
             if (isNull[i]) {
                 rows.append(QVariant{});
@@ -455,7 +457,7 @@ static std::optional<QString> mysqlFetchStmtRows(MYSQL_STMT *stmt,
         }
     }
 
-    if (fetchRet != MYSQL_NO_DATA) {
+    if (fetchRet != MYSQL_NO_DATA && fetchRet != 0 && fetchRet != MYSQL_DATA_TRUNCATED) {
         return QString::fromUtf8(mysql_stmt_error(stmt));
     }
     return {};
@@ -477,12 +479,26 @@ AMysqlThread::~AMysqlThread()
         for (MYSQL_STMT *stmt : m_preparedQueries) {
             mysql_stmt_close(stmt);
         }
+        for (MYSQL_STMT *stmt : m_cursors) {
+            mysql_stmt_close(stmt);
+        }
         mysql_close(m_mysql);
     }
 }
 
 void AMysqlThread::enqueueAndSignal(MysqlQueryPromise &promise)
 {
+    {
+        // Waits for a KILL being sent, the next query must not receive it
+        QMutexLocker _(&m_running->mutex);
+        m_running->serial = 0;
+    }
+    if (promise.result->m_error && !promise.deadline.isForever() &&
+        promise.deadline.hasExpired()) {
+        // Most likely interrupted by KILL QUERY
+        promise.result->m_error = u"Query timed out"_s;
+    }
+
     {
         QMutexLocker _(&m_promisesMutex);
         m_promisesReady.enqueue(std::move(promise));
@@ -490,25 +506,27 @@ void AMysqlThread::enqueueAndSignal(MysqlQueryPromise &promise)
     Q_EMIT queryReady();
 }
 
-void AMysqlThread::open()
+namespace {
+
+MYSQL *mysqlConnect(const QString &connInfo, QString &error)
 {
-    m_mysql = mysql_init(nullptr);
-    if (!m_mysql) {
-        Q_EMIT openned(false, u"mysql_init() failed: out of memory"_s);
-        return;
+    MYSQL *mysql = mysql_init(nullptr);
+    if (!mysql) {
+        error = u"mysql_init() failed: out of memory"_s;
+        return nullptr;
     }
 
-    QUrl url(m_connInfo);
+    QUrl url(connInfo);
     QUrlQuery query(url);
 
     unsigned int connectTimeout = query.queryItemValue(u"connect_timeout"_s).toUInt();
     if (connectTimeout > 0) {
-        mysql_options(m_mysql, MYSQL_OPT_CONNECT_TIMEOUT, &connectTimeout);
+        mysql_options(mysql, MYSQL_OPT_CONNECT_TIMEOUT, &connectTimeout);
     }
 
     unsigned int readTimeout = query.queryItemValue(u"read_timeout"_s).toUInt();
     if (readTimeout > 0) {
-        mysql_options(m_mysql, MYSQL_OPT_READ_TIMEOUT, &readTimeout);
+        mysql_options(mysql, MYSQL_OPT_READ_TIMEOUT, &readTimeout);
     }
 
     unsigned long clientFlags = 0;
@@ -529,7 +547,7 @@ void AMysqlThread::open()
     if ((clientFlags & CLIENT_SSL) || !sslCa.isEmpty() || !sslCert.isEmpty() || !sslKey.isEmpty() ||
         !sslCipher.isEmpty()) {
         // Order is key, cert, ca, capath, cipher (was previously key/ca swapped).
-        mysql_ssl_set(m_mysql,
+        mysql_ssl_set(mysql,
                       sslKey.isEmpty() ? nullptr : sslKey.constData(),
                       sslCert.isEmpty() ? nullptr : sslCert.constData(),
                       sslCa.isEmpty() ? nullptr : sslCa.constData(),
@@ -543,7 +561,7 @@ void AMysqlThread::open()
     const QByteArray database = url.path().mid(1).toUtf8(); // strip leading '/'
     const unsigned int port   = (url.port() > 0) ? static_cast<unsigned int>(url.port()) : 3306u;
 
-    MYSQL *conn = mysql_real_connect(m_mysql,
+    MYSQL *conn = mysql_real_connect(mysql,
                                      host.isEmpty() ? nullptr : host.constData(),
                                      user.isEmpty() ? nullptr : user.constData(),
                                      password.isEmpty() ? nullptr : password.constData(),
@@ -553,16 +571,77 @@ void AMysqlThread::open()
                                      clientFlags);
 
     if (!conn) {
-        const QString error = QString::fromUtf8(mysql_error(m_mysql));
-        mysql_close(m_mysql);
-        m_mysql = nullptr;
+        error = QString::fromUtf8(mysql_error(mysql));
+        mysql_close(mysql);
+        return nullptr;
+    }
+
+    return mysql;
+}
+
+} // namespace
+
+void AMysqlThread::open()
+{
+    QString error;
+    m_mysql = mysqlConnect(m_connInfo, error);
+    if (!m_mysql) {
         Q_EMIT openned(false, error);
         return;
     }
 
+    m_threadId = mysql_thread_id(m_mysql);
     Q_EMIT openned(true, {});
 }
 
+void AMysqlThread::killQuery(const QString &connInfo,
+                             unsigned long threadId,
+                             std::shared_ptr<AMysqlRunning> running,
+                             quint64 serial)
+{
+    QString error;
+    MYSQL *mysql = mysqlConnect(connInfo, error);
+    if (!mysql) {
+        qWarning(ASQL_MYSQL) << "Failed to connect to kill query" << threadId << error;
+        mysql_thread_end();
+        return;
+    }
+
+    {
+        // The query might have completed while connecting, and a KILL QUERY
+        // received by an idle connection is cleared by its next query
+        QMutexLocker _(&running->mutex);
+        if (running->serial == serial) {
+            const QByteArray kill = "KILL QUERY " + QByteArray::number(quint64(threadId));
+            if (mysql_real_query(
+                    mysql, kill.constData(), static_cast<unsigned long>(kill.size())) != 0) {
+                qWarning(ASQL_MYSQL) << "Failed to kill query" << threadId << mysql_error(mysql);
+            }
+        }
+    }
+    mysql_close(mysql);
+    mysql_thread_end();
+}
+
+bool AMysqlThread::startDeadline(MysqlQueryPromise &promise)
+{
+    if (promise.deadline.hasExpired()) {
+        // Timed out while waiting in the queue
+        promise.result->m_error = u"Query timed out"_s;
+        return false;
+    }
+
+    if (!promise.deadline.isForever()) {
+        // The driver kills the query if it's still running by then
+        {
+            QMutexLocker _(&m_running->mutex);
+            m_running->serial = ++m_serial;
+        }
+        Q_EMIT deadlineStarted(m_serial, promise.deadline.deadline());
+    }
+    return true;
+}
+
 MYSQL_STMT *AMysqlThread::prepare(MysqlQueryPromise &promise)
 {
     MYSQL_STMT *stmt = mysql_stmt_init(m_mysql);
@@ -585,6 +664,10 @@ void AMysqlThread::query(MysqlQueryPromise promise)
 {
     auto _ = qScopeGuard([&] { enqueueAndSignal(promise); });
 
+    if (!startDeadline(promise)) {
+        return;
+    }
+
     MYSQL_STMT *stmt = prepare(promise);
     if (!stmt) {
         return;
@@ -638,6 +721,11 @@ void AMysqlThread::query(MysqlQueryPromise promise)
 
 void AMysqlThread::queryPrepared(MysqlQueryPromise promise)
 {
+    if (!startDeadline(promise)) {
+        enqueueAndSignal(promise);
+        return;
+    }
+
     const int queryId = promise.preparedQuery->identification();
 
     MYSQL_STMT *stmt = nullptr;
@@ -712,6 +800,10 @@ void AMysqlThread::queryExec(MysqlQueryPromise promise)
 {
     auto _ = qScopeGuard([&] { enqueueAndSignal(promise); });
 
+    if (!startDeadline(promise)) {
+        return;
+    }
+
     const QByteArray &sql = promise.result->m_query;
     if (mysql_real_query(m_mysql, sql.constData(), static_cast<unsigned long>(sql.size())) != 0) {
         promise.result->m_error = QString::fromUtf8(mysql_error(m_mysql));
@@ -743,6 +835,109 @@ void AMysqlThread::queryExec(MysqlQueryPromise promise)
     promise.result->m_numRowsAffected = static_cast<qint64>(mysql_affected_rows(m_mysql));
 }
 
+void AMysqlThread::cursorDeclare(MysqlQueryPromise promise)
+{
+    auto _ = qScopeGuard([&] { enqueueAndSignal(promise); });
+
+    if (!startDeadline(promise)) {
+        return;
+    }
+
+    if (m_cursors.contains(promise.cursor)) {
+        promise.result->m_error = u"Cursor already declared"_s;
+        return;
+    }
+
+    MYSQL_STMT *stmt = prepare(promise);
+    if (!stmt) {
+        return;
+    }
+    auto stmtGuard = qScopeGuard([&] { mysql_stmt_close(stmt); });
+
+    // Rows stay on the server and are sent in batches of a page as they are fetched
+    unsigned long cursorType   = CURSOR_TYPE_READ_ONLY;
+    unsigned long prefetchRows = static_cast<unsigned long>(promise.fetchCount);
+    if (mysql_stmt_attr_set(stmt, STMT_ATTR_CURSOR_TYPE, &cursorType) ||
+        mysql_stmt_attr_set(stmt, STMT_ATTR_PREFETCH_ROWS, &prefetchRows)) {
+        promise.result->m_error = QString::fromUtf8(mysql_stmt_error(stmt));
+        return;
+    }
+
+    const QVariantList &params = promise.result->m_queryArgs;
+    // Bind data must outlive mysql_stmt_execute() since MySQL stores pointers
+    // into these buffers.  Declare outside the if-block intentionally.
+    std::vector<MYSQL_BIND> binds;
+    std::vector<long long> intVals;
+    std::vector<double> doubleVals;
+    std::unique_ptr<MysqlBool[]> nullFlags;
+    std::vector<QByteArray> strVals;
+    std::vector<unsigned long> strLengths;
+
+    if (!params.isEmpty()) {
+        auto bindErr = mysqlBindParams(
+            stmt, params, binds, intVals, doubleVals, nullFlags, strVals, strLengths);
+        if (bindErr.has_value()) {
+            promise.result->m_error = bindErr;
+            return;
+        }
+    }
+
+    if (mysql_stmt_execute(stmt) != 0) {
+        promise.result->m_error = QString::fromUtf8(mysql_stmt_error(stmt));
+        return;
+    }
+
+    stmtGuard.dismiss();
+    m_cursors.insert(promise.cursor, stmt);
+}
+
+void AMysqlThread::cursorFetch(MysqlQueryPromise promise)
+{
+    auto _ = qScopeGuard([&] { enqueueAndSignal(promise); });
+
+    if (!startDeadline(promise)) {
+        return;
+    }
+
+    MYSQL_STMT *stmt = m_cursors.value(promise.cursor);
+    if (!stmt) {
+        promise.result->m_error = u"Cursor not declared"_s;
+        return;
+    }
+
+    MYSQL_RES *meta = mysql_stmt_result_metadata(stmt);
+    if (!meta) {
+        promise.result->m_error = u"Cursor query does not return rows"_s;
+        return;
+    }
+    auto metaGuard = qScopeGuard([&] { mysql_free_result(meta); });
+
+    const unsigned int numFields = mysql_num_fields(meta);
+    MYSQL_FIELD *fields          = mysql_fetch_fields(meta);
+    promise.result->m_fields.reserve(static_cast<int>(numFields));
+    for (unsigned int i = 0; i < numFields; ++i) {
+        promise.result->m_fields.append(QString::fromUtf8(fields[i].name));
+    }
+
+    auto fetchErr = mysqlFetchStmtRows(
+        stmt, numFields, fields, promise.result->m_rows, promise.fetchCount);
+    if (fetchErr.has_value()) {
+        promise.result->m_error = fetchErr;
+    }
+}
+
+void AMysqlThread::cursorClose(MysqlQueryPromise promise)
+{
+    auto _ = qScopeGuard([&] { enqueueAndSignal(promise); });
+
+    MYSQL_STMT *stmt = m_cursors.take(promise.cursor);
+    if (!stmt) {
+        promise.result->m_error = u"Cursor not declared"_s;
+        return;
+    }
+    mysql_stmt_close(stmt);
+}
+
 // ---------------------------------------------------------------------------
 // ADriverMysql
 // ---------------------------------------------------------------------------
@@ -754,6 +949,14 @@ ADriverMysql::ADriverMysql(const QString &connInfo)
     m_thread.setObjectName(connectionThreadName(connInfo));
     m_worker.moveToThread(&m_thread);
 
+    m_deadlineTimer.setSingleShot(true);
+    connect(&m_worker,
+            &AMysqlThread::deadlineStarted,
+            this,
+            &ADriverMysql::armDeadline,
+            Qt::QueuedConnection);
+    connect(&m_deadlineTimer, &QTimer::timeout, this, &ADriverMysql::killTimedOutQuery);
+
     connect(&m_worker, &AMysqlThread::queryReady, this, [this] {
         Q_ASSERT(this);
         QQueue<MysqlQueryPromise> ready;
@@ -770,8 +973,13 @@ ADriverMysql::ADriverMysql(const QString &connInfo)
                 }
             }
 
-            if (promise.result->m_lastResultSet && --m_queueSize == 0) {
-                selfDriver.reset();
+            if (promise.result->m_lastResultSet) {
+                --m_queueSize;
+                // Queries waiting for room are queued before we might release ourself
+                wakeQueueWaiters();
+                if (m_queueSize == 0) {
+                    selfDriver.reset();
+                }
             }
         }
     }, Qt::QueuedConnection);
@@ -788,6 +996,36 @@ ADriverMysql::~ADriverMysql()
     m_thread.wait();
 }
 
+void ADriverMysql::armDeadline(quint64 serial, qint64 deadline)
+{
+    QDeadlineTimer timer;
+    timer.setDeadline(deadline);
+    m_deadlineSerial = serial;
+    m_deadlineTimer.start(
+        std::chrono::ceil<std::chrono::milliseconds>(timer.remainingTimeAsDuration()));
+}
+
+void ADriverMysql::killTimedOutQuery()
+{
+    {
+        QMutexLocker _(&m_worker.m_running->mutex);
+        if (m_worker.m_running->serial != m_deadlineSerial) {
+            // The query completed in the mean time
+            return;
+        }
+    }
+
+    // KILL QUERY needs another connection, opening it must not block the event loop
+    qDebug(ASQL_MYSQL) << "Query timed out, killing it";
+    QThread *killer = QThread::create(&AMysqlThread::killQuery,
+                                      connectionInfo(),
+                                      m_worker.m_threadId.load(),
+                                      m_worker.m_running,
+                                      m_deadlineSerial);
+    connect(killer, &QThread::finished, killer, &QObject::deleteLater);
+    killer->start();
+}
+
 QString ADriverMysql::driverName() const
 {
     return u"mysql"_s;
@@ -847,7 +1085,10 @@ void ADriverMysql::open(const std::shared_ptr<ADriver> &driver, QObject *receive
 
         deliverOpenWaiters(isOpen, error);
 
-        if (--m_queueSize == 0) {
+        --m_queueSize;
+        // Queries waiting for room are queued before we might release ourself
+        wakeQueueWaiters();
+        if (m_queueSize == 0) {
             selfDriver.reset();
         }
     }, Qt::SingleShotConnection);
@@ -905,6 +1146,7 @@ void ADriverMysql::exec(const std::shared_ptr<ADriver> &db,
     if (receiver) {
         data.receiver = receiver;
     }
+    data.deadline = queryDeadline();
     data.result->m_query.setRawData(query.data(), query.size());
 
 #if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
@@ -933,6 +1175,7 @@ void ADriverMysql::exec(const std::shared_ptr<ADriver> &db,
     if (receiver) {
         data.receiver = receiver;
     }
+    data.deadline = queryDeadline();
     data.result->m_query = query.toUtf8();
 
 #if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
@@ -962,6 +1205,7 @@ void ADriverMysql::exec(const std::shared_ptr<ADriver> &db,
     if (receiver) {
         data.receiver = receiver;
     }
+    data.deadline = queryDeadline();
     data.result->m_query.setRawData(query.data(), query.size());
     data.result->m_queryArgs = params;
 
@@ -990,6 +1234,7 @@ void ADriverMysql::exec(const std::shared_ptr<ADriver> &db,
     if (receiver) {
         data.receiver = receiver;
     }
+    data.deadline = queryDeadline();
     data.result->m_query     = query.toUtf8();
     data.result->m_queryArgs = params;
 
@@ -1019,6 +1264,7 @@ void ADriverMysql::exec(const std::shared_ptr<ADriver> &db,
     if (receiver) {
         data.receiver = receiver;
     }
+    data.deadline = queryDeadline();
     data.result->m_query     = query.query();
     data.result->m_queryArgs = params;
 
@@ -1033,14 +1279,108 @@ void ADriverMysql::exec(const std::shared_ptr<ADriver> &db,
 #endif
 }
 
+void ADriverMysql::cursorDeclare(const std::shared_ptr<ADriver> &db,
+                                 const QString &name,
+                                 QStringView query,
+                                 const QVariantList &params,
+                                 int pageSize,
+                                 QObject *receiver,
+                                 ACoroDataRef cb)
+{
+    ++m_queueSize;
+    selfDriver = db;
+
+    MysqlQueryPromise data{
+        .cb         = std::move(cb),
+        .result     = std::make_shared<AResultMysql>(),
+        .cursor     = name,
+        .fetchCount = pageSize,
+    };
+    if (receiver) {
+        data.receiver = receiver;
+    }
+    data.deadline = queryDeadline();
+    data.result->m_query     = query.toUtf8();
+    data.result->m_queryArgs = params;
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+    QMetaObject::invokeMethod(
+        &m_worker, &AMysqlThread::cursorDeclare, Qt::QueuedConnection, std::move(data));
+#else
+    QMetaObject::invokeMethod(&m_worker,
+                              "cursorDeclare",
+                              Qt::QueuedConnection,
+                              Q_ARG(ASql::MysqlQueryPromise, std::move(data)));
+#endif
+}
+
+void ADriverMysql::cursorFetch(const std::shared_ptr<ADriver> &db,
+                               const QString &name,
+                               int count,
+                               QObject *receiver,
+                               ACoroDataRef cb)
+{
+    ++m_queueSize;
+    selfDriver = db;
+
+    MysqlQueryPromise data{
+        .cb         = std::move(cb),
+        .result     = std::make_shared<AResultMysql>(),
+        .cursor     = name,
+        .fetchCount = count,
+    };
+    if (receiver) {
+        data.receiver = receiver;
+    }
+    data.deadline = queryDeadline();
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+    QMetaObject::invokeMethod(
+        &m_worker, &AMysqlThread::cursorFetch, Qt::QueuedConnection, std::move(data));
+#else
+    QMetaObject::invokeMethod(&m_worker,
+                              "cursorFetch",
+                              Qt::QueuedConnection,
+                              Q_ARG(ASql::MysqlQueryPromise, std::move(data)));
+#endif
+}
+
+void ADriverMysql::cursorClose(const std::shared_ptr<ADriver> &db,
+                               const QString &name,
+                               QObject *receiver,
+                               ACoroDataRef cb)
+{
+    ++m_queueSize;
+    selfDriver = db;
+
+    MysqlQueryPromise data{
+        .cb     = std::move(cb),
+        .result = std::make_shared<AResultMysql>(),
+        .cursor = name,
+    };
+    if (receiver) {
+        data.receiver = receiver;
+    }
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+    QMetaObject::invokeMethod(
+        &m_worker, &AMysqlThread::cursorClose, Qt::QueuedConnection, std::move(data));
+#else
+    QMetaObject::invokeMethod(&m_worker,
+                              "cursorClose",
+                              Qt::QueuedConnection,
+                              Q_ARG(ASql::MysqlQueryPromise, std::move(data)));
+#endif
+}
+
 void ADriverMysql::setLastQuerySingleRowMode()
 {
     // Not supported for MySQL driver
 }
 
-bool ADriverMysql::enterPipelineMode(std::chrono::milliseconds timeout)
+bool ADriverMysql::enterPipelineMode(const APipelineSyncPolicy &policy)
 {
-    Q_UNUSED(timeout)
+    Q_UNUSED(policy)
     return false;
 }
 
@@ -14,6 +14,8 @@
 #else
 #    include <mysql/mysql.h>
 #endif
+#include <atomic>
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -22,6 +24,7 @@
 #include <QPointer>
 #include <QQueue>
 #include <QThread>
+#include <QTimer>
 
 namespace ASql {
 
@@ -42,7 +45,6 @@ public:
     int fields() const override;
     qint64 numRowsAffected() const override;
 
-    int indexOfField(QLatin1String name) const override;
     QString fieldName(int column) const override;
     QVariant value(int row, int column) const override;
 
@@ -81,6 +83,23 @@ struct MysqlQueryPromise {
     ACoroDataRef cb;
     std::shared_ptr<AResultMysql> result;
     std::optional<QPointer<QObject>> receiver;
+    QDeadlineTimer deadline{QDeadlineTimer::Forever};
+    // Server side cursor the promise operates on and rows to fetch from it
+    QString cursor;
+    int fetchCount = 0;
+};
+
+/*!
+ * \brief AMysqlRunning holds the serial of the running query with a deadline, zero
+ * if none
+ *
+ * The worker changes it under the mutex when a query completes, so a KILL sent
+ * while holding it can only hit the query it was meant for. It's shared with the
+ * threads sending KILL QUERY, which might outlive the connection.
+ */
+struct AMysqlRunning {
+    QMutex mutex;
+    quint64 serial = 0;
 };
 
 class AMysqlThread final : public QThread
@@ -92,24 +111,43 @@ public:
 
     QMutex m_promisesMutex;
     QQueue<ASql::MysqlQueryPromise> m_promisesReady;
+    std::shared_ptr<AMysqlRunning> m_running = std::make_shared<AMysqlRunning>();
+    std::atomic<unsigned long> m_threadId{0};
+
+    /*!
+     * \brief killQuery runs KILL QUERY \p threadId on a new connection if the query
+     * with \p serial is still \p running, it blocks so it must not be called from the
+     * thread running the event loop
+     */
+    static void killQuery(const QString &connInfo,
+                          unsigned long threadId,
+                          std::shared_ptr<AMysqlRunning> running,
+                          quint64 serial);
 
 public Q_SLOTS:
     void open();
     void query(ASql::MysqlQueryPromise promise);
     void queryPrepared(ASql::MysqlQueryPromise promise);
     void queryExec(ASql::MysqlQueryPromise promise);
+    void cursorDeclare(ASql::MysqlQueryPromise promise);
+    void cursorFetch(ASql::MysqlQueryPromise promise);
+    void cursorClose(ASql::MysqlQueryPromise promise);
 
 Q_SIGNALS:
     void openned(bool isOpen, QString error);
     void queryReady();
+    void deadlineStarted(quint64 serial, qint64 deadline);
 
 private:
     MYSQL_STMT *prepare(MysqlQueryPromise &promise);
+    bool startDeadline(MysqlQueryPromise &promise);
     void enqueueAndSignal(MysqlQueryPromise &promise);
 
     QHash<int, MYSQL_STMT *> m_preparedQueries;
+    QHash<QString, MYSQL_STMT *> m_cursors;
     QString m_connInfo;
-    MYSQL *m_mysql = nullptr;
+    MYSQL *m_mysql   = nullptr;
+    quint64 m_serial = 0;
 };
 
 class ADriverMysql final : public ADriver
@@ -160,9 +198,28 @@ public:
               QObject *receiver,
               ACoroDataRef cb) override;
 
+    void cursorDeclare(const std::shared_ptr<ADriver> &db,
+                       const QString &name,
+                       QStringView query,
+                       const QVariantList &params,
+                       int pageSize,
+                       QObject *receiver,
+                       ACoroDataRef cb) override;
+
+    void cursorFetch(const std::shared_ptr<ADriver> &db,
+                     const QString &name,
+                     int count,
+                     QObject *receiver,
+                     ACoroDataRef cb) override;
+
+    void cursorClose(const std::shared_ptr<ADriver> &db,
+                     const QString &name,
+                     QObject *receiver,
+                     ACoroDataRef cb) override;
+
     void setLastQuerySingleRowMode() override;
 
-    bool enterPipelineMode(std::chrono::milliseconds timeout) override;
+    bool enterPipelineMode(const APipelineSyncPolicy &policy) override;
 
     bool exitPipelineMode() override;
 
@@ -182,12 +239,16 @@ public:
 
 private:
     void deliverOpenWaiters(bool isOpen, const QString &error);
+    void armDeadline(quint64 serial, qint64 deadline);
+    void killTimedOutQuery();
 
     std::optional<QPointer<QObject>> m_stateChangedReceiver;
     std::shared_ptr<ADriver> selfDriver;
     AMysqlThread m_worker;
     QThread m_thread;
+    QTimer m_deadlineTimer;
     ADatabase::State m_state = ADatabase::State::Disconnected;
+    quint64 m_deadlineSerial = 0;
     int m_queueSize          = 0;
     std::vector<OpenPromise> m_openWaiters;
 };
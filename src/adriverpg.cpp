@@ -6,21 +6,18 @@
 #include "adriverpg.h"
 
 #include "acoroexpected.h"
+#include "apgtypes.h"
 #include "aresult.h"
 #include "asql_connection_util.h"
 
 #include <libpq-fe.h>
 
 #include <QDate>
-#include <QJsonArray>
-#include <QJsonDocument>
-#include <QJsonObject>
 #include <QLoggingCategory>
 #include <QThread>
 #include <QTimer>
 #include <QUrlQuery>
 #include <QUuid>
-#include <QtEndian>
 
 Q_LOGGING_CATEGORY(ASQL_PG, "asql.pg", QtInfoMsg)
 
@@ -28,127 +25,13 @@ using namespace ASql;
 using namespace Qt::StringLiterals;
 
 namespace {
-// workaround for postgres defining their OIDs in a private header file
-#define QBOOLOID 16
-#define QINT8OID 20
-#define QINT2OID 21
-#define QINT4OID 23
-#define QTEXTOID 25
-#define QNUMERICOID 1700
-#define QFLOAT4OID 700
-#define QFLOAT8OID 701
-#define QABSTIMEOID 702
-#define QRELTIMEOID 703
-#define QUNKNOWNOID 705
-#define QDATEOID 1082
-#define QTIMEOID 1083
-#define QTIMETZOID 1266
-#define QTIMESTAMPOID 1114
-#define QTIMESTAMPTZOID 1184
-#define QOIDOID 2278
-#define QBYTEAOID 17
-#define QREGPROCOID 24
-#define QXIDOID 28
-#define QCIDOID 29
-#define QJSONOID 114
-#define QJSONBOID 3802
-#define QUUIDOID 2950
-#define QBITOID 1560
-#define QVARBITOID 1562
-
-#define VARHDRSZ 4
-
-QByteArray preparedQueryStringId(int id)
-{
-    return "asql_" + QByteArray::number(id, 16);
-}
-
-inline QMetaType qDecodePSQLType(int t)
-{
-    int type = QMetaType::UnknownType;
-    switch (t) {
-    case QBOOLOID:
-        type = QMetaType::Bool;
-        break;
-    case QINT8OID:
-        type = QMetaType::LongLong;
-        break;
-    case QINT2OID:
-    case QINT4OID:
-    case QOIDOID:
-    case QREGPROCOID:
-    case QXIDOID:
-    case QCIDOID:
-        type = QMetaType::Int;
-        break;
-    case QNUMERICOID:
-    case QFLOAT4OID:
-    case QFLOAT8OID:
-        type = QMetaType::Double;
-        break;
-    case QABSTIMEOID:
-    case QRELTIMEOID:
-    case QDATEOID:
-        type = QMetaType::QDate;
-        break;
-    case QTIMEOID:
-    case QTIMETZOID:
-        type = QMetaType::QTime;
-        break;
-    case QTIMESTAMPOID:
-    case QTIMESTAMPTZOID:
-        type = QMetaType::QDateTime;
-        break;
-    case QBYTEAOID:
-        type = QMetaType::QByteArray;
-        break;
-    case QJSONBOID:
-        [[fallthrough]];
-    case QJSONOID:
-        type = QMetaType::QJsonValue;
-        break;
-    case QUUIDOID:
-        type = QMetaType::QUuid;
-        break;
-    default:
-        type = QMetaType::QString;
-        break;
-    }
-    //    qDebug(ASQL_PG) << "decode pg type" << t << type;
-    return QMetaType(type);
-}
-
-QByteArray decodePgByteaText(const char *val, int length)
-{
-    if (length >= 2 && val[0] == '\\' && val[1] == 'x') {
-        return QByteArray::fromHex(QByteArray(val + 2, length - 2));
-    }
-
-    size_t outLength    = 0;
-    unsigned char *data = PQunescapeBytea(reinterpret_cast<const unsigned char *>(val), &outLength);
-    QByteArray decoded(reinterpret_cast<const char *>(data), int(outLength));
-    PQfreemem(data);
-    return decoded;
-}
 
-QByteArray pgColumnBytes(PGresult *result, int row, int column)
+inline PgTypes::Value pgValue(const PGresult *result, int row, int column)
 {
-    if (PQgetisnull(result, row, column) == 1) {
-        return {};
-    }
-
-    const char *val  = PQgetvalue(result, row, column);
-    const int length = PQgetlength(result, row, column);
-
-    if (PQftype(result, column) != QBYTEAOID) {
-        return QByteArray(val, length);
-    }
-
-    if (PQfformat(result, column) == 1) {
-        return QByteArray(val, length);
-    }
-
-    return decodePgByteaText(val, length);
+    return {PQftype(result, column),
+            PQgetvalue(result, row, column),
+            PQgetlength(result, row, column),
+            PQfformat(result, column) == 1};
 }
 
 QString connectionStatus(ConnStatusType type)
@@ -266,6 +149,12 @@ void ADriverPg::open(const std::shared_ptr<ADriver> &driver, QObject *receiver,
                 case PGRES_POLLING_OK:
                     qDebug(ASQL_PG) << "PGRES_POLLING_OK 1" << type << m_writeNotify->isEnabled();
                     m_writeNotify->setEnabled(false);
+                    // Writes must never block the event loop, pending output
+                    // is flushed by cmdFlush() once the socket is writable
+                    if (PQsetnonblocking(m_conn->conn(), 1) != 0) {
+                        qWarning(ASQL_PG) << "Failed to set non-blocking mode"
+                                          << m_conn->errorMessage();
+                    }
                     setState(ADatabase::State::Connected, {});
                     deliverOpenWaiters(true, {});
 
@@ -277,9 +166,11 @@ void ADriverPg::open(const std::shared_ptr<ADriver> &driver, QObject *receiver,
                     const QString error = m_conn->errorMessage();
                     qDebug(ASQL_PG) << "PGRES_POLLING_FAILED" << type << error;
 
-                    deliverOpenWaiters(false, error);
-
+                    // Disconnected before the waiters run, so that a pool
+                    // can release the connection from their callbacks
                     finishConnection(error);
+
+                    deliverOpenWaiters(false, error);
                     return;
                 }
                 default:
@@ -306,6 +197,11 @@ void ADriverPg::open(const std::shared_ptr<ADriver> &driver, QObject *receiver,
                 } else {
                     if (PQconsumeInput(m_conn->conn()) == 1) {
                         while (PQisBusy(m_conn->conn()) == 0) {
+                            if (m_copyOut && !drainCopyOut()) {
+                                // wait for more COPY data
+                                break;
+                            }
+
                             PGresult *result = PQgetResult(m_conn->conn());
 
                             //                            qWarning() << "Not busy: RESULT" << result
@@ -315,14 +211,35 @@ void ADriverPg::open(const std::shared_ptr<ADriver> &driver, QObject *receiver,
                                 auto safeResult = std::make_shared<AResultPg>(result);
 
                                 ExecStatusType status = safeResult->status();
+                                if (status == PGRES_COPY_IN) {
+                                    // libpq keeps returning COPY_IN results until the
+                                    // copy is ended, only the first one is delivered
+                                    if (!m_copyIn) {
+                                        copyInStarted(std::move(safeResult));
+                                    }
+                                    break;
+                                } else if (status == PGRES_COPY_OUT) {
+                                    // Rows are read with PQgetCopyData() until the
+                                    // final COPY result is available
+                                    m_copyOut = true;
+                                    continue;
+                                }
+
                                 switch (status) {
 #ifdef LIBPQ_HAS_PIPELINING
                                 case PGRES_PIPELINE_SYNC:
                                     --m_pipelineSync;
+                                    if (m_implicitPipeline && m_pipelineSync == 0) {
+                                        leaveImplicitPipeline();
+                                    }
                                     continue;
 #endif
                                 case PGRES_TUPLES_OK:
                                     [[fallthrough]];
+#ifdef LIBPQ_HAS_CHUNK_MODE
+                                case PGRES_TUPLES_CHUNK:
+                                    [[fallthrough]];
+#endif
                                 case PGRES_SINGLE_TUPLE:
                                     [[fallthrough]];
                                 case PGRES_COMMAND_OK:
@@ -331,10 +248,38 @@ void ADriverPg::open(const std::shared_ptr<ADriver> &driver, QObject *receiver,
                                     safeResult->m_error = true;
                                     safeResult->m_errorString =
                                         QString::fromLocal8Bit(PQresultErrorMessage(result));
+#ifdef LIBPQ_HAS_PIPELINING
+                                    if (status == PGRES_PIPELINE_ABORTED &&
+                                        safeResult->m_errorString.isEmpty()) {
+                                        safeResult->m_errorString = u"Pipeline aborted"_s;
+                                    }
+#endif
                                     break;
                                 }
 
                                 APGQuery &pgQuery = m_queuedQueries.front();
+                                if (pgQuery.preparedQuery && !pgQuery.preparing &&
+                                    !safeResult->hasError()) {
+                                    // Same statement, same fields
+                                    safeResult->setFieldIndex(m_preparedQueries.fieldIndex(
+                                        pgQuery.preparedQuery->identification(),
+                                        PQnfields(result)));
+                                }
+#ifdef LIBPQ_HAS_PIPELINING
+                                if (status == PGRES_PIPELINE_ABORTED && pgQuery.result &&
+                                    pgQuery.result->hasError()) {
+                                    // Keep the error that aborted the pipeline
+                                    continue;
+                                }
+#endif
+                                if (Q_UNLIKELY(pgQuery.timedOut) && safeResult->hasError()) {
+                                    safeResult->m_errorString = u"Query timed out"_s;
+                                }
+                                if (pgQuery.chunkedRows > 1 && !safeResult->hasError() &&
+                                    batchChunkedRows(pgQuery, safeResult)) {
+                                    continue;
+                                }
+
                                 //                                qDebug(ASQL_PG) << "RESULT" <<
                                 //                                result << "status" << status <<
                                 //                                PGRES_TUPLES_OK << "shared_ptr
@@ -353,32 +298,55 @@ void ADriverPg::open(const std::shared_ptr<ADriver> &driver, QObject *receiver,
                                 m_queryRunning    = false;
 
                                 if (Q_UNLIKELY(pgQuery.preparedQuery && pgQuery.preparing)) {
+                                    const auto id = pgQuery.preparedQuery->identification();
                                     if (Q_UNLIKELY(pgQuery.result && pgQuery.result->hasError())) {
                                         // PREPARE OR PREPARED QUERY ERROR
-                                        auto query = m_queuedQueries.front();
-                                        m_queuedQueries.pop();
+                                        m_preparedQueries.remove(id, pgQuery.preparedName);
+                                        if (pipelineStatus() != ADatabase::PipelineStatus::Off) {
+                                            // The execution was already sent and will be
+                                            // reported as aborted, keep the prepare error
+                                            pgQuery.preparing = false;
+                                        } else {
+                                            auto query = std::move(m_queuedQueries.front());
+                                            m_queuedQueries.pop_front();
+                                            nextQuery();
+                                            query.done();
+                                        }
+                                    } else if (pgQuery.describing) {
+                                        // Query described
+                                        if (pgQuery.result) {
+                                            m_preparedQueries.describe(id, *pgQuery.result);
+                                        }
+                                        pgQuery.result.reset();
+                                        pgQuery.describing = false;
+                                        pgQuery.preparing  = false;
+                                        deallocateEvicted(selfDriver);
                                         nextQuery();
-                                        query.done();
                                     } else {
                                         pgQuery.result.reset();
 
-                                        const auto id    = pgQuery.preparedQuery->identification();
-                                        const auto idStr = preparedQueryStringId(id);
                                         // Query prepared
-                                        m_preparedQueries.insert(id, idStr);
-                                        pgQuery.preparing = false;
-                                        nextQuery();
+                                        m_preparedQueries.insert(
+                                            id, pgQuery.preparedName, m_evictedPrepared);
+                                        if (!describePrepared(pgQuery)) {
+                                            pgQuery.preparing = false;
+                                            deallocateEvicted(selfDriver);
+                                            nextQuery();
+                                        }
                                     }
                                 } else {
-                                    auto query = m_queuedQueries.front();
-                                    m_queuedQueries.pop();
+                                    auto query = std::move(m_queuedQueries.front());
+                                    m_queuedQueries.pop_front();
+                                    if (m_implicitPipeline) {
+                                        m_queryRunning = --m_pipelinedQueries > 0;
+                                    }
                                     nextQuery();
                                     query.done();
                                 }
                             }
 
                             if (pipelineStatus() == ADatabase::PipelineStatus::Off ||
-                                !m_pipelineSync) {
+                                (!m_pipelineSync && !m_pipelinedQueries)) {
                                 // In PIPELINE mode a null result means the end of a query
                                 // but PQisBusy() should indicate it's end instead
                                 break;
@@ -386,10 +354,10 @@ void ADriverPg::open(const std::shared_ptr<ADriver> &driver, QObject *receiver,
                         }
                         //                        qDebug(ASQL_PG) << "Not busy OUT" << this;
 
-                        if (!m_queuedQueries.empty() && m_pipelineSync == 0 &&
-                            pipelineStatus() != ADatabase::PipelineStatus::Off && m_autoSyncTimer &&
-                            !m_autoSyncTimer->isActive()) {
-                            m_autoSyncTimer->start();
+                        if (m_pipelineSync == 0 && m_autoSync.pending() &&
+                            m_autoSync.policy().syncWhenIdle) {
+                            // Queries batched while waiting for results go now
+                            syncPipeline(APgAutoSync::Trigger::Idle);
                         }
 
                         PGnotify *notify = nullptr;
@@ -429,6 +397,8 @@ void ADriverPg::open(const std::shared_ptr<ADriver> &driver, QObject *receiver,
                     }
                 }
 
+                wakeQueueWaiters();
+
                 // CRITICAL it's only safe to release ourself
                 // after all connection processing took place
                 if (m_queuedQueries.empty()) {
@@ -463,14 +433,169 @@ void ADriverPg::begin(const std::shared_ptr<ADriver> &db, QObject *receiver, ACo
     exec(db, u8"BEGIN", receiver, std::move(cb));
 }
 
+bool ADriverPg::beginPipelined(const std::shared_ptr<ADriver> &db)
+{
+#ifdef LIBPQ_HAS_PIPELINING
+    // In pipeline mode the syncs are up to the caller
+    if (m_pipelinedTransaction ||
+        (pipelineStatus() != ADatabase::PipelineStatus::Off && !m_implicitPipeline)) {
+        return false;
+    }
+
+    APGQuery pgQuery;
+    pgQuery.query.setRawData("BEGIN", 5);
+    pgQuery.transaction = APGQuery::Transaction::Begin;
+
+    m_pipelinedTransaction       = true;
+    m_pipelinedTransactionFailed = false;
+    enqueue(db, std::move(pgQuery));
+    return true;
+#else
+    Q_UNUSED(db)
+    return false;
+#endif
+}
+
+bool ADriverPg::pipelinedTransaction() const
+{
+    return m_pipelinedTransaction;
+}
+
+void ADriverPg::beginPipelineBatch(const std::shared_ptr<ADriver> &db,
+                                   const std::shared_ptr<APipelineBatch> &batch,
+                                   int queries)
+{
+    Q_UNUSED(db)
+#ifdef LIBPQ_HAS_PIPELINING
+    // Statements of a pipelined transaction are already sent together, in
+    // pipeline mode the end of the batch is synced as well
+    if (queries < 2 || m_pipelinedTransaction) {
+        return;
+    }
+
+    // Until a query of it is sent on its own or a sync splits it
+    batch->synced       = true;
+    m_issuingBatch      = batch;
+    m_pipelineBatch     = queries;
+    m_pipelineBatchSize = queries;
+#else
+    Q_UNUSED(batch)
+    Q_UNUSED(queries)
+#endif
+}
+
+void ADriverPg::endPipelineBatch(const std::shared_ptr<ADriver> &db)
+{
+    m_issuingBatch.reset();
+    if (m_pipelineBatch == 0) {
+        return;
+    }
+
+    // Fewer queries than announced were issued, the ones that follow are not
+    // part of the batch and the last one issued has to end it
+    const bool issued = m_pipelineBatch < m_pipelineBatchSize;
+    m_pipelineBatch   = 0;
+    if (!issued || m_queuedQueries.empty()) {
+        return;
+    }
+
+    APGQuery &last = m_queuedQueries.back();
+    const bool sent =
+        m_implicitPipeline ? m_pipelinedQueries == int(m_queuedQueries.size())
+                           : pipelineStatus() == ADatabase::PipelineStatus::On && isConnected();
+    if (sent) {
+        pipelineSync();
+    } else if (last.transaction == APGQuery::Transaction::Begin) {
+        last.transaction = APGQuery::Transaction::None;
+    } else if (last.transaction == APGQuery::Transaction::Statement) {
+        last.transaction = APGQuery::Transaction::Sync;
+    }
+    deallocateEvicted(db);
+}
+
 void ADriverPg::commit(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoroDataRef cb)
 {
-    exec(db, u8"COMMIT", receiver, std::move(cb));
+    endTransaction(db, u8"COMMIT", receiver, std::move(cb));
 }
 
 void ADriverPg::rollback(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoroDataRef cb)
 {
-    exec(db, u8"ROLLBACK", receiver, std::move(cb));
+    endTransaction(db, u8"ROLLBACK", receiver, std::move(cb));
+}
+
+void ADriverPg::endTransaction(const std::shared_ptr<ADriver> &db,
+                               QUtf8StringView query,
+                               QObject *receiver,
+                               ACoroDataRef cb)
+{
+    if (!m_pipelinedTransaction) {
+        exec(db, query, receiver, std::move(cb));
+        return;
+    }
+
+    APGQuery pgQuery;
+    pgQuery.query.setRawData(query.data(), query.size());
+    pgQuery.cb          = std::move(cb);
+    pgQuery.deadline    = queryDeadline();
+    pgQuery.transaction = APGQuery::Transaction::End;
+
+    setupCheckReceiver(pgQuery, receiver);
+
+    if (m_pipelinedTransactionFailed && pgQuery.query != "ROLLBACK") {
+        // Statements of it were dropped, committing would keep only part of it
+        APGQuery rollback;
+        rollback.query.setRawData("ROLLBACK", 8);
+        rollback.transaction = APGQuery::Transaction::End;
+        pgQuery.doneError(u"Transaction timed out"_s);
+        pgQuery = std::move(rollback);
+    }
+
+    m_pipelinedTransaction       = false;
+    m_pipelinedTransactionFailed = false;
+    enqueue(db, std::move(pgQuery));
+}
+
+void ADriverPg::enqueue(const std::shared_ptr<ADriver> &db, APGQuery &&pgQuery)
+{
+    if (pgQuery.transaction == APGQuery::Transaction::None && m_pipelinedTransaction) {
+        if (m_pipelinedTransactionFailed) {
+            pgQuery.doneError(u"Transaction timed out"_s);
+            return;
+        }
+        pgQuery.transaction = APGQuery::Transaction::Statement;
+    } else if (pgQuery.transaction == APGQuery::Transaction::None && m_pipelineBatch > 0) {
+        // The first query starts the pipeline, the last one syncs it
+        if (m_pipelineBatch == m_pipelineBatchSize) {
+            pgQuery.transaction = APGQuery::Transaction::Begin;
+        } else if (m_pipelineBatch == 1) {
+            pgQuery.transaction = APGQuery::Transaction::Sync;
+        } else {
+            pgQuery.transaction = APGQuery::Transaction::Statement;
+        }
+        pgQuery.batch = m_issuingBatch;
+        --m_pipelineBatch;
+    }
+
+    const bool begin = pgQuery.transaction == APGQuery::Transaction::Begin;
+    const bool end   = pgQuery.transaction == APGQuery::Transaction::Sync ||
+                       pgQuery.transaction == APGQuery::Transaction::End;
+    if (queryShouldBeQueued(pgQuery) || runQuery(pgQuery)) {
+        selfDriver = db;
+        armDeadline(pgQuery.deadline);
+        m_queuedQueries.emplace_back(std::move(pgQuery));
+
+        if (begin && isConnected()) {
+            // Starts the pipeline if nothing else is running
+            nextQuery();
+        } else {
+            syncImplicitPipeline();
+        }
+    }
+
+    if (end) {
+        // Deallocations evicted meanwhile follow the transaction or batch
+        deallocateEvicted(db);
+    }
 }
 
 void ADriverPg::setupCheckReceiver(APGQuery &pgQuery, QObject *receiver)
@@ -502,6 +627,23 @@ void ADriverPg::cancelCurrentQueryOnReceiverDestroyed(QObject *obj)
         return;
     }
 
+    cancelRunningQuery();
+}
+
+void ADriverPg::cancelRunningQuery()
+{
+#ifdef LIBPQ_HAS_ASYNC_CANCEL
+    if (m_cancel && m_cancel->isActive()) {
+        // The request already on its way cancels whatever is running
+        return;
+    }
+
+    m_cancel = std::make_unique<APgCancel>(m_conn->conn());
+    if (!m_cancel->start()) {
+        m_cancel.reset();
+    }
+#else
+    // Blocks until the cancel request is delivered on a new connection
     PGcancel *cancel = PQgetCancel(m_conn->conn());
     char errbuf[256];
     int ret = PQcancel(cancel, errbuf, 256);
@@ -511,8 +653,234 @@ void ADriverPg::cancelCurrentQueryOnReceiverDestroyed(QObject *obj)
         qDebug(ASQL_PG) << "PQcancel failed" << ret << errbuf;
     }
     PQfreeCancel(cancel);
+#endif
+}
+
+void ADriverPg::armDeadline(const QDeadlineTimer &deadline)
+{
+    if (deadline.isForever()) {
+        return;
+    }
+
+    if (!m_deadlineTimer) {
+        m_deadlineTimer = std::make_unique<QTimer>();
+        m_deadlineTimer->setSingleShot(true);
+        connect(m_deadlineTimer.get(), &QTimer::timeout, this, &ADriverPg::expireDeadlines);
+    }
+
+    // A single timer is armed for the closest deadline
+    const auto remaining =
+        std::chrono::ceil<std::chrono::milliseconds>(deadline.remainingTimeAsDuration());
+    if (!m_deadlineTimer->isActive() || m_deadlineTimer->remainingTimeAsDuration() > remaining) {
+        m_deadlineTimer->start(remaining);
+    }
+}
+
+void ADriverPg::expireDeadlines()
+{
+    const qsizetype sent = sentQueries();
+    std::vector<APGQuery> expired;
+    QDeadlineTimer next{QDeadlineTimer::Forever};
+    bool cancel = false;
+    bool sync   = false;
+
+    qsizetype index = 0;
+    while (index < m_queuedQueries.size()) {
+        APGQuery &pgQuery = m_queuedQueries[index];
+        if (!pgQuery.deadline.hasExpired()) {
+            next = std::min(next, pgQuery.deadline);
+            ++index;
+        } else if (index < sent) {
+            // Already on the server, its result reports the timeout
+            cancel |= !pgQuery.timedOut;
+            pgQuery.timedOut = true;
+            ++index;
+        } else if (pgQuery.transaction != APGQuery::Transaction::None && !pgQuery.batch) {
+            expireTransaction(index, expired);
+        } else {
+            // The boundaries of a batch move to its neighbours
+            if (pgQuery.transaction == APGQuery::Transaction::Begin) {
+                retagBatchBegin(index + 1, pgQuery.batch);
+            } else if (pgQuery.transaction == APGQuery::Transaction::Sync) {
+                sync |= retagBatchEnd(index - 1, sent, pgQuery.batch);
+            }
+            expired.emplace_back(std::move(pgQuery));
+            m_queuedQueries.erase(m_queuedQueries.begin() + index);
+        }
+    }
+
+    if (sync) {
+        // The part of the batch already sent is synced on its own
+        m_syncingBatch.reset();
+        pipelineSync();
+    }
+
+    if (cancel) {
+        cancelRunningQuery();
+    }
+
+    if (!next.isForever()) {
+        armDeadline(next);
+    }
+
+    for (APGQuery &pgQuery : expired) {
+        pgQuery.doneError(u"Query timed out"_s);
+    }
+
+    wakeQueueWaiters();
+    if (m_queuedQueries.empty()) {
+        selfDriver.reset();
+    }
+}
+
+void ADriverPg::expireTransaction(qsizetype index, std::vector<APGQuery> &expired)
+{
+    // BEGIN might be on the server already, the statements that follow are
+    // dropped and the transaction ends with a rollback
+    while (index < m_queuedQueries.size() &&
+           m_queuedQueries[index].transaction == APGQuery::Transaction::Statement) {
+        expired.emplace_back(std::move(m_queuedQueries[index]));
+        m_queuedQueries.erase(m_queuedQueries.begin() + index);
+    }
+
+    if (index == m_queuedQueries.size()) {
+        // Not ended yet, endTransaction() rolls it back
+        m_pipelinedTransactionFailed = m_pipelinedTransaction;
+        return;
+    }
+
+    APGQuery rollback;
+    rollback.query.setRawData("ROLLBACK", 8);
+    rollback.transaction = APGQuery::Transaction::End;
+    expired.emplace_back(std::exchange(m_queuedQueries[index], std::move(rollback)));
+}
+
+void ADriverPg::retagBatchBegin(qsizetype index, const std::shared_ptr<APipelineBatch> &batch)
+{
+    if (index >= m_queuedQueries.size() || m_queuedQueries[index].batch != batch) {
+        return;
+    }
+
+    APGQuery &pgQuery = m_queuedQueries[index];
+    if (pgQuery.transaction == APGQuery::Transaction::Statement) {
+        pgQuery.transaction = APGQuery::Transaction::Begin;
+    } else if (pgQuery.transaction == APGQuery::Transaction::Sync) {
+        pgQuery.transaction = APGQuery::Transaction::None;
+    }
+}
+
+bool ADriverPg::retagBatchEnd(qsizetype index,
+                              qsizetype sent,
+                              const std::shared_ptr<APipelineBatch> &batch)
+{
+    if (index < 0 || m_queuedQueries[index].batch != batch) {
+        return false;
+    } else if (index < sent) {
+        return m_implicitPipeline || pipelineStatus() == ADatabase::PipelineStatus::On;
+    }
+
+    APGQuery &pgQuery = m_queuedQueries[index];
+    if (pgQuery.transaction == APGQuery::Transaction::Begin) {
+        pgQuery.transaction = APGQuery::Transaction::None;
+    } else if (pgQuery.transaction == APGQuery::Transaction::Statement) {
+        pgQuery.transaction = APGQuery::Transaction::Sync;
+    }
+    return false;
+}
+
+qsizetype ADriverPg::sentQueries() const
+{
+    if (!m_queryRunning) {
+        return 0;
+    } else if (m_implicitPipeline) {
+        return m_pipelinedQueries;
+    } else if (pipelineStatus() != ADatabase::PipelineStatus::Off) {
+        // Explicit pipelines send every query right away
+        return qsizetype(m_queuedQueries.size());
+    }
+    return 1;
+}
+
+#ifdef LIBPQ_HAS_ASYNC_CANCEL
+APgCancel::APgCancel(PGconn *conn)
+    : m_cancel(PQcancelCreate(conn))
+{
+}
+
+APgCancel::~APgCancel()
+{
+    // The notifier must go away before its socket is closed
+    m_notifier.reset();
+    PQcancelFinish(m_cancel);
+}
+
+bool APgCancel::start()
+{
+    if (!m_cancel || PQcancelStart(m_cancel) == 0) {
+        qDebug(ASQL_PG) << "PQcancelStart failed"
+                        << (m_cancel ? PQcancelErrorMessage(m_cancel) : "out of memory");
+        return false;
+    }
+
+    // After PQcancelStart the socket must be polled as if it asked for writing
+    m_active = true;
+    wait(QSocketNotifier::Write);
+    return true;
+}
+
+void APgCancel::poll()
+{
+    switch (PQcancelPoll(m_cancel)) {
+    case PGRES_POLLING_READING:
+        wait(QSocketNotifier::Read);
+        return;
+    case PGRES_POLLING_WRITING:
+        wait(QSocketNotifier::Write);
+        return;
+    case PGRES_POLLING_OK:
+        qDebug(ASQL_PG) << "PQcancel sent";
+        break;
+    default:
+        qDebug(ASQL_PG) << "PQcancel failed" << PQcancelErrorMessage(m_cancel);
+        break;
+    }
+    finish();
 }
 
+void APgCancel::wait(QSocketNotifier::Type type)
+{
+    const int socket = PQcancelSocket(m_cancel);
+    if (socket < 0) {
+        qDebug(ASQL_PG) << "PQcancel failed" << PQcancelErrorMessage(m_cancel);
+        finish();
+        return;
+    }
+
+    if (m_notifier && m_notifier->socket() == socket && m_notifier->type() == type) {
+        m_notifier->setEnabled(true);
+        return;
+    }
+
+    // This might be called from the current notifier's activated signal
+    finish();
+    m_active   = true;
+    m_notifier = std::make_unique<QSocketNotifier>(socket, type);
+    QObject::connect(m_notifier.get(), &QSocketNotifier::activated, m_notifier.get(), [this] {
+        m_notifier->setEnabled(false);
+        poll();
+    });
+}
+
+void APgCancel::finish()
+{
+    m_active = false;
+    if (m_notifier) {
+        m_notifier->setEnabled(false);
+        m_notifier.release()->deleteLater();
+    }
+}
+#endif
+
 bool ADriverPg::runQuery(APGQuery &pgQuery)
 {
     int ret;
@@ -523,13 +891,45 @@ bool ADriverPg::runQuery(APGQuery &pgQuery)
     }
 
     if (ret == 1) {
-        if (pipelineStatus() != ADatabase::PipelineStatus::Off && m_autoSyncTimer &&
-            !m_autoSyncTimer->isActive()) {
-            m_autoSyncTimer->start();
+        if (pgQuery.batch) {
+            if (!m_implicitPipeline && pipelineStatus() == ADatabase::PipelineStatus::Off) {
+                // Sent on its own, the batch didn't make it into a single pipeline
+                pgQuery.batch->synced = false;
+            } else if (pgQuery.transaction == APGQuery::Transaction::Begin) {
+                m_syncingBatch = pgQuery.batch;
+            } else if (pgQuery.transaction == APGQuery::Transaction::Sync) {
+                // The sync that follows is the one of the batch
+                m_syncingBatch.reset();
+            }
+        }
+        if (m_implicitPipeline) {
+            if (pgQuery.transaction == APGQuery::Transaction::Begin ||
+                pgQuery.transaction == APGQuery::Transaction::Statement) {
+                // Transactions and batches are synced at their end, meanwhile
+                // the server is asked to send the results it has
+#ifdef LIBPQ_HAS_PIPELINING
+                PQsendFlushRequest(m_conn->conn());
+#endif
+            } else {
+                // A sync per query keeps errors isolated as in sequential mode
+                pipelineSync();
+                if (pgQuery.transaction == APGQuery::Transaction::End) {
+                    m_pipelinedTransactionEnd = true;
+                }
+            }
+            ++m_pipelinedQueries;
         }
         m_queryRunning = true;
-        if (pgQuery.setSingleRow) {
-            setSingleRowMode();
+        if (!pgQuery.preparing) {
+            if (pgQuery.chunkedRows > 1) {
+                setChunkedRowsMode(pgQuery.chunkedRows);
+            } else if (pgQuery.setSingleRow) {
+                setSingleRowMode();
+            }
+        }
+        if (!m_implicitPipeline && pipelineStatus() != ADatabase::PipelineStatus::Off) {
+            // The rows mode must be set before the sync
+            autoSyncSent(pgQuery);
         }
         cmdFlush();
         return true;
@@ -539,9 +939,44 @@ bool ADriverPg::runQuery(APGQuery &pgQuery)
     }
 }
 
-bool ADriverPg::queryShouldBeQueued() const
+void ADriverPg::autoSyncSent(const APGQuery &pgQuery)
 {
-    return pipelineStatus() != ADatabase::PipelineStatus::On &&
+    qsizetype bytes =
+        pgQuery.preparedQuery ? pgQuery.preparedQuery->query().size() : pgQuery.query.size();
+    if (!pgQuery.params.isEmpty()) {
+        bytes += m_params.dataSize();
+    }
+
+    // A batch is only synced at its end, unless it exceeds the policy limits
+    const bool batched = pgQuery.transaction == APGQuery::Transaction::Begin ||
+                         pgQuery.transaction == APGQuery::Transaction::Statement;
+    const auto trigger = m_autoSync.querySent(bytes, m_pipelineSync == 0 && !batched);
+    if (trigger != APgAutoSync::Trigger::None) {
+        syncPipeline(trigger);
+    } else if (pgQuery.transaction == APGQuery::Transaction::Sync) {
+        syncPipeline(APgAutoSync::Trigger::Manual);
+    } else if (m_autoSyncTimer && !m_autoSyncTimer->isActive()) {
+        m_autoSyncTimer->start();
+    }
+}
+
+bool ADriverPg::queryShouldBeQueued(const APGQuery &pgQuery) const
+{
+    if (m_implicitPipeline) {
+        // Join the running pipeline unless that would reorder the queue, nothing
+        // follows the end of a transaction until it's known to be committed
+        return m_pipelinedQueries != int(m_queuedQueries.size()) || !canPipeline(pgQuery) ||
+               m_pipelinedTransactionEnd;
+    }
+
+    const ADatabase::PipelineStatus status = pipelineStatus();
+    if (pgQuery.transaction == APGQuery::Transaction::Begin &&
+        status == ADatabase::PipelineStatus::Off) {
+        // Sent once a pipeline can be started for the transaction or batch
+        return true;
+    }
+
+    return status != ADatabase::PipelineStatus::On &&
            (m_queryRunning || !isConnected() || m_queuedQueries.size() > 0);
 }
 
@@ -552,14 +987,13 @@ void ADriverPg::exec(const std::shared_ptr<ADriver> &db,
 {
     APGQuery pgQuery;
     pgQuery.query.setRawData(query.data(), query.size());
-    pgQuery.cb = std::move(cb);
+    pgQuery.cb           = std::move(cb);
+    pgQuery.resultFormat = resultFormatFlag();
+    pgQuery.deadline     = queryDeadline();
 
     setupCheckReceiver(pgQuery, receiver);
 
-    if (queryShouldBeQueued() || runQuery(pgQuery)) {
-        selfDriver = db;
-        m_queuedQueries.emplace(std::move(pgQuery));
-    }
+    enqueue(db, std::move(pgQuery));
 }
 
 void ADriverPg::exec(const std::shared_ptr<ADriver> &db,
@@ -568,15 +1002,14 @@ void ADriverPg::exec(const std::shared_ptr<ADriver> &db,
                      ACoroDataRef cb)
 {
     APGQuery pgQuery;
-    pgQuery.query = query.toUtf8();
-    pgQuery.cb    = std::move(cb);
+    pgQuery.query        = query.toUtf8();
+    pgQuery.cb           = std::move(cb);
+    pgQuery.resultFormat = resultFormatFlag();
+    pgQuery.deadline     = queryDeadline();
 
     setupCheckReceiver(pgQuery, receiver);
 
-    if (queryShouldBeQueued() || runQuery(pgQuery)) {
-        selfDriver = db;
-        m_queuedQueries.emplace(std::move(pgQuery));
-    }
+    enqueue(db, std::move(pgQuery));
 }
 
 void ADriverPg::exec(const std::shared_ptr<ADriver> &db,
@@ -587,15 +1020,14 @@ void ADriverPg::exec(const std::shared_ptr<ADriver> &db,
 {
     APGQuery pgQuery;
     pgQuery.query.setRawData(query.data(), query.size());
-    pgQuery.params = params;
-    pgQuery.cb     = std::move(cb);
+    pgQuery.params       = params;
+    pgQuery.cb           = std::move(cb);
+    pgQuery.resultFormat = resultFormatFlag();
+    pgQuery.deadline     = queryDeadline();
 
     setupCheckReceiver(pgQuery, receiver);
 
-    if (queryShouldBeQueued() || runQuery(pgQuery)) {
-        selfDriver = db;
-        m_queuedQueries.emplace(std::move(pgQuery));
-    }
+    enqueue(db, std::move(pgQuery));
 }
 
 void ADriverPg::exec(const std::shared_ptr<ADriver> &db,
@@ -605,16 +1037,15 @@ void ADriverPg::exec(const std::shared_ptr<ADriver> &db,
                      ACoroDataRef cb)
 {
     APGQuery pgQuery;
-    pgQuery.query  = query.toUtf8();
-    pgQuery.params = params;
-    pgQuery.cb     = std::move(cb);
+    pgQuery.query        = query.toUtf8();
+    pgQuery.params       = params;
+    pgQuery.cb           = std::move(cb);
+    pgQuery.resultFormat = resultFormatFlag();
+    pgQuery.deadline     = queryDeadline();
 
     setupCheckReceiver(pgQuery, receiver);
 
-    if (queryShouldBeQueued() || runQuery(pgQuery)) {
-        selfDriver = db;
-        m_queuedQueries.emplace(std::move(pgQuery));
-    }
+    enqueue(db, std::move(pgQuery));
 }
 
 void ADriverPg::exec(const std::shared_ptr<ADriver> &db,
@@ -627,13 +1058,207 @@ void ADriverPg::exec(const std::shared_ptr<ADriver> &db,
     pgQuery.preparedQuery = query;
     pgQuery.params        = params;
     pgQuery.cb            = std::move(cb);
+    pgQuery.resultFormat  = resultFormatFlag();
+    pgQuery.deadline      = queryDeadline();
 
     setupCheckReceiver(pgQuery, receiver);
 
-    if (queryShouldBeQueued() || runQuery(pgQuery)) {
-        selfDriver = db;
-        m_queuedQueries.emplace(std::move(pgQuery));
-    }
+    enqueue(db, std::move(pgQuery));
+
+    // Deallocations are queued after the query that caused them
+    deallocateEvicted(db);
+}
+
+void ADriverPg::copyIn(const std::shared_ptr<ADriver> &db,
+                       QStringView query,
+                       QObject *receiver,
+                       ACoroDataRef cb)
+{
+    APGQuery pgQuery;
+    pgQuery.query = query.toUtf8();
+    pgQuery.cb    = std::move(cb);
+
+    setupCheckReceiver(pgQuery, receiver);
+
+    enqueue(db, std::move(pgQuery));
+}
+
+void ADriverPg::copyOut(const std::shared_ptr<ADriver> &db,
+                        QStringView query,
+                        ACopyOutFn chunkCb,
+                        QObject *receiver,
+                        ACoroDataRef cb)
+{
+    APGQuery pgQuery;
+    pgQuery.query     = query.toUtf8();
+    pgQuery.copyOutCb = std::move(chunkCb);
+    pgQuery.cb        = std::move(cb);
+    pgQuery.deadline  = queryDeadline();
+
+    setupCheckReceiver(pgQuery, receiver);
+
+    enqueue(db, std::move(pgQuery));
+}
+
+bool ADriverPg::drainCopyOut()
+{
+    const APGQuery &pgQuery = m_queuedQueries.front();
+    const bool deliver =
+        pgQuery.copyOutCb && (!pgQuery.checkReceiver || !pgQuery.receiver.isNull());
+
+    // Each chunk is released right after being delivered so memory
+    // usage does not depend on the size of the export
+    char *buffer = nullptr;
+    int length;
+    while ((length = PQgetCopyData(m_conn->conn(), &buffer, 1)) > 0) {
+        if (deliver) {
+            pgQuery.copyOutCb(QByteArrayView(buffer, length));
+        }
+        PQfreemem(buffer);
+        buffer = nullptr;
+    }
+
+    if (length == 0) {
+        return false;
+    }
+
+    // -1 means the COPY is done, -2 an error, either way
+    // the next PQgetResult() has the final result
+    m_copyOut = false;
+    return true;
+}
+
+bool ADriverPg::copyInData(QByteArrayView data)
+{
+    if (!m_copyIn) {
+        qWarning(ASQL_PG) << "COPY FROM STDIN not in progress";
+        return false;
+    }
+
+    // libpq sends complete 8KiB chunks by itself, anything left is sent on
+    // copyInFlush() or copyInEnd(), in non-blocking mode it never blocks
+    if (PQputCopyData(m_conn->conn(), data.data(), int(data.size())) != 1) {
+        qWarning(ASQL_PG) << "Failed to queue COPY data" << m_conn->errorMessage();
+        return false;
+    }
+    return true;
+}
+
+bool ADriverPg::copyInRow(const QVariantList &row)
+{
+    m_copyRowBuffer.clear();
+    for (qsizetype i = 0; i < row.size(); ++i) {
+        if (i) {
+            m_copyRowBuffer.append('\t');
+        }
+        PgTypes::appendCopyText(m_copyRowBuffer, row[i]);
+    }
+    m_copyRowBuffer.append('\n');
+
+    return copyInData(m_copyRowBuffer);
+}
+
+bool ADriverPg::copyInBinaryRow(const QVariantList &row)
+{
+    if (!m_copyIn) {
+        qWarning(ASQL_PG) << "COPY FROM STDIN not in progress";
+        return false;
+    }
+
+    m_copyRowBuffer.clear();
+    if (!m_copyInBinary) {
+        PgTypes::appendCopyBinaryHeader(m_copyRowBuffer);
+        m_copyInBinary = true;
+    }
+
+    // No query is sent while COPY is in progress so the parameters encoder is free
+    m_params.encode(row);
+    PgTypes::appendCopyBinaryRow(m_copyRowBuffer, m_params);
+
+    return copyInData(m_copyRowBuffer);
+}
+
+void ADriverPg::copyInFlush(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoroDataRef cb)
+{
+    Q_UNUSED(db);
+    Q_UNUSED(receiver);
+    if (!m_copyIn) {
+        if (cb) {
+            AResult result = resultError(u"COPY FROM STDIN not in progress"_s);
+            cb.deliverResult(result);
+        }
+        return;
+    }
+
+    m_copyInFlushWaiters.push_back(std::move(cb));
+    if (!m_flush) {
+        cmdFlush();
+    }
+}
+
+void ADriverPg::copyInEnd(const std::shared_ptr<ADriver> &db,
+                          const QString &error,
+                          QObject *receiver,
+                          ACoroDataRef cb)
+{
+    if (!m_copyIn || m_queuedQueries.empty()) {
+        if (cb) {
+            AResult result = resultError(u"COPY FROM STDIN not in progress"_s);
+            cb.deliverResult(result);
+        }
+        return;
+    }
+
+    if (error.isEmpty() && m_copyInBinary) {
+        m_copyRowBuffer.clear();
+        PgTypes::appendCopyBinaryTrailer(m_copyRowBuffer);
+        copyInData(m_copyRowBuffer);
+    }
+    m_copyIn       = false;
+    m_copyInBinary = false;
+
+    // The COPY query stays at the front of the queue, its final result
+    // now goes to whoever ended it
+    APGQuery &pgQuery     = m_queuedQueries.front();
+    pgQuery.cb            = std::move(cb);
+    pgQuery.receiver      = nullptr;
+    pgQuery.checkReceiver = nullptr;
+    setupCheckReceiver(pgQuery, receiver);
+    selfDriver = db;
+
+    const QByteArray errorMsg = error.toUtf8();
+    if (PQputCopyEnd(m_conn->conn(), error.isEmpty() ? nullptr : errorMsg.constData()) != 1) {
+        const QString connError = m_conn->errorMessage();
+        qWarning(ASQL_PG) << "Failed to end COPY" << connError;
+        finishConnection(connError);
+        return;
+    }
+    cmdFlush();
+}
+
+void ADriverPg::copyInStarted(std::shared_ptr<AResultPg> result)
+{
+    m_copyIn          = true;
+    APGQuery &pgQuery = m_queuedQueries.front();
+    if (pgQuery.cb && (!pgQuery.checkReceiver || !pgQuery.receiver.isNull())) {
+        pgQuery.result = std::move(result);
+        pgQuery.done();
+    } else {
+        // Nobody is going to write, end it so the connection can be used again
+        copyInEnd(selfDriver, u"COPY aborted by the client"_s, nullptr, {});
+    }
+}
+
+void ADriverPg::deliverCopyInFlushed(const QString &error)
+{
+    const auto waiters = std::move(m_copyInFlushWaiters);
+    m_copyInFlushWaiters.clear();
+    for (const ACoroDataRef &cb : waiters) {
+        if (cb) {
+            AResult result = error.isEmpty() ? resultSuccess() : resultError(error);
+            cb.deliverResult(result);
+        }
+    }
 }
 
 void ADriverPg::setLastQuerySingleRowMode()
@@ -650,20 +1275,89 @@ void ADriverPg::setLastQuerySingleRowMode()
     }
 }
 
-bool ADriverPg::enterPipelineMode(std::chrono::milliseconds timeout)
+void ADriverPg::setLastQueryChunkedRowsMode(int rows)
+{
+    if (rows <= 1) {
+        setLastQuerySingleRowMode();
+        return;
+    }
+
+    if (m_queuedQueries.size() == 1) {
+        APGQuery &pgQuery   = m_queuedQueries.front();
+        pgQuery.chunkedRows = rows;
+        if (!pgQuery.preparing && m_state == ADatabase::State::Connected) {
+            setChunkedRowsMode(rows);
+        }
+    } else if (m_queuedQueries.size() > 1) {
+        APGQuery &pgQuery   = m_queuedQueries.back();
+        pgQuery.chunkedRows = rows;
+    }
+}
+
+bool ADriverPg::batchChunkedRows(APGQuery &pgQuery, const std::shared_ptr<AResultPg> &result)
+{
+    const ExecStatusType status = result->status();
+    if (status == PGRES_TUPLES_OK && result->size() == 0 && pgQuery.result) {
+        // This empty result only marks the end of the rows, make the
+        // pending chunk the last result set to save a resume
+        return true;
+    }
+
+#ifndef LIBPQ_HAS_CHUNK_MODE
+    if (status == PGRES_SINGLE_TUPLE) {
+        if (!pgQuery.result) {
+            // Single row results are read-only, start the chunk with a copy we can append to
+            pgQuery.result = std::make_shared<AResultPg>(
+                PQcopyResult(result->m_result, PG_COPYRES_ATTRS | PG_COPYRES_TUPLES));
+        } else {
+            PGresult *chunk = pgQuery.result->m_result;
+            const int row   = PQntuples(chunk);
+            for (int column = 0; column < PQnfields(result->m_result); ++column) {
+                const bool null = PQgetisnull(result->m_result, 0, column) == 1;
+                PQsetvalue(chunk,
+                           row,
+                           column,
+                           null ? nullptr : PQgetvalue(result->m_result, 0, column),
+                           null ? -1 : PQgetlength(result->m_result, 0, column));
+            }
+        }
+
+        if (pgQuery.result->size() >= pgQuery.chunkedRows) {
+            pgQuery.result->m_lastResultSet = false;
+            pgQuery.done();
+            pgQuery.result.reset();
+        }
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+bool ADriverPg::enterPipelineMode(const APipelineSyncPolicy &policy)
 {
 #ifdef LIBPQ_HAS_PIPELINING
     // Refuse to enter Pipeline mode if we have queued queries
-    if (isConnected() && m_queuedQueries.empty() && PQenterPipelineMode(m_conn->conn()) == 1) {
+    if (isConnected() && m_queuedQueries.empty() && !m_implicitPipeline &&
+        PQenterPipelineMode(m_conn->conn()) == 1) {
         using namespace std::chrono;
-        if (timeout > 0ms && !m_autoSyncTimer) {
-            m_autoSyncTimer = std::make_unique<QTimer>();
-            m_autoSyncTimer->setInterval(timeout);
-            m_autoSyncTimer->setSingleShot(true);
-            connect(m_autoSyncTimer.get(), &QTimer::timeout, this, &ADriverPg::pipelineSync);
+        m_autoSync.setPolicy(policy);
+        if (policy.latency > 0ms) {
+            if (!m_autoSyncTimer) {
+                m_autoSyncTimer = std::make_unique<QTimer>();
+                m_autoSyncTimer->setSingleShot(true);
+                connect(m_autoSyncTimer.get(), &QTimer::timeout, this, [this] {
+                    syncPipeline(APgAutoSync::Trigger::Latency);
+                });
+            }
+            m_autoSyncTimer->setInterval(policy.latency);
+        } else {
+            m_autoSyncTimer.reset();
         }
         return true;
     }
+#else
+    Q_UNUSED(policy)
 #endif
 
     return false;
@@ -672,10 +1366,12 @@ bool ADriverPg::enterPipelineMode(std::chrono::milliseconds timeout)
 bool ADriverPg::exitPipelineMode()
 {
 #ifdef LIBPQ_HAS_PIPELINING
-    return isConnected() && PQexitPipelineMode(m_conn->conn()) == 1;
-#else
-    return false;
+    if (isConnected() && !m_implicitPipeline && PQexitPipelineMode(m_conn->conn()) == 1) {
+        m_autoSyncTimer.reset();
+        return true;
+    }
 #endif
+    return false;
 }
 
 ADatabase::PipelineStatus ADriverPg::pipelineStatus() const
@@ -689,19 +1385,94 @@ ADatabase::PipelineStatus ADriverPg::pipelineStatus() const
 }
 
 bool ADriverPg::pipelineSync()
+{
+    return syncPipeline(APgAutoSync::Trigger::Manual);
+}
+
+bool ADriverPg::syncPipeline(APgAutoSync::Trigger trigger)
 {
 #ifdef LIBPQ_HAS_PIPELINING
     if (isConnected() && PQpipelineSync(m_conn->conn()) == 1) {
+        if (m_syncingBatch) {
+            // Synced before its end, the batch takes more than one sync
+            m_syncingBatch->synced = false;
+            m_syncingBatch.reset();
+        }
         ++m_pipelineSync;
+        m_autoSync.synced(trigger);
+        if (m_autoSyncTimer) {
+            m_autoSyncTimer->stop();
+        }
         return true;
     }
+#else
+    Q_UNUSED(trigger)
 #endif
     return false;
 }
 
+APipelineSyncStats ADriverPg::pipelineSyncStats() const
+{
+    return m_autoSync.stats();
+}
+
+void ADriverPg::setPreparedCacheCapacity(const std::shared_ptr<ADriver> &db, int capacity)
+{
+    m_preparedQueries.setCapacity(capacity, m_evictedPrepared);
+    deallocateEvicted(db);
+}
+
+APreparedCacheStats ADriverPg::preparedCacheStats() const
+{
+    return m_preparedQueries.stats();
+}
+
+void ADriverPg::deallocateEvicted(const std::shared_ptr<ADriver> &db)
+{
+    // Deallocations wait for a pipelined transaction or batch to be issued, inside
+    // one they would take its place or be skipped when it fails
+    if (m_pipelinedTransaction || m_pipelineBatch > 0) {
+        return;
+    }
+
+    while (!m_evictedPrepared.isEmpty()) {
+        APGQuery pgQuery;
+        pgQuery.query      = m_evictedPrepared.takeFirst();
+        pgQuery.deallocate = true;
+
+        qDebug(ASQL_PG) << "Deallocating prepared statement" << pgQuery.query;
+        enqueue(db, std::move(pgQuery));
+    }
+}
+
+void ADriverPg::setAutoPipeline(bool enable)
+{
+    m_autoPipeline = enable;
+}
+
+bool ADriverPg::autoPipeline() const
+{
+    return m_autoPipeline;
+}
+
+void ADriverPg::setResultFormat(ADatabase::ResultFormat format)
+{
+    m_resultFormat = format;
+}
+
+ADatabase::ResultFormat ADriverPg::resultFormat() const
+{
+    return m_resultFormat;
+}
+
+int ADriverPg::resultFormatFlag() const
+{
+    return m_resultFormat == ADatabase::ResultFormat::Binary ? 1 : 0;
+}
+
 int ADriverPg::queueSize() const
 {
-    return m_queuedQueries.size();
+    return int(m_queuedQueries.size());
 }
 
 void ADriverPg::subscribeToNotification(const std::shared_ptr<ADriver> &db,
@@ -797,14 +1568,124 @@ ACoroTerminator ADriverPg::unlistenCoro(std::shared_ptr<ADriver> db, QString nam
     qDebug(ASQL_PG) << "unsubscribed" << r.has_value() << (!r ? r.error() : r->errorString());
 }
 
+bool ADriverPg::canPipeline(const APGQuery &pgQuery) const
+{
+    if (pgQuery.copyOutCb || pgQuery.setSingleRow || pgQuery.chunkedRows) {
+        return false;
+    }
+
+    if (pgQuery.preparedQuery) {
+        return m_preparedQueries.contains(pgQuery.preparedQuery->identification());
+    }
+
+    // Pipelines use the extended query protocol which
+    // allows neither COPY nor multiple commands per query
+    const QByteArrayView query = QByteArrayView(pgQuery.query).trimmed();
+    if (query.size() >= 4 && qstrnicmp(query.data(), 4, "COPY", 4) == 0) {
+        return false;
+    }
+
+    const qsizetype semicolon = query.indexOf(';');
+    return semicolon == -1 || semicolon == query.size() - 1;
+}
+
+bool ADriverPg::startImplicitPipeline()
+{
+#ifdef LIBPQ_HAS_PIPELINING
+    int pipelinable = 0;
+    for (const APGQuery &pgQuery : m_queuedQueries) {
+        if (!canPipeline(pgQuery) || ++pipelinable > 1) {
+            break;
+        }
+    }
+
+    // A transaction or batch is pipelined even if the rest of it wasn't issued yet
+    const bool begin =
+        pipelinable > 0 && m_queuedQueries.front().transaction == APGQuery::Transaction::Begin;
+    if ((pipelinable < 2 && !begin) || PQenterPipelineMode(m_conn->conn()) != 1) {
+        return false;
+    }
+
+    m_implicitPipeline = true;
+
+    auto it = m_queuedQueries.begin();
+    while (it != m_queuedQueries.end() && canPipeline(*it) && !m_pipelinedTransactionEnd) {
+        if (it->discarded()) {
+            it = m_queuedQueries.erase(it);
+        } else if (runQuery(*it)) {
+            ++it;
+        } else {
+            it = m_queuedQueries.erase(it);
+        }
+    }
+
+    if (m_pipelinedQueries == 0) {
+        // Nothing was sent after all
+        PQexitPipelineMode(m_conn->conn());
+        m_implicitPipeline = false;
+        return false;
+    }
+
+    syncImplicitPipeline();
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ADriverPg::syncImplicitPipeline()
+{
+    // A query that can't join the pipeline waits for it to complete, which takes
+    // a sync, a pipelined transaction or batch goes on sequentially
+    if (m_implicitPipeline && m_pipelineSync == 0 &&
+        m_pipelinedQueries < int(m_queuedQueries.size())) {
+        pipelineSync();
+    }
+}
+
+void ADriverPg::leaveImplicitPipeline()
+{
+#ifdef LIBPQ_HAS_PIPELINING
+    if (PQexitPipelineMode(m_conn->conn()) != 1) {
+        qWarning(ASQL_PG) << "Failed to exit pipeline mode" << m_conn->errorMessage();
+    }
+
+    if (m_pipelinedTransactionEnd && PQtransactionStatus(m_conn->conn()) == PQTRANS_INERROR) {
+        // The pipelined transaction failed and skipped its end, the
+        // server waits for a rollback before anything else
+        APGQuery pgQuery;
+        pgQuery.query.setRawData("ROLLBACK", 8);
+        pgQuery.transaction = APGQuery::Transaction::End;
+        m_queuedQueries.emplace_front(std::move(pgQuery));
+    }
+#endif
+    m_implicitPipeline        = false;
+    m_pipelinedTransactionEnd = false;
+
+    // Send whatever was left waiting for the pipeline to complete
+    nextQuery();
+}
+
 void ADriverPg::nextQuery()
 {
+    if (m_implicitPipeline) {
+        // Queries not pipelined are sent once the pipeline completes
+        return;
+    }
+
     const bool pipelineOff = pipelineStatus() == ADatabase::PipelineStatus::Off;
+    if (pipelineOff && m_autoPipeline && !m_queryRunning && isConnected() &&
+        startImplicitPipeline()) {
+        return;
+    }
 
     while (pipelineOff && !m_queuedQueries.empty() && !m_queryRunning) {
         APGQuery &pgQuery = m_queuedQueries.front();
-        if ((pgQuery.checkReceiver && pgQuery.receiver.isNull()) || !pgQuery.cb) {
-            m_queuedQueries.pop();
+        if (pgQuery.discarded()) {
+            m_queuedQueries.pop_front();
+        } else if (pgQuery.transaction == APGQuery::Transaction::Begin && isConnected() &&
+                   startImplicitPipeline()) {
+            return;
         } else {
             runQuery(pgQuery);
         }
@@ -817,52 +1698,93 @@ void ADriverPg::finishConnection(const QString &error)
 
     m_subscribedNotifications.clear();
     m_preparedQueries.clear();
-    m_pipelineSync = 0;
+    m_evictedPrepared.clear();
+    m_pipelineSync     = 0;
+    m_pipelinedQueries = 0;
+    m_implicitPipeline = false;
+    m_copyIn           = false;
+    m_copyInBinary     = false;
+    m_copyOut          = false;
+    // Statements issued after a failure are not part of the transaction
+    m_pipelinedTransaction       = false;
+    m_pipelinedTransactionFailed = false;
+    m_pipelinedTransactionEnd    = false;
+    m_pipelineBatch              = 0;
+    m_issuingBatch.reset();
+    m_syncingBatch.reset();
+    deliverCopyInFlushed(error);
     m_autoSyncTimer.reset();
+    m_autoSync.reset();
+    if (m_deadlineTimer) {
+        m_deadlineTimer->stop();
+    }
     m_readNotify.reset();
     m_writeNotify.reset();
     setState(ADatabase::State::Disconnected, error);
 
     while (!m_queuedQueries.empty()) {
-        APGQuery pgQuery = m_queuedQueries.front();
-        m_queuedQueries.pop();
+        APGQuery pgQuery = std::move(m_queuedQueries.front());
+        m_queuedQueries.pop_front();
         pgQuery.result                = std::make_shared<AResultPg>(nullptr);
         pgQuery.result->m_error       = true;
         pgQuery.result->m_errorString = error;
         pgQuery.done();
     }
+
+    // Queries waiting for room were issued before the failure as well
+    failQueueWaiters(error);
 }
 
 int ADriverPg::doExec(APGQuery &pgQuery)
 {
     int ret;
-    if (pgQuery.preparedQuery) {
-        auto prepared = m_preparedQueries.find(pgQuery.preparedQuery->identification());
-        if (prepared == m_preparedQueries.end()) {
-            const auto preparedId = preparedQueryStringId(pgQuery.preparedQuery->identification());
-            ret                   = PQsendPrepare(m_conn->conn(),
-                                                  preparedId.constData(),
-                                                  pgQuery.preparedQuery->query().constData(),
-                                                  0,
-                                                  nullptr); // perhaps later use binary results
+    if (pgQuery.deallocate) {
+#ifdef LIBPQ_HAS_CLOSE_PREPARED
+        ret = PQsendClosePrepared(m_conn->conn(), pgQuery.query.constData());
+#else
+        const QByteArray deallocate = "DEALLOCATE " + pgQuery.query;
+        ret                         = PQsendQuery(m_conn->conn(), deallocate.constData());
+#endif
+    } else if (pgQuery.preparedQuery) {
+        const int id        = pgQuery.preparedQuery->identification();
+        QByteArray prepared = m_preparedQueries.find(id, pgQuery.preparedName.isNull());
+        if (prepared.isNull()) {
+            pgQuery.preparedName = m_preparedQueries.nextName(id);
+            ret                  = PQsendPrepare(m_conn->conn(),
+                                                 pgQuery.preparedName.constData(),
+                                                 pgQuery.preparedQuery->query().constData(),
+                                                 0,
+                                                 nullptr);
 
             if (ret == 1 && pipelineStatus() == ADatabase::PipelineStatus::On) {
-                // pretend that it was prepared otherwise it can't be used in in the pipeline
-                prepared =
-                    m_preparedQueries.insert(pgQuery.preparedQuery->identification(), preparedId);
+                // pretend that it was prepared otherwise it can't be used in in the pipeline,
+                // it's removed if preparing fails
+                prepared = pgQuery.preparedName;
+                m_preparedQueries.insert(id, prepared, m_evictedPrepared);
             }
             pgQuery.preparing = true;
         }
 
-        if (prepared != m_preparedQueries.end()) {
+        if (!prepared.isNull()) {
             ret = PQsendQueryPrepared(m_conn->conn(),
-                                      prepared.value().constData(),
+                                      prepared.constData(),
                                       0,
                                       nullptr,
                                       nullptr,
                                       nullptr,
-                                      0); // perhaps later use binary results
+                                      pgQuery.resultFormat);
         }
+    } else if (pgQuery.resultFormat == 1) {
+        // Only the extended query protocol can request binary results,
+        // which means a single command per query
+        ret = PQsendQueryParams(m_conn->conn(),
+                                pgQuery.query.constData(),
+                                0,
+                                nullptr,
+                                nullptr,
+                                nullptr,
+                                nullptr,
+                                pgQuery.resultFormat);
     } else {
         ret = PQsendQuery(m_conn->conn(), pgQuery.query.constData());
     }
@@ -870,179 +1792,72 @@ int ADriverPg::doExec(APGQuery &pgQuery)
     return ret;
 }
 
-int ADriverPg::doExecParams(APGQuery &pgQuery)
+bool ADriverPg::describePrepared(APGQuery &pgQuery)
 {
-    const QVariantList &params = pgQuery.params;
-    auto paramTypes            = std::make_unique<Oid[]>(params.size());
-    auto paramValues           = std::make_unique<const char *[]>(params.size());
-    auto paramLengths          = std::make_unique<int[]>(params.size());
-    auto paramFormats          = std::make_unique<int[]>(params.size());
-
-    QByteArrayList deleteLater;
-    for (int i = 0; i < params.size(); ++i) {
-        QVariant v = params[i];
-        QByteArray data;
-        //        qDebug(ASQL_PG) << v << v.type() << v.isNull() << "---" <<
-        //        QString::number(v.toInt()).toLatin1().constData() << v.toString().isNull();
-        if (!v.isNull()) {
-            switch (v.userType()) {
-            case QMetaType::QString:
-            {
-                const QString text = v.toString();
-                paramTypes[i]      = !text.isNull() ? QTEXTOID : QUNKNOWNOID;
-                paramFormats[i]    = 0;
-                data               = text.toUtf8();
-            } break;
-            case QMetaType::QByteArray:
-                paramTypes[i]   = QBYTEAOID;
-                paramFormats[i] = 1;
-                data            = v.toByteArray();
-                break;
-            case QMetaType::Int:
-                paramTypes[i]   = QINT4OID;
-                paramFormats[i] = 1;
-                {
-                    const qint32 number = v.toInt();
-                    data.resize(4);
-                    qToBigEndian<qint32>(number, data.data());
-                }
-                break;
-            case QMetaType::LongLong:
-                paramTypes[i]   = QINT8OID;
-                paramFormats[i] = 1;
-                {
-                    const qint64 number = v.toLongLong();
-                    data.resize(8);
-                    qToBigEndian<qint64>(number, data.data());
-                }
-                break;
-            case QMetaType::QUuid:
-                paramTypes[i]   = QUUIDOID;
-                paramFormats[i] = 1;
-                data            = v.toUuid().toRfc4122();
-                break;
-            case QMetaType::Bool:
-                paramTypes[i]   = QBOOLOID;
-                paramFormats[i] = 1;
-                data.append(v.toBool() ? 0x01 : 0x00);
-                break;
-            case QMetaType::UnknownType:
-                paramTypes[i]   = QUNKNOWNOID;
-                paramFormats[i] = 0;
-                break;
-            case QMetaType::QJsonObject:
-                paramTypes[i]   = QJSONBOID;
-                paramFormats[i] = 0;
-                data            = QJsonDocument(v.toJsonObject()).toJson(QJsonDocument::Compact);
-                break;
-            case QMetaType::QJsonArray:
-                paramTypes[i]   = QJSONBOID;
-                paramFormats[i] = 0;
-                data            = QJsonDocument(v.toJsonArray()).toJson(QJsonDocument::Compact);
-                break;
-            case QMetaType::QJsonValue:
-            {
-                const QJsonValue jValue = v.toJsonValue();
-                switch (jValue.type()) {
-                case QJsonValue::Bool:
-                    paramTypes[i]   = QBOOLOID;
-                    paramFormats[i] = 1;
-                    data.append(jValue.toBool() ? 0x01 : 0x00);
-                    break;
-                    ;
-                case QJsonValue::Double:
-                    paramTypes[i]   = QUNKNOWNOID; // This allows PG to try to deduce the type
-                    paramFormats[i] = 0;
-                    data            = jValue.toVariant().toString().toLatin1();
-                    break;
-                case QJsonValue::String:
-                {
-                    const QString text = v.toString();
-                    paramTypes[i]      = !text.isNull() ? QTEXTOID : QUNKNOWNOID;
-                    paramFormats[i]    = 0;
-                    data               = jValue.toString().toUtf8();
-                } break;
-                case QJsonValue::Array:
-                    paramTypes[i]   = QJSONBOID;
-                    paramFormats[i] = 0;
-                    data = QJsonDocument(jValue.toArray()).toJson(QJsonDocument::Compact);
-                    break;
-                case QJsonValue::Object:
-                    paramTypes[i]   = QJSONBOID;
-                    paramFormats[i] = 0;
-                    data = QJsonDocument(jValue.toObject()).toJson(QJsonDocument::Compact);
-                    break;
-                default:
-                    paramTypes[i]   = QUNKNOWNOID;
-                    paramFormats[i] = 0;
-                    paramValues[i]  = nullptr;
-                    paramLengths[i] = 0;
-                }
-            } break;
-            case QMetaType::QJsonDocument:
-                paramTypes[i]   = QJSONBOID;
-                paramFormats[i] = 0;
-                data            = v.toJsonDocument().toJson(QJsonDocument::Compact);
-                break;
-            default:
-                paramTypes[i]   = QUNKNOWNOID; // This allows PG to try to deduce the type
-                paramFormats[i] = 0;
-                data            = v.toString().toUtf8();
-            }
+    // Pipelined executions were sent along with the preparation
+    if (pipelineStatus() != ADatabase::PipelineStatus::Off) {
+        return false;
+    }
 
-            if (data.size() || paramTypes[i] != QUNKNOWNOID) {
-                deleteLater.append(data); // Otherwise our temporary data will be deleted
-                paramValues[i]  = data.constData();
-                paramLengths[i] = data.size();
-            } else {
-                paramValues[i]  = nullptr;
-                paramLengths[i] = 0;
-            }
-        } else {
-            paramTypes[i]   = QUNKNOWNOID;
-            paramFormats[i] = 0;
-            paramValues[i]  = nullptr;
-            paramLengths[i] = 0;
-        }
+    if (PQsendDescribePrepared(m_conn->conn(), pgQuery.preparedName.constData()) != 1) {
+        qWarning(ASQL_PG) << "Failed to describe prepared query" << m_conn->errorMessage();
+        return false;
     }
+    pgQuery.describing = true;
+    m_queryRunning     = true;
+    cmdFlush();
+    return true;
+}
+
+int ADriverPg::doExecParams(APGQuery &pgQuery)
+{
+    // The encoder is shared by all queries of this connection so
+    // that its buffers don't need to be allocated each time, described
+    // statements get their values in the declared types
+    m_params.encode(pgQuery.params,
+                    pgQuery.preparedQuery
+                        ? m_preparedQueries.paramTypes(pgQuery.preparedQuery->identification())
+                        : std::span<const Oid>{});
 
     int ret;
     if (pgQuery.preparedQuery) {
-        auto prepared = m_preparedQueries.find(pgQuery.preparedQuery->identification());
-        if (prepared == m_preparedQueries.end()) {
-            const auto preparedId = preparedQueryStringId(pgQuery.preparedQuery->identification());
-            ret                   = PQsendPrepare(m_conn->conn(),
-                                                  preparedId.constData(),
-                                                  pgQuery.preparedQuery->query().constData(),
-                                                  params.size(),
-                                                  paramTypes.get());
+        const int id        = pgQuery.preparedQuery->identification();
+        QByteArray prepared = m_preparedQueries.find(id, pgQuery.preparedName.isNull());
+        if (prepared.isNull()) {
+            pgQuery.preparedName = m_preparedQueries.nextName(id);
+            ret                  = PQsendPrepare(m_conn->conn(),
+                                                 pgQuery.preparedName.constData(),
+                                                 pgQuery.preparedQuery->query().constData(),
+                                                 m_params.size(),
+                                                 m_params.types());
 
             if (ret == 1 && pipelineStatus() == ADatabase::PipelineStatus::On) {
-                // pretend that it was prepared otherwise it can't be used in in the pipeline
-                prepared =
-                    m_preparedQueries.insert(pgQuery.preparedQuery->identification(), preparedId);
+                // pretend that it was prepared otherwise it can't be used in in the pipeline,
+                // it's removed if preparing fails
+                prepared = pgQuery.preparedName;
+                m_preparedQueries.insert(id, prepared, m_evictedPrepared);
             }
             pgQuery.preparing = true;
         }
 
-        if (prepared != m_preparedQueries.end()) {
+        if (!prepared.isNull()) {
             ret = PQsendQueryPrepared(m_conn->conn(),
-                                      prepared.value().constData(),
-                                      params.size(),
-                                      paramValues.get(),
-                                      paramLengths.get(),
-                                      paramFormats.get(),
-                                      0); // perhaps later use binary results
+                                      prepared.constData(),
+                                      m_params.size(),
+                                      m_params.values(),
+                                      m_params.lengths(),
+                                      m_params.formats(),
+                                      pgQuery.resultFormat);
         }
     } else {
         ret = PQsendQueryParams(m_conn->conn(),
                                 pgQuery.query.constData(),
-                                params.size(),
-                                paramTypes.get(),
-                                paramValues.get(),
-                                paramLengths.get(),
-                                paramFormats.get(),
-                                0); // perhaps later use binary results
+                                m_params.size(),
+                                m_params.types(),
+                                m_params.values(),
+                                m_params.lengths(),
+                                m_params.formats(),
+                                pgQuery.resultFormat);
     }
 
     return ret;
@@ -1055,6 +1870,19 @@ void ADriverPg::setSingleRowMode()
     }
 }
 
+void ADriverPg::setChunkedRowsMode(int rows)
+{
+#ifdef LIBPQ_HAS_CHUNK_MODE
+    if (PQsetChunkedRowsMode(m_conn->conn(), rows) != 1) {
+        qWarning(ASQL_PG) << "Failed to set chunked rows mode";
+    }
+#else
+    Q_UNUSED(rows);
+    // Rows arrive one by one and get batched by batchChunkedRows()
+    setSingleRowMode();
+#endif
+}
+
 void ADriverPg::cmdFlush()
 {
     int ret = PQflush(m_conn->conn());
@@ -1064,6 +1892,11 @@ void ADriverPg::cmdFlush()
         // Wait for write-ready and call it again
         m_flush = true;
         m_writeNotify->setEnabled(true);
+        return;
+    }
+
+    if (!m_copyInFlushWaiters.empty()) {
+        deliverCopyInFlushed(ret == -1 ? m_conn->errorMessage() : QString{});
     }
 }
 
@@ -1072,6 +1905,127 @@ bool ADriverPg::isConnected() const
     return m_state == ADatabase::State::Connected;
 }
 
+QByteArray APgPreparedCache::find(int id, bool countHit)
+{
+    auto it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        return {};
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, it->lru);
+    if (countHit) {
+        ++m_hits;
+    }
+    return it->name;
+}
+
+bool APgPreparedCache::contains(int id) const
+{
+    return m_entries.contains(id);
+}
+
+QByteArray APgPreparedCache::nextName(int id)
+{
+    ++m_misses;
+    return "asql_" + QByteArray::number(id, 16) + '_' + QByteArray::number(++m_names, 16);
+}
+
+void APgPreparedCache::insert(int id, const QByteArray &name, QByteArrayList &evicted)
+{
+    auto it = m_entries.find(id);
+    if (it != m_entries.end()) {
+        it->name = name;
+        it->fieldIndex.reset();
+        it->fields = -1;
+        it->paramTypes.clear();
+        m_lru.splice(m_lru.begin(), m_lru, it->lru);
+        return;
+    }
+
+    m_lru.push_front(id);
+    m_entries.insert(id, {name, m_lru.begin()});
+    evict(evicted);
+}
+
+void APgPreparedCache::remove(int id, const QByteArray &name)
+{
+    auto it = m_entries.find(id);
+    if (it != m_entries.end() && it->name == name) {
+        m_lru.erase(it->lru);
+        m_entries.erase(it);
+    }
+}
+
+std::shared_ptr<AFieldIndex> APgPreparedCache::fieldIndex(int id, int fields)
+{
+    auto it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        return {};
+    }
+
+    if (!it->fieldIndex || it->fields != fields) {
+        it->fieldIndex = std::make_shared<AFieldIndex>();
+        it->fields     = fields;
+    }
+    return it->fieldIndex;
+}
+
+void APgPreparedCache::describe(int id, const AResultPg &description)
+{
+    auto it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        return;
+    }
+
+    const int params = PQnparams(description.m_result);
+    it->paramTypes.resize(params);
+    for (int i = 0; i < params; ++i) {
+        it->paramTypes[i] = PQparamtype(description.m_result, i);
+    }
+
+    // The row description has the field names, so results don't need to build it,
+    // an index built for an earlier description is stale
+    it->fieldIndex = std::make_shared<AFieldIndex>();
+    it->fields     = PQnfields(description.m_result);
+    std::ignore    = it->fieldIndex->indexOf(description, QStringView{});
+}
+
+std::span<const Oid> APgPreparedCache::paramTypes(int id) const
+{
+    auto it = m_entries.constFind(id);
+    if (it == m_entries.constEnd()) {
+        return {};
+    }
+    return {it->paramTypes.constData(), size_t(it->paramTypes.size())};
+}
+
+void APgPreparedCache::setCapacity(int capacity, QByteArrayList &evicted)
+{
+    m_capacity = qMax(0, capacity);
+    evict(evicted);
+}
+
+void APgPreparedCache::clear()
+{
+    m_entries.clear();
+    m_lru.clear();
+}
+
+APreparedCacheStats APgPreparedCache::stats() const
+{
+    return {m_hits, m_misses, m_evictions, int(m_entries.size()), m_capacity};
+}
+
+void APgPreparedCache::evict(QByteArrayList &evicted)
+{
+    while (m_capacity > 0 && m_entries.size() > m_capacity) {
+        const int id = m_lru.back();
+        m_lru.pop_back();
+        evicted.append(m_entries.take(id).name);
+        ++m_evictions;
+    }
+}
+
 AResultPg::AResultPg(PGresult *result)
     : m_result{result}
 {
@@ -1127,19 +2081,17 @@ qint64 AResultPg::numRowsAffected() const
     return QString::fromLatin1(PQcmdTuples(m_result)).toLongLong();
 }
 
-int AResultPg::indexOfField(QLatin1String name) const
+QString AResultPg::fieldName(int column) const
 {
-    for (int i = 0; i < fields(); ++i) {
-        if (qstrcmp(name.data(), PQfname(m_result, i)) == 0) {
-            return i;
-        }
-    }
-    return -1;
+    return QString::fromUtf8(PQfname(m_result, column));
 }
 
-QString AResultPg::fieldName(int column) const
+QVariantList AResultPg::toList(int row, int column) const
 {
-    return QString::fromUtf8(PQfname(m_result, column));
+    if (PQgetisnull(m_result, row, column)) {
+        return {};
+    }
+    return PgTypes::toList(pgValue(m_result, row, column));
 }
 
 QVariant AResultPg::value(int row, int column) const
@@ -1149,112 +2101,11 @@ QVariant AResultPg::value(int row, int column) const
         return {};
     }
 
-    int ptype      = PQftype(m_result, column);
-    QMetaType type = qDecodePSQLType(ptype);
     if (PQgetisnull(m_result, row, column)) {
-        return QVariant(type, nullptr);
+        return QVariant(PgTypes::metaTypeForOid(PQftype(m_result, column)), nullptr);
     }
 
-    const char *val = PQgetvalue(m_result, row, column);
-    switch (type.id()) {
-    case QMetaType::Bool:
-        return QVariant((bool) (val[0] == 't'));
-    case QMetaType::QString:
-        return QString::fromUtf8(val);
-    case QMetaType::LongLong:
-        if (val[0] == '-') {
-            return QString::fromLatin1(val).toLongLong();
-        } else {
-            return QString::fromLatin1(val).toULongLong();
-        }
-    case QMetaType::Int:
-        return atoi(val);
-    case QMetaType::Double:
-    {
-        //        if (ptype == QNUMERICOID) {
-        //            if (numericalPrecisionPolicy() != QSql::HighPrecision) {
-        //                QVariant retval;
-        //                bool convert;
-        //                double dbl=QString::fromLatin1(val).toDouble(&convert);
-        //                if (numericalPrecisionPolicy() == QSql::LowPrecisionInt64)
-        //                    retval = (qlonglong)dbl;
-        //                else if (numericalPrecisionPolicy() == QSql::LowPrecisionInt32)
-        //                    retval = (int)dbl;
-        //                else if (numericalPrecisionPolicy() == QSql::LowPrecisionDouble)
-        //                    retval = dbl;
-        //                if (!convert)
-        //                    return QVariant();
-        //                return retval;
-        //            }
-        //            return QString::fromLatin1(val);
-        //        }
-        if (qstricmp(val, "Infinity") == 0) {
-            return qInf();
-        }
-        if (qstricmp(val, "-Infinity") == 0) {
-            return -qInf();
-        }
-        return QString::fromLatin1(val).toDouble();
-    }
-    case QMetaType::QDate:
-        if (val[0] == '\0') {
-            return QDate();
-        } else {
-#ifndef QT_NO_DATESTRING
-            return QDate::fromString(QString::fromLatin1(val), Qt::ISODate);
-#else
-            return QString::fromLatin1(val);
-#endif
-        }
-    case QMetaType::QTime:
-    {
-        const QString str = QString::fromLatin1(val);
-#ifndef QT_NO_DATESTRING
-        if (str.isEmpty()) {
-            return QTime();
-        } else {
-            return QTime::fromString(str, Qt::ISODate);
-        }
-#else
-        return QVariant(str);
-#endif
-    }
-    case QMetaType::QDateTime:
-    {
-        QString dtval = QString::fromLatin1(val);
-#ifndef QT_NO_DATESTRING
-        if (dtval.length() < 10) {
-            return QDateTime();
-        } else {
-            QChar sign = dtval[dtval.size() - 3];
-            if (sign == u'-' || sign == u'+') {
-                dtval += u":00";
-            }
-            return QDateTime::fromString(dtval, Qt::ISODate);
-        }
-#else
-        return dtval;
-#endif
-    }
-    case QMetaType::QByteArray:
-        return decodePgByteaText(val, PQgetlength(m_result, row, column));
-    case QMetaType::QJsonValue:
-    {
-        const auto doc = QJsonDocument::fromJson(val);
-        if (doc.isObject()) {
-            return doc.object();
-        } else if (doc.isArray()) {
-            return doc.array();
-        }
-        break;
-    }
-    case QMetaType::QUuid:
-        return QUuid::fromString(val);
-    default:
-    case QMetaType::UnknownType:
-        qWarning(ASQL_PG, "unknown data type");
-    }
-    return {};
+    return PgTypes::toVariant(pgValue(m_result, row, column));
 }
 
 bool AResultPg::isNull(int row, int column) const
@@ -1266,42 +2117,31 @@ bool AResultPg::isNull(int row, int column) const
 bool AResultPg::toBool(int row, int column) const
 {
     Q_ASSERT_X(column < PQnfields(m_result), "toBool", "column out of range");
-    const char *val = PQgetvalue(m_result, row, column);
-    return val[0] == 't';
+    return PgTypes::toBool(pgValue(m_result, row, column));
 }
 
 int AResultPg::toInt(int row, int column) const
 {
     Q_ASSERT_X(column < PQnfields(m_result), "toInt", "column out of range");
-    const char *val = PQgetvalue(m_result, row, column);
-    return atoi(val);
+    return PgTypes::toInt(pgValue(m_result, row, column));
 }
 
 qint64 AResultPg::toLongLong(int row, int column) const
 {
     Q_ASSERT_X(column < PQnfields(m_result), "toLongLong", "column out of range");
-    const char *val = PQgetvalue(m_result, row, column);
-    return QString::fromLatin1(val).toLongLong();
+    return PgTypes::toLongLong(pgValue(m_result, row, column));
 }
 
 quint64 AResultPg::toULongLong(int row, int column) const
 {
     Q_ASSERT_X(column < PQnfields(m_result), "toULongLong", "column out of range");
-    const char *val = PQgetvalue(m_result, row, column);
-    return QString::fromLatin1(val).toULongLong();
+    return PgTypes::toULongLong(pgValue(m_result, row, column));
 }
 
 double AResultPg::toDouble(int row, int column) const
 {
     Q_ASSERT_X(column < PQnfields(m_result), "toDouble", "column out of range");
-    const char *val = PQgetvalue(m_result, row, column);
-    if (qstricmp(val, "Infinity") == 0) {
-        return qInf();
-    }
-    if (qstricmp(val, "-Infinity") == 0) {
-        return -qInf();
-    }
-    return QString::fromLatin1(val).toDouble();
+    return PgTypes::toDouble(pgValue(m_result, row, column));
 }
 
 QString AResultPg::toString(int row, int column) const
@@ -1311,8 +2151,7 @@ QString AResultPg::toString(int row, int column) const
         return {};
     }
 
-    const char *val = PQgetvalue(m_result, row, column);
-    return QString::fromUtf8(val);
+    return PgTypes::toString(pgValue(m_result, row, column));
 }
 
 std::string AResultPg::toStdString(int row, int column) const
@@ -1322,8 +2161,7 @@ std::string AResultPg::toStdString(int row, int column) const
         return {};
     }
 
-    const char *val = PQgetvalue(m_result, row, column);
-    return std::string(val);
+    return PgTypes::toStdString(pgValue(m_result, row, column));
 }
 
 QUuid AResultPg::toUuid(int row, int column) const
@@ -1333,77 +2171,35 @@ QUuid AResultPg::toUuid(int row, int column) const
         return {};
     }
 
-    const char *val = PQgetvalue(m_result, row, column);
-    return QUuid::fromString(val);
+    return PgTypes::toUuid(pgValue(m_result, row, column));
 }
 
 QDate AResultPg::toDate(int row, int column) const
 {
     Q_ASSERT_X(column < PQnfields(m_result), "toDate", "column out of range");
-    const char *val = PQgetvalue(m_result, row, column);
-    if (val[0] == '\0') {
-        return {};
-    } else {
-#ifndef QT_NO_DATESTRING
-        return QDate::fromString(QString::fromLatin1(val), Qt::ISODate);
-#else
-        return {};
-#endif
-    }
+    return PgTypes::toDate(pgValue(m_result, row, column));
 }
 
 QTime AResultPg::toTime(int row, int column) const
 {
     Q_ASSERT_X(column < PQnfields(m_result), "toTime", "column out of range");
-    const char *val   = PQgetvalue(m_result, row, column);
-    const QString str = QString::fromLatin1(val);
-#ifndef QT_NO_DATESTRING
-    if (str.isEmpty()) {
-        return {};
-    } else {
-        return QTime::fromString(str, Qt::ISODate);
-    }
-#else
-    return {};
-#endif
+    return PgTypes::toTime(pgValue(m_result, row, column));
 }
 
 QDateTime AResultPg::toDateTime(int row, int column) const
 {
     Q_ASSERT_X(column < PQnfields(m_result), "toDateTime", "column out of range");
-    const char *val = PQgetvalue(m_result, row, column);
-    QString dtval   = QString::fromLatin1(val);
-#ifndef QT_NO_DATESTRING
-    if (dtval.length() < 10) {
-        return {};
-    } else {
-        QChar sign = dtval[dtval.size() - 3];
-        if (sign == u'-' || sign == u'+') {
-            dtval += u":00";
-        }
-        return QDateTime::fromString(dtval, Qt::ISODate);
-    }
-#else
-    return {};
-#endif
+    return PgTypes::toDateTime(pgValue(m_result, row, column));
 }
 
 QJsonValue AResultPg::toJsonValue(int row, int column) const
 {
-    QJsonValue ret;
     Q_ASSERT_X(column < PQnfields(m_result), "toJsonValue", "column out of range");
     if (PQgetisnull(m_result, row, column) == 1) {
-        return ret;
+        return {};
     }
 
-    const char *val = PQgetvalue(m_result, row, column);
-    auto doc        = QJsonDocument::fromJson(val);
-    if (doc.isObject()) {
-        ret = doc.object();
-    } else if (doc.isArray()) {
-        ret = doc.array();
-    }
-    return ret;
+    return PgTypes::toJsonValue(pgValue(m_result, row, column));
 }
 
 QCborValue AResultPg::toCborValue(int row, int column) const
@@ -1422,7 +2218,11 @@ QCborValue AResultPg::toCborValue(int row, int column) const
 QByteArray AResultPg::toByteArray(int row, int column) const
 {
     Q_ASSERT_X(column < PQnfields(m_result), "toByteArray", "column out of range");
-    return pgColumnBytes(m_result, row, column);
+    if (PQgetisnull(m_result, row, column) == 1) {
+        return {};
+    }
+
+    return PgTypes::toByteArray(pgValue(m_result, row, column));
 }
 
 #include "moc_adriverpg.cpp"
@@ -5,17 +5,21 @@
 #pragma once
 
 #include "acoroexpected.h"
+#include "apgautosync.h"
+#include "apgtypes.h"
 #include "apreparedquery.h"
 #include "aresult.h"
+#include "aringqueue.h"
 
 #include <adriver.h>
 #include <libpq-fe.h>
+#include <list>
 #include <optional>
+#include <span>
 #include <vector>
 
 #include <QHash>
 #include <QPointer>
-#include <queue>
 
 class QTimer;
 
@@ -40,7 +44,6 @@ public:
     int fields() const override;
     qint64 numRowsAffected() const override;
 
-    int indexOfField(QLatin1String name) const override;
     QString fieldName(int column) const override;
     QVariant value(int row, int column) const override;
 
@@ -59,6 +62,7 @@ public:
     QJsonValue toJsonValue(int row, int column) const final;
     QCborValue toCborValue(int row, int column) const final;
     QByteArray toByteArray(int row, int column) const override;
+    QVariantList toList(int row, int column) const override;
 
     inline void processResult();
 
@@ -73,16 +77,48 @@ public:
 class APGQuery
 {
 public:
-    APGQuery() = default;
+    // Position in a pipelined transaction or batch, only their ends are followed
+    // by a sync, Sync ends a batch and End a transaction
+    enum class Transaction : quint8 { None, Begin, Statement, Sync, End };
+
+    APGQuery()                            = default;
+    APGQuery(APGQuery &&)                 = default;
+    APGQuery &operator=(APGQuery &&)      = default;
+    APGQuery(const APGQuery &)            = delete;
+    APGQuery &operator=(const APGQuery &) = delete;
+
     QByteArray query;
     std::optional<APreparedQuery> preparedQuery;
     std::shared_ptr<AResultPg> result;
     QVariantList params;
     ACoroDataRef cb;
+    ACopyOutFn copyOutCb;
     QPointer<QObject> receiver;
     QObject *checkReceiver = nullptr;
+    QDeadlineTimer deadline{QDeadlineTimer::Forever};
+    int resultFormat       = 0;
+    QByteArray preparedName;
+    int chunkedRows        = 0;
     bool preparing         = false;
+    bool describing        = false;
     bool setSingleRow      = false;
+    bool deallocate        = false;
+    bool timedOut          = false;
+
+    Transaction transaction = Transaction::None;
+    // Set on the queries of a pipeline batch
+    std::shared_ptr<APipelineBatch> batch;
+
+    inline bool discarded() const
+    {
+        // Deallocations might have no callback but must run, and so do the
+        // boundaries of pipelined transactions and batches, which delimit the pipeline
+        if (deallocate || transaction == Transaction::Begin || transaction == Transaction::Sync ||
+            transaction == Transaction::End) {
+            return false;
+        }
+        return (checkReceiver && receiver.isNull()) || !cb;
+    }
 
     inline void done()
     {
@@ -108,6 +144,81 @@ public:
     }
 };
 
+/*!
+ * \brief APgPreparedCache tracks the statements prepared on a connection in LRU order
+ */
+class APgPreparedCache
+{
+public:
+    /*!
+     * \brief find returns the statement name of \p id marking it as the most recently used,
+     * or a null QByteArray if it's not prepared
+     */
+    QByteArray find(int id, bool countHit);
+
+    [[nodiscard]] bool contains(int id) const;
+
+    /*!
+     * \brief nextName returns an unique statement name for \p id, names are never reused
+     * so that a statement can be prepared again while the old one is not yet deallocated
+     */
+    QByteArray nextName(int id);
+
+    /*!
+     * \brief insert adds \p name as the most recently used statement, names of the
+     * statements evicted to respect the capacity are appended to \p evicted
+     */
+    void insert(int id, const QByteArray &name, QByteArrayList &evicted);
+
+    void remove(int id, const QByteArray &name);
+
+    /*!
+     * \brief fieldIndex returns the field index shared by the results of \p id with
+     * \p fields columns, or nullptr if it's not prepared
+     *
+     * A different number of columns than the last description replaces the index,
+     * so a statement whose rows changed doesn't reuse the old names.
+     */
+    std::shared_ptr<AFieldIndex> fieldIndex(int id, int fields);
+
+    /*!
+     * \brief describe stores the parameter types of \p id from the result of describing
+     * it and builds a new field index from the row description
+     */
+    void describe(int id, const AResultPg &description);
+
+    /*!
+     * \brief paramTypes returns the parameter types of \p id, empty if it was not described
+     */
+    std::span<const Oid> paramTypes(int id) const;
+
+    void setCapacity(int capacity, QByteArrayList &evicted);
+
+    void clear();
+
+    [[nodiscard]] APreparedCacheStats stats() const;
+
+private:
+    void evict(QByteArrayList &evicted);
+
+    struct Entry {
+        QByteArray name;
+        std::list<int>::iterator lru;
+        std::shared_ptr<AFieldIndex> fieldIndex;
+        // Columns the field index was built for
+        int fields = -1;
+        QVarLengthArray<Oid, 8> paramTypes;
+    };
+    QHash<int, Entry> m_entries;
+    // Most recently used first
+    std::list<int> m_lru;
+    quint64 m_hits      = 0;
+    quint64 m_misses    = 0;
+    quint64 m_evictions = 0;
+    quint64 m_names     = 0;
+    int m_capacity      = 0;
+};
+
 class APgConn
 {
 public:
@@ -133,6 +244,32 @@ private:
     PGconn *m_conn;
 };
 
+#ifdef LIBPQ_HAS_ASYNC_CANCEL
+/*!
+ * \brief APgCancel sends a cancel request on its own connection without
+ * blocking the event loop, the socket is polled by a QSocketNotifier
+ */
+class APgCancel
+{
+public:
+    APgCancel(PGconn *conn);
+    ~APgCancel();
+
+    bool start();
+
+    bool isActive() const { return m_active; }
+
+private:
+    void poll();
+    void wait(QSocketNotifier::Type type);
+    void finish();
+
+    PGcancelConn *m_cancel;
+    std::unique_ptr<QSocketNotifier> m_notifier;
+    bool m_active = false;
+};
+#endif
+
 class ADriverPg final : public ADriver
 {
     Q_OBJECT
@@ -150,6 +287,12 @@ public:
     ADatabase::State state() const override;
 
     void begin(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoroDataRef cb) override;
+    bool beginPipelined(const std::shared_ptr<ADriver> &db) override;
+    bool pipelinedTransaction() const override;
+    void beginPipelineBatch(const std::shared_ptr<ADriver> &db,
+                            const std::shared_ptr<APipelineBatch> &batch,
+                            int queries) override;
+    void endPipelineBatch(const std::shared_ptr<ADriver> &db) override;
     void commit(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoroDataRef cb) override;
     void rollback(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoroDataRef cb) override;
 
@@ -179,9 +322,29 @@ public:
               QObject *receiver,
               ACoroDataRef cb) override;
 
+    void copyIn(const std::shared_ptr<ADriver> &db,
+                QStringView query,
+                QObject *receiver,
+                ACoroDataRef cb) override;
+    void copyOut(const std::shared_ptr<ADriver> &db,
+                 QStringView query,
+                 ACopyOutFn chunkCb,
+                 QObject *receiver,
+                 ACoroDataRef cb) override;
+    bool copyInData(QByteArrayView data) override;
+    bool copyInRow(const QVariantList &row) override;
+    bool copyInBinaryRow(const QVariantList &row) override;
+    void copyInFlush(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoroDataRef cb) override;
+    void copyInEnd(const std::shared_ptr<ADriver> &db,
+                   const QString &error,
+                   QObject *receiver,
+                   ACoroDataRef cb) override;
+
     void setLastQuerySingleRowMode() override;
 
-    bool enterPipelineMode(std::chrono::milliseconds timeout) override;
+    void setLastQueryChunkedRowsMode(int rows) override;
+
+    bool enterPipelineMode(const APipelineSyncPolicy &policy) override;
 
     bool exitPipelineMode() override;
 
@@ -189,6 +352,19 @@ public:
 
     bool pipelineSync() override;
 
+    APipelineSyncStats pipelineSyncStats() const override;
+
+    void setPreparedCacheCapacity(const std::shared_ptr<ADriver> &db, int capacity) override;
+
+    APreparedCacheStats preparedCacheStats() const override;
+
+    void setAutoPipeline(bool enable) override;
+
+    bool autoPipeline() const override;
+
+    void setResultFormat(ADatabase::ResultFormat format) override;
+    ADatabase::ResultFormat resultFormat() const override;
+
     int queueSize() const override;
 
     void subscribeToNotification(const std::shared_ptr<ADriver> &db,
@@ -201,19 +377,47 @@ public:
 
 private:
     inline void setupCheckReceiver(APGQuery &pgQuery, QObject *receiver);
+    void enqueue(const std::shared_ptr<ADriver> &db, APGQuery &&pgQuery);
+    void endTransaction(const std::shared_ptr<ADriver> &db,
+                        QUtf8StringView query,
+                        QObject *receiver,
+                        ACoroDataRef cb);
     void cancelCurrentQueryOnReceiverDestroyed(QObject *obj);
+    void cancelRunningQuery();
+    inline void armDeadline(const QDeadlineTimer &deadline);
+    void expireDeadlines();
+    void expireTransaction(qsizetype index, std::vector<APGQuery> &expired);
+    void retagBatchBegin(qsizetype index, const std::shared_ptr<APipelineBatch> &batch);
+    bool retagBatchEnd(qsizetype index,
+                       qsizetype sent,
+                       const std::shared_ptr<APipelineBatch> &batch);
+    qsizetype sentQueries() const;
     inline bool runQuery(APGQuery &pgQuery);
-    inline bool queryShouldBeQueued() const;
+    inline bool queryShouldBeQueued(const APGQuery &pgQuery) const;
+    bool canPipeline(const APGQuery &pgQuery) const;
+    bool startImplicitPipeline();
+    void syncImplicitPipeline();
+    void leaveImplicitPipeline();
+    bool syncPipeline(APgAutoSync::Trigger trigger);
+    inline void autoSyncSent(const APGQuery &pgQuery);
+    void deallocateEvicted(const std::shared_ptr<ADriver> &db);
+    inline int resultFormatFlag() const;
     void nextQuery();
     void finishConnection(const QString &error);
     inline int doExec(APGQuery &pgQuery);
     inline int doExecParams(APGQuery &query);
+    bool describePrepared(APGQuery &pgQuery);
     inline void setSingleRowMode();
+    inline void setChunkedRowsMode(int rows);
+    bool batchChunkedRows(APGQuery &pgQuery, const std::shared_ptr<AResultPg> &result);
     inline void cmdFlush();
     inline bool isConnected() const;
     ACoroTerminator listenCoro(std::shared_ptr<ADriver> db, QString name);
     ACoroTerminator unlistenCoro(std::shared_ptr<ADriver> db, QString name);
     void deliverOpenWaiters(bool isOpen, const QString &error);
+    void copyInStarted(std::shared_ptr<AResultPg> result);
+    void deliverCopyInFlushed(const QString &error);
+    bool drainCopyOut();
 
     struct OpenCaller {
         std::shared_ptr<ADriver> driver;
@@ -231,18 +435,47 @@ private:
 
     std::optional<QPointer<QObject>> m_stateChangedReceiver;
     QHash<QString, ANotificationFn> m_subscribedNotifications;
-    std::queue<APGQuery> m_queuedQueries;
+    ARingQueue<APGQuery> m_queuedQueries;
     std::shared_ptr<ADriver> selfDriver;
-    QHash<int, QByteArray> m_preparedQueries;
+    APgPreparedCache m_preparedQueries;
+    QByteArrayList m_evictedPrepared;
+    PgTypes::Params m_params;
+    std::vector<ACoroDataRef> m_copyInFlushWaiters;
+    QByteArray m_copyRowBuffer;
     std::unique_ptr<QSocketNotifier> m_writeNotify;
     std::unique_ptr<QSocketNotifier> m_readNotify;
     std::unique_ptr<QTimer> m_autoSyncTimer;
+    std::unique_ptr<QTimer> m_deadlineTimer;
     std::unique_ptr<APgConn> m_conn;
-    ADatabase::State m_state  = ADatabase::State::Disconnected;
-    int m_pipelineSync        = 0;
-    bool m_flush              = false;
-    bool m_queryRunning       = false;
-    bool m_notificationPtrSet = false;
+    APgAutoSync m_autoSync;
+    // The pipeline batch being issued, and the one sent but not yet synced
+    std::shared_ptr<APipelineBatch> m_issuingBatch;
+    std::shared_ptr<APipelineBatch> m_syncingBatch;
+#ifdef LIBPQ_HAS_ASYNC_CANCEL
+    std::unique_ptr<APgCancel> m_cancel;
+#endif
+    ADatabase::State m_state               = ADatabase::State::Disconnected;
+    ADatabase::ResultFormat m_resultFormat = ADatabase::ResultFormat::Text;
+    int m_pipelineSync                     = 0;
+    int m_pipelinedQueries                 = 0;
+    // Queries of a pipelined batch still to be issued, out of its size
+    int m_pipelineBatch                    = 0;
+    int m_pipelineBatchSize                = 0;
+    bool m_flush                           = false;
+    bool m_queryRunning                    = false;
+    bool m_copyIn                          = false;
+    // The binary COPY header was sent, the trailer must follow the last row
+    bool m_copyInBinary                    = false;
+    bool m_copyOut                         = false;
+    bool m_autoPipeline                    = false;
+    bool m_implicitPipeline                = false;
+    // Statements issued now belong to a pipelined transaction
+    bool m_pipelinedTransaction            = false;
+    // A statement of it timed out before being sent, it can only be rolled back
+    bool m_pipelinedTransactionFailed      = false;
+    // The end of a pipelined transaction was sent in the running pipeline
+    bool m_pipelinedTransactionEnd         = false;
+    bool m_notificationPtrSet              = false;
 };
 
 } // namespace ASql
@@ -0,0 +1,2181 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "adriverpgnative.h"
+
+#include "acoroexpected.h"
+#include "apgtypes.h"
+#include "aresult.h"
+
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QLocalSocket>
+#include <QLoggingCategory>
+#include <QMessageAuthenticationCode>
+#include <QPasswordDigestor>
+#include <QRandomGenerator>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUrl>
+#include <QtEndian>
+
+Q_LOGGING_CATEGORY(ASQL_PGN, "asql.pg.native", QtInfoMsg)
+
+using namespace ASql;
+using namespace Qt::StringLiterals;
+
+namespace {
+
+// Protocol 3.0
+constexpr qint32 ProtocolVersion   = 196608;
+constexpr qint32 CancelRequestCode = 80877102;
+
+// Size of the receive blocks, messages that don't fit get a block of their own
+constexpr qsizetype BufferSize = 64 * 1024;
+// Blocks kept around to be reused once no result references them
+constexpr size_t RingSize = 4;
+// COPY data is written to the socket in chunks of this size
+constexpr qsizetype CopyChunkSize = 8 * 1024;
+
+// NULL cells point here so that decoders see an empty value like libpq gives them
+constexpr char EmptyValue[] = "";
+
+enum AuthRequest : qint32 {
+    AuthOk            = 0,
+    AuthCleartext     = 3,
+    AuthMD5           = 5,
+    AuthSASL          = 10,
+    AuthSASLContinue  = 11,
+    AuthSASLFinal     = 12,
+};
+
+inline void appendInt16(QByteArray &out, qint16 value)
+{
+    char data[2];
+    qToBigEndian(value, data);
+    out.append(data, 2);
+}
+
+inline void appendInt32(QByteArray &out, qint32 value)
+{
+    char data[4];
+    qToBigEndian(value, data);
+    out.append(data, 4);
+}
+
+inline void appendString(QByteArray &out, QByteArrayView value)
+{
+    out.append(value);
+    out.append('\0');
+}
+
+// Returns the offset of the length, which is filled by endMessage()
+inline qsizetype beginMessage(QByteArray &out, char type)
+{
+    out.append(type);
+    const qsizetype at = out.size();
+    appendInt32(out, 0);
+    return at;
+}
+
+inline void endMessage(QByteArray &out, qsizetype at)
+{
+    qToBigEndian<qint32>(qint32(out.size() - at), out.data() + at);
+}
+
+inline bool readInt16(const char *&it, const char *end, qint16 &value)
+{
+    if (end - it < 2) {
+        return false;
+    }
+    value  = qFromBigEndian<qint16>(it);
+    it    += 2;
+    return true;
+}
+
+inline bool readInt32(const char *&it, const char *end, qint32 &value)
+{
+    if (end - it < 4) {
+        return false;
+    }
+    value  = qFromBigEndian<qint32>(it);
+    it    += 4;
+    return true;
+}
+
+inline bool readString(const char *&it, const char *end, QByteArrayView &value)
+{
+    const auto nul = static_cast<const char *>(std::memchr(it, '\0', end - it));
+    if (!nul) {
+        return false;
+    }
+    value = QByteArrayView(it, nul - it);
+    it    = nul + 1;
+    return true;
+}
+
+qint64 rowsAffected(QByteArrayView tag)
+{
+    // Same commands PQcmdTuples() reports a count for
+    const qsizetype space = tag.indexOf(' ');
+    if (space == -1) {
+        return 0;
+    }
+
+    const QByteArrayView command = tag.first(space);
+    if (command != "INSERT" && command != "UPDATE" && command != "DELETE" &&
+        command != "SELECT" && command != "MERGE" && command != "MOVE" && command != "FETCH" &&
+        command != "COPY") {
+        return 0;
+    }
+    return tag.sliced(tag.lastIndexOf(' ') + 1).toLongLong();
+}
+
+bool isCopy(QByteArrayView query)
+{
+    query = query.trimmed();
+    return query.size() >= 4 && qstrnicmp(query.data(), 4, "COPY", 4) == 0;
+}
+
+QByteArray hmacSha256(const QByteArray &key, const QByteArray &message)
+{
+    return QMessageAuthenticationCode::hash(message, key, QCryptographicHash::Sha256);
+}
+
+QString fromPercentEncoding(QStringView value)
+{
+    return QUrl::fromPercentEncoding(value.toUtf8());
+}
+
+void applyOption(APgNativeOptions &options, QStringView key, const QString &value)
+{
+    if (key == u"host" || key == u"hostaddr") {
+        // Only the first host is used
+        options.host = value.section(u',', 0, 0);
+    } else if (key == u"port") {
+        options.port = value.section(u',', 0, 0).toUShort();
+    } else if (key == u"dbname") {
+        options.database = value;
+    } else if (key == u"user") {
+        options.user = value;
+    } else if (key == u"password") {
+        options.password = value;
+    } else if (key == u"application_name") {
+        options.applicationName = value;
+    } else if (key == u"sslmode") {
+        options.sslMode = value;
+    } else if (key == u"connect_timeout") {
+        options.connectTimeout = value.toInt();
+    } else {
+        qDebug(ASQL_PGN) << "Ignoring connection option" << key;
+    }
+}
+
+void parseUri(QStringView info, APgNativeOptions &options)
+{
+    QStringView rest = info.sliced(info.indexOf(u"://") + 3);
+
+    const qsizetype question = rest.indexOf(u'?');
+    if (question != -1) {
+        const auto pairs = rest.sliced(question + 1).split(u'&', Qt::SkipEmptyParts);
+        for (QStringView pair : pairs) {
+            const qsizetype equal = pair.indexOf(u'=');
+            if (equal != -1) {
+                applyOption(options,
+                            pair.first(equal),
+                            fromPercentEncoding(pair.sliced(equal + 1)));
+            }
+        }
+        rest = rest.first(question);
+    }
+
+    const qsizetype slash = rest.indexOf(u'/');
+    if (slash != -1) {
+        if (const auto database = fromPercentEncoding(rest.sliced(slash + 1));
+            !database.isEmpty()) {
+            options.database = database;
+        }
+        rest = rest.first(slash);
+    }
+
+    const qsizetype at = rest.lastIndexOf(u'@');
+    if (at != -1) {
+        const QStringView userInfo = rest.first(at);
+        const qsizetype colon      = userInfo.indexOf(u':');
+        if (colon != -1) {
+            options.user     = fromPercentEncoding(userInfo.first(colon));
+            options.password = fromPercentEncoding(userInfo.sliced(colon + 1));
+        } else {
+            options.user = fromPercentEncoding(userInfo);
+        }
+        rest = rest.sliced(at + 1);
+    }
+
+    rest = rest.first(rest.indexOf(u',') == -1 ? rest.size() : rest.indexOf(u','));
+    if (rest.startsWith(u'[')) {
+        const qsizetype bracket = rest.indexOf(u']');
+        if (bracket != -1) {
+            options.host = rest.sliced(1, bracket - 1).toString();
+            rest         = rest.sliced(bracket + 1);
+            if (rest.startsWith(u':')) {
+                options.port = rest.sliced(1).toUShort();
+            }
+            return;
+        }
+    }
+
+    const qsizetype colon = rest.lastIndexOf(u':');
+    if (colon != -1) {
+        options.port = rest.sliced(colon + 1).toUShort();
+        rest         = rest.first(colon);
+    }
+    if (!rest.isEmpty()) {
+        options.host = fromPercentEncoding(rest);
+    }
+}
+
+void parseKeywords(QStringView info, APgNativeOptions &options)
+{
+    qsizetype i = 0;
+    auto skipSpaces = [&] {
+        while (i < info.size() && info[i].isSpace()) {
+            ++i;
+        }
+    };
+
+    while (true) {
+        skipSpaces();
+        const qsizetype keyStart = i;
+        while (i < info.size() && info[i] != u'=' && !info[i].isSpace()) {
+            ++i;
+        }
+        const QStringView key = info.sliced(keyStart, i - keyStart);
+        skipSpaces();
+        if (key.isEmpty() || i >= info.size() || info[i] != u'=') {
+            return;
+        }
+        ++i;
+        skipSpaces();
+
+        QString value;
+        const bool quoted = i < info.size() && info[i] == u'\'';
+        if (quoted) {
+            ++i;
+        }
+        while (i < info.size()) {
+            const QChar c = info[i];
+            if (quoted ? c == u'\'' : c.isSpace()) {
+                ++i;
+                break;
+            }
+            if (c == u'\\' && i + 1 < info.size()) {
+                ++i;
+            }
+            value.append(info[i++]);
+        }
+        applyOption(options, key, value);
+    }
+}
+
+} // namespace
+
+APgNativeOptions APgNativeOptions::fromConnectionInfo(const QString &connectionInfo)
+{
+    APgNativeOptions options;
+    if (connectionInfo.startsWith(u"postgres://") ||
+        connectionInfo.startsWith(u"postgresql://")) {
+        parseUri(connectionInfo, options);
+    } else {
+        parseKeywords(connectionInfo, options);
+    }
+
+    // Same fallbacks libpq uses
+    if (options.host.isEmpty()) {
+        options.host = qEnvironmentVariable("PGHOST");
+    }
+    if (options.port == 0) {
+        options.port = qEnvironmentVariableIntValue("PGPORT");
+        if (options.port == 0) {
+            options.port = 5432;
+        }
+    }
+    if (options.user.isEmpty()) {
+        options.user = qEnvironmentVariable("PGUSER");
+        if (options.user.isEmpty()) {
+            options.user = qEnvironmentVariable("USER", qEnvironmentVariable("USERNAME"));
+        }
+    }
+    if (options.password.isEmpty()) {
+        options.password = qEnvironmentVariable("PGPASSWORD");
+    }
+    if (options.database.isEmpty()) {
+        options.database = qEnvironmentVariable("PGDATABASE", options.user);
+    }
+    if (options.applicationName.isEmpty()) {
+        options.applicationName = qEnvironmentVariable("PGAPPNAME");
+    }
+    if (options.sslMode.isEmpty()) {
+        options.sslMode = qEnvironmentVariable("PGSSLMODE");
+    }
+
+    if (options.host.isEmpty()) {
+#ifdef Q_OS_WIN
+        options.host = u"localhost"_s;
+#else
+        // The socket directory is a build option of the server
+        options.host = u"/var/run/postgresql"_s;
+        for (const auto &dir : {u"/var/run/postgresql"_s, u"/tmp"_s}) {
+            if (QFileInfo::exists(dir + u"/.s.PGSQL." + QString::number(options.port))) {
+                options.host = dir;
+                break;
+            }
+        }
+#endif
+    }
+
+    return options;
+}
+
+QString APgNativeOptions::socketPath() const
+{
+    return host + u"/.s.PGSQL." + QString::number(port);
+}
+
+ADriverPgNative::ADriverPgNative(const QString &connInfo)
+    : ADriver(connInfo)
+{
+}
+
+ADriverPgNative::~ADriverPgNative()
+{
+    if (m_socket) {
+        if (isConnected()) {
+            // Terminate
+            QByteArray terminate;
+            endMessage(terminate, beginMessage(terminate, 'X'));
+            m_socket->write(terminate);
+        }
+        // We might be inside one of its signals
+        m_socket->disconnect(this);
+        m_socket.release()->deleteLater();
+    }
+}
+
+QString ADriverPgNative::driverName() const
+{
+    return u"postgres"_s;
+}
+
+bool ADriverPgNative::isValid() const
+{
+    return true;
+}
+
+void ADriverPgNative::deliverOpenWaiters(bool isOpen, const QString &error)
+{
+    const auto waiters = std::move(m_openWaiters);
+    m_openWaiters.clear();
+    for (const OpenCaller &caller : waiters) {
+        caller.emit(isOpen, error);
+    }
+}
+
+void ADriverPgNative::open(const std::shared_ptr<ADriver> &driver, QObject *receiver, AOpenFn cb)
+{
+    qDebug(ASQL_PGN) << "Open" << redactedConnectionInfo();
+
+    if (m_state == ADatabase::State::Connected) {
+        if (cb) {
+            cb(true, {});
+        }
+        return;
+    }
+
+    if (cb) {
+        OpenCaller caller;
+        caller.driver = driver;
+        caller.cb     = cb;
+        if (receiver) {
+            caller.receiverPtr = receiver;
+        }
+        m_openWaiters.push_back(std::move(caller));
+    }
+
+    if (m_state == ADatabase::State::Connecting) {
+        return;
+    }
+
+    m_options = APgNativeOptions::fromConnectionInfo(connectionInfo());
+    if (m_options.sslMode == u"require" || m_options.sslMode.startsWith(u"verify")) {
+        deliverOpenWaiters(false,
+                           u"sslmode=%1 is not supported by the native driver"_s.arg(
+                               m_options.sslMode));
+        return;
+    }
+
+    m_auth = Auth::Startup;
+    setState(ADatabase::State::Connecting, {});
+
+    auto failed = [this](const QString &error) {
+        // Disconnected before the waiters run, so that a pool
+        // can release the connection from their callbacks
+        finishConnection(error);
+        deliverOpenWaiters(false, error);
+    };
+
+    if (m_options.host.startsWith(u'/')) {
+        auto socket = new QLocalSocket;
+        m_socket.reset(socket);
+        connect(socket, &QLocalSocket::connected, this, &ADriverPgNative::writeStartup);
+        connect(socket, &QLocalSocket::errorOccurred, this, [this, socket, failed] {
+            failed(socket->errorString());
+        });
+        connect(socket, &QLocalSocket::disconnected, this, [failed] {
+            failed(u"server closed the connection unexpectedly"_s);
+        });
+        connect(socket, &QIODevice::readyRead, this, &ADriverPgNative::readSocket);
+        connect(socket, &QIODevice::bytesWritten, this, [this, socket] {
+            if (socket->bytesToWrite() == 0) {
+                deliverCopyInFlushed({});
+            }
+        });
+        socket->connectToServer(m_options.socketPath());
+    } else {
+        auto socket = new QTcpSocket;
+        m_socket.reset(socket);
+        connect(socket, &QTcpSocket::connected, this, [this, socket] {
+            // Small messages like a Sync must not wait for more data
+            socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            writeStartup();
+        });
+        connect(socket, &QTcpSocket::errorOccurred, this, [this, socket, failed] {
+            failed(socket->errorString());
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [failed] {
+            failed(u"server closed the connection unexpectedly"_s);
+        });
+        connect(socket, &QIODevice::readyRead, this, &ADriverPgNative::readSocket);
+        connect(socket, &QIODevice::bytesWritten, this, [this, socket] {
+            if (socket->bytesToWrite() == 0) {
+                deliverCopyInFlushed({});
+            }
+        });
+        socket->connectToHost(m_options.host, m_options.port);
+    }
+
+    if (m_options.connectTimeout > 0) {
+        // Covers authentication too, like in libpq
+        if (!m_connectTimer) {
+            m_connectTimer = std::make_unique<QTimer>();
+            m_connectTimer->setSingleShot(true);
+            connect(m_connectTimer.get(), &QTimer::timeout, this, [failed] {
+                failed(u"timeout expired"_s);
+            });
+        }
+        m_connectTimer->start(std::chrono::seconds{m_options.connectTimeout});
+    }
+}
+
+bool ADriverPgNative::isOpen() const
+{
+    return isConnected();
+}
+
+void ADriverPgNative::setState(ADatabase::State state, const QString &status)
+{
+    m_state = state;
+    Q_EMIT stateChanged(state, status);
+}
+
+ADatabase::State ADriverPgNative::state() const
+{
+    return m_state;
+}
+
+void ADriverPgNative::begin(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoroDataRef cb)
+{
+    exec(db, u8"BEGIN", receiver, std::move(cb));
+}
+
+void ADriverPgNative::commit(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoroDataRef cb)
+{
+    exec(db, u8"COMMIT", receiver, std::move(cb));
+}
+
+void ADriverPgNative::rollback(const std::shared_ptr<ADriver> &db,
+                               QObject *receiver,
+                               ACoroDataRef cb)
+{
+    exec(db, u8"ROLLBACK", receiver, std::move(cb));
+}
+
+void ADriverPgNative::exec(const std::shared_ptr<ADriver> &db,
+                           QUtf8StringView query,
+                           QObject *receiver,
+                           ACoroDataRef cb)
+{
+    APgNativeQuery pgQuery;
+    pgQuery.query.setRawData(query.data(), query.size());
+    pgQuery.cb = std::move(cb);
+    enqueue(db, std::move(pgQuery), receiver);
+}
+
+void ADriverPgNative::exec(const std::shared_ptr<ADriver> &db,
+                           QStringView query,
+                           QObject *receiver,
+                           ACoroDataRef cb)
+{
+    APgNativeQuery pgQuery;
+    pgQuery.query = query.toUtf8();
+    pgQuery.cb    = std::move(cb);
+    enqueue(db, std::move(pgQuery), receiver);
+}
+
+void ADriverPgNative::exec(const std::shared_ptr<ADriver> &db,
+                           QUtf8StringView query,
+                           const QVariantList &params,
+                           QObject *receiver,
+                           ACoroDataRef cb)
+{
+    APgNativeQuery pgQuery;
+    pgQuery.query.setRawData(query.data(), query.size());
+    pgQuery.params = params;
+    pgQuery.cb     = std::move(cb);
+    enqueue(db, std::move(pgQuery), receiver);
+}
+
+void ADriverPgNative::exec(const std::shared_ptr<ADriver> &db,
+                           QStringView query,
+                           const QVariantList &params,
+                           QObject *receiver,
+                           ACoroDataRef cb)
+{
+    APgNativeQuery pgQuery;
+    pgQuery.query  = query.toUtf8();
+    pgQuery.params = params;
+    pgQuery.cb     = std::move(cb);
+    enqueue(db, std::move(pgQuery), receiver);
+}
+
+void ADriverPgNative::exec(const std::shared_ptr<ADriver> &db,
+                           const APreparedQuery &query,
+                           const QVariantList &params,
+                           QObject *receiver,
+                           ACoroDataRef cb)
+{
+    APgNativeQuery pgQuery;
+    pgQuery.preparedQuery = query;
+    pgQuery.query         = query.query();
+    pgQuery.params        = params;
+    pgQuery.cb            = std::move(cb);
+    enqueue(db, std::move(pgQuery), receiver);
+}
+
+void ADriverPgNative::copyIn(const std::shared_ptr<ADriver> &db,
+                             QStringView query,
+                             QObject *receiver,
+                             ACoroDataRef cb)
+{
+    APgNativeQuery pgQuery;
+    pgQuery.query  = query.toUtf8();
+    pgQuery.cb     = std::move(cb);
+    pgQuery.copyIn = true;
+    enqueue(db, std::move(pgQuery), receiver);
+}
+
+void ADriverPgNative::copyOut(const std::shared_ptr<ADriver> &db,
+                              QStringView query,
+                              ACopyOutFn chunkCb,
+                              QObject *receiver,
+                              ACoroDataRef cb)
+{
+    APgNativeQuery pgQuery;
+    pgQuery.query     = query.toUtf8();
+    pgQuery.copyOutCb = std::move(chunkCb);
+    pgQuery.cb        = std::move(cb);
+    enqueue(db, std::move(pgQuery), receiver);
+}
+
+void ADriverPgNative::enqueue(const std::shared_ptr<ADriver> &db,
+                              APgNativeQuery &&pgQuery,
+                              QObject *receiver)
+{
+    const bool copy = pgQuery.copyIn || pgQuery.copyOutCb || isCopy(pgQuery.query);
+    if (copy && m_pipeline) {
+        pgQuery.doneError(u"COPY is not allowed in pipeline mode"_s);
+        return;
+    }
+
+    pgQuery.binaryResults = m_resultFormat == ADatabase::ResultFormat::Binary;
+    pgQuery.deadline      = queryDeadline();
+    // Only the extended query protocol takes parameters or returns binary
+    // results, which means a single command per query
+    if (!copy && (m_pipeline || pgQuery.preparedQuery || !pgQuery.params.isEmpty() ||
+                  pgQuery.binaryResults)) {
+        pgQuery.kind = APgNativeQuery::Kind::Extended;
+        pgQuery.sync = !m_pipeline;
+    }
+    pgQuery.barrier = copy;
+
+    setupCheckReceiver(pgQuery, receiver);
+
+    selfDriver = db;
+    armDeadline(pgQuery.deadline);
+    m_queuedQueries.emplace_back(std::move(pgQuery));
+    sendQueries();
+}
+
+void ADriverPgNative::setupCheckReceiver(APgNativeQuery &pgQuery, QObject *receiver)
+{
+    if (!receiver) {
+        return;
+    }
+
+    pgQuery.receiver      = receiver;
+    pgQuery.checkReceiver = receiver;
+    connect(receiver,
+            &QObject::destroyed,
+            this,
+            &ADriverPgNative::cancelCurrentQueryOnReceiverDestroyed,
+            Qt::UniqueConnection);
+}
+
+void ADriverPgNative::cancelCurrentQueryOnReceiverDestroyed(QObject *obj)
+{
+    // Queries not running yet are skipped when their turn comes
+    if (m_sentQueries > 0 && m_queuedQueries.front().checkReceiver == obj) {
+        cancelRunningQuery();
+    }
+}
+
+void ADriverPgNative::cancelRunningQuery()
+{
+    // A CancelRequest goes on a new connection, the server closes it right away
+    QByteArray request;
+    appendInt32(request, 16);
+    appendInt32(request, CancelRequestCode);
+    appendInt32(request, m_backendPid);
+    appendInt32(request, m_backendKey);
+
+    if (m_options.host.startsWith(u'/')) {
+        auto socket = new QLocalSocket(this);
+        connect(socket, &QLocalSocket::connected, socket, [socket, request] {
+            socket->write(request);
+            socket->disconnectFromServer();
+        });
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::errorOccurred, socket, &QObject::deleteLater);
+        socket->connectToServer(m_options.socketPath());
+    } else {
+        auto socket = new QTcpSocket(this);
+        connect(socket, &QTcpSocket::connected, socket, [socket, request] {
+            socket->write(request);
+            socket->disconnectFromHost();
+        });
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::errorOccurred, socket, &QObject::deleteLater);
+        socket->connectToHost(m_options.host, m_options.port);
+    }
+}
+
+void ADriverPgNative::armDeadline(const QDeadlineTimer &deadline)
+{
+    if (deadline.isForever()) {
+        return;
+    }
+
+    if (!m_deadlineTimer) {
+        m_deadlineTimer = std::make_unique<QTimer>();
+        m_deadlineTimer->setSingleShot(true);
+        connect(
+            m_deadlineTimer.get(), &QTimer::timeout, this, &ADriverPgNative::expireDeadlines);
+    }
+
+    // A single timer is armed for the closest deadline
+    const auto remaining =
+        std::chrono::ceil<std::chrono::milliseconds>(deadline.remainingTimeAsDuration());
+    if (!m_deadlineTimer->isActive() || m_deadlineTimer->remainingTimeAsDuration() > remaining) {
+        m_deadlineTimer->start(remaining);
+    }
+}
+
+void ADriverPgNative::expireDeadlines()
+{
+    std::vector<APgNativeQuery> expired;
+    QDeadlineTimer next{QDeadlineTimer::Forever};
+
+    qsizetype index = 0;
+    for (auto it = m_queuedQueries.begin(); it != m_queuedQueries.end(); ++index) {
+        if (it->kind == APgNativeQuery::Kind::Sync) {
+            // Ends the pipeline of the queries before it, even if they are dropped
+            ++it;
+        } else if (!it->deadline.hasExpired()) {
+            next = std::min(next, it->deadline);
+            ++it;
+        } else if (it->sent) {
+            // Already on the server, it's canceled once it's running
+            if (!it->timedOut && index == 0) {
+                cancelRunningQuery();
+            }
+            it->timedOut = true;
+            ++it;
+        } else {
+            expired.emplace_back(std::move(*it));
+            it = m_queuedQueries.erase(it);
+        }
+    }
+
+    if (!next.isForever()) {
+        armDeadline(next);
+    }
+
+    for (APgNativeQuery &pgQuery : expired) {
+        pgQuery.doneError(u"Query timed out"_s);
+    }
+
+    wakeQueueWaiters();
+    if (m_queuedQueries.empty()) {
+        selfDriver.reset();
+    }
+}
+
+void ADriverPgNative::sendQueries()
+{
+    if (!isConnected()) {
+        return;
+    }
+
+    auto trigger = APgAutoSync::Trigger::None;
+    auto it      = m_queuedQueries.begin() + m_sentQueries;
+    while (it != m_queuedQueries.end()) {
+        if (m_barrier) {
+            // Nothing can follow a COPY until it's done
+            break;
+        }
+
+        if (it->discarded()) {
+            it = m_queuedQueries.erase(it);
+            continue;
+        }
+
+        const qsizetype size = m_sendBuffer.size();
+        sendQuery(*it);
+        ++m_sentQueries;
+        m_barrier = it->barrier;
+        if (m_pipeline && it->kind != APgNativeQuery::Kind::Sync) {
+            const auto sent =
+                m_autoSync.querySent(m_sendBuffer.size() - size, m_pipelineSyncs == 0);
+            if (sent != APgAutoSync::Trigger::None) {
+                trigger = sent;
+            }
+        }
+        ++it;
+    }
+
+    if (trigger != APgAutoSync::Trigger::None) {
+        // The sync is written along with the batch it ends
+        syncPipeline(trigger);
+        return;
+    }
+
+    if (!m_sendBuffer.isEmpty()) {
+        m_socket->write(m_sendBuffer);
+        m_sendBuffer.clear();
+
+        if (m_autoSync.pending() && m_autoSyncTimer && !m_autoSyncTimer->isActive()) {
+            m_autoSyncTimer->start();
+        }
+    }
+}
+
+void ADriverPgNative::sendQuery(APgNativeQuery &pgQuery)
+{
+    pgQuery.sent = true;
+
+    switch (pgQuery.kind) {
+    case APgNativeQuery::Kind::Sync:
+        endMessage(m_sendBuffer, beginMessage(m_sendBuffer, 'S'));
+        return;
+    case APgNativeQuery::Kind::Simple:
+    {
+        const qsizetype at = beginMessage(m_sendBuffer, 'Q');
+        appendString(m_sendBuffer, pgQuery.query);
+        endMessage(m_sendBuffer, at);
+        return;
+    }
+    case APgNativeQuery::Kind::Extended:
+        break;
+    }
+
+    QByteArray statement;
+    if (pgQuery.preparedQuery) {
+        const int id = pgQuery.preparedQuery->identification();
+        auto it      = m_prepared.find(id);
+        if (it == m_prepared.end()) {
+            m_params.encode(pgQuery.params);
+
+            // Parsed and described along with the first execution, later ones use the
+            // declared types of the parameters that arrive in the ParameterDescription
+            Prepared prepared;
+            prepared.name       = "asql_" + QByteArray::number(++m_preparedNames);
+            prepared.fieldIndex = std::make_shared<AFieldIndex>();
+            it                  = m_prepared.insert(id, std::move(prepared));
+            statement           = it->name;
+            pgQuery.preparing   = true;
+        } else {
+            m_params.encode(pgQuery.params, it->paramTypes);
+            statement = it->name;
+        }
+    } else {
+        m_params.encode(pgQuery.params);
+    }
+
+    if (!pgQuery.preparedQuery || pgQuery.preparing) {
+        // Parse
+        qsizetype at = beginMessage(m_sendBuffer, 'P');
+        appendString(m_sendBuffer, statement);
+        appendString(m_sendBuffer, pgQuery.query);
+        appendInt16(m_sendBuffer, qint16(m_params.size()));
+        for (int i = 0; i < m_params.size(); ++i) {
+            appendInt32(m_sendBuffer, qint32(m_params.types()[i]));
+        }
+        endMessage(m_sendBuffer, at);
+
+        if (pgQuery.preparing) {
+            // Describe the statement
+            at = beginMessage(m_sendBuffer, 'D');
+            m_sendBuffer.append('S');
+            appendString(m_sendBuffer, statement);
+            endMessage(m_sendBuffer, at);
+        }
+    }
+
+    // Bind to the unnamed portal
+    qsizetype at = beginMessage(m_sendBuffer, 'B');
+    appendString(m_sendBuffer, {});
+    appendString(m_sendBuffer, statement);
+    appendInt16(m_sendBuffer, qint16(m_params.size()));
+    for (int i = 0; i < m_params.size(); ++i) {
+        appendInt16(m_sendBuffer, qint16(m_params.formats()[i]));
+    }
+    appendInt16(m_sendBuffer, qint16(m_params.size()));
+    for (int i = 0; i < m_params.size(); ++i) {
+        const char *value = m_params.values()[i];
+        if (value) {
+            appendInt32(m_sendBuffer, m_params.lengths()[i]);
+            m_sendBuffer.append(value, m_params.lengths()[i]);
+        } else {
+            appendInt32(m_sendBuffer, -1);
+        }
+    }
+    // A single result format applies to all columns
+    appendInt16(m_sendBuffer, 1);
+    appendInt16(m_sendBuffer, pgQuery.binaryResults ? 1 : 0);
+    endMessage(m_sendBuffer, at);
+
+    // Describe the portal
+    at = beginMessage(m_sendBuffer, 'D');
+    m_sendBuffer.append('P');
+    appendString(m_sendBuffer, {});
+    endMessage(m_sendBuffer, at);
+
+    // Execute all rows
+    at = beginMessage(m_sendBuffer, 'E');
+    appendString(m_sendBuffer, {});
+    appendInt32(m_sendBuffer, 0);
+    endMessage(m_sendBuffer, at);
+
+    if (pgQuery.sync) {
+        endMessage(m_sendBuffer, beginMessage(m_sendBuffer, 'S'));
+    }
+}
+
+void ADriverPgNative::writeStartup()
+{
+    QByteArray startup;
+    appendInt32(startup, 0);
+    appendInt32(startup, ProtocolVersion);
+    appendString(startup, "user");
+    appendString(startup, m_options.user.toUtf8());
+    appendString(startup, "database");
+    appendString(startup, m_options.database.toUtf8());
+    if (!m_options.applicationName.isEmpty()) {
+        appendString(startup, "application_name");
+        appendString(startup, m_options.applicationName.toUtf8());
+    }
+    appendString(startup, "client_encoding");
+    appendString(startup, "UTF8");
+    startup.append('\0');
+    qToBigEndian<qint32>(qint32(startup.size()), startup.data());
+
+    m_socket->write(startup);
+}
+
+void ADriverPgNative::writePassword(QByteArrayView password)
+{
+    QByteArray message;
+    const qsizetype at = beginMessage(message, 'p');
+    appendString(message, password);
+    endMessage(message, at);
+    m_socket->write(message);
+}
+
+void ADriverPgNative::readSocket()
+{
+    while (m_socket) {
+        if (m_ring.empty() || m_writePos == m_ring[m_ringIndex]->capacity) {
+            nextBuffer(BufferSize);
+        }
+
+        APgNativeBuffer &buffer = *m_ring[m_ringIndex];
+        const qint64 read =
+            m_socket->read(buffer.data.get() + m_writePos, buffer.capacity - m_writePos);
+        if (read <= 0) {
+            break;
+        }
+        m_writePos += read;
+
+        // Messages are handled where they were read, DataRow cells are not copied
+        while (m_socket && m_writePos - m_readPos >= 5) {
+            const char *message = m_ring[m_ringIndex]->data.get() + m_readPos;
+            const qint32 length = qFromBigEndian<qint32>(message + 1);
+            if (Q_UNLIKELY(length < 4)) {
+                finishConnection(u"Invalid message length received"_s);
+                break;
+            }
+
+            const qsizetype total = 1 + qsizetype(length);
+            if (m_writePos - m_readPos < total) {
+                if (m_readPos + total > m_ring[m_ringIndex]->capacity) {
+                    // The rest of the message doesn't fit in this block
+                    nextBuffer(total);
+                }
+                break;
+            }
+
+            m_readPos += total;
+            handleMessage(message[0], message + 5, message + total);
+        }
+
+        if (m_socket && m_writePos - m_readPos < 5 &&
+            m_readPos + 5 > m_ring[m_ringIndex]->capacity) {
+            nextBuffer(BufferSize);
+        }
+    }
+
+    wakeQueueWaiters();
+
+    // CRITICAL it's only safe to release ourself
+    // after all connection processing took place
+    if (m_queuedQueries.empty()) {
+        selfDriver.reset();
+    }
+}
+
+void ADriverPgNative::nextBuffer(qsizetype needed)
+{
+    needed = std::max(needed, BufferSize);
+
+    const char *pending       = nullptr;
+    const qsizetype remaining = m_writePos - m_readPos;
+    if (!m_ring.empty()) {
+        auto &current = m_ring[m_ringIndex];
+        if (current.use_count() == 1 && current->capacity >= needed) {
+            // No result references this block, move what is left to its start
+            std::memmove(current->data.get(), current->data.get() + m_readPos, remaining);
+            m_readPos  = 0;
+            m_writePos = remaining;
+            return;
+        }
+        pending = current->data.get() + m_readPos;
+    }
+
+    std::shared_ptr<APgNativeBuffer> previous;
+    if (m_ring.size() < RingSize) {
+        m_ringIndex = m_ring.size();
+        m_ring.emplace_back(std::make_shared<APgNativeBuffer>(needed));
+    } else {
+        // Keeps the block alive until the pending bytes are copied
+        previous    = m_ring[m_ringIndex];
+        m_ringIndex = (m_ringIndex + 1) % RingSize;
+
+        auto &candidate = m_ring[m_ringIndex];
+        if (candidate.use_count() > 1 || candidate->capacity < needed ||
+            (candidate->capacity > BufferSize && needed == BufferSize)) {
+            // Still referenced by results, or the wrong size, let results keep it
+            candidate = std::make_shared<APgNativeBuffer>(needed);
+        }
+    }
+
+    if (remaining > 0) {
+        std::memcpy(m_ring[m_ringIndex]->data.get(), pending, remaining);
+    }
+    m_readPos  = 0;
+    m_writePos = remaining;
+}
+
+void ADriverPgNative::handleMessage(char type, const char *data, const char *end)
+{
+    switch (type) {
+    case 'D': // DataRow
+    {
+        if (Q_UNLIKELY(m_sentQueries == 0 || !m_fields)) {
+            qWarning(ASQL_PGN) << "Unexpected DataRow";
+            return;
+        }
+
+        APgNativeQuery &pgQuery = m_queuedQueries.front();
+        if (!pgQuery.result) {
+            newResult(pgQuery);
+        }
+        if (Q_UNLIKELY(!pgQuery.result->appendRow(m_ring[m_ringIndex], data, end))) {
+            finishConnection(u"Malformed DataRow received"_s);
+            return;
+        }
+        if (pgQuery.chunkedRows > 0 && pgQuery.result->m_rows >= pgQuery.chunkedRows) {
+            deliverPartial(pgQuery);
+        }
+        return;
+    }
+    case 'C': // CommandComplete
+    {
+        QByteArrayView tag;
+        readString(data, end, tag);
+        handleCommandComplete(tag);
+        return;
+    }
+    case 'I': // EmptyQueryResponse
+        handleCommandComplete({});
+        return;
+    case 'Z': // ReadyForQuery
+        if (m_state != ADatabase::State::Connected) {
+            connected();
+        } else {
+            handleReadyForQuery();
+        }
+        return;
+    case 'T': // RowDescription
+        handleRowDescription(data, end);
+        return;
+    case 't': // ParameterDescription
+        handleParameterDescription(data, end);
+        return;
+    case 'n': // NoData
+        if (m_describingStatement) {
+            m_describingStatement = false;
+        } else {
+            m_fields.reset();
+        }
+        return;
+    case '1': // ParseComplete
+        if (m_sentQueries > 0) {
+            m_queuedQueries.front().preparing = false;
+        }
+        return;
+    case '2': // BindComplete
+    case '3': // CloseComplete
+    case 's': // PortalSuspended
+        return;
+    case 'E': // ErrorResponse
+        handleError(data, end);
+        return;
+    case 'N': // NoticeResponse
+        qDebug(ASQL_PGN) << "Notice" << errorMessage(data, end);
+        return;
+    case 'A': // NotificationResponse
+        handleNotification(data, end);
+        return;
+    case 'G': // CopyInResponse
+        copyInStarted();
+        return;
+    case 'H': // CopyOutResponse
+        m_copyOut = true;
+        return;
+    case 'd': // CopyData
+        if (m_copyOut) {
+            const APgNativeQuery &pgQuery = m_queuedQueries.front();
+            if (pgQuery.copyOutCb && (!pgQuery.checkReceiver || !pgQuery.receiver.isNull())) {
+                // Straight from the receive buffer
+                pgQuery.copyOutCb(QByteArrayView(data, end - data));
+            }
+        }
+        return;
+    case 'c': // CopyDone
+        m_copyOut = false;
+        return;
+    case 'W': // CopyBothResponse
+        finishConnection(u"Replication connections are not supported"_s);
+        return;
+    case 'R': // Authentication
+        handleAuthentication(data, end);
+        return;
+    case 'S': // ParameterStatus
+        return;
+    case 'K': // BackendKeyData
+        readInt32(data, end, m_backendPid);
+        readInt32(data, end, m_backendKey);
+        return;
+    case 'v': // NegotiateProtocolVersion
+        qDebug(ASQL_PGN) << "Server does not support some protocol options";
+        return;
+    default:
+        qWarning(ASQL_PGN) << "Unknown message type" << type;
+        return;
+    }
+}
+
+void ADriverPgNative::handleAuthentication(const char *data, const char *end)
+{
+    qint32 request;
+    if (!readInt32(data, end, request)) {
+        return;
+    }
+
+    switch (request) {
+    case AuthOk:
+        if (m_auth == Auth::Sasl) {
+            // Without the server signature the server didn't prove it knows the password
+            finishAuthentication(u"SCRAM authentication incomplete"_s);
+            return;
+        }
+        m_auth = Auth::Done;
+        return;
+    case AuthCleartext:
+        writePassword(m_options.password.toUtf8());
+        return;
+    case AuthMD5:
+    {
+        if (end - data < 4) {
+            break;
+        }
+        const QByteArray inner =
+            QCryptographicHash::hash(m_options.password.toUtf8() + m_options.user.toUtf8(),
+                                     QCryptographicHash::Md5)
+                .toHex();
+        const QByteArray outer =
+            QCryptographicHash::hash(inner + QByteArrayView(data, 4), QCryptographicHash::Md5)
+                .toHex();
+        writePassword("md5" + outer);
+        return;
+    }
+    case AuthSASL:
+    {
+        QByteArrayView mechanism;
+        bool scram = false;
+        while (readString(data, end, mechanism) && !mechanism.isEmpty()) {
+            scram |= mechanism == "SCRAM-SHA-256";
+        }
+        if (!scram) {
+            break;
+        }
+
+        QByteArray nonce(24, Qt::Uninitialized);
+        QRandomGenerator::system()->fillRange(reinterpret_cast<quint32 *>(nonce.data()),
+                                              nonce.size() / 4);
+        m_scramClientNonce     = nonce.toBase64();
+        // The user is taken from the startup message
+        m_scramClientFirstBare = "n=,r=" + m_scramClientNonce;
+        const QByteArray first = "n,," + m_scramClientFirstBare;
+
+        QByteArray message;
+        const qsizetype at = beginMessage(message, 'p');
+        appendString(message, "SCRAM-SHA-256");
+        appendInt32(message, qint32(first.size()));
+        message.append(first);
+        endMessage(message, at);
+        m_auth = Auth::Sasl;
+        m_socket->write(message);
+        return;
+    }
+    case AuthSASLContinue:
+        if (m_auth == Auth::Sasl && scramContinue(QByteArray(data, end - data))) {
+            return;
+        }
+        finishAuthentication(u"SCRAM authentication failed"_s);
+        return;
+    case AuthSASLFinal:
+        if (m_auth != Auth::Sasl || m_scramServerSignature.isEmpty() ||
+            QByteArrayView(data, end - data).trimmed() != "v=" + m_scramServerSignature) {
+            finishAuthentication(u"SCRAM server signature mismatch"_s);
+            return;
+        }
+        m_auth = Auth::SaslVerified;
+        return;
+    default:
+        break;
+    }
+
+    finishAuthentication(
+        u"Authentication method %1 is not supported by the native driver"_s.arg(request));
+}
+
+bool ADriverPgNative::scramContinue(const QByteArray &serverFirst)
+{
+    QByteArray nonce;
+    QByteArray salt;
+    int iterations = 0;
+    for (const QByteArray &attribute : serverFirst.split(',')) {
+        if (attribute.startsWith("r=")) {
+            nonce = attribute.sliced(2);
+        } else if (attribute.startsWith("s=")) {
+            salt = QByteArray::fromBase64(attribute.sliced(2));
+        } else if (attribute.startsWith("i=")) {
+            iterations = attribute.sliced(2).toInt();
+        }
+    }
+
+    if (!nonce.startsWith(m_scramClientNonce) || salt.isEmpty() || iterations <= 0) {
+        return false;
+    }
+
+    // RFC 5802, channel binding is not used as the connection is not encrypted
+    const QByteArray saltedPassword = QPasswordDigestor::deriveKeyPbkdf2(
+        QCryptographicHash::Sha256, m_options.password.toUtf8(), salt, iterations, 32);
+    const QByteArray clientKey = hmacSha256(saltedPassword, "Client Key");
+    const QByteArray storedKey = QCryptographicHash::hash(clientKey, QCryptographicHash::Sha256);
+    const QByteArray finalWithoutProof = "c=biws,r=" + nonce;
+    const QByteArray authMessage =
+        m_scramClientFirstBare + ',' + serverFirst + ',' + finalWithoutProof;
+    const QByteArray clientSignature = hmacSha256(storedKey, authMessage);
+
+    QByteArray proof = clientKey;
+    for (qsizetype i = 0; i < proof.size(); ++i) {
+        proof[i] = char(proof[i] ^ clientSignature[i]);
+    }
+
+    const QByteArray serverKey = hmacSha256(saltedPassword, "Server Key");
+    m_scramServerSignature     = hmacSha256(serverKey, authMessage).toBase64();
+
+    QByteArray message;
+    const qsizetype at = beginMessage(message, 'p');
+    message.append(finalWithoutProof + ",p=" + proof.toBase64());
+    endMessage(message, at);
+    m_socket->write(message);
+    return true;
+}
+
+void ADriverPgNative::finishAuthentication(const QString &error)
+{
+    finishConnection(error);
+    deliverOpenWaiters(false, error);
+}
+
+void ADriverPgNative::connected()
+{
+    if (m_connectTimer) {
+        m_connectTimer->stop();
+    }
+    m_scramClientNonce.clear();
+    m_scramClientFirstBare.clear();
+    m_scramServerSignature.clear();
+
+    setState(ADatabase::State::Connected, {});
+    deliverOpenWaiters(true, {});
+
+    // see if we have queue queries
+    sendQueries();
+}
+
+QString ADriverPgNative::errorMessage(const char *data, const char *end)
+{
+    // Formatted like PQresultErrorMessage() does by default
+    QByteArrayView severity;
+    QByteArrayView message;
+    QByteArrayView detail;
+    QByteArrayView hint;
+    while (data < end && *data != '\0') {
+        const char field = *data++;
+        QByteArrayView value;
+        if (!readString(data, end, value)) {
+            break;
+        }
+        switch (field) {
+        case 'S':
+            severity = value;
+            break;
+        case 'M':
+            message = value;
+            break;
+        case 'D':
+            detail = value;
+            break;
+        case 'H':
+            hint = value;
+            break;
+        default:
+            break;
+        }
+    }
+
+    QString ret = QString::fromUtf8(severity) + u":  " + QString::fromUtf8(message) + u'\n';
+    if (!detail.isEmpty()) {
+        ret += u"DETAIL:  " + QString::fromUtf8(detail) + u'\n';
+    }
+    if (!hint.isEmpty()) {
+        ret += u"HINT:  " + QString::fromUtf8(hint) + u'\n';
+    }
+    return ret;
+}
+
+void ADriverPgNative::handleError(const char *data, const char *end)
+{
+    const QString error = errorMessage(data, end);
+    if (m_state != ADatabase::State::Connected) {
+        finishAuthentication(error);
+        return;
+    }
+
+    if (m_sentQueries == 0) {
+        // e.g. FATAL errors sent before the server closes the connection
+        qWarning(ASQL_PGN) << "Error" << error;
+        return;
+    }
+
+    m_describingStatement = false;
+    m_copyOut             = false;
+    if (m_copyIn) {
+        m_copyIn       = false;
+        m_copyInBinary = false;
+        deliverCopyInFlushed(error);
+    }
+
+    APgNativeQuery &pgQuery = m_queuedQueries.front();
+    if (pgQuery.preparing) {
+        // Parse failed, the next execution prepares it again
+        m_prepared.remove(pgQuery.preparedQuery->identification());
+        pgQuery.preparing = false;
+    }
+
+    if (pgQuery.result && pgQuery.commandComplete) {
+        deliverPartial(pgQuery);
+    }
+    pgQuery.result                = std::make_shared<AResultPgNative>();
+    pgQuery.result->m_error       = true;
+    pgQuery.result->m_errorString = pgQuery.timedOut ? u"Query timed out"_s : error;
+    pgQuery.commandComplete       = true;
+
+    if (!pgQuery.sync) {
+        // Pipelined queries up to the next Sync are skipped by the server
+        m_pipelineAborted = true;
+        completeFront();
+        while (m_sentQueries > 0 &&
+               m_queuedQueries.front().kind != APgNativeQuery::Kind::Sync) {
+            APgNativeQuery aborted = std::move(m_queuedQueries.front());
+            m_queuedQueries.pop_front();
+            --m_sentQueries;
+            aborted.doneError(u"Pipeline aborted"_s);
+        }
+    }
+}
+
+void ADriverPgNative::handleNotification(const char *data, const char *end)
+{
+    qint32 pid;
+    QByteArrayView channel;
+    QByteArrayView payload;
+    if (!readInt32(data, end, pid) || !readString(data, end, channel) ||
+        !readString(data, end, payload)) {
+        return;
+    }
+
+    const QString name = QString::fromUtf8(channel);
+    auto it            = m_subscribedNotifications.constFind(name);
+    if (it != m_subscribedNotifications.constEnd()) {
+        const ADatabaseNotification notification{
+            name, QString::fromUtf8(payload), pid == m_backendPid};
+        if (it.value()) {
+            it.value()(notification);
+        }
+        Q_EMIT notificationReceived(notification);
+    } else {
+        qWarning(ASQL_PGN,
+                 "received notification for '%s' which isn't subscribed to.",
+                 qPrintable(name));
+    }
+}
+
+void ADriverPgNative::handleParameterDescription(const char *data, const char *end)
+{
+    m_describingStatement = true;
+    if (m_sentQueries == 0) {
+        return;
+    }
+
+    const APgNativeQuery &pgQuery = m_queuedQueries.front();
+    if (!pgQuery.preparedQuery) {
+        return;
+    }
+
+    auto it = m_prepared.find(pgQuery.preparedQuery->identification());
+    qint16 count;
+    if (it == m_prepared.end() || !readInt16(data, end, count)) {
+        return;
+    }
+
+    // The statement is being described, results of an earlier description
+    // keep their own index
+    it->fieldIndex = std::make_shared<AFieldIndex>();
+    it->paramTypes.clear();
+    qint32 oid;
+    while (count-- > 0 && readInt32(data, end, oid)) {
+        it->paramTypes.append(Oid(oid));
+    }
+}
+
+void ADriverPgNative::handleRowDescription(const char *data, const char *end)
+{
+    if (m_describingStatement) {
+        // The portal description that follows has the result formats
+        m_describingStatement = false;
+        return;
+    }
+
+    auto fields = std::make_shared<APgNativeFields>();
+    qint16 count;
+    if (readInt16(data, end, count)) {
+        fields->fields.reserve(count);
+        for (qint16 i = 0; i < count; ++i) {
+            QByteArrayView name;
+            qint32 table;
+            qint16 column;
+            qint32 type;
+            qint16 size;
+            qint32 modifier;
+            qint16 format;
+            if (!readString(data, end, name) || !readInt32(data, end, table) ||
+                !readInt16(data, end, column) || !readInt32(data, end, type) ||
+                !readInt16(data, end, size) || !readInt32(data, end, modifier) ||
+                !readInt16(data, end, format)) {
+                qWarning(ASQL_PGN) << "Malformed RowDescription";
+                break;
+            }
+            fields->fields.append({QString::fromUtf8(name), Oid(type), format == 1});
+        }
+    }
+    m_fields = std::move(fields);
+
+    if (m_sentQueries > 0) {
+        APgNativeQuery &pgQuery = m_queuedQueries.front();
+        if (pgQuery.result && pgQuery.commandComplete) {
+            // The previous command of a multi command query
+            deliverPartial(pgQuery);
+        }
+        newResult(pgQuery);
+    }
+}
+
+void ADriverPgNative::handleCommandComplete(QByteArrayView tag)
+{
+    if (m_sentQueries == 0) {
+        return;
+    }
+
+    APgNativeQuery &pgQuery = m_queuedQueries.front();
+    if (pgQuery.result && pgQuery.commandComplete) {
+        deliverPartial(pgQuery);
+    }
+    if (!pgQuery.result) {
+        newResult(pgQuery);
+    }
+    pgQuery.result->m_numRowsAffected = rowsAffected(tag);
+    pgQuery.commandComplete           = true;
+    m_fields.reset();
+
+    if (!pgQuery.sync) {
+        completeFront();
+    }
+}
+
+void ADriverPgNative::handleReadyForQuery()
+{
+    if (m_sentQueries == 0) {
+        return;
+    }
+
+    m_describingStatement = false;
+    m_fields.reset();
+
+    const APgNativeQuery &pgQuery = m_queuedQueries.front();
+    if (pgQuery.kind == APgNativeQuery::Kind::Sync) {
+        m_pipelineAborted = false;
+        if (--m_pipelineSyncs == 0 && m_autoSync.pending() &&
+            m_autoSync.policy().syncWhenIdle) {
+            // Queries batched while waiting for results go now
+            syncPipeline(APgAutoSync::Trigger::Idle);
+        }
+        completeFront();
+    } else if (pgQuery.sync) {
+        completeFront();
+    }
+}
+
+void ADriverPgNative::newResult(APgNativeQuery &pgQuery)
+{
+    pgQuery.result           = std::make_shared<AResultPgNative>();
+    pgQuery.result->m_fields = m_fields;
+    pgQuery.commandComplete  = false;
+    if (pgQuery.preparedQuery && m_fields) {
+        // Same statement, same fields
+        auto it = m_prepared.constFind(pgQuery.preparedQuery->identification());
+        if (it != m_prepared.constEnd()) {
+            pgQuery.result->setFieldIndex(it->fieldIndex);
+        }
+    }
+}
+
+void ADriverPgNative::deliverPartial(APgNativeQuery &pgQuery)
+{
+    // Rows of the same command continue on a new result
+    const bool continues = !pgQuery.commandComplete;
+    pgQuery.result->m_lastResultSet = false;
+    pgQuery.done();
+    if (continues) {
+        newResult(pgQuery);
+    }
+}
+
+void ADriverPgNative::completeFront()
+{
+    APgNativeQuery pgQuery = std::move(m_queuedQueries.front());
+    m_queuedQueries.pop_front();
+    --m_sentQueries;
+    if (pgQuery.barrier) {
+        m_barrier = false;
+        m_copyOut = false;
+    }
+
+    if (m_sentQueries > 0 && m_queuedQueries.front().timedOut) {
+        // It timed out while waiting for the previous ones
+        cancelRunningQuery();
+    }
+
+    // Queries blocked by a COPY can go now
+    sendQueries();
+
+    pgQuery.done();
+}
+
+void ADriverPgNative::copyInStarted()
+{
+    if (m_sentQueries == 0) {
+        return;
+    }
+
+    m_copyIn                = true;
+    APgNativeQuery &pgQuery = m_queuedQueries.front();
+    if (pgQuery.cb && (!pgQuery.checkReceiver || !pgQuery.receiver.isNull())) {
+        pgQuery.result.reset();
+        pgQuery.done();
+    } else {
+        // Nobody is going to write, end it so the connection can be used again
+        copyInEnd(selfDriver, u"COPY aborted by the client"_s, nullptr, {});
+    }
+}
+
+bool ADriverPgNative::copyInData(QByteArrayView data)
+{
+    if (!m_copyIn) {
+        qWarning(ASQL_PGN) << "COPY FROM STDIN not in progress";
+        return false;
+    }
+
+    const qsizetype at = beginMessage(m_sendBuffer, 'd');
+    m_sendBuffer.append(data);
+    endMessage(m_sendBuffer, at);
+
+    // Small rows are sent together
+    if (m_sendBuffer.size() >= CopyChunkSize) {
+        m_socket->write(m_sendBuffer);
+        m_sendBuffer.clear();
+    }
+    return true;
+}
+
+bool ADriverPgNative::copyInRow(const QVariantList &row)
+{
+    m_copyRowBuffer.clear();
+    for (qsizetype i = 0; i < row.size(); ++i) {
+        if (i) {
+            m_copyRowBuffer.append('\t');
+        }
+        PgTypes::appendCopyText(m_copyRowBuffer, row[i]);
+    }
+    m_copyRowBuffer.append('\n');
+
+    return copyInData(m_copyRowBuffer);
+}
+
+bool ADriverPgNative::copyInBinaryRow(const QVariantList &row)
+{
+    if (!m_copyIn) {
+        qWarning(ASQL_PGN) << "COPY FROM STDIN not in progress";
+        return false;
+    }
+
+    m_copyRowBuffer.clear();
+    if (!m_copyInBinary) {
+        PgTypes::appendCopyBinaryHeader(m_copyRowBuffer);
+        m_copyInBinary = true;
+    }
+
+    // No query is sent while COPY is in progress so the parameters encoder is free
+    m_params.encode(row);
+    PgTypes::appendCopyBinaryRow(m_copyRowBuffer, m_params);
+
+    return copyInData(m_copyRowBuffer);
+}
+
+void ADriverPgNative::copyInFlush(const std::shared_ptr<ADriver> &db,
+                                  QObject *receiver,
+                                  ACoroDataRef cb)
+{
+    Q_UNUSED(db);
+    Q_UNUSED(receiver);
+    if (!m_copyIn) {
+        if (cb) {
+            AResult result = resultError(u"COPY FROM STDIN not in progress"_s);
+            cb.deliverResult(result);
+        }
+        return;
+    }
+
+    if (!m_sendBuffer.isEmpty()) {
+        m_socket->write(m_sendBuffer);
+        m_sendBuffer.clear();
+    }
+
+    m_copyInFlushWaiters.push_back(std::move(cb));
+    if (m_socket->bytesToWrite() == 0) {
+        deliverCopyInFlushed({});
+    }
+}
+
+void ADriverPgNative::copyInEnd(const std::shared_ptr<ADriver> &db,
+                                const QString &error,
+                                QObject *receiver,
+                                ACoroDataRef cb)
+{
+    if (!m_copyIn || m_sentQueries == 0) {
+        if (cb) {
+            AResult result = resultError(u"COPY FROM STDIN not in progress"_s);
+            cb.deliverResult(result);
+        }
+        return;
+    }
+
+    if (error.isEmpty()) {
+        if (m_copyInBinary) {
+            m_copyRowBuffer.clear();
+            PgTypes::appendCopyBinaryTrailer(m_copyRowBuffer);
+            copyInData(m_copyRowBuffer);
+        }
+        // CopyDone
+        endMessage(m_sendBuffer, beginMessage(m_sendBuffer, 'c'));
+    } else {
+        const qsizetype at = beginMessage(m_sendBuffer, 'f');
+        appendString(m_sendBuffer, error.toUtf8());
+        endMessage(m_sendBuffer, at);
+    }
+    m_copyIn       = false;
+    m_copyInBinary = false;
+
+    // The COPY query stays at the front of the queue, its final result
+    // now goes to whoever ended it
+    APgNativeQuery &pgQuery = m_queuedQueries.front();
+    pgQuery.cb              = std::move(cb);
+    pgQuery.receiver        = nullptr;
+    pgQuery.checkReceiver   = nullptr;
+    setupCheckReceiver(pgQuery, receiver);
+    selfDriver = db;
+
+    m_socket->write(m_sendBuffer);
+    m_sendBuffer.clear();
+}
+
+void ADriverPgNative::deliverCopyInFlushed(const QString &error)
+{
+    const auto waiters = std::move(m_copyInFlushWaiters);
+    m_copyInFlushWaiters.clear();
+    for (const ACoroDataRef &cb : waiters) {
+        if (cb) {
+            AResult result = error.isEmpty() ? resultSuccess() : resultError(error);
+            cb.deliverResult(result);
+        }
+    }
+}
+
+void ADriverPgNative::setLastQuerySingleRowMode()
+{
+    setLastQueryChunkedRowsMode(1);
+}
+
+void ADriverPgNative::setLastQueryChunkedRowsMode(int rows)
+{
+    // Rows are parsed by us, a chunk is delivered once it's full
+    if (!m_queuedQueries.empty()) {
+        m_queuedQueries.back().chunkedRows = std::max(rows, 1);
+    }
+}
+
+bool ADriverPgNative::enterPipelineMode(const APipelineSyncPolicy &policy)
+{
+    // Refuse to enter Pipeline mode if we have queued queries
+    if (!isConnected() || !m_queuedQueries.empty() || m_pipeline) {
+        return false;
+    }
+
+    m_pipeline = true;
+    m_autoSync.setPolicy(policy);
+
+    using namespace std::chrono;
+    if (policy.latency > 0ms) {
+        if (!m_autoSyncTimer) {
+            m_autoSyncTimer = std::make_unique<QTimer>();
+            m_autoSyncTimer->setSingleShot(true);
+            connect(m_autoSyncTimer.get(), &QTimer::timeout, this, [this] {
+                syncPipeline(APgAutoSync::Trigger::Latency);
+            });
+        }
+        m_autoSyncTimer->setInterval(policy.latency);
+    } else {
+        m_autoSyncTimer.reset();
+    }
+    return true;
+}
+
+bool ADriverPgNative::exitPipelineMode()
+{
+    // Like libpq it's only possible once all results were received
+    if (!m_pipeline || !m_queuedQueries.empty()) {
+        return false;
+    }
+
+    m_pipeline        = false;
+    m_pipelineAborted = false;
+    m_autoSyncTimer.reset();
+    return true;
+}
+
+ADatabase::PipelineStatus ADriverPgNative::pipelineStatus() const
+{
+    if (!m_pipeline) {
+        return ADatabase::PipelineStatus::Off;
+    }
+    return m_pipelineAborted ? ADatabase::PipelineStatus::Aborted
+                             : ADatabase::PipelineStatus::On;
+}
+
+bool ADriverPgNative::pipelineSync()
+{
+    return syncPipeline(APgAutoSync::Trigger::Manual);
+}
+
+bool ADriverPgNative::syncPipeline(APgAutoSync::Trigger trigger)
+{
+    if (!isConnected() || !m_pipeline) {
+        return false;
+    }
+
+    APgNativeQuery sync;
+    sync.kind = APgNativeQuery::Kind::Sync;
+    m_queuedQueries.emplace_back(std::move(sync));
+    ++m_pipelineSyncs;
+    m_autoSync.synced(trigger);
+    if (m_autoSyncTimer) {
+        m_autoSyncTimer->stop();
+    }
+    sendQueries();
+    return true;
+}
+
+APipelineSyncStats ADriverPgNative::pipelineSyncStats() const
+{
+    return m_autoSync.stats();
+}
+
+void ADriverPgNative::setResultFormat(ADatabase::ResultFormat format)
+{
+    m_resultFormat = format;
+}
+
+ADatabase::ResultFormat ADriverPgNative::resultFormat() const
+{
+    return m_resultFormat;
+}
+
+int ADriverPgNative::queueSize() const
+{
+    return int(m_queuedQueries.size());
+}
+
+void ADriverPgNative::subscribeToNotification(const std::shared_ptr<ADriver> &db,
+                                              const QString &name,
+                                              QObject *receiver,
+                                              ANotificationFn cb)
+{
+    if (quoteIdentifier(name).isEmpty()) {
+        qWarning(ASQL_PGN) << "Invalid notification channel name" << name;
+        return;
+    }
+
+    if (m_subscribedNotifications.contains(name)) {
+        qWarning(ASQL_PGN) << "Already subscribed to notification" << name;
+        return;
+    }
+
+    m_subscribedNotifications.insert(name, std::move(cb));
+    listenCoro(db, name);
+
+    if (receiver) {
+        connect(receiver, &QObject::destroyed, this, [=, this] {
+            m_subscribedNotifications.remove(name);
+        });
+    }
+}
+
+QStringList ADriverPgNative::subscribedToNotifications() const
+{
+    return m_subscribedNotifications.keys();
+}
+
+void ADriverPgNative::unsubscribeFromNotification(const std::shared_ptr<ADriver> &db,
+                                                  const QString &name)
+{
+    if (m_subscribedNotifications.remove(name)) {
+        unlistenCoro(db, name);
+    }
+}
+
+QString ADriverPgNative::quoteIdentifier(QStringView name)
+{
+    if (name.isEmpty() || name.contains(QChar(u'\0'))) {
+        return {};
+    }
+
+    QString quoted = name.toString();
+    quoted.replace(u'"', u"\"\""_s);
+    return u'"' + quoted + u'"';
+}
+
+ACoroTerminator ADriverPgNative::listenCoro(std::shared_ptr<ADriver> db, QString name)
+{
+    co_yield this;
+
+    if (!isConnected()) {
+        qWarning(ASQL_PGN) << "Cannot listen, not connected" << name;
+        m_subscribedNotifications.remove(name);
+        co_return;
+    }
+
+    AExpectedResult result(this);
+    const QString query = u"LISTEN "_s + quoteIdentifier(name);
+    exec(db, QStringView(query), this, result.ref());
+    auto r = co_await result;
+
+    qDebug(ASQL_PGN) << "subscribed" << r.has_value() << (!r ? r.error() : r->errorString());
+    if (!r || r->hasError()) {
+        m_subscribedNotifications.remove(name);
+    }
+}
+
+ACoroTerminator ADriverPgNative::unlistenCoro(std::shared_ptr<ADriver> db, QString name)
+{
+    co_yield this;
+
+    if (!isConnected()) {
+        qWarning(ASQL_PGN) << "Cannot unlisten, not connected" << name;
+        co_return;
+    }
+
+    AExpectedResult result(this);
+    const QString query = u"UNLISTEN "_s + quoteIdentifier(name);
+    exec(db, QStringView(query), this, result.ref());
+    auto r = co_await result;
+
+    qDebug(ASQL_PGN) << "unsubscribed" << r.has_value() << (!r ? r.error() : r->errorString());
+}
+
+void ADriverPgNative::finishConnection(const QString &error)
+{
+    if (m_socket) {
+        // We might be inside one of its signals
+        m_socket->disconnect(this);
+        m_socket->close();
+        m_socket.release()->deleteLater();
+    }
+
+    // Whatever is left is from the old connection, results
+    // keep the blocks they reference
+    m_readPos = m_writePos;
+    if (!m_ring.empty()) {
+        nextBuffer(BufferSize);
+    }
+
+    m_subscribedNotifications.clear();
+    m_prepared.clear();
+    m_fields.reset();
+    m_sendBuffer.clear();
+    m_autoSyncTimer.reset();
+    m_autoSync.reset();
+    if (m_connectTimer) {
+        m_connectTimer->stop();
+    }
+    if (m_deadlineTimer) {
+        m_deadlineTimer->stop();
+    }
+    m_sentQueries         = 0;
+    m_pipelineSyncs       = 0;
+    m_describingStatement = false;
+    m_pipeline            = false;
+    m_pipelineAborted     = false;
+    m_barrier             = false;
+    m_copyIn              = false;
+    m_copyInBinary        = false;
+    m_copyOut             = false;
+    deliverCopyInFlushed(error);
+    setState(ADatabase::State::Disconnected, error);
+
+    while (!m_queuedQueries.empty()) {
+        APgNativeQuery pgQuery = std::move(m_queuedQueries.front());
+        m_queuedQueries.pop_front();
+        pgQuery.doneError(error);
+    }
+
+    // Queries waiting for room were issued before the failure as well
+    failQueueWaiters(error);
+}
+
+bool ADriverPgNative::isConnected() const
+{
+    return m_state == ADatabase::State::Connected;
+}
+
+bool AResultPgNative::appendRow(const std::shared_ptr<const APgNativeBuffer> &buffer,
+                                const char *data,
+                                const char *end)
+{
+    qint16 count;
+    if (!readInt16(data, end, count) || !m_fields || count != m_fields->fields.size()) {
+        return false;
+    }
+
+    for (qint16 i = 0; i < count; ++i) {
+        qint32 length;
+        if (!readInt32(data, end, length)) {
+            return false;
+        }
+
+        if (length < 0) {
+            m_cells.push_back({EmptyValue, -1});
+        } else if (length <= end - data) {
+            m_cells.push_back({data, length});
+            data += length;
+        } else {
+            return false;
+        }
+    }
+
+    if (m_buffers.empty() || m_buffers.back() != buffer) {
+        m_buffers.push_back(buffer);
+    }
+    ++m_rows;
+    return true;
+}
+
+PgTypes::Value AResultPgNative::pgValue(int row, int column) const
+{
+    const Cell &cell                    = m_cells[size_t(row) * m_fields->fields.size() + column];
+    const APgNativeFields::Field &field = m_fields->fields[column];
+    return {field.type, cell.data, std::max(cell.length, 0), field.binary};
+}
+
+bool AResultPgNative::lastResultSet() const
+{
+    return m_lastResultSet;
+}
+
+bool AResultPgNative::hasError() const
+{
+    return m_error;
+}
+
+QString AResultPgNative::errorString() const
+{
+    return m_errorString;
+}
+
+QByteArray AResultPgNative::query() const
+{
+    return m_query;
+}
+
+QVariantList AResultPgNative::queryArgs() const
+{
+    return m_queryArgs;
+}
+
+int AResultPgNative::size() const
+{
+    return m_rows;
+}
+
+int AResultPgNative::fields() const
+{
+    return m_fields ? int(m_fields->fields.size()) : 0;
+}
+
+qint64 AResultPgNative::numRowsAffected() const
+{
+    return m_numRowsAffected;
+}
+
+QString AResultPgNative::fieldName(int column) const
+{
+    if (column < 0 || column >= fields()) {
+        return {};
+    }
+    return m_fields->fields[column].name;
+}
+
+QVariantList AResultPgNative::toList(int row, int column) const
+{
+    if (isNull(row, column)) {
+        return {};
+    }
+    return PgTypes::toList(pgValue(row, column));
+}
+
+QVariant AResultPgNative::value(int row, int column) const
+{
+    if (column >= fields()) {
+        qWarning(ASQL_PGN, "column %d out of range", column);
+        return {};
+    }
+
+    if (isNull(row, column)) {
+        return QVariant(PgTypes::metaTypeForOid(m_fields->fields[column].type), nullptr);
+    }
+
+    return PgTypes::toVariant(pgValue(row, column));
+}
+
+bool AResultPgNative::isNull(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "isNull", "column out of range");
+    return m_cells[size_t(row) * m_fields->fields.size() + column].length < 0;
+}
+
+bool AResultPgNative::toBool(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "toBool", "column out of range");
+    return PgTypes::toBool(pgValue(row, column));
+}
+
+int AResultPgNative::toInt(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "toInt", "column out of range");
+    return PgTypes::toInt(pgValue(row, column));
+}
+
+qint64 AResultPgNative::toLongLong(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "toLongLong", "column out of range");
+    return PgTypes::toLongLong(pgValue(row, column));
+}
+
+quint64 AResultPgNative::toULongLong(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "toULongLong", "column out of range");
+    return PgTypes::toULongLong(pgValue(row, column));
+}
+
+double AResultPgNative::toDouble(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "toDouble", "column out of range");
+    return PgTypes::toDouble(pgValue(row, column));
+}
+
+QString AResultPgNative::toString(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "toString", "column out of range");
+    if (isNull(row, column)) {
+        return {};
+    }
+
+    return PgTypes::toString(pgValue(row, column));
+}
+
+std::string AResultPgNative::toStdString(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "toStdString", "column out of range");
+    if (isNull(row, column)) {
+        return {};
+    }
+
+    return PgTypes::toStdString(pgValue(row, column));
+}
+
+QUuid AResultPgNative::toUuid(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "toUuid", "column out of range");
+    if (isNull(row, column)) {
+        return {};
+    }
+
+    return PgTypes::toUuid(pgValue(row, column));
+}
+
+QDate AResultPgNative::toDate(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "toDate", "column out of range");
+    return PgTypes::toDate(pgValue(row, column));
+}
+
+QTime AResultPgNative::toTime(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "toTime", "column out of range");
+    return PgTypes::toTime(pgValue(row, column));
+}
+
+QDateTime AResultPgNative::toDateTime(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "toDateTime", "column out of range");
+    return PgTypes::toDateTime(pgValue(row, column));
+}
+
+QJsonValue AResultPgNative::toJsonValue(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "toJsonValue", "column out of range");
+    if (isNull(row, column)) {
+        return {};
+    }
+
+    return PgTypes::toJsonValue(pgValue(row, column));
+}
+
+QCborValue AResultPgNative::toCborValue(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "toCborValue", "column out of range");
+    if (isNull(row, column)) {
+        return {};
+    }
+
+    const PgTypes::Value value = pgValue(row, column);
+    return QCborValue::fromCbor(value.data, value.length);
+}
+
+QByteArray AResultPgNative::toByteArray(int row, int column) const
+{
+    Q_ASSERT_X(column < fields(), "toByteArray", "column out of range");
+    if (isNull(row, column)) {
+        return {};
+    }
+
+    return PgTypes::toByteArray(pgValue(row, column));
+}
+
+#include "moc_adriverpgnative.cpp"
@@ -0,0 +1,430 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "acoroexpected.h"
+#include "apgautosync.h"
+#include "apgtypes.h"
+#include "apreparedquery.h"
+#include "aresult.h"
+#include "aringqueue.h"
+
+#include <adriver.h>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <QHash>
+#include <QIODevice>
+#include <QPointer>
+
+class QTimer;
+
+namespace ASql {
+
+/*!
+ * \brief APgNativeBuffer is a block of memory the socket is read into
+ *
+ * Results keep a reference to the blocks their rows live in, a block is only
+ * written again once no result references it anymore.
+ */
+class APgNativeBuffer
+{
+public:
+    explicit APgNativeBuffer(qsizetype capacity)
+        : data(std::make_unique_for_overwrite<char[]>(capacity))
+        , capacity(capacity)
+    {
+    }
+
+    std::unique_ptr<char[]> data;
+    const qsizetype capacity;
+};
+
+/*!
+ * \brief APgNativeFields is a RowDescription, shared by all results it describes
+ */
+class APgNativeFields
+{
+public:
+    struct Field {
+        QString name;
+        Oid type;
+        bool binary;
+    };
+    QVarLengthArray<Field, 16> fields;
+};
+
+class AResultPgNative final : public AResultPrivate
+{
+public:
+    AResultPgNative() = default;
+
+    bool lastResultSet() const override;
+    bool hasError() const override;
+    QString errorString() const override;
+
+    QByteArray query() const override;
+    QVariantList queryArgs() const override;
+
+    int size() const override;
+    int fields() const override;
+    qint64 numRowsAffected() const override;
+
+    QString fieldName(int column) const override;
+    QVariant value(int row, int column) const override;
+
+    bool isNull(int row, int column) const override;
+    bool toBool(int row, int column) const override;
+    int toInt(int row, int column) const override;
+    qint64 toLongLong(int row, int column) const override;
+    quint64 toULongLong(int row, int column) const override;
+    double toDouble(int row, int column) const override;
+    QString toString(int row, int column) const override;
+    std::string toStdString(int row, int column) const override;
+    QUuid toUuid(int row, int column) const override;
+    QDate toDate(int row, int column) const override;
+    QTime toTime(int row, int column) const override;
+    QDateTime toDateTime(int row, int column) const override;
+    QJsonValue toJsonValue(int row, int column) const final;
+    QCborValue toCborValue(int row, int column) const final;
+    QByteArray toByteArray(int row, int column) const override;
+    QVariantList toList(int row, int column) const override;
+
+    /*!
+     * \brief appendRow references the cells of the DataRow message between \p data
+     * and \p end, which lives inside \p buffer, nothing is copied
+     */
+    bool appendRow(const std::shared_ptr<const APgNativeBuffer> &buffer,
+                   const char *data,
+                   const char *end);
+
+    inline PgTypes::Value pgValue(int row, int column) const;
+
+    struct Cell {
+        const char *data;
+        // -1 for NULL
+        int length;
+    };
+
+    QByteArray m_query;
+    QVariantList m_queryArgs;
+    QString m_errorString;
+    std::shared_ptr<const APgNativeFields> m_fields;
+    // Flat: row * fields + column, pointing into m_buffers
+    std::vector<Cell> m_cells;
+    std::vector<std::shared_ptr<const APgNativeBuffer>> m_buffers;
+    qint64 m_numRowsAffected = 0;
+    int m_rows               = 0;
+    bool m_error             = false;
+    bool m_lastResultSet     = true;
+};
+
+class APgNativeQuery
+{
+public:
+    enum class Kind {
+        // Query message, allows many commands but only text results
+        Simple,
+        // Parse/Bind/Describe/Execute
+        Extended,
+        // A Sync that ends a pipeline
+        Sync,
+    };
+
+    APgNativeQuery()                                  = default;
+    APgNativeQuery(APgNativeQuery &&)                 = default;
+    APgNativeQuery &operator=(APgNativeQuery &&)      = default;
+    APgNativeQuery(const APgNativeQuery &)            = delete;
+    APgNativeQuery &operator=(const APgNativeQuery &) = delete;
+
+    QByteArray query;
+    std::optional<APreparedQuery> preparedQuery;
+    std::shared_ptr<AResultPgNative> result;
+    QVariantList params;
+    ACoroDataRef cb;
+    ACopyOutFn copyOutCb;
+    QPointer<QObject> receiver;
+    QObject *checkReceiver = nullptr;
+    QDeadlineTimer deadline{QDeadlineTimer::Forever};
+    Kind kind              = Kind::Simple;
+    int chunkedRows        = 0;
+    bool binaryResults     = false;
+    // Followed by its own Sync, it ends with ReadyForQuery
+    bool sync              = true;
+    bool sent              = false;
+    // Nothing is sent after it until it's done, e.g. a COPY
+    bool barrier           = false;
+    bool copyIn            = false;
+    // The named statement is being parsed along with this execution
+    bool preparing         = false;
+    // The result has all the rows of its command
+    bool commandComplete   = false;
+    bool timedOut          = false;
+
+    inline bool discarded() const
+    {
+        return kind != Kind::Sync && ((checkReceiver && receiver.isNull()) || !cb);
+    }
+
+    inline void done()
+    {
+        if (cb && (!checkReceiver || !receiver.isNull())) {
+            if (!result) {
+                result = std::make_shared<AResultPgNative>();
+            }
+            result->m_query     = query;
+            result->m_queryArgs = params;
+            AResult r(std::move(result));
+            cb.deliverResult(r);
+        }
+        result.reset();
+    }
+
+    inline void doneError(const QString &error)
+    {
+        result                = std::make_shared<AResultPgNative>();
+        result->m_errorString = error;
+        result->m_error       = true;
+        done();
+    }
+};
+
+/*!
+ * \brief APgNativeOptions are the connection parameters, as an URI or
+ * keyword/value string like the ones libpq takes
+ */
+struct APgNativeOptions {
+    static APgNativeOptions fromConnectionInfo(const QString &connectionInfo);
+
+    // Path of the Unix domain socket when host is a directory
+    QString socketPath() const;
+
+    QString host;
+    QString user;
+    QString password;
+    QString database;
+    QString applicationName;
+    QString sslMode;
+    int connectTimeout = 0;
+    quint16 port       = 0;
+};
+
+/*!
+ * \brief ADriverPgNative talks to the server with the frontend/backend protocol
+ * version 3.0 directly, without libpq
+ *
+ * Queries are written as soon as they are issued, each followed by its own Sync
+ * so that errors stay isolated as if they ran one after the other, and results are
+ * matched in order as the server answers them. Rows are not copied: results keep
+ * references to the receive buffers the DataRow messages were read into.
+ */
+class ADriverPgNative final : public ADriver
+{
+    Q_OBJECT
+public:
+    ADriverPgNative(const QString &connInfo);
+    virtual ~ADriverPgNative();
+
+    QString driverName() const override;
+
+    bool isValid() const override;
+    void open(const std::shared_ptr<ADriver> &driver, QObject *receiver, AOpenFn cb) override;
+    bool isOpen() const override;
+
+    void setState(ADatabase::State state, const QString &status);
+    ADatabase::State state() const override;
+
+    void begin(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoroDataRef cb) override;
+    void commit(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoroDataRef cb) override;
+    void rollback(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoroDataRef cb) override;
+
+    void exec(const std::shared_ptr<ADriver> &db,
+              QUtf8StringView query,
+              QObject *receiver,
+              ACoroDataRef cb) override;
+    void exec(const std::shared_ptr<ADriver> &db,
+              QStringView query,
+              QObject *receiver,
+              ACoroDataRef cb) override;
+    void exec(const std::shared_ptr<ADriver> &db,
+              QUtf8StringView query,
+              const QVariantList &params,
+              QObject *receiver,
+              ACoroDataRef cb) override;
+    void exec(const std::shared_ptr<ADriver> &db,
+              QStringView query,
+              const QVariantList &params,
+              QObject *receiver,
+              ACoroDataRef cb) override;
+    void exec(const std::shared_ptr<ADriver> &db,
+              const APreparedQuery &query,
+              const QVariantList &params,
+              QObject *receiver,
+              ACoroDataRef cb) override;
+
+    void copyIn(const std::shared_ptr<ADriver> &db,
+                QStringView query,
+                QObject *receiver,
+                ACoroDataRef cb) override;
+    void copyOut(const std::shared_ptr<ADriver> &db,
+                 QStringView query,
+                 ACopyOutFn chunkCb,
+                 QObject *receiver,
+                 ACoroDataRef cb) override;
+    bool copyInData(QByteArrayView data) override;
+    bool copyInRow(const QVariantList &row) override;
+    bool copyInBinaryRow(const QVariantList &row) override;
+    void copyInFlush(const std::shared_ptr<ADriver> &db, QObject *receiver, ACoroDataRef cb) override;
+    void copyInEnd(const std::shared_ptr<ADriver> &db,
+                   const QString &error,
+                   QObject *receiver,
+                   ACoroDataRef cb) override;
+
+    void setLastQuerySingleRowMode() override;
+
+    void setLastQueryChunkedRowsMode(int rows) override;
+
+    bool enterPipelineMode(const APipelineSyncPolicy &policy) override;
+
+    bool exitPipelineMode() override;
+
+    ADatabase::PipelineStatus pipelineStatus() const override;
+
+    bool pipelineSync() override;
+
+    APipelineSyncStats pipelineSyncStats() const override;
+
+    void setResultFormat(ADatabase::ResultFormat format) override;
+    ADatabase::ResultFormat resultFormat() const override;
+
+    int queueSize() const override;
+
+    void subscribeToNotification(const std::shared_ptr<ADriver> &db,
+                                 const QString &name,
+                                 QObject *receiver,
+                                 ANotificationFn cb) override;
+    QStringList subscribedToNotifications() const override;
+    void unsubscribeFromNotification(const std::shared_ptr<ADriver> &db,
+                                     const QString &name) override;
+
+private:
+    struct Prepared {
+        QByteArray name;
+        std::shared_ptr<AFieldIndex> fieldIndex;
+        QVarLengthArray<Oid, 8> paramTypes;
+    };
+
+    enum class Auth {
+        Startup,
+        Sasl,
+        // The server signature of the SCRAM exchange matched
+        SaslVerified,
+        Done,
+    };
+
+    void enqueue(const std::shared_ptr<ADriver> &db, APgNativeQuery &&pgQuery, QObject *receiver);
+    void setupCheckReceiver(APgNativeQuery &pgQuery, QObject *receiver);
+    void cancelCurrentQueryOnReceiverDestroyed(QObject *obj);
+    void cancelRunningQuery();
+    void armDeadline(const QDeadlineTimer &deadline);
+    void expireDeadlines();
+    void sendQueries();
+    void sendQuery(APgNativeQuery &pgQuery);
+    bool syncPipeline(APgAutoSync::Trigger trigger);
+    void writeStartup();
+    void writePassword(QByteArrayView password);
+    void readSocket();
+    void nextBuffer(qsizetype needed);
+    void handleMessage(char type, const char *data, const char *end);
+    void handleAuthentication(const char *data, const char *end);
+    bool scramContinue(const QByteArray &serverFirst);
+    void finishAuthentication(const QString &error);
+    void handleError(const char *data, const char *end);
+    void handleNotification(const char *data, const char *end);
+    void handleParameterDescription(const char *data, const char *end);
+    void handleRowDescription(const char *data, const char *end);
+    void handleCommandComplete(QByteArrayView tag);
+    void handleReadyForQuery();
+    void newResult(APgNativeQuery &pgQuery);
+    void deliverPartial(APgNativeQuery &pgQuery);
+    void completeFront();
+    void copyInStarted();
+    void connected();
+    void finishConnection(const QString &error);
+    void deliverOpenWaiters(bool isOpen, const QString &error);
+    void deliverCopyInFlushed(const QString &error);
+    static QString errorMessage(const char *data, const char *end);
+    static QString quoteIdentifier(QStringView name);
+    ACoroTerminator listenCoro(std::shared_ptr<ADriver> db, QString name);
+    ACoroTerminator unlistenCoro(std::shared_ptr<ADriver> db, QString name);
+    inline bool isConnected() const;
+
+    struct OpenCaller {
+        std::shared_ptr<ADriver> driver;
+        AOpenFn cb;
+        std::optional<QPointer<QObject>> receiverPtr;
+
+        void emit(bool isOpen, const QString &error) const
+        {
+            if (cb && (!receiverPtr.has_value() || !receiverPtr->isNull())) {
+                cb(isOpen, error);
+            }
+        }
+    };
+    std::vector<OpenCaller> m_openWaiters;
+
+    APgNativeOptions m_options;
+    QHash<QString, ANotificationFn> m_subscribedNotifications;
+    QHash<int, Prepared> m_prepared;
+    ARingQueue<APgNativeQuery> m_queuedQueries;
+    std::shared_ptr<ADriver> selfDriver;
+    PgTypes::Params m_params;
+    std::vector<ACoroDataRef> m_copyInFlushWaiters;
+    // Messages are built here and written to the socket at once
+    QByteArray m_sendBuffer;
+    QByteArray m_copyRowBuffer;
+
+    // Receive ring, m_ring[m_ringIndex] is the block being read into
+    std::vector<std::shared_ptr<APgNativeBuffer>> m_ring;
+    size_t m_ringIndex   = 0;
+    qsizetype m_readPos  = 0;
+    qsizetype m_writePos = 0;
+
+    // Fields of the result being received
+    std::shared_ptr<const APgNativeFields> m_fields;
+
+    APgAutoSync m_autoSync;
+
+    std::unique_ptr<QIODevice> m_socket;
+    std::unique_ptr<QTimer> m_autoSyncTimer;
+    std::unique_ptr<QTimer> m_deadlineTimer;
+    std::unique_ptr<QTimer> m_connectTimer;
+
+    QByteArray m_scramClientNonce;
+    QByteArray m_scramClientFirstBare;
+    QByteArray m_scramServerSignature;
+
+    ADatabase::State m_state               = ADatabase::State::Disconnected;
+    ADatabase::ResultFormat m_resultFormat = ADatabase::ResultFormat::Text;
+    Auth m_auth                            = Auth::Startup;
+    quint64 m_preparedNames                = 0;
+    qint32 m_backendPid                    = 0;
+    qint32 m_backendKey                    = 0;
+    // Queries written and not answered yet, they are at the front of the queue
+    qsizetype m_sentQueries                = 0;
+    // Syncs queued in pipeline mode whose ReadyForQuery didn't arrive yet
+    int m_pipelineSyncs                    = 0;
+    // A statement description arrives before the portal one, it's only used for the cache
+    bool m_describingStatement             = false;
+    bool m_pipeline                        = false;
+    bool m_pipelineAborted                 = false;
+    bool m_barrier                         = false;
+    bool m_copyIn                          = false;
+    bool m_copyInBinary                    = false;
+    bool m_copyOut                         = false;
+};
+
+} // namespace ASql
@@ -0,0 +1,461 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "anotificationhub.h"
+
+#include "acoroexpected.h"
+#include "adatabase.h"
+#include "adriver.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include <QHash>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QThread>
+#include <QTimer>
+
+Q_LOGGING_CATEGORY(ASQL_HUB, "asql.notificationhub", QtInfoMsg)
+
+using namespace std::chrono;
+using namespace Qt::StringLiterals;
+
+namespace ASql {
+
+struct ANotificationSubscriber {
+    quint64 id = 0;
+    QString channel;
+    QObject *receiver = nullptr;
+    ANotificationFn cb;
+    ANotificationBatchFn batchCb;
+    ANotificationOptions options;
+    QMetaObject::Connection destroyedConn;
+    std::atomic_bool cancelled = false;
+
+    // Guarded by the hub mutex
+    QList<ADatabaseNotification> pending;
+    bool flushScheduled = false;
+
+    [[nodiscard]] bool coalesces() const
+    {
+        return batchCb || options.interval > 0ms || options.deduplicate || options.latestOnly;
+    }
+
+    void collect(const ADatabaseNotification &notification)
+    {
+        if (options.latestOnly) {
+            pending.clear();
+        } else if (options.deduplicate &&
+                   std::ranges::any_of(pending, [&notification](const auto &collected) {
+            return collected.payload == notification.payload;
+        })) {
+            return;
+        }
+        pending.append(notification);
+    }
+
+    void deliver(const QList<ADatabaseNotification> &notifications) const
+    {
+        if (batchCb) {
+            if (!cancelled) {
+                batchCb(notifications);
+            }
+            return;
+        }
+
+        for (const auto &notification : notifications) {
+            // Callbacks might unsubscribe
+            if (cancelled) {
+                return;
+            }
+            cb(notification);
+        }
+    }
+};
+
+using ANotificationSubscriberPtr = std::shared_ptr<ANotificationSubscriber>;
+// Notifications to deliver in the current thread once the mutex is released
+using ANotificationDeliveries =
+    std::vector<std::pair<ANotificationSubscriberPtr, QList<ADatabaseNotification>>>;
+
+class ANotificationHubPrivate
+{
+public:
+    ANotificationHubPrivate(ANotificationHub *q,
+                            std::shared_ptr<ADriverFactory> factory,
+                            const QString &name)
+        : db(factory)
+        , name(name)
+        , q_ptr(q)
+    {
+    }
+
+    ACoroTerminator open();
+    void listen(const QString &channel);
+    void unlisten(const QString &channel);
+    quint64 addSubscriber(const ANotificationSubscriberPtr &subscriber);
+    void dispatch(const ADatabaseNotification &notification);
+    void flush(const ANotificationSubscriberPtr &subscriber);
+    void schedule(const ANotificationSubscriberPtr &subscriber,
+                  QList<ADatabaseNotification> notifications,
+                  ANotificationDeliveries &local);
+    void stateChanged(ADatabase::State state);
+
+    ADatabase db;
+    QString name;
+    QTimer reconnectTimer;
+
+    // Guards the subscriptions, which are changed from any thread
+    mutable QMutex mutex;
+    QHash<QString, std::vector<ANotificationSubscriberPtr>> channels;
+    QHash<quint64, ANotificationSubscriberPtr> subscribers;
+    quint64 lastId = 0;
+
+    ANotificationHub *q_ptr;
+    Q_DECLARE_PUBLIC(ANotificationHub)
+};
+
+namespace {
+
+QMutex &hubsMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+QHash<QString, ANotificationHub *> &hubs()
+{
+    static QHash<QString, ANotificationHub *> hubs;
+    return hubs;
+}
+
+} // namespace
+
+ACoroTerminator ANotificationHubPrivate::open()
+{
+    Q_Q(ANotificationHub);
+    co_yield q;
+
+    auto result = co_await db.coOpen(q);
+    if (!result) {
+        qWarning(ASQL_HUB) << "Failed to open connection" << name << result.error();
+        reconnectTimer.start();
+    }
+}
+
+void ANotificationHubPrivate::listen(const QString &channel)
+{
+    {
+        QMutexLocker locker(&mutex);
+        if (!channels.contains(channel)) {
+            return;
+        }
+    }
+
+    // LISTEN is issued for every channel once the connection is up
+    if (db.isOpen() && !db.subscribedToNotifications().contains(channel)) {
+        db.subscribeToNotification(channel, nullptr, {});
+    }
+}
+
+void ANotificationHubPrivate::unlisten(const QString &channel)
+{
+    {
+        QMutexLocker locker(&mutex);
+        if (channels.contains(channel)) {
+            return;
+        }
+    }
+
+    if (db.isOpen()) {
+        db.unsubscribeFromNotification(channel);
+    }
+}
+
+quint64 ANotificationHubPrivate::addSubscriber(const ANotificationSubscriberPtr &subscriber)
+{
+    Q_Q(ANotificationHub);
+    bool first;
+    {
+        QMutexLocker locker(&mutex);
+        subscriber->id = ++lastId;
+
+        auto &channelSubscribers = channels[subscriber->channel];
+        first                    = channelSubscribers.empty();
+        channelSubscribers.push_back(subscriber);
+        subscribers.insert(subscriber->id, subscriber);
+    }
+
+    if (subscriber->receiver) {
+        subscriber->destroyedConn = QObject::connect(
+            subscriber->receiver,
+            &QObject::destroyed,
+            q,
+            [q, id = subscriber->id] { q->unsubscribe(id); },
+            Qt::DirectConnection);
+    }
+
+    if (first) {
+        QMetaObject::invokeMethod(q, [this, channel = subscriber->channel] { listen(channel); });
+    }
+
+    return subscriber->id;
+}
+
+void ANotificationHubPrivate::schedule(const ANotificationSubscriberPtr &subscriber,
+                                       QList<ADatabaseNotification> notifications,
+                                       ANotificationDeliveries &local)
+{
+    if (!subscriber->receiver || subscriber->receiver->thread() == QThread::currentThread()) {
+        local.emplace_back(subscriber, std::move(notifications));
+    } else {
+        // The mutex keeps the receiver alive as its destroyed()
+        // handler has to take it to unsubscribe
+        QMetaObject::invokeMethod(
+            subscriber->receiver,
+            [subscriber, notifications = std::move(notifications)] {
+            subscriber->deliver(notifications);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void ANotificationHubPrivate::dispatch(const ADatabaseNotification &notification)
+{
+    Q_Q(ANotificationHub);
+    ANotificationDeliveries local;
+    {
+        QMutexLocker locker(&mutex);
+        auto it = channels.constFind(notification.name);
+        if (it == channels.constEnd()) {
+            return;
+        }
+
+        for (const auto &subscriber : it.value()) {
+            if (!subscriber->coalesces()) {
+                schedule(subscriber, {notification}, local);
+                continue;
+            }
+
+            subscriber->collect(notification);
+            if (!subscriber->flushScheduled) {
+                subscriber->flushScheduled = true;
+                QTimer::singleShot(
+                    subscriber->options.interval, q, [this, subscriber] { flush(subscriber); });
+            }
+        }
+    }
+
+    // Callbacks might unsubscribe, so they run without the lock
+    for (const auto &[target, notifications] : local) {
+        target->deliver(notifications);
+    }
+}
+
+void ANotificationHubPrivate::flush(const ANotificationSubscriberPtr &subscriber)
+{
+    ANotificationDeliveries local;
+    {
+        QMutexLocker locker(&mutex);
+        subscriber->flushScheduled = false;
+        auto notifications         = std::exchange(subscriber->pending, {});
+        if (subscriber->cancelled || notifications.isEmpty()) {
+            return;
+        }
+        schedule(subscriber, std::move(notifications), local);
+    }
+
+    for (const auto &[target, notifications] : local) {
+        target->deliver(notifications);
+    }
+}
+
+void ANotificationHubPrivate::stateChanged(ADatabase::State state)
+{
+    if (state == ADatabase::State::Connected) {
+        reconnectTimer.stop();
+
+        QStringList listen;
+        {
+            QMutexLocker locker(&mutex);
+            listen = channels.keys();
+        }
+
+        qDebug(ASQL_HUB) << "Connected" << name << "listening to" << listen;
+        for (const QString &channel : std::as_const(listen)) {
+            db.subscribeToNotification(channel, nullptr, {});
+        }
+    } else if (state == ADatabase::State::Disconnected) {
+        qWarning(ASQL_HUB) << "Connection lost" << name << "reconnecting in"
+                           << reconnectTimer.intervalAsDuration();
+        reconnectTimer.start();
+    }
+}
+
+} // namespace ASql
+
+using namespace ASql;
+
+ANotificationHub::ANotificationHub(std::shared_ptr<ADriverFactory> factory, const QString &name)
+    : d_ptr(new ANotificationHubPrivate(this, std::move(factory), name))
+{
+    Q_D(ANotificationHub);
+    d->reconnectTimer.setSingleShot(true);
+    d->reconnectTimer.setInterval(5s);
+    connect(&d->reconnectTimer, &QTimer::timeout, this, [d] { d->open(); });
+
+    if (auto driver = d->db.driver()) {
+        connect(driver,
+                &ADriver::notificationReceived,
+                this,
+                [d](const ADatabaseNotification &notification) { d->dispatch(notification); });
+        connect(driver,
+                &ADriver::stateChanged,
+                this,
+                [d](ADatabase::State state) { d->stateChanged(state); });
+    }
+
+    d->open();
+}
+
+ANotificationHub::~ANotificationHub()
+{
+    Q_D(ANotificationHub);
+    d->reconnectTimer.stop();
+    if (auto driver = d->db.driver()) {
+        driver->disconnect(this);
+    }
+
+    {
+        QMutexLocker locker(&d->mutex);
+        for (const auto &subscriber : std::as_const(d->subscribers)) {
+            subscriber->cancelled = true;
+            QObject::disconnect(subscriber->destroyedConn);
+        }
+    }
+
+    delete d_ptr;
+}
+
+ANotificationHub *ANotificationHub::create(std::shared_ptr<ADriverFactory> factory,
+                                           QStringView name)
+{
+    QMutexLocker locker(&hubsMutex());
+    auto &registry = hubs();
+    auto it        = registry.constFind(name.toString());
+    if (it != registry.constEnd()) {
+        return it.value();
+    }
+
+    auto hub = new ANotificationHub(std::move(factory), name.toString());
+    registry.insert(name.toString(), hub);
+    return hub;
+}
+
+ANotificationHub *ANotificationHub::instance(QStringView name)
+{
+    QMutexLocker locker(&hubsMutex());
+    return hubs().value(name.toString());
+}
+
+void ANotificationHub::remove(QStringView name)
+{
+    ANotificationHub *hub;
+    {
+        QMutexLocker locker(&hubsMutex());
+        hub = hubs().take(name.toString());
+    }
+    delete hub;
+}
+
+quint64 ANotificationHub::subscribe(const QString &channel,
+                                    QObject *receiver,
+                                    ANotificationFn cb,
+                                    const ANotificationOptions &options)
+{
+    Q_D(ANotificationHub);
+    if (channel.isEmpty() || !cb) {
+        qWarning(ASQL_HUB) << "Invalid subscription to" << channel;
+        return 0;
+    }
+
+    auto subscriber      = std::make_shared<ANotificationSubscriber>();
+    subscriber->channel  = channel;
+    subscriber->receiver = receiver;
+    subscriber->cb       = std::move(cb);
+    subscriber->options  = options;
+    return d->addSubscriber(subscriber);
+}
+
+quint64 ANotificationHub::subscribeBatch(const QString &channel,
+                                         QObject *receiver,
+                                         ANotificationBatchFn cb,
+                                         const ANotificationOptions &options)
+{
+    Q_D(ANotificationHub);
+    if (channel.isEmpty() || !cb) {
+        qWarning(ASQL_HUB) << "Invalid subscription to" << channel;
+        return 0;
+    }
+
+    auto subscriber      = std::make_shared<ANotificationSubscriber>();
+    subscriber->channel  = channel;
+    subscriber->receiver = receiver;
+    subscriber->batchCb  = std::move(cb);
+    subscriber->options  = options;
+    return d->addSubscriber(subscriber);
+}
+
+void ANotificationHub::unsubscribe(quint64 id)
+{
+    Q_D(ANotificationHub);
+    ANotificationSubscriberPtr subscriber;
+    bool last = false;
+    {
+        QMutexLocker locker(&d->mutex);
+        subscriber = d->subscribers.take(id);
+        if (!subscriber) {
+            return;
+        }
+        subscriber->cancelled = true;
+
+        auto it = d->channels.find(subscriber->channel);
+        if (it != d->channels.end()) {
+            std::erase(it.value(), subscriber);
+            if (it.value().empty()) {
+                d->channels.erase(it);
+                last = true;
+            }
+        }
+    }
+
+    QObject::disconnect(subscriber->destroyedConn);
+
+    if (last) {
+        QMetaObject::invokeMethod(
+            this, [d, channel = subscriber->channel] { d->unlisten(channel); });
+    }
+}
+
+QStringList ANotificationHub::channels() const
+{
+    Q_D(const ANotificationHub);
+    QMutexLocker locker(&d->mutex);
+    return d->channels.keys();
+}
+
+void ANotificationHub::setReconnectInterval(milliseconds interval)
+{
+    Q_D(ANotificationHub);
+    d->reconnectTimer.setInterval(interval);
+}
+
+ADatabase ANotificationHub::database() const
+{
+    Q_D(const ANotificationHub);
+    return d->db;
+}
+
+#include "moc_anotificationhub.cpp"
@@ -0,0 +1,149 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <adatabase.h>
+#include <apool.h>
+#include <asql_export.h>
+#include <chrono>
+
+#include <QObject>
+
+namespace ASql {
+
+/*!
+ * \brief ANotificationOptions controls how a hub subscription delivers bursts of
+ * notifications
+ *
+ * With any option set notifications are collected and delivered together once
+ * \c interval has elapsed since the first one, so a burst costs a single callback
+ * (or one per collected notification for ANotificationFn callbacks).
+ */
+struct ANotificationOptions {
+    /*!
+     * \brief interval notifications are collected for this long before being delivered,
+     * which happens at most once per interval, 0 collects the ones read at once
+     */
+    std::chrono::milliseconds interval{0};
+
+    /*!
+     * \brief deduplicate drops notifications with a payload already collected
+     */
+    bool deduplicate = false;
+
+    /*!
+     * \brief latestOnly only delivers the last notification collected
+     */
+    bool latestOnly = false;
+};
+
+using ANotificationBatchFn =
+    std::function<void(const QList<ADatabaseNotification> &notifications)>;
+
+class ANotificationHubPrivate;
+/*!
+ * \brief ANotificationHub shares a single connection among any number of
+ * notification subscribers
+ *
+ * Subscribing with ADatabase::subscribeToNotification() ties the subscription to that
+ * connection, which must then be kept out of the pool. A hub holds one dedicated
+ * connection that LISTENs to the union of the channels of its subscribers, each
+ * notification is delivered to every subscriber of the channel.
+ *
+ * The hub lives in the thread that created it, subscribe() and unsubscribe() can be
+ * called from any thread, callbacks run in the thread of their receiver. If the connection
+ * is lost it's reopened and all channels are LISTENed again, notifications sent while
+ * disconnected are lost.
+ *
+ * \code
+ * ANotificationHub::create(APg::factory(url));
+ * ...
+ * ANotificationHub::instance()->subscribe(u"items"_s, this, [](const auto &notification) {
+ *     qDebug() << notification.payload;
+ * });
+ * \endcode
+ *
+ * \note Only supported by Postgres.
+ */
+class ASQL_EXPORT ANotificationHub : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(ANotificationHub)
+public:
+    /*!
+     * \brief create creates the hub named \p name in the current thread, its
+     * connection is created by \p factory and opened right away
+     *
+     * Using the name of the pool that shares the same factory keeps them paired.
+     * If a hub with this name exists it's returned instead.
+     */
+    static ANotificationHub *create(std::shared_ptr<ADriverFactory> factory,
+                                    QStringView name = APool::defaultPool);
+
+    /*!
+     * \brief instance returns the hub named \p name or nullptr, it's safe to call from
+     * any thread
+     */
+    static ANotificationHub *instance(QStringView name = APool::defaultPool);
+
+    /*!
+     * \brief remove deletes the hub named \p name, must be called from the hub thread
+     */
+    static void remove(QStringView name = APool::defaultPool);
+
+    /*!
+     * \brief subscribe calls \p cb for every notification on \p channel
+     *
+     * \p cb runs in the thread of \p receiver and the subscription is removed once
+     * \p receiver is destroyed, without a receiver it runs in the hub thread.
+     * \p options coalesce bursts of notifications.
+     *
+     * \return the subscription id, used by unsubscribe()
+     */
+    quint64 subscribe(const QString &channel,
+                      QObject *receiver,
+                      ANotificationFn cb,
+                      const ANotificationOptions &options = {});
+
+    /*!
+     * \brief subscribeBatch calls \p cb with the notifications on \p channel collected
+     * according to \p options, otherwise it behaves like subscribe()
+     */
+    quint64 subscribeBatch(const QString &channel,
+                           QObject *receiver,
+                           ANotificationBatchFn cb,
+                           const ANotificationOptions &options = {});
+
+    /*!
+     * \brief unsubscribe removes the subscription \p id, the channel is UNLISTENed
+     * once it has no subscribers
+     */
+    void unsubscribe(quint64 id);
+
+    /*!
+     * \brief channels returns the channels with subscribers
+     */
+    [[nodiscard]] QStringList channels() const;
+
+    /*!
+     * \brief setReconnectInterval sets how long to wait before trying to reopen a lost
+     * connection, the default is 5 seconds, must be called from the hub thread
+     */
+    void setReconnectInterval(std::chrono::milliseconds interval);
+
+    /*!
+     * \brief database returns the dedicated connection, which can be used to send
+     * notifications, it must only be used from the hub thread
+     */
+    [[nodiscard]] ADatabase database() const;
+
+private:
+    ANotificationHub(std::shared_ptr<ADriverFactory> factory, const QString &name);
+    ~ANotificationHub() override;
+
+    ANotificationHubPrivate *d_ptr;
+};
+
+} // namespace ASql
@@ -0,0 +1,107 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "adatabase.h"
+
+#include <algorithm>
+
+namespace ASql {
+
+/*!
+ * \brief APgAutoSync follows an APipelineSyncPolicy for the queries sent in pipeline
+ * mode, telling the driver when the current batch must be synced, and accounts the
+ * size of the batches
+ *
+ * Drivers own the latency timer, it runs while a batch is pending.
+ */
+class APgAutoSync
+{
+public:
+    enum class Trigger { None, Manual, Idle, Limit, Latency };
+
+    void setPolicy(const APipelineSyncPolicy &policy)
+    {
+        m_policy = policy;
+        reset();
+    }
+
+    [[nodiscard]] const APipelineSyncPolicy &policy() const { return m_policy; }
+
+    /*!
+     * \brief pending returns true if queries were sent after the last sync
+     */
+    [[nodiscard]] bool pending() const { return m_queries > 0; }
+
+    /*!
+     * \brief querySent accounts a query of \p bytes sent after the last sync and
+     * returns what requires the batch to be synced now, if anything
+     *
+     * \param idle true when no synced batch is waiting for its results
+     */
+    [[nodiscard]] Trigger querySent(qsizetype bytes, bool idle)
+    {
+        ++m_queries;
+        m_bytes += bytes;
+        if (idle && m_policy.syncWhenIdle) {
+            return Trigger::Idle;
+        }
+        if ((m_policy.maxQueries > 0 && m_queries >= m_policy.maxQueries) ||
+            (m_policy.maxBytes > 0 && m_bytes >= m_policy.maxBytes)) {
+            return Trigger::Limit;
+        }
+        return Trigger::None;
+    }
+
+    /*!
+     * \brief synced closes the current batch
+     */
+    void synced(Trigger trigger)
+    {
+        if (m_queries == 0) {
+            return;
+        }
+
+        ++m_stats.syncs;
+        switch (trigger) {
+        case Trigger::Idle:
+            ++m_stats.idleSyncs;
+            break;
+        case Trigger::Limit:
+            ++m_stats.limitSyncs;
+            break;
+        case Trigger::Latency:
+            ++m_stats.latencySyncs;
+            break;
+        default:
+            break;
+        }
+        m_stats.queries += quint64(m_queries);
+        m_stats.bytes += quint64(m_bytes);
+        m_stats.lastBatchQueries = m_queries;
+        m_stats.lastBatchBytes   = m_bytes;
+        m_stats.maxBatchQueries  = std::max(m_stats.maxBatchQueries, m_queries);
+        reset();
+    }
+
+    /*!
+     * \brief reset forgets the current batch, when the connection is lost
+     */
+    void reset()
+    {
+        m_queries = 0;
+        m_bytes   = 0;
+    }
+
+    [[nodiscard]] APipelineSyncStats stats() const { return m_stats; }
+
+private:
+    APipelineSyncPolicy m_policy;
+    APipelineSyncStats m_stats;
+    qsizetype m_bytes = 0;
+    int m_queries     = 0;
+};
+
+} // namespace ASql
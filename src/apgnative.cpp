@@ -0,0 +1,62 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#include "apgnative.h"
+
+#include "adriverpgnative.h"
+
+using namespace ASql;
+
+namespace ASql {
+
+class APgNativePrivate
+{
+public:
+    QString connection;
+};
+
+} // namespace ASql
+
+APgNative::APgNative(const QString &connectionInfo)
+    : d(std::make_unique<APgNativePrivate>())
+{
+    d->connection = connectionInfo;
+}
+
+APgNative::~APgNative() = default;
+
+std::shared_ptr<ADriverFactory> APgNative::factory(const QUrl &connectionInfo)
+{
+    return APgNative::factory(connectionInfo.toString(QUrl::None));
+}
+
+std::shared_ptr<ADriverFactory> APgNative::factory(const QString &connectionInfo)
+{
+    return std::make_shared<APgNative>(connectionInfo);
+}
+
+std::shared_ptr<ADriverFactory> APgNative::factory(QStringView connectionInfo)
+{
+    return APgNative::factory(connectionInfo.toString());
+}
+
+ADatabase APgNative::database(const QString &connectionInfo)
+{
+    return ADatabase(std::make_shared<APgNative>(connectionInfo));
+}
+
+ADriver *APgNative::createRawDriver() const
+{
+    return new ADriverPgNative(d->connection);
+}
+
+std::shared_ptr<ADriver> APgNative::createDriver() const
+{
+    return std::make_shared<ADriverPgNative>(d->connection);
+}
+
+ADatabase APgNative::createDatabase() const
+{
+    return ADatabase(std::make_shared<ADriverPgNative>(d->connection));
+}
@@ -0,0 +1,51 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include "adriverfactory.h"
+
+#include <asql_pg_export.h>
+
+#include <QUrl>
+
+namespace ASql {
+
+class APgNativePrivate;
+class ASQL_PG_EXPORT APgNative : public ADriverFactory
+{
+public:
+    /*!
+     * \brief APgNative constructs a factory of Postgres drivers that speak the
+     * wire protocol directly instead of going through libpq
+     *
+     * The connection info has the same URI or keyword/value format APg takes,
+     * e.g. "postgresql://username@/db2". The host can be a name, an address or
+     * the directory of the Unix domain socket, only the first host is used.
+     *
+     * Supported options are \c host, \c port, \c dbname, \c user, \c password,
+     * \c application_name and \c connect_timeout, the PG* environment variables
+     * are used as fallbacks like in libpq. Trust, password, MD5 and SCRAM-SHA-256
+     * authentication are supported, TLS is not so \c sslmode=require fails to connect.
+     *
+     * All queries are pipelined: they are written as soon as they are issued and
+     * the results are read straight from the receive buffers without being copied.
+     */
+    APgNative(const QString &connectionInfo);
+    ~APgNative();
+
+    static std::shared_ptr<ADriverFactory> factory(const QUrl &connectionInfo);
+    static std::shared_ptr<ADriverFactory> factory(const QString &connectionInfo);
+    static std::shared_ptr<ADriverFactory> factory(QStringView connectionInfo);
+    static ADatabase database(const QString &connectionInfo);
+
+    ADriver *createRawDriver() const final;
+    std::shared_ptr<ADriver> createDriver() const final;
+    ADatabase createDatabase() const final;
+
+private:
+    std::unique_ptr<APgNativePrivate> d;
+};
+
+} // namespace ASql
@@ -0,0 +1,197 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "apgtemporal.h"
+
+#include <QTimeZone>
+
+using namespace ASql;
+
+namespace {
+
+class Cursor
+{
+public:
+    explicit Cursor(QByteArrayView text)
+        : m_it(text.data())
+        , m_end(text.data() + text.size())
+    {
+    }
+
+    [[nodiscard]] bool atEnd() const { return m_it == m_end; }
+    [[nodiscard]] char peek() const { return atEnd() ? '\0' : *m_it; }
+
+    bool skip(char ch)
+    {
+        if (peek() != ch) {
+            return false;
+        }
+        ++m_it;
+        return true;
+    }
+
+    // Reads exactly \p count digits
+    bool digits(int count, int &value)
+    {
+        if (m_end - m_it < count) {
+            return false;
+        }
+
+        int result = 0;
+        for (int i = 0; i < count; ++i) {
+            const unsigned digit = unsigned(m_it[i] - '0');
+            if (digit > 9) {
+                return false;
+            }
+            result = result * 10 + int(digit);
+        }
+        m_it += count;
+        value = result;
+        return true;
+    }
+
+    // Reads up to \p max digits, returns how many were read
+    int fraction(int max, int &value)
+    {
+        int count  = 0;
+        int result = 0;
+        while (count < max && !atEnd() && unsigned(*m_it - '0') <= 9) {
+            result = result * 10 + (*m_it - '0');
+            ++m_it;
+            ++count;
+        }
+        value = result;
+        return count;
+    }
+
+private:
+    const char *m_it;
+    const char *m_end;
+};
+
+bool readDate(Cursor &cursor, QDate &date)
+{
+    int year;
+    int month;
+    int day;
+    if (!cursor.digits(4, year) || !cursor.skip('-') || !cursor.digits(2, month) ||
+        !cursor.skip('-') || !cursor.digits(2, day) || !QDate::isValid(year, month, day)) {
+        return false;
+    }
+    date = QDate(year, month, day);
+    return true;
+}
+
+bool readTime(Cursor &cursor, QTime &time)
+{
+    int hour;
+    int minute;
+    int second;
+    if (!cursor.digits(2, hour) || !cursor.skip(':') || !cursor.digits(2, minute) ||
+        !cursor.skip(':') || !cursor.digits(2, second)) {
+        return false;
+    }
+
+    int msec = 0;
+    if (cursor.skip('.')) {
+        int usec;
+        const int count = cursor.fraction(6, usec);
+        if (count == 0) {
+            return false;
+        }
+        for (int i = count; i < 6; ++i) {
+            usec *= 10;
+        }
+        // Rounded like QTime::fromString(), without rolling over to the next second
+        msec = qMin((usec + 500) / 1000, 999);
+    }
+
+    // 24:00:00 and leap seconds are left to the generic parser
+    if (!QTime::isValid(hour, minute, second, msec)) {
+        return false;
+    }
+    time = QTime(hour, minute, second, msec);
+    return true;
+}
+
+bool readOffset(Cursor &cursor, int &offset)
+{
+    const char sign = cursor.peek();
+    if (sign != '+' && sign != '-') {
+        return false;
+    }
+    cursor.skip(sign);
+
+    int hours;
+    int minutes = 0;
+    int seconds = 0;
+    if (!cursor.digits(2, hours)) {
+        return false;
+    }
+    if (cursor.skip(':') && !cursor.digits(2, minutes)) {
+        return false;
+    }
+    if (cursor.skip(':') && !cursor.digits(2, seconds)) {
+        return false;
+    }
+
+    offset = hours * 3600 + minutes * 60 + seconds;
+    if (sign == '-') {
+        offset = -offset;
+    }
+    return true;
+}
+
+} // namespace
+
+std::optional<QDate> PgTypes::parseDate(QByteArrayView text)
+{
+    Cursor cursor(text);
+    QDate date;
+    if (!readDate(cursor, date) || !cursor.atEnd()) {
+        return std::nullopt;
+    }
+    return date;
+}
+
+std::optional<QTime> PgTypes::parseTime(QByteArrayView text)
+{
+    Cursor cursor(text);
+    QTime time;
+    int offset;
+    if (!readTime(cursor, time) || (!cursor.atEnd() && !readOffset(cursor, offset)) ||
+        !cursor.atEnd()) {
+        return std::nullopt;
+    }
+    return time;
+}
+
+std::optional<QDateTime> PgTypes::parseDateTime(QByteArrayView text)
+{
+    Cursor cursor(text);
+    QDate date;
+    if (!readDate(cursor, date)) {
+        return std::nullopt;
+    }
+
+    if (cursor.atEnd()) {
+        return QDateTime(date, QTime(0, 0), QTimeZone::LocalTime);
+    }
+
+    QTime time;
+    if (!cursor.skip(' ') || !readTime(cursor, time)) {
+        return std::nullopt;
+    }
+
+    if (cursor.atEnd()) {
+        return QDateTime(date, time, QTimeZone::LocalTime);
+    }
+
+    int offset;
+    if (!readOffset(cursor, offset) || !cursor.atEnd()) {
+        return std::nullopt;
+    }
+    return QDateTime(date, time, QTimeZone::fromSecondsAheadOfUtc(offset));
+}
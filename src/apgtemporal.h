@@ -0,0 +1,38 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <asql_pg_export.h>
+#include <optional>
+
+#include <QByteArrayView>
+#include <QDateTime>
+
+namespace ASql::PgTypes {
+
+/*!
+ * \brief parseDate parses a date in the ISO DateStyle output of PostgreSQL,
+ * \c YYYY-MM-DD, without allocating
+ *
+ * Anything else, like BC dates, years past 9999, infinity or other DateStyles,
+ * returns std::nullopt and is left to the generic ISO parser.
+ */
+ASQL_PG_EXPORT std::optional<QDate> parseDate(QByteArrayView text);
+
+/*!
+ * \brief parseTime parses \c HH:MM:SS[.ffffff][+TZ] without allocating, the zone
+ * of \c timetz values is ignored, fractions are rounded to milliseconds
+ */
+ASQL_PG_EXPORT std::optional<QTime> parseTime(QByteArrayView text);
+
+/*!
+ * \brief parseDateTime parses \c YYYY-MM-DD[ HH:MM:SS[.ffffff][+TZ]] without allocating
+ *
+ * Values with a zone, as \c timestamptz is sent, get that offset from UTC, the others
+ * are local time like the generic ISO parser does.
+ */
+ASQL_PG_EXPORT std::optional<QDateTime> parseDateTime(QByteArrayView text);
+
+} // namespace ASql::PgTypes
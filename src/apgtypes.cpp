@@ -0,0 +1,1481 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "apgtypes.h"
+
+#include "apgtemporal.h"
+
+#include <bit>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocale>
+#include <QLoggingCategory>
+#include <QStringEncoder>
+#include <QTimeZone>
+#include <QtEndian>
+
+Q_DECLARE_LOGGING_CATEGORY(ASQL_PG)
+
+using namespace ASql;
+using namespace Qt::StringLiterals;
+
+namespace {
+
+// 2000-01-01, the epoch used by the binary date/time types
+constexpr qint64 POSTGRES_EPOCH_JDATE = 2451545;
+constexpr qint64 POSTGRES_EPOCH_MSECS = 946684800000;
+constexpr qint64 USECS_PER_DAY        = 86400000000;
+constexpr quint16 NUMERIC_NEG         = 0x4000;
+constexpr quint16 NUMERIC_NAN         = 0xC000;
+constexpr quint16 NUMERIC_PINF        = 0xD000;
+constexpr quint16 NUMERIC_NINF        = 0xF000;
+constexpr int NUMERIC_HEADER_SIZE     = 8;
+constexpr char JSONB_BINARY_VERSION   = 1;
+
+struct NumericHeader {
+    qint16 ndigits;
+    qint16 weight;
+    quint16 sign;
+    qint16 dscale;
+};
+
+inline qint64 floorDiv(qint64 a, qint64 b)
+{
+    const qint64 q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+bool readNumericHeader(const PgTypes::Value &v, NumericHeader &h)
+{
+    if (v.length < NUMERIC_HEADER_SIZE) {
+        return false;
+    }
+    h.ndigits = qFromBigEndian<qint16>(v.data);
+    h.weight  = qFromBigEndian<qint16>(v.data + 2);
+    h.sign    = qFromBigEndian<quint16>(v.data + 4);
+    h.dscale  = qFromBigEndian<qint16>(v.data + 6);
+    return h.ndigits >= 0 && v.length >= NUMERIC_HEADER_SIZE + h.ndigits * 2;
+}
+
+inline qint16 numericDigit(const PgTypes::Value &v, const NumericHeader &h, int i)
+{
+    if (i < 0 || i >= h.ndigits) {
+        return 0;
+    }
+    return qFromBigEndian<qint16>(v.data + NUMERIC_HEADER_SIZE + i * 2);
+}
+
+double binaryNumericToDouble(const PgTypes::Value &v)
+{
+    NumericHeader h;
+    if (!readNumericHeader(v, h)) {
+        return 0;
+    }
+
+    switch (h.sign) {
+    case NUMERIC_NAN:
+        return qQNaN();
+    case NUMERIC_PINF:
+        return qInf();
+    case NUMERIC_NINF:
+        return -qInf();
+    default:
+        break;
+    }
+
+    double ret = 0;
+    for (int i = 0; i < h.ndigits; ++i) {
+        ret = ret * 10000 + numericDigit(v, h, i);
+    }
+    // dividing keeps fractional values correctly rounded, e.g. 123456789 / 10^4
+    const int exponent = h.weight - h.ndigits + 1;
+    if (exponent < 0) {
+        ret /= std::pow(10000.0, -exponent);
+    } else if (exponent > 0) {
+        ret *= std::pow(10000.0, exponent);
+    }
+    return h.sign == NUMERIC_NEG ? -ret : ret;
+}
+
+QByteArray binaryNumericToText(const PgTypes::Value &v)
+{
+    NumericHeader h;
+    if (!readNumericHeader(v, h)) {
+        return {};
+    }
+
+    switch (h.sign) {
+    case NUMERIC_NAN:
+        return "NaN"_ba;
+    case NUMERIC_PINF:
+        return "Infinity"_ba;
+    case NUMERIC_NINF:
+        return "-Infinity"_ba;
+    default:
+        break;
+    }
+
+    auto appendGroup = [](QByteArray &out, qint16 digit) {
+        const char group[4] = {char('0' + digit / 1000),
+                               char('0' + digit / 100 % 10),
+                               char('0' + digit / 10 % 10),
+                               char('0' + digit % 10)};
+        out.append(group, 4);
+    };
+
+    QByteArray out;
+    out.reserve((qMax<int>(h.weight, 0) + 2) * 4 + h.dscale + 2);
+    if (h.sign == NUMERIC_NEG) {
+        out.append('-');
+    }
+
+    if (h.weight < 0) {
+        out.append('0');
+    } else {
+        out.append(QByteArray::number(numericDigit(v, h, 0)));
+        for (int i = 1; i <= h.weight; ++i) {
+            appendGroup(out, numericDigit(v, h, i));
+        }
+    }
+
+    if (h.dscale > 0) {
+        out.append('.');
+        int written = 0;
+        for (int i = h.weight + 1; written < h.dscale; ++i) {
+            appendGroup(out, numericDigit(v, h, i));
+            written += 4;
+        }
+        out.chop(written - h.dscale);
+    }
+    return out;
+}
+
+qint64 binaryInteger(const PgTypes::Value &v);
+
+double binaryDouble(const PgTypes::Value &v)
+{
+    switch (v.oid) {
+    case QFLOAT4OID:
+        if (v.length == 4) {
+            return std::bit_cast<float>(qFromBigEndian<quint32>(v.data));
+        }
+        return 0;
+    case QFLOAT8OID:
+        if (v.length == 8) {
+            return std::bit_cast<double>(qFromBigEndian<quint64>(v.data));
+        }
+        return 0;
+    case QNUMERICOID:
+        return binaryNumericToDouble(v);
+    default:
+        return double(binaryInteger(v));
+    }
+}
+
+qint64 binaryInteger(const PgTypes::Value &v)
+{
+    switch (v.oid) {
+    case QBOOLOID:
+        return v.length == 1 && v.data[0] != 0;
+    case QREGPROCOID:
+    case QXIDOID:
+    case QCIDOID:
+        if (v.length == 4) {
+            return qFromBigEndian<quint32>(v.data);
+        }
+        return 0;
+    case QFLOAT4OID:
+    case QFLOAT8OID:
+    case QNUMERICOID:
+        return qint64(binaryDouble(v));
+    default:
+        break;
+    }
+
+    switch (v.length) {
+    case 2:
+        return qFromBigEndian<qint16>(v.data);
+    case 4:
+        return qFromBigEndian<qint32>(v.data);
+    case 8:
+        return qFromBigEndian<qint64>(v.data);
+    default:
+        return QByteArrayView(v.data, v.length).toLongLong();
+    }
+}
+
+QDate binaryDate(const PgTypes::Value &v)
+{
+    if (v.length != 4) {
+        return {};
+    }
+
+    const qint32 days = qFromBigEndian<qint32>(v.data);
+    if (days == std::numeric_limits<qint32>::max() || days == std::numeric_limits<qint32>::min()) {
+        // +/-infinity
+        return {};
+    }
+    return QDate::fromJulianDay(POSTGRES_EPOCH_JDATE + days);
+}
+
+QTime binaryTime(const PgTypes::Value &v)
+{
+    // time is int64 usecs since midnight, timetz appends an int32 zone offset which
+    // the text decoder also ignores
+    if (v.length < 8) {
+        return {};
+    }
+
+    const qint64 usecs = qFromBigEndian<qint64>(v.data);
+    return QTime::fromMSecsSinceStartOfDay(int(usecs / 1000));
+}
+
+QDateTime binaryDateTime(const PgTypes::Value &v)
+{
+    if (v.oid == QDATEOID) {
+        const QDate date = binaryDate(v);
+        return date.isValid() ? QDateTime(date, QTime(0, 0), QTimeZone::LocalTime) : QDateTime();
+    }
+
+    if (v.length != 8) {
+        return {};
+    }
+
+    const qint64 usecs = qFromBigEndian<qint64>(v.data);
+    if (usecs == std::numeric_limits<qint64>::max() ||
+        usecs == std::numeric_limits<qint64>::min()) {
+        // +/-infinity
+        return {};
+    }
+
+    if (v.oid == QTIMESTAMPTZOID) {
+        return QDateTime::fromMSecsSinceEpoch(POSTGRES_EPOCH_MSECS + floorDiv(usecs, 1000),
+                                              QTimeZone::UTC);
+    }
+
+    // timestamp without time zone is a wall clock value, like the text decoder
+    const qint64 days       = floorDiv(usecs, USECS_PER_DAY);
+    const qint64 usecsOfDay = usecs - days * USECS_PER_DAY;
+    return QDateTime(QDate::fromJulianDay(POSTGRES_EPOCH_JDATE + days),
+                     QTime::fromMSecsSinceStartOfDay(int(usecsOfDay / 1000)),
+                     QTimeZone::LocalTime);
+}
+
+bool isTextOid(Oid oid)
+{
+    switch (oid) {
+    case QTEXTOID:
+    case QNAMEOID:
+    case QBPCHAROID:
+    case QVARCHAROID:
+    case QXMLOID:
+    case QJSONOID:
+    case QUNKNOWNOID:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Returns the JSON document text without copying, the binary jsonb format is a
+// version byte followed by the text representation
+QByteArray jsonText(const PgTypes::Value &v)
+{
+    if (v.binary && v.oid == QJSONBOID && v.length > 0 && v.data[0] == JSONB_BINARY_VERSION) {
+        return QByteArray::fromRawData(v.data + 1, v.length - 1);
+    }
+    return QByteArray::fromRawData(v.data, v.length);
+}
+
+QByteArray binaryToText(const PgTypes::Value &v)
+{
+    switch (v.oid) {
+    case QBOOLOID:
+        return binaryInteger(v) ? "t"_ba : "f"_ba;
+    case QINT2OID:
+    case QINT4OID:
+    case QINT8OID:
+    case QREGPROCOID:
+    case QXIDOID:
+    case QCIDOID:
+        return QByteArray::number(binaryInteger(v));
+    case QFLOAT4OID:
+    case QFLOAT8OID:
+    {
+        const double number = binaryDouble(v);
+        if (qIsInf(number)) {
+            return number > 0 ? "Infinity"_ba : "-Infinity"_ba;
+        }
+        return QByteArray::number(number, 'g', QLocale::FloatingPointShortest);
+    }
+    case QNUMERICOID:
+        return binaryNumericToText(v);
+    case QUUIDOID:
+        return PgTypes::toUuid(v).toByteArray(QUuid::WithoutBraces);
+    case QDATEOID:
+        return binaryDate(v).toString(Qt::ISODate).toLatin1();
+    case QTIMEOID:
+    case QTIMETZOID:
+        return binaryTime(v).toString(Qt::ISODateWithMs).toLatin1();
+    case QTIMESTAMPOID:
+    case QTIMESTAMPTZOID:
+        return binaryDateTime(v).toString(Qt::ISODateWithMs).toLatin1();
+    case QBYTEAOID:
+        return "\\x" + QByteArray::fromRawData(v.data, v.length).toHex();
+    case QJSONBOID:
+        return jsonText(v);
+    default:
+        return QByteArray::fromRawData(v.data, v.length);
+    }
+}
+
+Oid arrayElementOid(Oid array)
+{
+    switch (array) {
+    case QBOOLARRAYOID:
+        return QBOOLOID;
+    case QBYTEAARRAYOID:
+        return QBYTEAOID;
+    case QINT2ARRAYOID:
+        return QINT2OID;
+    case QINT4ARRAYOID:
+        return QINT4OID;
+    case QINT8ARRAYOID:
+        return QINT8OID;
+    case QFLOAT4ARRAYOID:
+        return QFLOAT4OID;
+    case QFLOAT8ARRAYOID:
+        return QFLOAT8OID;
+    case QNUMERICARRAYOID:
+        return QNUMERICOID;
+    case QUUIDARRAYOID:
+        return QUUIDOID;
+    case QDATEARRAYOID:
+        return QDATEOID;
+    case QTIMEARRAYOID:
+        return QTIMEOID;
+    case QTIMESTAMPARRAYOID:
+        return QTIMESTAMPOID;
+    case QTIMESTAMPTZARRAYOID:
+        return QTIMESTAMPTZOID;
+    case QJSONARRAYOID:
+        return QJSONOID;
+    case QJSONBARRAYOID:
+        return QJSONBOID;
+    default:
+        // text, varchar, name and types without a decoder
+        return QTEXTOID;
+    }
+}
+
+inline QVariant nullElement(Oid element)
+{
+    return QVariant(PgTypes::metaTypeForOid(element), nullptr);
+}
+
+// Parses the text array literal at \p it, which must point to its opening brace
+bool parseTextArray(const char *&it,
+                    const char *end,
+                    Oid element,
+                    QByteArray &scratch,
+                    QVariantList &out)
+{
+    ++it;
+    if (it < end && *it == '}') {
+        ++it;
+        return true;
+    }
+
+    while (it < end) {
+        if (*it == '{') {
+            QVariantList nested;
+            if (!parseTextArray(it, end, element, scratch, nested)) {
+                return false;
+            }
+            out.append(QVariant(std::move(nested)));
+        } else if (*it == '"') {
+            scratch.resize(0);
+            ++it;
+            while (it < end && *it != '"') {
+                if (*it == '\\' && it + 1 < end) {
+                    ++it;
+                }
+                scratch.append(*it++);
+            }
+            if (it == end) {
+                return false;
+            }
+            ++it;
+            out.append(PgTypes::toVariant({element, scratch.constData(), int(scratch.size()), false}));
+        } else {
+            const char *begin = it;
+            while (it < end && *it != ',' && *it != '}') {
+                ++it;
+            }
+
+            const QByteArrayView token(begin, it - begin);
+            if (token == "NULL") {
+                out.append(nullElement(element));
+            } else {
+                // Scalar decoders expect a NUL terminated value
+                scratch.resize(0);
+                scratch.append(token);
+                out.append(
+                    PgTypes::toVariant({element, scratch.constData(), int(scratch.size()), false}));
+            }
+        }
+
+        if (it < end && *it == ',') {
+            ++it;
+        } else if (it < end && *it == '}') {
+            ++it;
+            return true;
+        } else {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool parseBinaryArray(const char *&it,
+                      const char *end,
+                      Oid element,
+                      const qint32 *dims,
+                      int ndim,
+                      QVariantList &out)
+{
+    out.reserve(dims[0]);
+    for (qint32 i = 0; i < dims[0]; ++i) {
+        if (ndim > 1) {
+            QVariantList nested;
+            if (!parseBinaryArray(it, end, element, dims + 1, ndim - 1, nested)) {
+                return false;
+            }
+            out.append(QVariant(std::move(nested)));
+            continue;
+        }
+
+        if (end - it < 4) {
+            return false;
+        }
+        const qint32 length = qFromBigEndian<qint32>(it);
+        it += 4;
+        if (length == -1) {
+            out.append(nullElement(element));
+        } else if (length < 0 || end - it < length) {
+            return false;
+        } else {
+            out.append(PgTypes::toVariant({element, it, length, true}));
+            it += length;
+        }
+    }
+    return true;
+}
+
+void appendCopyEscaped(QByteArray &out, QByteArrayView text)
+{
+    // copy runs of plain characters at once, only a few need escaping
+    qsizetype start = 0;
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        char escaped;
+        switch (text[i]) {
+        case '\\':
+            escaped = '\\';
+            break;
+        case '\t':
+            escaped = 't';
+            break;
+        case '\n':
+            escaped = 'n';
+            break;
+        case '\r':
+            escaped = 'r';
+            break;
+        default:
+            continue;
+        }
+        out.append(text.data() + start, i - start);
+        out.append('\\');
+        out.append(escaped);
+        start = i + 1;
+    }
+    out.append(text.data() + start, text.size() - start);
+}
+
+} // namespace
+
+QMetaType PgTypes::metaTypeForOid(Oid oid)
+{
+    int type = QMetaType::UnknownType;
+    switch (oid) {
+    case QBOOLOID:
+        type = QMetaType::Bool;
+        break;
+    case QINT8OID:
+        type = QMetaType::LongLong;
+        break;
+    case QINT2OID:
+    case QINT4OID:
+    case QOIDOID:
+    case QREGPROCOID:
+    case QXIDOID:
+    case QCIDOID:
+        type = QMetaType::Int;
+        break;
+    case QNUMERICOID:
+    case QFLOAT4OID:
+    case QFLOAT8OID:
+        type = QMetaType::Double;
+        break;
+    case QABSTIMEOID:
+    case QRELTIMEOID:
+    case QDATEOID:
+        type = QMetaType::QDate;
+        break;
+    case QTIMEOID:
+    case QTIMETZOID:
+        type = QMetaType::QTime;
+        break;
+    case QTIMESTAMPOID:
+    case QTIMESTAMPTZOID:
+        type = QMetaType::QDateTime;
+        break;
+    case QBYTEAOID:
+        type = QMetaType::QByteArray;
+        break;
+    case QJSONBOID:
+        [[fallthrough]];
+    case QJSONOID:
+        type = QMetaType::QJsonValue;
+        break;
+    case QUUIDOID:
+        type = QMetaType::QUuid;
+        break;
+    default:
+        type = QMetaType::QString;
+        break;
+    }
+    return QMetaType(type);
+}
+
+QByteArray PgTypes::decodeByteaText(const char *val, int length)
+{
+    if (length >= 2 && val[0] == '\\' && val[1] == 'x') {
+        return QByteArray::fromHex(QByteArray(val + 2, length - 2));
+    }
+
+    // PQunescapeBytea() needs a NUL terminated string
+    const QByteArray escaped(val, length);
+    size_t outLength    = 0;
+    unsigned char *data = PQunescapeBytea(
+        reinterpret_cast<const unsigned char *>(escaped.constData()), &outLength);
+    QByteArray decoded(reinterpret_cast<const char *>(data), int(outLength));
+    PQfreemem(data);
+    return decoded;
+}
+
+bool PgTypes::toBool(const Value &v)
+{
+    if (v.binary) {
+        return binaryInteger(v) != 0;
+    }
+    return v.length > 0 && v.data[0] == 't';
+}
+
+int PgTypes::toInt(const Value &v)
+{
+    if (v.binary) {
+        return int(binaryInteger(v));
+    }
+    return QByteArrayView(v.data, v.length).toInt();
+}
+
+qint64 PgTypes::toLongLong(const Value &v)
+{
+    if (v.binary) {
+        return binaryInteger(v);
+    }
+    return QByteArrayView(v.data, v.length).toLongLong();
+}
+
+quint64 PgTypes::toULongLong(const Value &v)
+{
+    if (v.binary) {
+        return quint64(binaryInteger(v));
+    }
+    return QByteArrayView(v.data, v.length).toULongLong();
+}
+
+double PgTypes::toDouble(const Value &v)
+{
+    if (v.binary) {
+        return binaryDouble(v);
+    }
+
+    const QByteArrayView text(v.data, v.length);
+    if (text.compare("Infinity", Qt::CaseInsensitive) == 0) {
+        return qInf();
+    }
+    if (text.compare("-Infinity", Qt::CaseInsensitive) == 0) {
+        return -qInf();
+    }
+    return text.toDouble();
+}
+
+QString PgTypes::toString(const Value &v)
+{
+    if (v.binary && !isTextOid(v.oid)) {
+        return QString::fromUtf8(binaryToText(v));
+    }
+    return QString::fromUtf8(v.data, v.length);
+}
+
+std::string PgTypes::toStdString(const Value &v)
+{
+    if (v.binary && !isTextOid(v.oid)) {
+        return binaryToText(v).toStdString();
+    }
+    return std::string(v.data, v.length);
+}
+
+QUuid PgTypes::toUuid(const Value &v)
+{
+    if (v.binary) {
+        if (v.length == 16) {
+            return QUuid::fromRfc4122(QByteArrayView(v.data, v.length));
+        }
+        return {};
+    }
+    return QUuid::fromString(QLatin1StringView(v.data, v.length));
+}
+
+QDate PgTypes::toDate(const Value &v)
+{
+    if (v.binary) {
+        if (v.oid == QDATEOID) {
+            return binaryDate(v);
+        }
+        return binaryDateTime(v).date();
+    }
+
+    if (v.length == 0) {
+        return {};
+    } else if (const auto date = parseDate(QByteArrayView(v.data, v.length))) {
+        return *date;
+    } else {
+#ifndef QT_NO_DATESTRING
+        return QDate::fromString(QString::fromLatin1(v.data, v.length), Qt::ISODate);
+#else
+        return {};
+#endif
+    }
+}
+
+QTime PgTypes::toTime(const Value &v)
+{
+    if (v.binary) {
+        if (v.oid == QTIMEOID || v.oid == QTIMETZOID) {
+            return binaryTime(v);
+        }
+        return binaryDateTime(v).time();
+    }
+
+    if (const auto time = parseTime(QByteArrayView(v.data, v.length))) {
+        return *time;
+    }
+
+    const QString str = QString::fromLatin1(v.data, v.length);
+#ifndef QT_NO_DATESTRING
+    if (str.isEmpty()) {
+        return {};
+    } else {
+        return QTime::fromString(str, Qt::ISODate);
+    }
+#else
+    return {};
+#endif
+}
+
+QDateTime PgTypes::toDateTime(const Value &v)
+{
+    if (v.binary) {
+        return binaryDateTime(v);
+    }
+
+    if (const auto dateTime = parseDateTime(QByteArrayView(v.data, v.length))) {
+        return *dateTime;
+    }
+
+    QString dtval = QString::fromLatin1(v.data, v.length);
+#ifndef QT_NO_DATESTRING
+    if (dtval.length() < 10) {
+        return {};
+    } else {
+        QChar sign = dtval[dtval.size() - 3];
+        if (sign == u'-' || sign == u'+') {
+            dtval += u":00";
+        }
+        return QDateTime::fromString(dtval, Qt::ISODate);
+    }
+#else
+    return {};
+#endif
+}
+
+QJsonValue PgTypes::toJsonValue(const Value &v)
+{
+    QJsonValue ret;
+    const auto doc = QJsonDocument::fromJson(jsonText(v));
+    if (doc.isObject()) {
+        ret = doc.object();
+    } else if (doc.isArray()) {
+        ret = doc.array();
+    }
+    return ret;
+}
+
+QByteArray PgTypes::toByteArray(const Value &v)
+{
+    if (v.oid == QBYTEAOID && !v.binary) {
+        return decodeByteaText(v.data, v.length);
+    }
+
+    if (v.oid == QJSONBOID) {
+        const QByteArray json = jsonText(v);
+        return QByteArray(json.constData(), json.size());
+    }
+    return QByteArray(v.data, v.length);
+}
+
+QVariant PgTypes::toVariant(const Value &v)
+{
+    const QMetaType type = metaTypeForOid(v.oid);
+    switch (type.id()) {
+    case QMetaType::Bool:
+        return QVariant(toBool(v));
+    case QMetaType::QString:
+        return toString(v);
+    case QMetaType::LongLong:
+        if (v.binary || (v.length > 0 && v.data[0] == '-')) {
+            return toLongLong(v);
+        } else {
+            return toULongLong(v);
+        }
+    case QMetaType::Int:
+        return toInt(v);
+    case QMetaType::Double:
+        return toDouble(v);
+    case QMetaType::QDate:
+        return toDate(v);
+    case QMetaType::QTime:
+        return toTime(v);
+    case QMetaType::QDateTime:
+        return toDateTime(v);
+    case QMetaType::QByteArray:
+        return toByteArray(v);
+    case QMetaType::QJsonValue:
+    {
+        const auto doc = QJsonDocument::fromJson(jsonText(v));
+        if (doc.isObject()) {
+            return doc.object();
+        } else if (doc.isArray()) {
+            return doc.array();
+        }
+        break;
+    }
+    case QMetaType::QUuid:
+        return toUuid(v);
+    default:
+    case QMetaType::UnknownType:
+        qWarning(ASQL_PG, "unknown data type");
+    }
+    return {};
+}
+
+QVariantList PgTypes::toList(const Value &v)
+{
+    QVariantList ret;
+    const char *it  = v.data;
+    const char *end = v.data + v.length;
+
+    if (v.binary) {
+        // ndim, has nulls flag, element type then size and lower bound of each dimension
+        constexpr int MAX_DIMS = 6;
+        if (v.length < 12) {
+            return {};
+        }
+        const qint32 ndim    = qFromBigEndian<qint32>(it);
+        const Oid element    = qFromBigEndian<quint32>(it + 8);
+        it                  += 12;
+        if (ndim < 0 || ndim > MAX_DIMS || end - it < ndim * 8) {
+            return {};
+        }
+        if (ndim == 0) {
+            return ret;
+        }
+
+        qint32 dims[MAX_DIMS];
+        for (int i = 0; i < ndim; ++i) {
+            dims[i]  = qFromBigEndian<qint32>(it);
+            it      += 8;
+            if (dims[i] < 0) {
+                return {};
+            }
+        }
+
+        if (!parseBinaryArray(it, end, element, dims, ndim, ret)) {
+            qWarning(ASQL_PG, "malformed binary array");
+            return {};
+        }
+        return ret;
+    }
+
+    // Skip the optional dimension decoration, e.g. [0:2]={1,2,3}
+    if (it < end && *it == '[') {
+        while (it < end && *it != '=') {
+            ++it;
+        }
+        ++it;
+    }
+
+    if (it >= end || *it != '{') {
+        return {};
+    }
+
+    QByteArray scratch;
+    if (!parseTextArray(it, end, arrayElementOid(v.oid), scratch, ret)) {
+        qWarning(ASQL_PG, "malformed array literal");
+        return {};
+    }
+    return ret;
+}
+
+void PgTypes::appendCopyText(QByteArray &out, const QVariant &value)
+{
+    if (value.isNull()) {
+        out.append("\\N", 2);
+        return;
+    }
+
+    switch (value.userType()) {
+    case QMetaType::Bool:
+        out.append(value.toBool() ? 't' : 'f');
+        break;
+    case QMetaType::Int:
+    case QMetaType::LongLong:
+    case QMetaType::Short:
+        out.append(QByteArray::number(value.toLongLong()));
+        break;
+    case QMetaType::UInt:
+    case QMetaType::ULongLong:
+    case QMetaType::UShort:
+        out.append(QByteArray::number(value.toULongLong()));
+        break;
+    case QMetaType::Double:
+    case QMetaType::Float:
+    {
+        const double number = value.toDouble();
+        if (qIsInf(number)) {
+            out.append(number > 0 ? "Infinity"_ba : "-Infinity"_ba);
+        } else {
+            out.append(QByteArray::number(number, 'g', QLocale::FloatingPointShortest));
+        }
+    } break;
+    case QMetaType::QByteArray:
+        // bytea hex format, the backslash itself needs escaping
+        out.append("\\\\x", 3);
+        out.append(value.toByteArray().toHex());
+        break;
+    case QMetaType::QUuid:
+        out.append(value.toUuid().toByteArray(QUuid::WithoutBraces));
+        break;
+    case QMetaType::QDate:
+        out.append(value.toDate().toString(Qt::ISODate).toLatin1());
+        break;
+    case QMetaType::QTime:
+        out.append(value.toTime().toString(Qt::ISODateWithMs).toLatin1());
+        break;
+    case QMetaType::QDateTime:
+        out.append(value.toDateTime().toString(Qt::ISODateWithMs).toLatin1());
+        break;
+    case QMetaType::QJsonObject:
+        appendCopyEscaped(out, QJsonDocument(value.toJsonObject()).toJson(QJsonDocument::Compact));
+        break;
+    case QMetaType::QJsonArray:
+        appendCopyEscaped(out, QJsonDocument(value.toJsonArray()).toJson(QJsonDocument::Compact));
+        break;
+    case QMetaType::QJsonDocument:
+        appendCopyEscaped(out, value.toJsonDocument().toJson(QJsonDocument::Compact));
+        break;
+    case QMetaType::QString:
+    {
+        const QString text = value.toString();
+        if (text.isNull()) {
+            out.append("\\N", 2);
+        } else {
+            appendCopyEscaped(out, text.toUtf8());
+        }
+    } break;
+    default:
+        appendCopyEscaped(out, value.toString().toUtf8());
+    }
+}
+
+void PgTypes::appendCopyBinaryHeader(QByteArray &out)
+{
+    // Signature, flags and header extension length
+    out.append("PGCOPY\n\377\r\n\0", 11);
+    const qsizetype offset = out.size();
+    out.resize(offset + 8);
+    qToBigEndian<qint32>(0, out.data() + offset);
+    qToBigEndian<qint32>(0, out.data() + offset + 4);
+}
+
+void PgTypes::appendCopyBinaryRow(QByteArray &out, const Params &params)
+{
+    qsizetype offset = out.size();
+    out.resize(offset + 2);
+    qToBigEndian<qint16>(qint16(params.size()), out.data() + offset);
+
+    for (int i = 0; i < params.size(); ++i) {
+        const char *value = params.values()[i];
+        offset            = out.size();
+        if (!value) {
+            out.resize(offset + 4);
+            qToBigEndian<qint32>(-1, out.data() + offset);
+            continue;
+        }
+
+        // The binary form of jsonb is a version byte followed by the text
+        const bool jsonb = params.formats()[i] == 0 && params.types()[i] == QJSONBOID;
+        const int length = params.lengths()[i];
+        out.resize(offset + 4);
+        qToBigEndian<qint32>(jsonb ? length + 1 : length, out.data() + offset);
+        if (jsonb) {
+            out.append('\1');
+        }
+        out.append(value, length);
+    }
+}
+
+void PgTypes::appendCopyBinaryTrailer(QByteArray &out)
+{
+    const qsizetype offset = out.size();
+    out.resize(offset + 2);
+    qToBigEndian<qint16>(-1, out.data() + offset);
+}
+
+void PgTypes::Params::encode(const QVariantList &params, std::span<const Oid> declared)
+{
+    m_types.clear();
+    m_values.clear();
+    m_lengths.clear();
+    m_formats.clear();
+    m_offsets.clear();
+    m_arena.clear();
+
+    for (qsizetype i = 0; i < params.size(); ++i) {
+        const QVariant &v = params[i];
+        const Oid oid     = size_t(i) < declared.size() ? declared[i] : QUNKNOWNOID;
+        if (oid == QUNKNOWNOID) {
+            encodeValue(v);
+        } else if (!encodeAs(v, oid)) {
+            encodeValue(v);
+            conform(v, oid);
+        }
+    }
+
+    // The arena might have moved while growing, point to the values once it's done
+    for (qsizetype i = 0; i < m_offsets.size(); ++i) {
+        if (m_offsets[i] != -1) {
+            m_values[i] = m_arena.constData() + m_offsets[i];
+        }
+    }
+}
+
+qsizetype PgTypes::Params::dataSize() const
+{
+    return std::accumulate(m_lengths.cbegin(), m_lengths.cend(), qsizetype{0});
+}
+
+void PgTypes::Params::encodeValue(const QVariant &v)
+{
+    if (v.isNull()) {
+        addNull(QUNKNOWNOID);
+        return;
+    }
+
+    switch (v.userType()) {
+    case QMetaType::QString:
+    {
+        const auto &text = *static_cast<const QString *>(v.constData());
+        if (text.isNull()) {
+            addNull(QUNKNOWNOID);
+        } else {
+            addText(QTEXTOID, text);
+        }
+    } break;
+    case QMetaType::QByteArray:
+        addExternal(QBYTEAOID, *static_cast<const QByteArray *>(v.constData()));
+        break;
+    case QMetaType::Bool:
+        addBinary<quint8>(QBOOLOID, v.toBool() ? 1 : 0);
+        break;
+    case QMetaType::Short:
+        addBinary<qint16>(QINT2OID, qint16(v.toInt()));
+        break;
+    case QMetaType::UShort:
+    case QMetaType::Int:
+        addBinary<qint32>(QINT4OID, v.toInt());
+        break;
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+        addBinary<qint64>(QINT8OID, v.toLongLong());
+        break;
+    case QMetaType::ULongLong:
+        // Might not fit int8
+        addNumeric(v.toULongLong());
+        break;
+    case QMetaType::Float:
+        addBinary<quint32>(QFLOAT4OID, std::bit_cast<quint32>(v.toFloat()));
+        break;
+    case QMetaType::Double:
+        addBinary<quint64>(QFLOAT8OID, std::bit_cast<quint64>(v.toDouble()));
+        break;
+    case QMetaType::QDate:
+    {
+        const auto &date = *static_cast<const QDate *>(v.constData());
+        if (date.isValid()) {
+            addBinary<qint32>(QDATEOID, qint32(date.toJulianDay() - POSTGRES_EPOCH_JDATE));
+        } else {
+            addNull(QUNKNOWNOID);
+        }
+    } break;
+    case QMetaType::QTime:
+    {
+        const auto &time = *static_cast<const QTime *>(v.constData());
+        if (time.isValid()) {
+            addBinary<qint64>(QTIMEOID, qint64(time.msecsSinceStartOfDay()) * 1000);
+        } else {
+            addNull(QUNKNOWNOID);
+        }
+    } break;
+    case QMetaType::QDateTime:
+    {
+        const auto &dateTime = *static_cast<const QDateTime *>(v.constData());
+        if (!dateTime.isValid()) {
+            addNull(QUNKNOWNOID);
+        } else if (dateTime.timeRepresentation().timeSpec() == Qt::LocalTime) {
+            // A wall clock value, like the text decoder returns for timestamp columns
+            addTimestamp(QTIMESTAMPOID, dateTime);
+        } else {
+            addTimestamp(QTIMESTAMPTZOID, dateTime);
+        }
+    } break;
+    case QMetaType::QUuid:
+    {
+        const auto &uuid = *static_cast<const QUuid *>(v.constData());
+        char *data       = grow(16);
+        qToBigEndian<quint32>(uuid.data1, data);
+        qToBigEndian<quint16>(uuid.data2, data + 4);
+        qToBigEndian<quint16>(uuid.data3, data + 6);
+        memcpy(data + 8, uuid.data4, 8);
+        add(QUUIDOID, 1, m_arena.size() - 16, 16);
+    } break;
+    case QMetaType::QJsonObject:
+        addText(QJSONBOID, QJsonDocument(v.toJsonObject()).toJson(QJsonDocument::Compact));
+        break;
+    case QMetaType::QJsonArray:
+        addText(QJSONBOID, QJsonDocument(v.toJsonArray()).toJson(QJsonDocument::Compact));
+        break;
+    case QMetaType::QJsonDocument:
+        addText(QJSONBOID, v.toJsonDocument().toJson(QJsonDocument::Compact));
+        break;
+    case QMetaType::QJsonValue:
+    {
+        const QJsonValue jValue = v.toJsonValue();
+        switch (jValue.type()) {
+        case QJsonValue::Bool:
+            addBinary<quint8>(QBOOLOID, jValue.toBool() ? 1 : 0);
+            break;
+        case QJsonValue::Double:
+            // This allows PG to try to deduce the type
+            addText(QUNKNOWNOID, jValue.toVariant().toString());
+            break;
+        case QJsonValue::String:
+            addText(QTEXTOID, jValue.toString());
+            break;
+        case QJsonValue::Array:
+            addText(QJSONBOID, QJsonDocument(jValue.toArray()).toJson(QJsonDocument::Compact));
+            break;
+        case QJsonValue::Object:
+            addText(QJSONBOID, QJsonDocument(jValue.toObject()).toJson(QJsonDocument::Compact));
+            break;
+        default:
+            addNull(QUNKNOWNOID);
+        }
+    } break;
+    default:
+    {
+        if (addArray(v)) {
+            break;
+        }
+
+        // This allows PG to try to deduce the type
+        const QString text = v.toString();
+        if (text.isEmpty()) {
+            addNull(QUNKNOWNOID);
+        } else {
+            addText(QUNKNOWNOID, text);
+        }
+    }
+    }
+}
+
+bool PgTypes::Params::encodeAs(const QVariant &v, Oid oid)
+{
+    if (v.isNull()) {
+        addNull(oid);
+        return true;
+    }
+
+    const int type     = v.userType();
+    const bool integer = type == QMetaType::Int || type == QMetaType::UInt ||
+                         type == QMetaType::LongLong || type == QMetaType::ULongLong ||
+                         type == QMetaType::Short || type == QMetaType::UShort;
+    const bool number  = integer || type == QMetaType::Double || type == QMetaType::Float;
+
+    // Values out of range are left to the server to report
+    const auto fits = [&v, type]<typename T>(T) {
+        if (type == QMetaType::ULongLong) {
+            return v.toULongLong() <= quint64(std::numeric_limits<T>::max());
+        }
+        const qint64 value = v.toLongLong();
+        return value >= std::numeric_limits<T>::min() && value <= std::numeric_limits<T>::max();
+    };
+
+    switch (oid) {
+    case QINT2OID:
+        if (integer && fits(qint16{})) {
+            addBinary<qint16>(QINT2OID, qint16(v.toLongLong()));
+            return true;
+        }
+        break;
+    case QINT4OID:
+        if (integer && fits(qint32{})) {
+            addBinary<qint32>(QINT4OID, qint32(v.toLongLong()));
+            return true;
+        }
+        break;
+    case QINT8OID:
+        if (integer && fits(qint64{})) {
+            addBinary<qint64>(QINT8OID, v.toLongLong());
+            return true;
+        }
+        break;
+    case QFLOAT4OID:
+        if (number) {
+            addBinary<quint32>(QFLOAT4OID, std::bit_cast<quint32>(v.toFloat()));
+            return true;
+        }
+        break;
+    case QFLOAT8OID:
+        if (number) {
+            addBinary<quint64>(QFLOAT8OID, std::bit_cast<quint64>(v.toDouble()));
+            return true;
+        }
+        break;
+    case QTIMESTAMPOID:
+    case QTIMESTAMPTZOID:
+        if (type == QMetaType::QDateTime) {
+            const auto &dateTime = *static_cast<const QDateTime *>(v.constData());
+            if (dateTime.isValid()) {
+                addTimestamp(oid, dateTime);
+            } else {
+                addNull(oid);
+            }
+            return true;
+        }
+        break;
+    default:
+        break;
+    }
+    return false;
+}
+
+void PgTypes::Params::conform(const QVariant &v, Oid oid)
+{
+    const qsizetype last = m_types.size() - 1;
+    if (m_types[last] == oid || m_formats[last] == 0) {
+        // Null and text values are converted by the server
+        m_types[last] = oid;
+        return;
+    }
+
+    // A binary value of another type would be rejected or, worse, misread
+    if (!v.canConvert<QString>()) {
+        return;
+    }
+
+    m_types.resize(last);
+    m_values.resize(last);
+    m_lengths.resize(last);
+    m_formats.resize(last);
+    m_offsets.resize(last);
+    addText(oid, v.toString());
+}
+
+void PgTypes::Params::addNull(Oid oid)
+{
+    m_types.append(oid);
+    m_values.append(nullptr);
+    m_lengths.append(0);
+    m_formats.append(0);
+    m_offsets.append(-1);
+}
+
+void PgTypes::Params::addTimestamp(Oid oid, const QDateTime &dateTime)
+{
+    if (oid == QTIMESTAMPOID) {
+        // The wall clock time, an offset is ignored as the server does for text values
+        const qint64 days = dateTime.date().toJulianDay() - POSTGRES_EPOCH_JDATE;
+        addBinary<qint64>(QTIMESTAMPOID,
+                          days * USECS_PER_DAY +
+                              qint64(dateTime.time().msecsSinceStartOfDay()) * 1000);
+    } else {
+        addBinary<qint64>(QTIMESTAMPTZOID,
+                          (dateTime.toMSecsSinceEpoch() - POSTGRES_EPOCH_MSECS) * 1000);
+    }
+}
+
+void PgTypes::Params::addExternal(Oid oid, QByteArrayView data)
+{
+    m_types.append(oid);
+    m_values.append(data.data() ? data.data() : "");
+    m_lengths.append(int(data.size()));
+    m_formats.append(1);
+    m_offsets.append(-1);
+}
+
+void PgTypes::Params::addText(Oid oid, QStringView text)
+{
+    // Text values must be NUL terminated
+    QStringEncoder encoder(QStringEncoder::Utf8);
+    const qsizetype offset = m_arena.size();
+    const qsizetype space  = encoder.requiredSpace(text.size()) + 1;
+    char *begin            = grow(space);
+    char *end              = encoder.appendToBuffer(begin, text);
+    *end                   = '\0';
+    m_arena.resize(offset + (end - begin) + 1);
+    add(oid, 0, offset, int(end - begin));
+}
+
+void PgTypes::Params::addText(Oid oid, QByteArrayView utf8)
+{
+    const qsizetype offset = m_arena.size();
+    char *data             = grow(utf8.size() + 1);
+    memcpy(data, utf8.data(), utf8.size());
+    data[utf8.size()] = '\0';
+    add(oid, 0, offset, int(utf8.size()));
+}
+
+void PgTypes::Params::addNumeric(quint64 number)
+{
+    // Base 10000 digits, most significant first, trailing zeros are implied by the weight
+    quint16 digits[5];
+    int ndigits = 0;
+    int weight  = -1;
+    while (number) {
+        digits[ndigits++] = quint16(number % 10000);
+        number /= 10000;
+        ++weight;
+    }
+    int skip = 0;
+    while (skip < ndigits && digits[skip] == 0) {
+        ++skip;
+    }
+
+    const int count        = ndigits - skip;
+    const qsizetype offset = m_arena.size();
+    const int length       = NUMERIC_HEADER_SIZE + count * 2;
+    char *data             = grow(length);
+    qToBigEndian<qint16>(qint16(count), data);
+    qToBigEndian<qint16>(qint16(qMax(weight, 0)), data + 2);
+    qToBigEndian<quint16>(0, data + 4);
+    qToBigEndian<quint16>(0, data + 6);
+    for (int i = 0; i < count; ++i) {
+        qToBigEndian<quint16>(digits[ndigits - 1 - i], data + NUMERIC_HEADER_SIZE + i * 2);
+    }
+    add(QNUMERICOID, 1, offset, length);
+}
+
+template <typename T>
+void PgTypes::Params::addBinary(Oid oid, T number)
+{
+    const qsizetype offset = m_arena.size();
+    qToBigEndian<T>(number, grow(sizeof(T)));
+    add(oid, 1, offset, sizeof(T));
+}
+
+bool PgTypes::Params::addArray(const QVariant &v)
+{
+    return addArray<int>(v) || addArray<qint64>(v) || addArray<QString>(v) ||
+           addArray<QUuid>(v) || addArray<QByteArray>(v) || addArray<double>(v) ||
+           addArray<float>(v) || addArray<qint16>(v) || addArray<bool>(v);
+}
+
+template <typename T>
+bool PgTypes::Params::addArray(const QVariant &v)
+{
+    const QMetaType type = v.metaType();
+    if (type == QMetaType::fromType<QList<T>>()) {
+        const auto &list = *static_cast<const QList<T> *>(v.constData());
+        addArray(std::span<const T>(list.constData(), list.size()));
+        return true;
+    }
+
+    // std::vector<bool> is not contiguous
+    if constexpr (!std::is_same_v<T, bool>) {
+        if (type == QMetaType::fromType<std::vector<T>>()) {
+            addArray(std::span<const T>(*static_cast<const std::vector<T> *>(v.constData())));
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+void PgTypes::Params::addArray(std::span<const T> values)
+{
+    Oid element;
+    Oid array;
+    if constexpr (std::is_same_v<T, int>) {
+        element = QINT4OID;
+        array   = QINT4ARRAYOID;
+    } else if constexpr (std::is_same_v<T, qint64>) {
+        element = QINT8OID;
+        array   = QINT8ARRAYOID;
+    } else if constexpr (std::is_same_v<T, qint16>) {
+        element = QINT2OID;
+        array   = QINT2ARRAYOID;
+    } else if constexpr (std::is_same_v<T, bool>) {
+        element = QBOOLOID;
+        array   = QBOOLARRAYOID;
+    } else if constexpr (std::is_same_v<T, float>) {
+        element = QFLOAT4OID;
+        array   = QFLOAT4ARRAYOID;
+    } else if constexpr (std::is_same_v<T, double>) {
+        element = QFLOAT8OID;
+        array   = QFLOAT8ARRAYOID;
+    } else if constexpr (std::is_same_v<T, QString>) {
+        element = QTEXTOID;
+        array   = QTEXTARRAYOID;
+    } else if constexpr (std::is_same_v<T, QByteArray>) {
+        element = QBYTEAOID;
+        array   = QBYTEAARRAYOID;
+    } else {
+        static_assert(std::is_same_v<T, QUuid>);
+        element = QUUIDOID;
+        array   = QUUIDARRAYOID;
+    }
+
+    // ndim, has nulls flag, element type then size and lower bound of the single dimension,
+    // empty arrays have no dimensions
+    const qsizetype offset = m_arena.size();
+    const bool empty       = values.empty();
+    char *header           = grow(empty ? 12 : 20);
+    qToBigEndian<qint32>(empty ? 0 : 1, header);
+    qToBigEndian<qint32>(0, header + 4);
+    qToBigEndian<quint32>(element, header + 8);
+    if (!empty) {
+        qToBigEndian<qint32>(qint32(values.size()), header + 12);
+        qToBigEndian<qint32>(1, header + 16);
+    }
+
+    bool hasNulls = false;
+    for (const T &value : values) {
+        hasNulls |= !appendElement(value);
+    }
+    if (hasNulls) {
+        qToBigEndian<qint32>(1, m_arena.data() + offset + 4);
+    }
+
+    add(array, 1, offset, int(m_arena.size() - offset));
+}
+
+bool PgTypes::Params::appendElement(const QString &value)
+{
+    if (value.isNull()) {
+        qToBigEndian<qint32>(-1, grow(4));
+        return false;
+    }
+
+    QStringEncoder encoder(QStringEncoder::Utf8);
+    const qsizetype offset = m_arena.size();
+    char *begin            = grow(4 + encoder.requiredSpace(value.size())) + 4;
+    char *end              = encoder.appendToBuffer(begin, value);
+    const auto length      = qint32(end - begin);
+    m_arena.resize(offset + 4 + length);
+    qToBigEndian<qint32>(length, m_arena.data() + offset);
+    return true;
+}
+
+bool PgTypes::Params::appendElement(const QByteArray &value)
+{
+    char *data = grow(4 + value.size());
+    qToBigEndian<qint32>(qint32(value.size()), data);
+    memcpy(data + 4, value.constData(), value.size());
+    return true;
+}
+
+bool PgTypes::Params::appendElement(const QUuid &value)
+{
+    char *data = grow(20);
+    qToBigEndian<qint32>(16, data);
+    qToBigEndian<quint32>(value.data1, data + 4);
+    qToBigEndian<quint16>(value.data2, data + 8);
+    qToBigEndian<quint16>(value.data3, data + 10);
+    memcpy(data + 12, value.data4, 8);
+    return true;
+}
+
+template <typename T>
+bool PgTypes::Params::appendElement(T value)
+{
+    char *data = grow(4 + sizeof(T));
+    qToBigEndian<qint32>(qint32(sizeof(T)), data);
+    if constexpr (std::is_same_v<T, bool>) {
+        data[4] = value ? 1 : 0;
+    } else if constexpr (std::is_same_v<T, double>) {
+        qToBigEndian<quint64>(std::bit_cast<quint64>(value), data + 4);
+    } else if constexpr (std::is_same_v<T, float>) {
+        qToBigEndian<quint32>(std::bit_cast<quint32>(value), data + 4);
+    } else {
+        qToBigEndian<T>(value, data + 4);
+    }
+    return true;
+}
+
+char *PgTypes::Params::grow(qsizetype size)
+{
+    const qsizetype offset = m_arena.size();
+    m_arena.resize(offset + size);
+    return m_arena.data() + offset;
+}
+
+void PgTypes::Params::add(Oid oid, int format, qsizetype offset, int length)
+{
+    m_types.append(oid);
+    m_values.append(nullptr);
+    m_lengths.append(length);
+    m_formats.append(format);
+    m_offsets.append(offset);
+}
@@ -0,0 +1,207 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <libpq-fe.h>
+#include <span>
+#include <string>
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QJsonValue>
+#include <QMetaType>
+#include <QString>
+#include <QUuid>
+#include <QVarLengthArray>
+#include <QVariant>
+
+// workaround for postgres defining their OIDs in a private header file
+#define QBOOLOID 16
+#define QINT8OID 20
+#define QINT2OID 21
+#define QINT4OID 23
+#define QTEXTOID 25
+#define QNAMEOID 19
+#define QBPCHAROID 1042
+#define QVARCHAROID 1043
+#define QXMLOID 142
+#define QNUMERICOID 1700
+#define QFLOAT4OID 700
+#define QFLOAT8OID 701
+#define QABSTIMEOID 702
+#define QRELTIMEOID 703
+#define QUNKNOWNOID 705
+#define QDATEOID 1082
+#define QTIMEOID 1083
+#define QTIMETZOID 1266
+#define QTIMESTAMPOID 1114
+#define QTIMESTAMPTZOID 1184
+#define QOIDOID 2278
+#define QBYTEAOID 17
+#define QREGPROCOID 24
+#define QXIDOID 28
+#define QCIDOID 29
+#define QJSONOID 114
+#define QJSONBOID 3802
+#define QUUIDOID 2950
+#define QBITOID 1560
+#define QVARBITOID 1562
+#define QBOOLARRAYOID 1000
+#define QBYTEAARRAYOID 1001
+#define QINT2ARRAYOID 1005
+#define QINT4ARRAYOID 1007
+#define QTEXTARRAYOID 1009
+#define QINT8ARRAYOID 1016
+#define QFLOAT4ARRAYOID 1021
+#define QFLOAT8ARRAYOID 1022
+#define QUUIDARRAYOID 2951
+#define QNAMEARRAYOID 1003
+#define QBPCHARARRAYOID 1014
+#define QVARCHARARRAYOID 1015
+#define QDATEARRAYOID 1182
+#define QTIMEARRAYOID 1183
+#define QTIMESTAMPARRAYOID 1115
+#define QTIMESTAMPTZARRAYOID 1185
+#define QNUMERICARRAYOID 1231
+#define QJSONARRAYOID 199
+#define QJSONBARRAYOID 3807
+
+#define VARHDRSZ 4
+
+namespace ASql::PgTypes {
+
+/*!
+ * \brief Column values as returned by the server, \c binary tells if the value
+ * is in the binary wire format (PQfformat() == 1) or in text format.
+ *
+ * Values are not required to be NUL terminated, decoders only read \c length bytes
+ * so that they can point straight into a receive buffer.
+ */
+struct Value {
+    Oid oid;
+    const char *data;
+    int length;
+    bool binary;
+};
+
+QMetaType metaTypeForOid(Oid oid);
+
+QByteArray decodeByteaText(const char *val, int length);
+
+bool toBool(const Value &v);
+int toInt(const Value &v);
+qint64 toLongLong(const Value &v);
+quint64 toULongLong(const Value &v);
+double toDouble(const Value &v);
+QString toString(const Value &v);
+std::string toStdString(const Value &v);
+QUuid toUuid(const Value &v);
+QDate toDate(const Value &v);
+QTime toTime(const Value &v);
+QDateTime toDateTime(const Value &v);
+QJsonValue toJsonValue(const Value &v);
+QByteArray toByteArray(const Value &v);
+QVariant toVariant(const Value &v);
+
+/*!
+ * \brief toList decodes an array in text or binary format, elements are decoded
+ * with toVariant() and nested arrays are returned as nested lists
+ */
+QVariantList toList(const Value &v);
+
+/*!
+ * \brief Params encodes query parameters into the arrays expected by libpq
+ *
+ * All encoded values are stored in an arena owned by this object, which is meant
+ * to be reused by every query of a connection, once the buffers have grown to fit
+ * the usual parameters encoding does not allocate. Values are only valid until the
+ * next call to encode().
+ *
+ * Numbers, booleans, UUIDs, bytea and date/time types are sent in binary with their
+ * exact OID, QByteArray data is not copied. QList<T> and std::vector<T> of these
+ * (except date/time types) and of QString are sent as binary arrays.
+ *
+ * When the parameter types of a prepared statement are known, integers, floating
+ * point numbers and timestamps are converted to the binary form of the declared type,
+ * other values that would not match it are sent as text for the server to convert.
+ */
+class Params
+{
+public:
+    void encode(const QVariantList &params, std::span<const Oid> declared = {});
+
+    [[nodiscard]] int size() const { return int(m_types.size()); }
+    [[nodiscard]] const Oid *types() const { return m_types.constData(); }
+    [[nodiscard]] const char *const *values() const { return m_values.constData(); }
+    [[nodiscard]] const int *lengths() const { return m_lengths.constData(); }
+    [[nodiscard]] const int *formats() const { return m_formats.constData(); }
+
+    /*!
+     * \brief dataSize returns the size of the encoded values
+     */
+    [[nodiscard]] qsizetype dataSize() const;
+
+private:
+    void encodeValue(const QVariant &v);
+    bool encodeAs(const QVariant &v, Oid oid);
+    void conform(const QVariant &v, Oid oid);
+    void addNull(Oid oid);
+    void addTimestamp(Oid oid, const QDateTime &dateTime);
+    void addExternal(Oid oid, QByteArrayView data);
+    void addText(Oid oid, QStringView text);
+    void addText(Oid oid, QByteArrayView utf8);
+    void addNumeric(quint64 number);
+    template <typename T>
+    void addBinary(Oid oid, T number);
+    bool addArray(const QVariant &v);
+    template <typename T>
+    bool addArray(const QVariant &v);
+    template <typename T>
+    void addArray(std::span<const T> values);
+    bool appendElement(const QString &value);
+    bool appendElement(const QByteArray &value);
+    bool appendElement(const QUuid &value);
+    template <typename T>
+    bool appendElement(T value);
+    char *grow(qsizetype size);
+    void add(Oid oid, int format, qsizetype offset, int length);
+
+    QVarLengthArray<Oid, 16> m_types;
+    QVarLengthArray<const char *, 16> m_values;
+    QVarLengthArray<int, 16> m_lengths;
+    QVarLengthArray<int, 16> m_formats;
+    // Offset in the arena of each value, -1 for null or external values
+    QVarLengthArray<qsizetype, 16> m_offsets;
+    QVarLengthArray<char, 1024> m_arena;
+};
+
+/*!
+ * \brief appendCopyText appends \p value to \p out as a COPY text format field
+ */
+void appendCopyText(QByteArray &out, const QVariant &value);
+
+/*!
+ * \brief appendCopyBinaryHeader appends the signature and empty header extension
+ * that start a COPY binary format stream
+ */
+void appendCopyBinaryHeader(QByteArray &out);
+
+/*!
+ * \brief appendCopyBinaryRow appends the values encoded by \p params as a COPY
+ * binary format tuple
+ *
+ * Values keep the representation Params picked for them as query parameters, so
+ * their types must match the columns exactly, e.g. an \c int goes to an \c int4
+ * column. Values Params sends as text are written as such, which text, varchar,
+ * json and jsonb columns accept.
+ */
+void appendCopyBinaryRow(QByteArray &out, const Params &params);
+
+/*!
+ * \brief appendCopyBinaryTrailer appends the marker that ends a COPY binary format stream
+ */
+void appendCopyBinaryTrailer(QByteArray &out);
+
+} // namespace ASql::PgTypes
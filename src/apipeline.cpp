@@ -0,0 +1,49 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "apipeline.h"
+
+using namespace ASql;
+
+APipeline &APipeline::exec(QStringView query, const QVariantList &params)
+{
+    m_statements.emplace_back(Statement{
+        .query  = query.toString(),
+        .params = params,
+    });
+    return *this;
+}
+
+APipeline &APipeline::exec(const APreparedQuery &query, const QVariantList &params)
+{
+    m_statements.emplace_back(Statement{
+        .preparedQuery = query,
+        .params        = params,
+    });
+    return *this;
+}
+
+qsizetype APipeline::size() const
+{
+    return qsizetype(m_statements.size());
+}
+
+bool APipeline::isEmpty() const
+{
+    return m_statements.empty();
+}
+
+void APipeline::clear()
+{
+    m_statements.clear();
+}
+
+QString APipelineResult::errorString() const
+{
+    if (m_failedIndex == -1) {
+        return {};
+    }
+    return m_results[size_t(m_failedIndex)].error();
+}
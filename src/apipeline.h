@@ -0,0 +1,115 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <apreparedquery.h>
+#include <aresult.h>
+#include <asql_export.h>
+#include <expected>
+#include <optional>
+#include <vector>
+
+#include <QVariantList>
+
+namespace ASql {
+
+/*!
+ * \brief APipeline collects queries that are sent together and awaited as one
+ *
+ * The queries are only sent once the pipeline is executed by ADatabase::exec(),
+ * so the same object can be executed many times and on different connections.
+ *
+ * \code
+ * APipeline pipeline;
+ * pipeline.exec(u"INSERT INTO log (msg) VALUES ($1)", {msg})
+ *     .exec(u"UPDATE counters SET hits = hits + 1");
+ * auto results = co_await db.exec(pipeline);
+ * if (results && !results->hasError()) { ... }
+ * \endcode
+ *
+ * On Postgres the queries are sent back to back in pipeline mode followed by a
+ * single sync, so the whole pipeline takes one round trip. Drivers without
+ * pipelining send them one after the other.
+ */
+class ASQL_EXPORT APipeline
+{
+public:
+    /*!
+     * \brief exec appends \p query with its \p params to the pipeline
+     */
+    APipeline &exec(QStringView query, const QVariantList &params = {});
+
+    /*!
+     * \brief exec appends the prepared \p query with its \p params to the pipeline
+     */
+    APipeline &exec(const APreparedQuery &query, const QVariantList &params = {});
+
+    [[nodiscard]] qsizetype size() const;
+
+    [[nodiscard]] bool isEmpty() const;
+
+    void clear();
+
+private:
+    friend class ADatabase;
+    struct Statement {
+        QString query;
+        std::optional<APreparedQuery> preparedQuery;
+        QVariantList params;
+    };
+    std::vector<Statement> m_statements;
+};
+
+/*!
+ * \brief APipelineResult holds the results of the queries of an APipeline, in the
+ * order they were added
+ *
+ * When a query fails in a pipeline sent with a single sync, the server skips the
+ * queries after it, they fail with a "Pipeline aborted" error, and as the pipeline
+ * runs in an implicit transaction the queries before it are rolled back as well,
+ * unless a transaction was already running. aborted() tells this happened.
+ */
+class ASQL_EXPORT APipelineResult
+{
+public:
+    using Result = std::expected<AResult, QString>;
+
+    [[nodiscard]] qsizetype size() const { return qsizetype(m_results.size()); }
+
+    [[nodiscard]] const Result &at(qsizetype index) const { return m_results[size_t(index)]; }
+    [[nodiscard]] const Result &operator[](qsizetype index) const { return at(index); }
+
+    [[nodiscard]] std::vector<Result>::const_iterator begin() const { return m_results.begin(); }
+    [[nodiscard]] std::vector<Result>::const_iterator end() const { return m_results.end(); }
+
+    /*!
+     * \brief hasError returns true if any query failed
+     */
+    [[nodiscard]] bool hasError() const { return m_failedIndex != -1; }
+
+    /*!
+     * \brief failedIndex returns the index of the first query that failed, or -1
+     */
+    [[nodiscard]] qsizetype failedIndex() const { return m_failedIndex; }
+
+    /*!
+     * \brief errorString returns the error of the first query that failed
+     */
+    [[nodiscard]] QString errorString() const;
+
+    /*!
+     * \brief aborted returns true if a query failed in a pipeline sent with a single
+     * sync, which aborts it, otherwise the queries succeed or fail on their own
+     */
+    [[nodiscard]] bool aborted() const { return m_synced && hasError(); }
+
+private:
+    friend class ADatabase;
+    std::vector<Result> m_results;
+    qsizetype m_failedIndex = -1;
+    bool m_synced           = false;
+};
+
+} // namespace ASql
@@ -11,16 +11,23 @@
 #include "apreparedquery.h"
 #include "atransaction.h"
 
+#include <algorithm>
 #include <expected>
+#include <optional>
+#include <queue>
+#include <tuple>
 
 #include <QLoggingCategory>
 #include <QObject>
 #include <QPointer>
-#include <queue>
+#include <QRandomGenerator>
+#include <QTimer>
+#include <QVarLengthArray>
 
 Q_LOGGING_CATEGORY(ASQL_POOL, "asql.pool", QtInfoMsg)
 
 using namespace ASql;
+using namespace std::chrono;
 
 struct APoolQueuedClient {
     ADatabaseFn cb;
@@ -28,32 +35,159 @@ struct APoolQueuedClient {
     bool checkReceiver;
 };
 
+struct APoolEndpointState {
+    APoolEndpoint endpoint;
+    steady_clock::time_point downUntil;
+    int failures = 0;
+};
+
 struct APoolInternal {
     QString name;
-    std::shared_ptr<ADriverFactory> driverFactory;
+    std::vector<APoolEndpointState> endpoints;
+    QHash<ADriver *, int> driverEndpoints;
     QVector<ADriver *> pool;
     std::queue<APoolQueuedClient> connectionQueue;
     APoolHookFn setupHook;
     APoolHookFn reuseHook;
-    int maxIdleConnections = 1;
-    int maximuConnections  = 10;
-    int connectionCount    = 0;
+    std::chrono::milliseconds queryTimeout{0};
+    std::chrono::milliseconds connectSpread{0};
+    std::optional<steady_clock::time_point> lastFailure;
+    ADatabase::QueueOverflow queueOverflow = ADatabase::QueueOverflow::Fail;
+    int maxQueueSize                       = 0;
+    int maxQueuedClients                   = 0;
+    int maxIdleConnections                 = 1;
+    int maximuConnections                  = 10;
+    int connectionCount                    = 0;
+
+    void release(ADriver *driver)
+    {
+        driverEndpoints.remove(driver);
+        driver->deleteLater();
+        --connectionCount;
+    }
 };
 
 static thread_local QHash<QStringView, APoolInternal> m_connectionPool;
 
+namespace {
+
+constexpr milliseconds endpointBackoff{1000};
+constexpr milliseconds endpointMaxBackoff{30000};
+
+/*!
+ * \brief selectEndpoint returns the endpoint for a new connection, available
+ * primaries come first, then available standbys, both by least in-flight queries,
+ * if every endpoint is down the one that recovers first is tried
+ */
+int selectEndpoint(const APoolInternal &iPool, const QList<int> &tried)
+{
+    const auto now = steady_clock::now();
+
+    QVarLengthArray<int, 8> inFlight(qsizetype(iPool.endpoints.size()), 0);
+    QVarLengthArray<int, 8> connections(qsizetype(iPool.endpoints.size()), 0);
+    for (const auto &[driver, endpoint] : iPool.driverEndpoints.asKeyValueRange()) {
+        inFlight[endpoint] += driver->queueSize();
+        ++connections[endpoint];
+    }
+
+    int selected = -1;
+    std::tuple<bool, APoolEndpoint::Role, steady_clock::time_point, int, int> selectedKey;
+    for (int i = 0; i < int(iPool.endpoints.size()); ++i) {
+        if (tried.contains(i)) {
+            continue;
+        }
+
+        const APoolEndpointState &state = iPool.endpoints[i];
+        const bool down                 = now < state.downUntil;
+        const auto key                  = std::make_tuple(down,
+                                         state.endpoint.role,
+                                         down ? state.downUntil : steady_clock::time_point{},
+                                         inFlight[i],
+                                         connections[i]);
+        if (selected == -1 || key < selectedKey) {
+            selected    = i;
+            selectedKey = key;
+        }
+    }
+    return selected;
+}
+
+void markEndpointDown(APoolInternal &iPool, int endpoint, const QString &error)
+{
+    const auto now    = steady_clock::now();
+    iPool.lastFailure = now;
+
+    APoolEndpointState &state = iPool.endpoints[endpoint];
+    if (now < state.downUntil) {
+        return;
+    }
+
+    // Full jitter keeps connections lost at once from retrying at once
+    ++state.failures;
+    const auto backoff =
+        std::min(endpointMaxBackoff, endpointBackoff * (1LL << std::min(state.failures - 1, 5)));
+    const auto delay =
+        backoff / 2 + milliseconds{QRandomGenerator::global()->bounded(qint64(backoff.count() / 2))};
+    state.downUntil = now + delay;
+
+    if (iPool.endpoints.size() > 1) {
+        qWarning(ASQL_POOL) << "Database endpoint down" << iPool.name << endpoint << "for" << delay
+                            << error;
+    }
+}
+
+void markEndpointUp(APoolInternal &iPool, int endpoint)
+{
+    APoolEndpointState &state = iPool.endpoints[endpoint];
+    state.failures            = 0;
+    state.downUntil           = {};
+}
+
+milliseconds connectDelay(const APoolInternal &iPool)
+{
+    if (iPool.connectSpread <= 0ms || !iPool.lastFailure ||
+        steady_clock::now() - *iPool.lastFailure > iPool.connectSpread) {
+        return 0ms;
+    }
+    return milliseconds{QRandomGenerator::global()->bounded(qint64(iPool.connectSpread.count()))};
+}
+
+} // namespace
+
+namespace ASql {
+
 struct PoolOpenDelivery : ACoroOpenData {
     std::shared_ptr<PoolOpenDelivery> self;
     std::shared_ptr<ACoroData<ADatabase>> coroData;
     ADatabase db;
     QString poolName;
     APoolHookFn setupHook;
+    QPointer<QObject> receiver;
+    bool checkReceiver = false;
+    int endpoint       = 0;
+    QList<int> triedEndpoints;
 
     void deliverOpen(bool isOpen, const QString &error) override
     {
         const auto keepAlive = std::move(self);
 
+        auto it = m_connectionPool.find(poolName);
         if (!isOpen) {
+            if (it != m_connectionPool.end()) {
+                markEndpointDown(it.value(), endpoint, error);
+
+                triedEndpoints.append(endpoint);
+                if (triedEndpoints.size() < qsizetype(it.value().endpoints.size()) &&
+                    (!checkReceiver || !receiver.isNull())) {
+                    qInfo(ASQL_POOL) << "Failing over to the next database endpoint" << poolName;
+                    // Returns the failed connection before opening a new one
+                    db = ADatabase{};
+                    APool::openConnection(
+                        receiver, std::move(coroData), poolName, std::move(triedEndpoints));
+                    return;
+                }
+            }
+
             if (coroData) {
                 coroData->deliverDirect(
                     std::unexpected(error.isEmpty() ? QStringLiteral("Connection failed") : error));
@@ -61,7 +195,6 @@ struct PoolOpenDelivery : ACoroOpenData {
             return;
         }
 
-        auto it = m_connectionPool.find(poolName);
         if (it == m_connectionPool.end()) {
             if (coroData) {
                 coroData->deliverDirect(
@@ -69,6 +202,7 @@ struct PoolOpenDelivery : ACoroOpenData {
             }
             return;
         }
+        markEndpointUp(it.value(), endpoint);
 
         if (setupHook) {
             setupHook(db);
@@ -79,6 +213,8 @@ struct PoolOpenDelivery : ACoroOpenData {
     }
 };
 
+} // namespace ASql
+
 const QStringView APool::defaultPool = u"asql_default_pool";
 
 void APool::create(std::shared_ptr<ADriverFactory> factory, QStringView poolName)
@@ -90,8 +226,28 @@ void APool::create(std::shared_ptr<ADriverFactory> factory, const QString &poolN
 {
     if (!m_connectionPool.contains(poolName)) {
         APoolInternal pool;
-        pool.name          = poolName;
-        pool.driverFactory = std::move(factory);
+        pool.name = poolName;
+        pool.endpoints.push_back({.endpoint = {.factory = std::move(factory)}});
+        m_connectionPool.emplace(pool.name, std::move(pool));
+    } else {
+        qWarning(ASQL_POOL) << "Ignoring addDatabase, connectionName already available" << poolName;
+    }
+}
+
+void APool::create(const std::vector<APoolEndpoint> &endpoints, QStringView poolName)
+{
+    if (endpoints.empty()) {
+        qCritical(ASQL_POOL) << "Ignoring addDatabase, no endpoints" << poolName;
+        return;
+    }
+
+    if (!m_connectionPool.contains(poolName)) {
+        APoolInternal pool;
+        pool.name          = poolName.toString();
+        pool.connectSpread = endpoints.size() > 1 ? 500ms : 0ms;
+        for (const APoolEndpoint &endpoint : endpoints) {
+            pool.endpoints.push_back({.endpoint = endpoint});
+        }
         m_connectionPool.emplace(pool.name, std::move(pool));
     } else {
         qWarning(ASQL_POOL) << "Ignoring addDatabase, connectionName already available" << poolName;
@@ -119,8 +275,7 @@ void APool::pushDatabaseBack(QStringView connectionName, ADriver *driver)
         APoolInternal &iPool = it.value();
         if (driver->state() == ADatabase::State::Disconnected) {
             qDebug(ASQL_POOL) << "Deleting database connection as is not open" << driver->isOpen();
-            driver->deleteLater();
-            --iPool.connectionCount;
+            iPool.release(driver);
             return;
         }
 
@@ -129,6 +284,9 @@ void APool::pushDatabaseBack(QStringView connectionName, ADriver *driver)
             return;
         }
 
+        // The next user expects the default format for plain queries
+        driver->setResultFormat(ADatabase::ResultFormat::Text);
+
         // Check for waiting clients
         while (!iPool.connectionQueue.empty()) {
             APoolQueuedClient client = iPool.connectionQueue.front();
@@ -141,6 +299,8 @@ void APool::pushDatabaseBack(QStringView connectionName, ADriver *driver)
                 driver, [connectionName = connectionName.toString()](ADriver *driver) {
                 pushDatabaseBack(connectionName, driver);
             })};
+            db.setQueryTimeout(iPool.queryTimeout);
+            db.setMaxQueueSize(iPool.maxQueueSize, iPool.queueOverflow);
             if (iPool.reuseHook) {
                 iPool.reuseHook(db);
             }
@@ -151,8 +311,7 @@ void APool::pushDatabaseBack(QStringView connectionName, ADriver *driver)
         if (iPool.pool.size() >= iPool.maxIdleConnections) {
             qDebug(ASQL_POOL) << "Deleting database connection due max idle connections"
                               << iPool.maxIdleConnections << iPool.pool.size();
-            driver->deleteLater();
-            --iPool.connectionCount;
+            iPool.release(driver);
         } else {
             qDebug(ASQL_POOL) << "Returning database connection to pool" << connectionName
                               << driver;
@@ -177,23 +336,45 @@ void APool::deliverDatabase(QObject *receiver,
                             std::shared_ptr<ACoroData<ADatabase>> coroData,
                             QStringView poolName)
 {
-    auto deliver = [coroData](ADatabase db) {
-        if (coroData) {
-            coroData->deliver(std::move(db));
-        }
-    };
-
-    ADatabase db;
     auto it = m_connectionPool.find(poolName);
     if (it == m_connectionPool.end()) {
         qCritical(ASQL_POOL) << "Database pool NOT FOUND" << poolName;
-        deliver({});
+        if (coroData) {
+            coroData->deliver(ADatabase{});
+        }
         return;
     }
 
     APoolInternal &iPool = it.value();
+
+    // Reopening a lost connection would stick to its endpoint, a new one picks the best
+    while (iPool.endpoints.size() > 1 && !iPool.pool.empty() &&
+           iPool.pool.last()->state() == ADatabase::State::Disconnected) {
+        iPool.release(iPool.pool.takeLast());
+    }
+
     if (iPool.pool.empty()) {
         if (iPool.maximuConnections && iPool.connectionCount >= iPool.maximuConnections) {
+            // Clients that gave up waiting don't count
+            while (!iPool.connectionQueue.empty()) {
+                const APoolQueuedClient &client = iPool.connectionQueue.front();
+                if ((client.checkReceiver && client.receiver.isNull()) || !client.cb) {
+                    iPool.connectionQueue.pop();
+                } else {
+                    break;
+                }
+            }
+
+            if (iPool.maxQueuedClients &&
+                qsizetype(iPool.connectionQueue.size()) >= iPool.maxQueuedClients) {
+                qWarning(ASQL_POOL) << "Maximum number of queued clients reached" << poolName
+                                    << iPool.connectionQueue.size();
+                if (coroData) {
+                    coroData->deliverDirect(std::unexpected(QStringLiteral("Pool queue is full")));
+                }
+                return;
+            }
+
             qInfo(ASQL_POOL) << "Maximum number of connections reached, queuing" << poolName
                              << iPool.connectionCount << iPool.connectionQueue.size();
             APoolQueuedClient queued;
@@ -203,36 +384,116 @@ void APool::deliverDatabase(QObject *receiver,
             iPool.connectionQueue.emplace(std::move(queued));
             return;
         }
-        ++iPool.connectionCount;
-        qDebug(ASQL_POOL) << "Creating a database connection for pool" << poolName;
-        const QString poolKey = poolName.toString();
-        db.d                  = std::shared_ptr<ADriver>(
-            iPool.driverFactory->createRawDriver(),
-            [poolKey](ADriver *driver) { pushDatabaseBack(poolKey, driver); });
-    } else {
-        qDebug(ASQL_POOL) << "Reusing a database connection from pool" << poolName;
-        ADriver *priv         = iPool.pool.takeLast();
-        const QString poolKey = poolName.toString();
-        db.d                  = std::shared_ptr<ADriver>(
-            priv, [poolKey](ADriver *driver) { pushDatabaseBack(poolKey, driver); });
+        openConnection(receiver, std::move(coroData), poolName, {});
+        return;
     }
 
+    qDebug(ASQL_POOL) << "Reusing a database connection from pool" << poolName;
+    ADriver *priv         = iPool.pool.takeLast();
+    const QString poolKey = poolName.toString();
+    ADatabase db;
+    db.d = std::shared_ptr<ADriver>(priv,
+                                    [poolKey](ADriver *driver) { pushDatabaseBack(poolKey, driver); });
+    db.setQueryTimeout(iPool.queryTimeout);
+    db.setMaxQueueSize(iPool.maxQueueSize, iPool.queueOverflow);
+
     if (db.isOpen()) {
         if (iPool.reuseHook) {
             iPool.reuseHook(db);
         }
-        deliver(std::move(db));
+        if (coroData) {
+            coroData->deliver(std::move(db));
+        }
+        return;
+    }
+
+    auto openState           = std::make_shared<PoolOpenDelivery>();
+    openState->self          = openState;
+    openState->coroData      = std::move(coroData);
+    openState->db            = std::move(db);
+    openState->poolName      = poolKey;
+    openState->setupHook     = iPool.setupHook;
+    openState->receiver      = receiver;
+    openState->checkReceiver = receiver;
+    openState->endpoint      = iPool.driverEndpoints.value(priv);
+    openDelivery(openState);
+}
+
+void APool::openConnection(QObject *receiver,
+                           std::shared_ptr<ACoroData<ADatabase>> coroData,
+                           QStringView poolName,
+                           QList<int> triedEndpoints)
+{
+    auto it = m_connectionPool.find(poolName);
+    if (it == m_connectionPool.end()) {
+        if (coroData) {
+            coroData->deliverDirect(
+                std::unexpected(QStringLiteral("Could not get a valid database connection")));
+        }
+        return;
+    }
+
+    APoolInternal &iPool = it.value();
+    const int endpoint   = selectEndpoint(iPool, triedEndpoints);
+    if (endpoint == -1) {
+        if (coroData) {
+            coroData->deliverDirect(std::unexpected(QStringLiteral("No database endpoint left")));
+        }
         return;
     }
 
-    auto openState       = std::make_shared<PoolOpenDelivery>();
-    openState->self      = openState;
-    openState->coroData  = std::move(coroData);
-    openState->db        = std::move(db);
-    openState->poolName  = poolName.toString();
-    openState->setupHook = iPool.setupHook;
+    ++iPool.connectionCount;
+    qDebug(ASQL_POOL) << "Creating a database connection for pool" << poolName << endpoint;
+    const QString poolKey = poolName.toString();
+    ADriver *driver       = iPool.endpoints[endpoint].endpoint.factory->createRawDriver();
+    iPool.driverEndpoints.insert(driver, endpoint);
+    if (iPool.endpoints.size() > 1) {
+        QObject::connect(driver,
+                         &ADriver::stateChanged,
+                         driver,
+                         [poolKey, driver](ADatabase::State state, const QString &status) {
+            auto it = m_connectionPool.find(poolKey);
+            if (state == ADatabase::State::Disconnected && it != m_connectionPool.end() &&
+                it.value().driverEndpoints.contains(driver)) {
+                markEndpointDown(it.value(), it.value().driverEndpoints.value(driver), status);
+            }
+        });
+    }
+
+    ADatabase db;
+    db.d = std::shared_ptr<ADriver>(driver,
+                                    [poolKey](ADriver *driver) { pushDatabaseBack(poolKey, driver); });
+    db.setQueryTimeout(iPool.queryTimeout);
+    db.setMaxQueueSize(iPool.maxQueueSize, iPool.queueOverflow);
+
+    auto openState            = std::make_shared<PoolOpenDelivery>();
+    openState->self           = openState;
+    openState->coroData       = std::move(coroData);
+    openState->db             = std::move(db);
+    openState->poolName       = poolKey;
+    openState->setupHook      = iPool.setupHook;
+    openState->receiver       = receiver;
+    openState->checkReceiver  = receiver;
+    openState->endpoint       = endpoint;
+    openState->triedEndpoints = std::move(triedEndpoints);
+
+    const auto delay = connectDelay(iPool);
+    if (delay > 0ms) {
+        qDebug(ASQL_POOL) << "Delaying connection after a failure" << poolName << delay;
+        QTimer::singleShot(delay, driver, [openState] { openDelivery(openState); });
+    } else {
+        openDelivery(openState);
+    }
+}
+
+void APool::openDelivery(const std::shared_ptr<PoolOpenDelivery> &openState)
+{
+    if (openState->checkReceiver && openState->receiver.isNull()) {
+        openState->self.reset();
+        return;
+    }
     openState->db.d->open(
-        openState->db.d, receiver, AOpenFn{std::weak_ptr<ACoroOpenData>{openState}});
+        openState->db.d, openState->receiver, AOpenFn{std::weak_ptr<ACoroOpenData>{openState}});
 }
 
 AExpectedDatabase APool::database(QObject *receiver, QStringView poolName)
@@ -294,6 +555,85 @@ void APool::setReuseHook(APoolHookFn hook, QStringView poolName)
     }
 }
 
+void APool::setQueryTimeout(std::chrono::milliseconds timeout, QStringView poolName)
+{
+    auto it = m_connectionPool.find(poolName);
+    if (it != m_connectionPool.end()) {
+        it.value().queryTimeout = timeout;
+    } else {
+        qCritical(ASQL_POOL) << "Failed to set query timeout: Database pool NOT FOUND" << poolName;
+    }
+}
+
+std::chrono::milliseconds APool::queryTimeout(QStringView poolName)
+{
+    return m_connectionPool.value(poolName).queryTimeout;
+}
+
+void APool::setConnectSpread(std::chrono::milliseconds spread, QStringView poolName)
+{
+    auto it = m_connectionPool.find(poolName);
+    if (it != m_connectionPool.end()) {
+        it.value().connectSpread = spread;
+    } else {
+        qCritical(ASQL_POOL) << "Failed to set connect spread: Database pool NOT FOUND"
+                             << poolName;
+    }
+}
+
+std::chrono::milliseconds APool::connectSpread(QStringView poolName)
+{
+    return m_connectionPool.value(poolName).connectSpread;
+}
+
+void APool::setMaxQueueSize(int max, ADatabase::QueueOverflow overflow, QStringView poolName)
+{
+    auto it = m_connectionPool.find(poolName);
+    if (it != m_connectionPool.end()) {
+        it.value().maxQueueSize  = max;
+        it.value().queueOverflow = overflow;
+    } else {
+        qCritical(ASQL_POOL) << "Failed to set maximum queue size: Database pool NOT FOUND"
+                             << poolName;
+    }
+}
+
+int APool::maxQueueSize(QStringView poolName)
+{
+    return m_connectionPool.value(poolName).maxQueueSize;
+}
+
+void APool::setMaxQueuedClients(int max, QStringView poolName)
+{
+    auto it = m_connectionPool.find(poolName);
+    if (it != m_connectionPool.end()) {
+        it.value().maxQueuedClients = max;
+    } else {
+        qCritical(ASQL_POOL) << "Failed to set maximum queued clients: Database pool NOT FOUND"
+                             << poolName;
+    }
+}
+
+int APool::maxQueuedClients(QStringView poolName)
+{
+    return m_connectionPool.value(poolName).maxQueuedClients;
+}
+
+int APool::queueSize(QStringView poolName)
+{
+    auto it = m_connectionPool.constFind(poolName);
+    if (it == m_connectionPool.constEnd()) {
+        return 0;
+    }
+
+    int size = int(it->connectionQueue.size());
+    for (auto driver = it->driverEndpoints.keyBegin(); driver != it->driverEndpoints.keyEnd();
+         ++driver) {
+        size += (*driver)->queueSize();
+    }
+    return size;
+}
+
 AExpectedResult APool::exec(QStringView query, QObject *receiver, QStringView poolName)
 {
     AExpectedResult coro(receiver);
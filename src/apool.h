@@ -16,6 +16,23 @@ namespace ASql {
 
 using APoolHookFn = std::function<ACoroTerminator(ADatabase)>;
 
+/*!
+ * \brief APoolEndpoint is one of the database servers of a multi-host pool
+ */
+struct APoolEndpoint {
+    enum class Role {
+        /*! New connections are spread among the available primaries */
+        Primary,
+        /*! Only used while no primary is available */
+        Standby,
+    };
+
+    std::shared_ptr<ADriverFactory> factory;
+    Role role = Role::Primary;
+};
+
+struct PoolOpenDelivery;
+
 class ASQL_EXPORT APool
 {
 public:
@@ -52,6 +69,23 @@ public:
      */
     static void create(std::shared_ptr<ADriverFactory> factory, const QString &poolName);
 
+    /*!
+     * \brief create creates a new database pool spread over multiple \p endpoints
+     *
+     * New connections go to the available endpoint with the least in-flight queries,
+     * standby endpoints are only used while no primary is available.
+     *
+     * An endpoint that fails to connect, or whose connection is lost, is considered down
+     * for an exponential backoff with jitter, a connection that fails to open is retried
+     * on the next endpoint before an error is delivered. After a failure new connections
+     * are opened with a random delay, see setConnectSpread().
+     *
+     * \param endpoints the servers of the pool, for example a primary and its standby
+     * \param poolName is an identifier for such pools
+     */
+    static void create(const std::vector<APoolEndpoint> &endpoints,
+                       QStringView poolName = defaultPool);
+
     /*!
      * \brief remove removes the database pool
      *
@@ -138,6 +172,80 @@ public:
      */
     static void setReuseHook(APoolHookFn hook, QStringView poolName = defaultPool);
 
+    /*!
+     * \brief setQueryTimeout sets the default query timeout of the pool connections
+     *
+     * It's applied every time a connection is handed out, so changes made with
+     * ADatabase::setQueryTimeout() only last while the connection is in use.
+     *
+     * \param timeout zero, the default, disables it
+     * \param poolName
+     * \sa ADatabase::setQueryTimeout
+     */
+    static void setQueryTimeout(std::chrono::milliseconds timeout,
+                                QStringView poolName = defaultPool);
+
+    /*!
+     * \brief Returns the default query timeout of the pool connections
+     */
+    static std::chrono::milliseconds queryTimeout(QStringView poolName = defaultPool);
+
+    /*!
+     * \brief setConnectSpread spreads the opening of new connections after an endpoint
+     * failure by a random delay up to \p spread, so that a failover doesn't flood the
+     * remaining endpoints with connection attempts
+     *
+     * The default is 500ms for multi-host pools and zero, disabled, otherwise.
+     *
+     * \param spread maximum delay, also how long after a failure it applies
+     * \param poolName
+     */
+    static void setConnectSpread(std::chrono::milliseconds spread,
+                                 QStringView poolName = defaultPool);
+
+    /*!
+     * \brief Returns the connect spread of the pool
+     */
+    static std::chrono::milliseconds connectSpread(QStringView poolName = defaultPool);
+
+    /*!
+     * \brief setMaxQueueSize limits how many queries each pool connection queues
+     *
+     * \param max zero, the default, means unlimited
+     * \param overflow what happens to queries issued when the queue is full
+     * \param poolName
+     * \sa ADatabase::setMaxQueueSize
+     */
+    static void setMaxQueueSize(int max,
+                                ADatabase::QueueOverflow overflow = ADatabase::QueueOverflow::Fail,
+                                QStringView poolName              = defaultPool);
+
+    /*!
+     * \brief Returns the maximum queue size of the pool connections
+     */
+    static int maxQueueSize(QStringView poolName = defaultPool);
+
+    /*!
+     * \brief setMaxQueuedClients limits how many callers wait for a connection once
+     * the maximum number of connections is reached, the ones above fail right away
+     * with a "Pool queue is full" error
+     *
+     * \param max zero, the default, means unlimited
+     * \param poolName
+     */
+    static void setMaxQueuedClients(int max, QStringView poolName = defaultPool);
+
+    /*!
+     * \brief Returns the maximum number of callers waiting for a connection
+     */
+    static int maxQueuedClients(QStringView poolName = defaultPool);
+
+    /*!
+     * \brief queueSize returns the current load of the pool, the queries queued on
+     * its connections plus the callers waiting for a connection
+     */
+    [[nodiscard]] static int queueSize(QStringView poolName = defaultPool);
+
     [[nodiscard]] static AExpectedResult
         exec(QStringView query, QObject *receiver = nullptr, QStringView poolName = defaultPool);
 
@@ -233,7 +341,14 @@ private:
     static void deliverDatabase(QObject *receiver,
                                 std::shared_ptr<ACoroData<ADatabase>> coroData,
                                 QStringView poolName);
+    static void openConnection(QObject *receiver,
+                               std::shared_ptr<ACoroData<ADatabase>> coroData,
+                               QStringView poolName,
+                               QList<int> triedEndpoints);
+    static void openDelivery(const std::shared_ptr<PoolOpenDelivery> &openState);
     inline static void pushDatabaseBack(QStringView connectionName, ADriver *driver);
+
+    friend struct PoolOpenDelivery;
 };
 
 } // namespace ASql
@@ -5,6 +5,8 @@
 
 #include "aresult.h"
 
+#include <algorithm>
+
 #include <QCborArray>
 #include <QCborMap>
 #include <QDateTime>
@@ -399,34 +401,126 @@ AResultPrivate::~AResultPrivate() = default;
 
 int AResultPrivate::indexOfField(const QString &name) const
 {
-    for (int i = 0; i < fields(); ++i) {
-        if (name == fieldName(i)) {
-            return i;
+    return fieldIndex().indexOf(*this, QStringView(name));
+}
+
+int AResultPrivate::indexOfField(QStringView name) const
+{
+    return fieldIndex().indexOf(*this, name);
+}
+
+int AResultPrivate::indexOfField(QLatin1String name) const
+{
+    return fieldIndex().indexOf(*this, name);
+}
+
+void AResultPrivate::setFieldIndex(std::shared_ptr<AFieldIndex> index)
+{
+    m_fieldIndex = std::move(index);
+}
+
+const AFieldIndex &AResultPrivate::fieldIndex() const
+{
+    std::call_once(m_fieldIndexOnce, [this] {
+        if (!m_fieldIndex) {
+            m_fieldIndex = std::make_shared<AFieldIndex>();
         }
+    });
+    return *m_fieldIndex;
+}
+
+namespace {
+
+inline char16_t fieldUnit(QChar ch)
+{
+    return ch.unicode();
+}
+
+inline char16_t fieldUnit(char ch)
+{
+    return uchar(ch);
+}
+
+// FNV-1a over UTF-16 code units, so Latin-1 and UTF-16 names hash alike
+template <typename View>
+quint64 fieldHash(View name)
+{
+    quint64 hash = 14695981039346656037ULL;
+    for (auto ch : name) {
+        hash ^= fieldUnit(ch);
+        hash *= 1099511628211ULL;
     }
-    return -1;
+    return hash;
 }
 
-int AResultPrivate::indexOfField(QStringView name) const
+} // namespace
+
+int AFieldIndex::indexOf(const AResultPrivate &result, QStringView name) const
 {
-    for (int i = 0; i < fields(); ++i) {
-        if (name == fieldName(i)) {
-            return i;
+    std::call_once(m_once, [this, &result] { build(result); });
+    return find(name);
+}
+
+int AFieldIndex::indexOf(const AResultPrivate &result, QLatin1String name) const
+{
+    std::call_once(m_once, [this, &result] { build(result); });
+    return find(name);
+}
+
+void AFieldIndex::build(const AResultPrivate &result) const
+{
+    const int fields = result.fields();
+    m_names.reserve(fields);
+    for (int i = 0; i < fields; ++i) {
+        m_names.append(result.fieldName(i));
+    }
+
+    // At most half full so probing always reaches an empty slot
+    qsizetype size = 8;
+    while (size < fields * 2) {
+        size *= 2;
+    }
+    m_slots.resize(size);
+    std::fill(m_slots.begin(), m_slots.end(), 0);
+
+    const qsizetype mask = size - 1;
+    for (int column = 0; column < fields; ++column) {
+        const QString &name = m_names.at(column);
+        qsizetype slot      = fieldHash(QStringView(name)) & mask;
+        while (m_slots[slot] && m_names.at(m_slots[slot] - 1) != name) {
+            slot = (slot + 1) & mask;
+        }
+
+        // Duplicated names resolve to the first column
+        if (!m_slots[slot]) {
+            m_slots[slot] = column + 1;
         }
     }
-    return -1;
 }
 
-int AResultPrivate::indexOfField(QLatin1String name) const
+template <typename View>
+int AFieldIndex::find(View name) const
 {
-    for (int i = 0; i < fields(); ++i) {
-        if (name == fieldName(i)) {
-            return i;
+    const qsizetype mask = m_slots.size() - 1;
+    for (qsizetype slot = fieldHash(name) & mask; m_slots[slot]; slot = (slot + 1) & mask) {
+        const int column = m_slots[slot] - 1;
+        if (m_names.at(column) == name) {
+            return column;
         }
     }
     return -1;
 }
 
+QVariantList AResultPrivate::toList(int row, int column) const
+{
+    return value(row, column).toList();
+}
+
+QVariantList AResult::AColumn::toList() const
+{
+    return d->toList(row, column);
+}
+
 QUuid AResult::AColumn::toUuid() const
 {
     return d->toUuid(row, column);
@@ -6,16 +6,20 @@
 
 #include <asql_export.h>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <QCborValue>
 #include <QDate>
 #include <QDateTime>
 #include <QJsonValue>
+#include <QStringList>
 #include <QTime>
+#include <QVarLengthArray>
 #include <QVariant>
 
 namespace ASql {
@@ -30,8 +34,21 @@ template <typename T>
 struct is_optional<std::optional<T>> : std::true_type {
 };
 
+template <typename T>
+struct is_array : std::false_type {
+};
+
+template <typename T>
+struct is_array<QList<T>> : std::true_type {
+};
+
+template <typename T>
+struct is_array<std::vector<T>> : std::true_type {
+};
+
 } // namespace detail
 
+class AFieldIndex;
 class ASQL_EXPORT AResultPrivate
 {
 public:
@@ -69,6 +86,49 @@ public:
     virtual QJsonValue toJsonValue(int row, int column) const  = 0;
     virtual QCborValue toCborValue(int row, int column) const  = 0;
     virtual QByteArray toByteArray(int row, int column) const  = 0;
+
+    /*!
+     * \brief toList returns the elements of an array column, multidimensional
+     * arrays are returned as nested lists
+     *
+     * The default implementation converts value() to a QVariantList.
+     */
+    virtual QVariantList toList(int row, int column) const;
+
+    /*!
+     * \brief setFieldIndex shares \p index among results with the same fields, it
+     * must be called before the result is delivered
+     */
+    void setFieldIndex(std::shared_ptr<AFieldIndex> index);
+
+private:
+    const AFieldIndex &fieldIndex() const;
+
+    mutable std::once_flag m_fieldIndexOnce;
+    mutable std::shared_ptr<AFieldIndex> m_fieldIndex;
+};
+
+/*!
+ * \brief AFieldIndex maps field names to their column in constant time
+ *
+ * It's built by the first lookup on a result, drivers share one among the results
+ * with the same row description, like the ones of a prepared query.
+ */
+class ASQL_EXPORT AFieldIndex
+{
+public:
+    [[nodiscard]] int indexOf(const AResultPrivate &result, QStringView name) const;
+    [[nodiscard]] int indexOf(const AResultPrivate &result, QLatin1String name) const;
+
+private:
+    void build(const AResultPrivate &result) const;
+    template <typename View>
+    int find(View name) const;
+
+    mutable std::once_flag m_once;
+    mutable QStringList m_names;
+    // Open addressing table of column + 1, zero marks an empty slot
+    mutable QVarLengthArray<int, 32> m_slots;
 };
 
 class ASQL_EXPORT AResult
@@ -242,12 +302,22 @@ public:
         [[nodiscard]] QCborValue toCborValue() const;
         [[nodiscard]] inline QByteArray toByteArray() const { return d->toByteArray(row, column); }
 
+        /*!
+         * \brief toList returns the elements of an array column
+         *
+         * Null elements are returned as null QVariants, multidimensional arrays
+         * are returned as nested lists.
+         */
+        [[nodiscard]] QVariantList toList() const;
+
         /*!
          * \brief as converts the column value to the requested type T.
          *
          * Supported types: bool, int, qint64, quint64, double, QString, std::string,
          * QUuid, QDate, QTime, QDateTime, QJsonValue, QCborValue, QByteArray, QVariant,
          * and std::optional<U> for any supported type U (returns std::nullopt when null).
+         * Array columns are supported as QList<U> or std::vector<U>, null elements are
+         * returned as std::nullopt when U is an std::optional, otherwise as a default value.
          * Any other type falls back to QVariant::value<T>().
          */
         template <typename T>
@@ -288,6 +358,22 @@ public:
                 return toByteArray();
             } else if constexpr (std::is_same_v<T, QVariant>) {
                 return value();
+            } else if constexpr (std::is_same_v<T, QVariantList>) {
+                return toList();
+            } else if constexpr (detail::is_array<T>::value) {
+                using U                 = typename T::value_type;
+                const QVariantList list = toList();
+                T ret;
+                ret.reserve(list.size());
+                for (const QVariant &item : list) {
+                    if constexpr (detail::is_optional<U>::value) {
+                        ret.push_back(item.isNull() ? U{}
+                                                    : U{item.template value<typename U::value_type>()});
+                    } else {
+                        ret.push_back(item.template value<U>());
+                    }
+                }
+                return ret;
             } else {
                 return value().template value<T>();
             }
@@ -533,17 +619,10 @@ protected:
 [[nodiscard]] ASQL_EXPORT AResult resultError(const QString &message);
 [[nodiscard]] ASQL_EXPORT AResult resultSuccess();
 
-#define AColumnIndex(result, columnName) \
-    ([result]() Q_DECL_NOEXCEPT -> int { \
-        static const int ix = result.indexOfField(columnName); \
-        return ix; \
-    }()) /**/
-
-#define AColumn(row, columnName) \
-    ([row]() Q_DECL_NOEXCEPT -> AResult::AColumn { \
-        static const int ix = row.d->indexOfField(columnName); \
-        return row[ix]; \
-    }()) /**/
+// Field lookups are done in constant time, these are kept for compatibility
+#define AColumnIndex(result, columnName) ((result).indexOfField(columnName)) /**/
+
+#define AColumn(row, columnName) ((row)[columnName]) /**/
 
 } // namespace ASql
 
@@ -0,0 +1,173 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <QtGlobal>
+
+namespace ASql {
+
+/*!
+ * \brief ARingQueue is a FIFO of move-only elements that reuses its slots
+ *
+ * Elements live in slots allocated once and recycled in ring order, so once the
+ * queue reached its working size pushing and popping allocates nothing. Popped
+ * slots are reset to a default constructed \c T, releasing what the element held.
+ *
+ * Unlike std::vector, and like std::deque, references to elements stay valid when
+ * other elements are added, as code holding the front element might deliver a result
+ * that queues a new query. Erasing from the middle is linear, it's only needed
+ * by the slow paths.
+ */
+template <typename T>
+class ARingQueue
+{
+public:
+    template <bool Const>
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = T;
+        using difference_type   = qsizetype;
+        using pointer           = std::conditional_t<Const, const T *, T *>;
+        using reference         = std::conditional_t<Const, const T &, T &>;
+        using Queue             = std::conditional_t<Const, const ARingQueue, ARingQueue>;
+
+        Iterator() = default;
+        Iterator(Queue *queue, qsizetype index)
+            : m_queue(queue)
+            , m_index(index)
+        {
+        }
+
+        reference operator*() const { return (*m_queue)[m_index]; }
+        pointer operator->() const { return &(*m_queue)[m_index]; }
+
+        Iterator &operator++()
+        {
+            ++m_index;
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            Iterator ret = *this;
+            ++m_index;
+            return ret;
+        }
+        Iterator operator+(qsizetype n) const { return Iterator(m_queue, m_index + n); }
+
+        bool operator==(const Iterator &other) const { return m_index == other.m_index; }
+
+    private:
+        friend class ARingQueue;
+        Queue *m_queue    = nullptr;
+        qsizetype m_index = 0;
+    };
+
+    using iterator       = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    [[nodiscard]] bool empty() const { return m_size == 0; }
+    [[nodiscard]] qsizetype size() const { return m_size; }
+
+    T &operator[](qsizetype index) { return *m_slots[slot(index)]; }
+    const T &operator[](qsizetype index) const { return *m_slots[slot(index)]; }
+
+    T &front() { return (*this)[0]; }
+    const T &front() const { return (*this)[0]; }
+    T &back() { return (*this)[m_size - 1]; }
+    const T &back() const { return (*this)[m_size - 1]; }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, m_size); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_size); }
+
+    T &emplace_back(T &&value)
+    {
+        if (m_size == qsizetype(m_slots.size())) {
+            grow();
+        }
+
+        auto &node = m_slots[slot(m_size)];
+        if (node) {
+            *node = std::move(value);
+        } else {
+            node = std::make_unique<T>(std::move(value));
+        }
+        ++m_size;
+        return *node;
+    }
+
+    T &emplace_front(T &&value)
+    {
+        if (m_size == qsizetype(m_slots.size())) {
+            grow();
+        }
+
+        m_head     = (m_head - 1) & (qsizetype(m_slots.size()) - 1);
+        auto &node = m_slots[m_head];
+        if (node) {
+            *node = std::move(value);
+        } else {
+            node = std::make_unique<T>(std::move(value));
+        }
+        ++m_size;
+        return *node;
+    }
+
+    void pop_front()
+    {
+        Q_ASSERT(m_size > 0);
+        *m_slots[m_head] = T{};
+        m_head           = (m_head + 1) & (qsizetype(m_slots.size()) - 1);
+        --m_size;
+    }
+
+    iterator erase(iterator pos)
+    {
+        Q_ASSERT(pos.m_index < m_size);
+        if (pos.m_index == 0) {
+            pop_front();
+            return begin();
+        }
+
+        // The freed slot moves to the back, the others keep their elements in place
+        *m_slots[slot(pos.m_index)] = T{};
+        for (qsizetype i = pos.m_index; i < m_size - 1; ++i) {
+            std::swap(m_slots[slot(i)], m_slots[slot(i + 1)]);
+        }
+        --m_size;
+        return pos;
+    }
+
+private:
+    qsizetype slot(qsizetype index) const
+    {
+        return (m_head + index) & (qsizetype(m_slots.size()) - 1);
+    }
+
+    void grow()
+    {
+        // Only the slot pointers move, the capacity is kept a power of two
+        std::vector<std::unique_ptr<T>> slots(std::max<size_t>(16, m_slots.size() * 2));
+        for (qsizetype i = 0; i < m_size; ++i) {
+            slots[i] = std::move(m_slots[slot(i)]);
+        }
+        m_slots = std::move(slots);
+        m_head  = 0;
+    }
+
+    std::vector<std::unique_ptr<T>> m_slots;
+    qsizetype m_head = 0;
+    qsizetype m_size = 0;
+};
+
+} // namespace ASql
@@ -68,6 +68,7 @@ public:
 
 private:
     friend class ADatabase;
+    friend class ACursorPrivate;
     ATransaction(const ADatabase &db, bool started);
     std::shared_ptr<ATransactionPrivate> d;
 };
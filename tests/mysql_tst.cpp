@@ -0,0 +1,99 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#include "CoverageObject.hpp"
+#include "acoroexpected.h"
+#include "adatabase.h"
+#include "amysql.h"
+#include "apool.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTest>
+
+using namespace ASql;
+using namespace Qt::Literals::StringLiterals;
+
+class TestMysql : public CoverageObject
+{
+    Q_OBJECT
+public:
+    void initTest() override;
+    void cleanupTest() override;
+
+private Q_SLOTS:
+    void testQueryTimeout();
+};
+
+void TestMysql::initTest()
+{
+    if (!qEnvironmentVariableIsSet("ASQL_MYSQL_TEST_DB")) {
+        QSKIP("ASQL_MYSQL_TEST_DB not set; skipping MySQL tests");
+    }
+    const QString url = qEnvironmentVariable("ASQL_MYSQL_TEST_DB", u"mysql:///"_s);
+    APool::create(AMysql::factory(url));
+    APool::setMaxIdleConnections(2);
+    APool::setMaxConnections(5);
+}
+
+void TestMysql::cleanupTest()
+{
+    APool::remove();
+}
+
+void TestMysql::testQueryTimeout()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            QElapsedTimer timer;
+            timer.start();
+
+            // SLEEP() returns 1 when killed, BENCHMARK() fails as interrupted
+            db->setQueryTimeout(std::chrono::milliseconds{300});
+            auto running = db->exec(u"SELECT BENCHMARK(10000000000, SHA2('asql', 512))"_s);
+            auto queued  = db->exec(u"SELECT 1"_s);
+            db->setQueryTimeout({});
+            auto later = db->exec(u"SELECT 42"_s);
+
+            auto runningResult = co_await running;
+            AVERIFY(!runningResult);
+            ACOMPARE_EQ(runningResult.error(), u"Query timed out"_s);
+
+            auto queuedResult = co_await queued;
+            AVERIFY(!queuedResult);
+            ACOMPARE_EQ(queuedResult.error(), u"Query timed out"_s);
+
+            // The KILL must not hit the query sent after the timed out one
+            auto laterResult = co_await later;
+            AVERIFY(laterResult);
+            ACOMPARE_EQ((*laterResult)[0][0].toInt(), 42);
+            AVERIFY(timer.elapsed() < 10000);
+
+            // A query completing right before its deadline leaves the connection usable
+            db->setQueryTimeout(std::chrono::milliseconds{50});
+            auto quick = db->exec(u"SELECT SLEEP(0.04)"_s);
+            db->setQueryTimeout({});
+            auto next = db->exec(u"SELECT SLEEP(0.2), 7"_s);
+            co_await quick;
+            auto nextResult = co_await next;
+            AVERIFY(nextResult);
+            // A killed SLEEP() returns 1
+            ACOMPARE_EQ((*nextResult)[0][0].toInt(), 0);
+            ACOMPARE_EQ((*nextResult)[0][1].toInt(), 7);
+        }(finished);
+    }
+    loop.exec();
+}
+
+QTEST_MAIN(TestMysql)
+#include "mysql_tst.moc"
@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#include "CoverageObject.hpp"
+#include "acoroexpected.h"
+#include "adatabase.h"
+#include "apg.h"
+#include "apool.h"
+
+#include <ctime>
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTest>
+
+using namespace ASql;
+using namespace Qt::Literals::StringLiterals;
+
+class BenchPg : public CoverageObject
+{
+    Q_OBJECT
+public:
+    void initTest() override;
+    void cleanupTest() override;
+
+private Q_SLOTS:
+    void benchmarkQueries_data();
+    void benchmarkQueries();
+};
+
+void BenchPg::initTest()
+{
+    if (!qEnvironmentVariableIsSet("ASQL_PG_TEST_DB")) {
+        QSKIP("ASQL_PG_TEST_DB not set; skipping PostgreSQL benchmarks");
+    }
+    const QString url = qEnvironmentVariable("ASQL_PG_TEST_DB", u"postgresql:///"_s);
+    APool::create(APg::factory(url));
+    APool::setMaxIdleConnections(2);
+    APool::setMaxConnections(5);
+}
+
+void BenchPg::cleanupTest()
+{
+    APool::remove();
+}
+
+void BenchPg::benchmarkQueries_data()
+{
+    QTest::addColumn<bool>("pipelined");
+
+    QTest::newRow("sequential") << false;
+    QTest::newRow("pipelined") << true;
+}
+
+void BenchPg::benchmarkQueries()
+{
+    QFETCH(bool, pipelined);
+
+    constexpr int Queries  = 1000;
+    qint64 total           = 0;
+    const std::clock_t cpu = std::clock();
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    QBENCHMARK {
+        QEventLoop loop;
+        {
+            auto finished = std::make_shared<QObject>();
+            connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+            [](std::shared_ptr<QObject> finished, bool pipelined) -> ACoroTerminator {
+                auto _ = qScopeGuard([finished] {});
+
+                auto db = co_await APool::database();
+                AVERIFY(db);
+
+                if (pipelined) {
+                    db->setAutoPipeline(true);
+                    auto restore = qScopeGuard([db]() mutable { db->setAutoPipeline(false); });
+
+                    std::vector<AExpectedResult> queries;
+                    queries.reserve(Queries);
+                    for (int i = 0; i < Queries; ++i) {
+                        queries.emplace_back(db->exec(u8"SELECT 1"));
+                    }
+                    for (auto &query : queries) {
+                        AVERIFY(co_await query);
+                    }
+                } else {
+                    for (int i = 0; i < Queries; ++i) {
+                        AVERIFY(co_await db->exec(u8"SELECT 1"));
+                    }
+                }
+            }(finished, pipelined);
+        }
+        loop.exec();
+        total += Queries;
+    }
+
+    // CPU time of the whole process, the server runs on its own
+    const double cpuSeconds = double(std::clock() - cpu) / CLOCKS_PER_SEC;
+    qInfo() << "queries per second" << total * 1000.0 / std::max<qint64>(elapsed.elapsed(), 1)
+            << "per core" << total / std::max(cpuSeconds, 0.001);
+}
+
+QTEST_MAIN(BenchPg)
+#include "pg_bench.moc"
@@ -0,0 +1,1092 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#include "CoverageObject.hpp"
+#include "acoroexpected.h"
+#include "acursor.h"
+#include "adatabase.h"
+#include "anotificationhub.h"
+#include "apg.h"
+#include "apool.h"
+#include "apreparedquery.h"
+
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QObject>
+#include <QTest>
+#include <QThread>
+#include <QTimeZone>
+#include <QTimer>
+
+using namespace ASql;
+using namespace Qt::Literals::StringLiterals;
+
+class TestPg : public CoverageObject
+{
+    Q_OBJECT
+public:
+    void initTest() override;
+    void cleanupTest() override;
+
+private Q_SLOTS:
+    void testCopyIn();
+    void testCopyInAbort();
+    void testCopyInBinary();
+    void testCopyOut();
+    void testChunkedRows();
+    void testAutoPipeline();
+    void testPipelineAutoSync();
+    void testPipelinedTransaction();
+    void testPipelineBatch();
+    void testPreparedCache();
+    void testCancelOnReceiverDestroyed();
+    void testQueryTimeout();
+    void testQueueLimit();
+    void testNotificationHub();
+    void testNotificationCoalescing();
+    void testPreparedFieldIndex();
+    void testPreparedDescribe();
+    void testCursor();
+};
+
+void TestPg::initTest()
+{
+    if (!qEnvironmentVariableIsSet("ASQL_PG_TEST_DB")) {
+        QSKIP("ASQL_PG_TEST_DB not set; skipping PostgreSQL tests");
+    }
+    const QString url = qEnvironmentVariable("ASQL_PG_TEST_DB", u"postgresql:///"_s);
+    APool::create(APg::factory(url));
+    APool::setMaxIdleConnections(2);
+    APool::setMaxConnections(5);
+}
+
+void TestPg::cleanupTest()
+{
+    APool::remove();
+}
+
+void TestPg::testCopyIn()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            auto created = co_await db->exec(
+                u8"CREATE TEMP TABLE copy_in (id int4, name text, data bytea, note text)");
+            AVERIFY(created);
+
+            auto copy = co_await db->copyIn(u"COPY copy_in (id, name, data, note) FROM STDIN"_s);
+            AVERIFY(copy);
+            AVERIFY(copy->isActive());
+
+            for (int i = 1; i <= 1000; ++i) {
+                AVERIFY(copy->writeRow({i,
+                                        u"name\t%1\\\n"_s.arg(i),
+                                        QByteArray("\x00\x01\xff", 3),
+                                        QVariant{}}));
+                if (i % 250 == 0) {
+                    auto flushed = co_await copy->flush();
+                    AVERIFY(flushed);
+                }
+            }
+            AVERIFY(copy->write("1001\tRaw\t\\N\tnote\n"));
+
+            auto result = co_await copy->finish();
+            AVERIFY(result);
+            ACOMPARE_EQ(result->numRowsAffected(), 1001);
+            AVERIFY(!copy->isActive());
+
+            auto check = co_await db->exec(
+                u8"SELECT name, data, note FROM copy_in WHERE id IN (7, 1001) ORDER BY id");
+            AVERIFY(check);
+            ACOMPARE_EQ(check->size(), 2);
+            ACOMPARE_EQ((*check)[0][0].toString(), u"name\t7\\\n"_s);
+            ACOMPARE_EQ((*check)[0][1].toByteArray(), QByteArray("\x00\x01\xff", 3));
+            AVERIFY((*check)[0][2].isNull());
+            ACOMPARE_EQ((*check)[1][0].toString(), u"Raw"_s);
+            AVERIFY((*check)[1][1].isNull());
+            ACOMPARE_EQ((*check)[1][2].toString(), u"note"_s);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testCopyInAbort()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            auto created = co_await db->exec(u8"CREATE TEMP TABLE copy_abort (id int4)");
+            AVERIFY(created);
+
+            {
+                auto copy = co_await db->copyIn(u"COPY copy_abort FROM STDIN"_s);
+                AVERIFY(copy);
+                AVERIFY(copy->writeRow({1}));
+
+                auto aborted = co_await copy->abort(u"changed my mind"_s);
+                AVERIFY(!aborted);
+                AVERIFY(aborted.error().contains(u"changed my mind"_s));
+            }
+
+            {
+                // Dropping the last reference aborts the COPY as well
+                auto copy = co_await db->copyIn(u"COPY copy_abort FROM STDIN"_s);
+                AVERIFY(copy);
+                AVERIFY(copy->writeRow({2}));
+            }
+
+            // The connection must be usable again
+            auto count = co_await db->exec(u8"SELECT count(*) FROM copy_abort");
+            AVERIFY(count);
+            ACOMPARE_EQ((*count)[0][0].toInt(), 0);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testCopyInBinary()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            auto created = co_await db->exec(
+                u8"CREATE TEMP TABLE copy_binary (id int4, total int8, ratio float8, name text, "
+                "data bytea, uid uuid, at timestamptz, doc jsonb, note text)");
+            AVERIFY(created);
+
+            auto copy = co_await db->copyIn(u"COPY copy_binary FROM STDIN (FORMAT binary)"_s);
+            AVERIFY(copy);
+
+            const QUuid uid       = QUuid::createUuid();
+            const QDateTime epoch =
+                QDateTime(QDate(2024, 2, 29), QTime(13, 45, 7, 123), QTimeZone::UTC);
+            for (int i = 1; i <= 1000; ++i) {
+                AVERIFY(copy->writeBinaryRow({
+                    i,
+                    qint64(i) * 1'000'000'000,
+                    i / 4.0,
+                    u"name\t%1"_s.arg(i),
+                    QByteArray("\x00\x01\xff", 3),
+                    uid,
+                    epoch.addSecs(i),
+                    QJsonObject{{u"id"_s, i}},
+                    QVariant{},
+                }));
+            }
+
+            auto result = co_await copy->finish();
+            AVERIFY(result);
+            ACOMPARE_EQ(result->numRowsAffected(), 1000);
+
+            auto check = co_await db->exec(
+                u8"SELECT total, ratio, name, data, uid, at, doc->>'id', note FROM copy_binary "
+                "WHERE id = 7");
+            AVERIFY(check);
+            ACOMPARE_EQ(check->size(), 1);
+            auto row = (*check)[0];
+            ACOMPARE_EQ(row[0].toLongLong(), Q_INT64_C(7000000000));
+            ACOMPARE_EQ(row[1].toDouble(), 1.75);
+            ACOMPARE_EQ(row[2].toString(), u"name\t7"_s);
+            ACOMPARE_EQ(row[3].toByteArray(), QByteArray("\x00\x01\xff", 3));
+            ACOMPARE_EQ(row[4].toUuid(), uid);
+            ACOMPARE_EQ(row[5].toDateTime().toMSecsSinceEpoch(),
+                        epoch.addSecs(7).toMSecsSinceEpoch());
+            ACOMPARE_EQ(row[6].toInt(), 7);
+            AVERIFY(row[7].isNull());
+
+            // A value that does not match the column type makes the COPY fail
+            auto mismatch =
+                co_await db->copyIn(u"COPY copy_binary (total) FROM STDIN (FORMAT binary)"_s);
+            AVERIFY(mismatch);
+            AVERIFY(mismatch->writeBinaryRow({1}));
+            AVERIFY(!co_await mismatch->finish());
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testCopyOut()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            auto chunks = std::make_shared<int>(0);
+            auto sum    = std::make_shared<qint64>(0);
+            auto result = co_await db->copyOut(
+                u"COPY (SELECT generate_series(1, 10000)) TO STDOUT"_s,
+                [chunks, sum](QByteArrayView chunk) {
+                ++*chunks;
+                *sum += chunk.trimmed().toLongLong();
+            });
+            AVERIFY(result);
+            ACOMPARE_EQ(result->numRowsAffected(), 10000);
+            ACOMPARE_EQ(*chunks, 10000);
+            ACOMPARE_EQ(*sum, Q_INT64_C(50005000));
+
+            QBuffer buffer;
+            AVERIFY(buffer.open(QIODevice::WriteOnly));
+            auto toDevice = co_await db->copyOut(
+                u"COPY (VALUES (1, 'a'), (2, NULL)) TO STDOUT WITH (FORMAT csv)"_s, &buffer);
+            AVERIFY(toDevice);
+            ACOMPARE_EQ(toDevice->numRowsAffected(), 2);
+            ACOMPARE_EQ(buffer.data(), QByteArray("1,a\n2,\n"));
+
+            // Errors are reported by the awaitable
+            auto failed = co_await db->copyOut(u"COPY missing_table TO STDOUT"_s, ACopyOutFn{});
+            AVERIFY(!failed);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testChunkedRows()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            auto stream = db->execStream(
+                u"SELECT generate_series(1, $1::int4) AS n"_s, {1050}, 100);
+            int batches = 0;
+            int rows    = 0;
+            qint64 sum  = 0;
+            while (true) {
+                auto batch = co_await stream;
+                AVERIFY(batch);
+                AVERIFY(batch->size() <= 100);
+                ++batches;
+                for (auto row : *batch) {
+                    ++rows;
+                    sum += row[0].toLongLong();
+                }
+                if (batch->lastResultSet()) {
+                    break;
+                }
+            }
+            ACOMPARE_EQ(rows, 1050);
+            ACOMPARE_EQ(sum, Q_INT64_C(551775));
+            AVERIFY(batches >= 11);
+            AVERIFY(batches <= 12);
+
+            // Empty result sets still deliver a last result
+            auto empty = db->execStream(u"SELECT 1 WHERE false"_s, {}, 100);
+            auto last  = co_await empty;
+            AVERIFY(last);
+            ACOMPARE_EQ(last->size(), 0);
+            AVERIFY(last->lastResultSet());
+
+            // Errors end the stream
+            auto failed = db->execStream(u"SELECT * FROM missing_table"_s, {}, 100);
+            auto error  = co_await failed;
+            AVERIFY(!error);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testAutoPipeline()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            db->setAutoPipeline(true);
+            AVERIFY(db->autoPipeline());
+            auto restore = qScopeGuard([db]() mutable { db->setAutoPipeline(false); });
+
+            // The first query is sent right away, the following ones are pipelined
+            // once it completes, multiple commands wait for the pipeline to finish
+            auto first  = db->exec(u"SELECT $1::int4"_s, {1});
+            auto failed = db->exec(u"SELECT 1/0"_s);
+            auto third  = db->exec(u"SELECT $1::int4"_s, {3});
+            auto multi  = db->execMulti(u"SELECT 4; SELECT 5"_s);
+            auto last   = db->exec(u"SELECT $1::int4"_s, {6});
+
+            auto firstResult = co_await first;
+            AVERIFY(firstResult);
+            ACOMPARE_EQ((*firstResult)[0][0].toInt(), 1);
+
+            // Errors do not affect the other queries
+            auto failedResult = co_await failed;
+            AVERIFY(!failedResult);
+
+            auto thirdResult = co_await third;
+            AVERIFY(thirdResult);
+            ACOMPARE_EQ((*thirdResult)[0][0].toInt(), 3);
+
+            auto multiResult = co_await multi;
+            AVERIFY(multiResult);
+            ACOMPARE_EQ((*multiResult)[0][0].toInt(), 4);
+            AVERIFY(!multiResult->lastResultSet());
+            multiResult = co_await multi;
+            AVERIFY(multiResult);
+            ACOMPARE_EQ((*multiResult)[0][0].toInt(), 5);
+
+            auto lastResult = co_await last;
+            AVERIFY(lastResult);
+            ACOMPARE_EQ((*lastResult)[0][0].toInt(), 6);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testPipelineAutoSync()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            // The first query goes alone, the others wait for its results
+            AVERIFY(db->enterPipelineModeWithPolicy(APipelineSyncPolicy{}));
+            std::vector<AExpectedResult> queries;
+            for (int i = 0; i < 10; ++i) {
+                queries.emplace_back(db->exec(u"SELECT $1::int4"_s, {i}));
+            }
+            for (int i = 0; i < 10; ++i) {
+                auto result = co_await queries[i];
+                AVERIFY(result);
+                ACOMPARE_EQ((*result)[0][0].toInt(), i);
+            }
+            AVERIFY(db->exitPipelineMode());
+
+            auto stats = db->pipelineSyncStats();
+            ACOMPARE_EQ(stats.queries, 10u);
+            ACOMPARE_EQ(stats.syncs, 2u);
+            ACOMPARE_EQ(stats.idleSyncs, 2u);
+            ACOMPARE_EQ(stats.maxBatchQueries, 9);
+
+            // Full batches are synced, the remaining query once the latency budget expires
+            AVERIFY(db->enterPipelineModeWithPolicy(APipelineSyncPolicy{
+                .latency      = std::chrono::milliseconds{50},
+                .maxQueries   = 3,
+                .syncWhenIdle = false,
+            }));
+            queries.clear();
+            for (int i = 0; i < 7; ++i) {
+                queries.emplace_back(db->exec(u"SELECT $1::int4"_s, {i}));
+            }
+            for (auto &query : queries) {
+                AVERIFY(co_await query);
+            }
+            AVERIFY(db->exitPipelineMode());
+
+            stats = db->pipelineSyncStats();
+            ACOMPARE_EQ(stats.queries, 17u);
+            ACOMPARE_EQ(stats.limitSyncs, 2u);
+            ACOMPARE_EQ(stats.latencySyncs, 1u);
+            ACOMPARE_EQ(stats.lastBatchQueries, 1);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testPipelinedTransaction()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            auto create = co_await db->exec(u"CREATE TEMP TABLE pipelined_transaction (id int4)"_s);
+            AVERIFY(create);
+
+            // BEGIN, the inserts and COMMIT are sent together
+            auto t = co_await db->begin(ADatabase::TransactionMode::Pipelined);
+            AVERIFY(t);
+            AVERIFY(t->isActive());
+            auto first  = db->exec(u"INSERT INTO pipelined_transaction VALUES ($1)"_s, {1});
+            auto second = db->exec(u"INSERT INTO pipelined_transaction VALUES ($1)"_s, {2});
+            auto commit = t->commit();
+            AVERIFY(co_await first);
+            AVERIFY(co_await second);
+            AVERIFY(co_await commit);
+            AVERIFY(!t->isActive());
+
+            // Results can be awaited before the transaction ends
+            t = co_await db->begin(ADatabase::TransactionMode::Pipelined);
+            AVERIFY(t);
+            auto returning =
+                co_await db->exec(u"INSERT INTO pipelined_transaction VALUES ($1) RETURNING id"_s,
+                                  {3});
+            AVERIFY(returning);
+            ACOMPARE_EQ((*returning)[0][0].toInt(), 3);
+            AVERIFY(co_await t->commit());
+
+            // A failing statement fails the following ones and rolls the transaction back
+            t = co_await db->begin(ADatabase::TransactionMode::Pipelined);
+            AVERIFY(t);
+            auto inserted = db->exec(u"INSERT INTO pipelined_transaction VALUES ($1)"_s, {4});
+            auto failed   = db->exec(u"SELECT 1/0"_s);
+            auto skipped  = db->exec(u"INSERT INTO pipelined_transaction VALUES ($1)"_s, {5});
+            auto rollback = t->commit();
+            AVERIFY(co_await inserted);
+            AVERIFY(!co_await failed);
+            AVERIFY(!co_await skipped);
+            AVERIFY(!co_await rollback);
+
+            auto count = co_await db->exec(u"SELECT count(*) FROM pipelined_transaction"_s);
+            AVERIFY(count);
+            ACOMPARE_EQ((*count)[0][0].toInt(), 3);
+
+            co_await db->exec(u"DROP TABLE pipelined_transaction"_s);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testPipelineBatch()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            auto empty = co_await db->exec(APipeline{});
+            AVERIFY(empty);
+            ACOMPARE_EQ(empty->size(), 0);
+
+            APipeline pipeline;
+            for (int i = 0; i < 5; ++i) {
+                pipeline.exec(u"SELECT $1::int4"_s, {i});
+            }
+            auto results = co_await db->exec(pipeline);
+            AVERIFY(results);
+            AVERIFY(!results->hasError());
+            ACOMPARE_EQ(results->size(), 5);
+            for (int i = 0; i < 5; ++i) {
+                AVERIFY(results->at(i));
+                ACOMPARE_EQ((*results->at(i))[0][0].toInt(), i);
+            }
+
+            // The query after the failing one is skipped and the one before rolled back
+            auto create = co_await db->exec(u"CREATE TEMP TABLE pipeline_batch (id int4)"_s);
+            AVERIFY(create);
+
+            APipeline failing;
+            failing.exec(u"INSERT INTO pipeline_batch VALUES ($1)"_s, {1})
+                .exec(u"SELECT 1/0"_s)
+                .exec(u"INSERT INTO pipeline_batch VALUES ($1)"_s, {2});
+            results = co_await db->exec(failing);
+            AVERIFY(results);
+            AVERIFY(results->hasError());
+            AVERIFY(results->aborted());
+            ACOMPARE_EQ(results->failedIndex(), 1);
+            AVERIFY(!results->errorString().isEmpty());
+            AVERIFY(results->at(0));
+            AVERIFY(!results->at(2));
+
+            auto count = co_await db->exec(u"SELECT count(*) FROM pipeline_batch"_s);
+            AVERIFY(count);
+            ACOMPARE_EQ((*count)[0][0].toInt(), 0);
+
+            // Multiple commands can't be pipelined, so the batch takes more than one sync
+            // and the queries fail on their own
+            APipeline split;
+            split.exec(u"INSERT INTO pipeline_batch VALUES ($1)"_s, {3})
+                .exec(u"SELECT 1/0; SELECT 1"_s);
+            results = co_await db->exec(split);
+            AVERIFY(results);
+            AVERIFY(results->hasError());
+            AVERIFY(!results->aborted());
+            ACOMPARE_EQ(results->failedIndex(), 1);
+            AVERIFY(results->at(0));
+
+            count = co_await db->exec(u"SELECT count(*) FROM pipeline_batch"_s);
+            AVERIFY(count);
+            ACOMPARE_EQ((*count)[0][0].toInt(), 1);
+
+            // In pipeline mode the batch is synced by itself
+            AVERIFY(db->enterPipelineMode(std::chrono::milliseconds{0}));
+            results = co_await db->exec(pipeline);
+            AVERIFY(results);
+            AVERIFY(!results->hasError());
+            ACOMPARE_EQ(results->size(), 5);
+            AVERIFY(db->exitPipelineMode());
+
+            co_await db->exec(u"DROP TABLE pipeline_batch"_s);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testPreparedCache()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            db->setPreparedCacheCapacity(2);
+            auto restore = qScopeGuard([db]() mutable { db->setPreparedCacheCapacity(0); });
+            const APreparedCacheStats before = db->preparedCacheStats();
+            ACOMPARE_EQ(before.capacity, 2);
+
+            const APreparedQuery first(u"SELECT $1::int4 + 1"_s);
+            const APreparedQuery second(u"SELECT $1::int4 + 2"_s);
+            const APreparedQuery third(u"SELECT $1::int4 + 3"_s);
+
+            // first and second are evicted once third and first are prepared again
+            for (const auto &[query, expected] : {std::pair{first, 2},
+                                                  std::pair{second, 3},
+                                                  std::pair{third, 4},
+                                                  std::pair{first, 2},
+                                                  std::pair{first, 2}}) {
+                auto result = co_await db->exec(query, {1});
+                AVERIFY(result);
+                ACOMPARE_EQ((*result)[0][0].toInt(), expected);
+            }
+
+            const APreparedCacheStats after = db->preparedCacheStats();
+            ACOMPARE_EQ(after.hits - before.hits, 1u);
+            ACOMPARE_EQ(after.misses - before.misses, 4u);
+            ACOMPARE_EQ(after.evictions - before.evictions, 2u);
+            ACOMPARE_EQ(after.size, 2);
+
+            // Evicted statements are deallocated on the server
+            auto server = co_await db->exec(
+                u8"SELECT count(*) FROM pg_prepared_statements WHERE name LIKE 'asql\\_%'");
+            AVERIFY(server);
+            ACOMPARE_EQ((*server)[0][0].toInt(), 2);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testCancelOnReceiverDestroyed()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            QElapsedTimer timer;
+            timer.start();
+
+            // Destroying the receiver cancels the running query without
+            // blocking, so the next query on the connection runs right away
+            auto receiver = new QObject;
+            QTimer::singleShot(200, receiver, &QObject::deleteLater);
+            [](ADatabase db, QObject *receiver) -> ACoroTerminator {
+                co_yield receiver;
+                co_await db.exec(u8"SELECT pg_sleep(30)", receiver);
+                qFatal("Coroutine must not be resumed");
+            }(*db, receiver);
+
+            auto result = co_await db->exec(u8"SELECT 42");
+            AVERIFY(result);
+            ACOMPARE_EQ((*result)[0][0].toInt(), 42);
+            AVERIFY(timer.elapsed() < 10000);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testQueryTimeout()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            QElapsedTimer timer;
+            timer.start();
+
+            db->setQueryTimeout(std::chrono::milliseconds{300});
+            auto running = db->exec(u8"SELECT pg_sleep(30)");
+            auto queued  = db->exec(u8"SELECT 1");
+            db->setQueryTimeout({});
+            auto later = db->exec(u8"SELECT 42");
+
+            auto runningResult = co_await running;
+            AVERIFY(!runningResult);
+            ACOMPARE_EQ(runningResult.error(), u"Query timed out"_s);
+
+            auto queuedResult = co_await queued;
+            AVERIFY(!queuedResult);
+            ACOMPARE_EQ(queuedResult.error(), u"Query timed out"_s);
+
+            // Queries without a deadline still run once the cancelled one is done
+            auto laterResult = co_await later;
+            AVERIFY(laterResult);
+            ACOMPARE_EQ((*laterResult)[0][0].toInt(), 42);
+            AVERIFY(timer.elapsed() < 10000);
+
+            // A pipelined transaction timing out while queued is rolled back, not left open
+            db->setQueryTimeout(std::chrono::milliseconds{300});
+            auto sleeping = db->exec(u8"SELECT pg_sleep(30)");
+            auto t        = co_await db->begin(ADatabase::TransactionMode::Pipelined);
+            AVERIFY(t);
+            auto statement = db->exec(u8"SELECT 1");
+            auto commit    = t->commit();
+            db->setQueryTimeout({});
+
+            AVERIFY(!co_await sleeping);
+            auto statementResult = co_await statement;
+            AVERIFY(!statementResult);
+            ACOMPARE_EQ(statementResult.error(), u"Query timed out"_s);
+            auto commitResult = co_await commit;
+            AVERIFY(!commitResult);
+            ACOMPARE_EQ(commitResult.error(), u"Query timed out"_s);
+
+            auto outside = co_await db->exec(u8"SELECT now() = statement_timestamp()");
+            AVERIFY(outside);
+            AVERIFY((*outside)[0][0].toBool());
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testQueueLimit()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            db->setMaxQueueSize(2);
+            auto first  = db->exec(u8"SELECT 1");
+            auto second = db->exec(u8"SELECT 2");
+            auto third  = db->exec(u8"SELECT 3");
+            AVERIFY(APool::queueSize() >= 2);
+
+            auto thirdResult = co_await third;
+            AVERIFY(!thirdResult);
+            ACOMPARE_EQ(thirdResult.error(), u"Query queue is full"_s);
+
+            AVERIFY(co_await first);
+            AVERIFY(co_await second);
+
+            // A pipeline takes room for all of its queries
+            APipeline pipeline;
+            pipeline.exec(u"SELECT 1"_s).exec(u"SELECT 2"_s);
+            auto queued     = db->exec(u8"SELECT 1");
+            auto notFitting = co_await db->exec(pipeline);
+            AVERIFY(!notFitting);
+            ACOMPARE_EQ(notFitting.error(), u"Query queue is full"_s);
+            AVERIFY(co_await queued);
+            auto fitting = co_await db->exec(pipeline);
+            AVERIFY(fitting);
+            AVERIFY(!fitting->hasError());
+
+            // Waiting queries are sent in order as the queue drains
+            db->setMaxQueueSize(1, ADatabase::QueueOverflow::Wait);
+            auto a = db->exec(u8"SELECT 1");
+            auto b = db->exec(u8"SELECT 2");
+            auto c = db->exec(u8"SELECT 3");
+            ACOMPARE_EQ(db->queueSize(), 1);
+
+            auto aResult = co_await a;
+            AVERIFY(aResult);
+            ACOMPARE_EQ((*aResult)[0][0].toInt(), 1);
+            auto bResult = co_await b;
+            AVERIFY(bResult);
+            ACOMPARE_EQ((*bResult)[0][0].toInt(), 2);
+            auto cResult = co_await c;
+            AVERIFY(cResult);
+            ACOMPARE_EQ((*cResult)[0][0].toInt(), 3);
+
+            // Statements of a pipelined transaction don't wait, they run before its COMMIT
+            auto t = co_await db->begin(ADatabase::TransactionMode::Pipelined);
+            AVERIFY(t);
+            auto inside = db->exec(u8"SELECT 5");
+            auto commit = t->commit();
+
+            auto insideResult = co_await inside;
+            AVERIFY(insideResult);
+            ACOMPARE_EQ((*insideResult)[0][0].toInt(), 5);
+            AVERIFY(co_await commit);
+
+            // Waiting queries fail when the connection is lost
+            auto pid = co_await db->exec(u8"SELECT pg_backend_pid()");
+            AVERIFY(pid);
+            auto sleeping = db->exec(u8"SELECT pg_sleep(10)");
+            auto waiting  = db->exec(u8"SELECT 4");
+
+            auto killer = co_await APool::database();
+            AVERIFY(killer);
+            AVERIFY(co_await killer->exec(u8"SELECT pg_terminate_backend($1)",
+                                          {(*pid)[0][0].toInt()}));
+            AVERIFY(!co_await sleeping);
+            AVERIFY(!co_await waiting);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testNotificationHub()
+{
+    const QString url = qEnvironmentVariable("ASQL_PG_TEST_DB", u"postgresql:///"_s);
+    auto hub          = ANotificationHub::create(APg::factory(url), u"hub");
+    QCOMPARE(ANotificationHub::instance(u"hub"), hub);
+    QTRY_VERIFY(hub->database().isOpen());
+
+    QObject receiver;
+    int received = 0;
+    QString payload;
+    const quint64 receiverId =
+        hub->subscribe(u"hub_test"_s, &receiver, [&](const ADatabaseNotification &notification) {
+        ++received;
+        payload = notification.payload.toString();
+    });
+
+    int receivedNoReceiver = 0;
+    const quint64 noReceiverId =
+        hub->subscribe(u"hub_test"_s, nullptr, [&](const ADatabaseNotification &) {
+        ++receivedNoReceiver;
+    });
+
+    QThread worker;
+    worker.start();
+    auto workerReceiver = new QObject;
+    workerReceiver->moveToThread(&worker);
+    std::atomic_int receivedWorker        = 0;
+    std::atomic<QThread *> receivedThread = nullptr;
+    hub->subscribe(u"hub_test"_s, workerReceiver, [&](const ADatabaseNotification &) {
+        receivedThread = QThread::currentThread();
+        ++receivedWorker;
+    });
+
+    // A single LISTEN is shared by all subscribers
+    QCOMPARE(hub->channels(), QStringList{u"hub_test"_s});
+    QTRY_COMPARE(hub->database().subscribedToNotifications(), QStringList{u"hub_test"_s});
+
+    auto notify = hub->database().exec(u8"NOTIFY hub_test, 'hello'");
+    QTRY_COMPARE(received, 1);
+    QTRY_COMPARE(receivedNoReceiver, 1);
+    QTRY_COMPARE(receivedWorker.load(), 1);
+    QCOMPARE(payload, u"hello"_s);
+    QCOMPARE(receivedThread.load(), &worker);
+
+    hub->unsubscribe(receiverId);
+    hub->unsubscribe(noReceiverId);
+    notify = hub->database().exec(u8"NOTIFY hub_test, 'again'");
+    QTRY_COMPARE(receivedWorker.load(), 2);
+    QCOMPARE(received, 1);
+    QCOMPARE(receivedNoReceiver, 1);
+
+    // Destroying the last receiver UNLISTENs the channel
+    QMetaObject::invokeMethod(workerReceiver, &QObject::deleteLater);
+    QTRY_VERIFY(hub->channels().isEmpty());
+    QTRY_VERIFY(hub->database().subscribedToNotifications().isEmpty());
+
+    worker.quit();
+    worker.wait();
+    ANotificationHub::remove(u"hub");
+    QCOMPARE(ANotificationHub::instance(u"hub"), nullptr);
+}
+
+void TestPg::testNotificationCoalescing()
+{
+    const QString url = qEnvironmentVariable("ASQL_PG_TEST_DB", u"postgresql:///"_s);
+    auto hub          = ANotificationHub::create(APg::factory(url), u"hub");
+    QTRY_VERIFY(hub->database().isOpen());
+
+    int batches = 0;
+    QList<ADatabaseNotification> batched;
+    hub->subscribeBatch(
+        u"hub_burst"_s, nullptr, [&](const QList<ADatabaseNotification> &notifications) {
+        ++batches;
+        batched.append(notifications);
+    }, {.interval = std::chrono::milliseconds{200}});
+
+    int latestCalls = 0;
+    QString latest;
+    hub->subscribe(u"hub_burst"_s, nullptr, [&](const ADatabaseNotification &notification) {
+        ++latestCalls;
+        latest = notification.payload.toString();
+    }, {.interval = std::chrono::milliseconds{200}, .latestOnly = true});
+
+    QStringList unique;
+    hub->subscribe(u"hub_repeat"_s, nullptr, [&](const ADatabaseNotification &notification) {
+        unique.append(notification.payload.toString());
+    }, {.interval = std::chrono::milliseconds{200}, .deduplicate = true});
+
+    QTRY_COMPARE(hub->database().subscribedToNotifications().size(), 2);
+
+    // A burst of distinct payloads sent in a single transaction
+    auto burst = hub->database().exec(
+        u8"SELECT pg_notify('hub_burst', i::text) FROM generate_series(1, 1000) i");
+    QTRY_COMPARE(batched.size(), 1000);
+    QVERIFY(batches < 10);
+    QCOMPARE(batched.last().payload.toString(), u"1000"_s);
+    QTRY_COMPARE(latest, u"1000"_s);
+    QVERIFY(latestCalls < 10);
+
+    // Postgres only folds duplicates within a transaction, send each on its own
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished, ADatabase db) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            for (const QString &query : {u"NOTIFY hub_repeat, 'a'"_s,
+                                         u"NOTIFY hub_repeat, 'b'"_s,
+                                         u"NOTIFY hub_repeat, 'a'"_s,
+                                         u"NOTIFY hub_repeat, 'a'"_s}) {
+                auto result = co_await db.exec(QStringView(query));
+                AVERIFY(result);
+            }
+        }(finished, hub->database());
+    }
+    loop.exec();
+
+    QTRY_COMPARE(unique.size(), 2);
+    QTest::qWait(300);
+    QCOMPARE(unique, (QStringList{u"a"_s, u"b"_s}));
+
+    ANotificationHub::remove(u"hub");
+}
+
+void TestPg::testPreparedFieldIndex()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            // Results of the same prepared statement share their field index
+            const APreparedQuery query(u"SELECT $1::int4 AS id, $1::int4 * 2 AS twice"_s);
+            for (int i = 1; i <= 3; ++i) {
+                auto result = co_await db->exec(query, {i});
+                AVERIFY(result);
+                ACOMPARE_EQ(result->indexOfField(u"twice"_s), 1);
+                ACOMPARE_EQ((*result)[0][QLatin1String("id")].toInt(), i);
+                ACOMPARE_EQ((*result)[0][u"twice"_s].toInt(), i * 2);
+            }
+
+            auto other = co_await db->exec(u8"SELECT 2 AS twice, 1 AS id");
+            AVERIFY(other);
+            ACOMPARE_EQ(other->indexOfField(u"twice"_s), 0);
+
+            // A statement prepared again after its table changed gets a new index
+            db->setPreparedCacheCapacity(1);
+            auto restore = qScopeGuard([db]() mutable { db->setPreparedCacheCapacity(0); });
+            AVERIFY(co_await db->exec(u8"CREATE TEMP TABLE asql_fields (a int4, b int4)"));
+            AVERIFY(co_await db->exec(u8"INSERT INTO asql_fields VALUES (1, 2)"));
+            const APreparedQuery select(u"SELECT * FROM asql_fields"_s);
+            auto before = co_await db->exec(select);
+            AVERIFY(before);
+            ACOMPARE_EQ(before->indexOfField(u"a"_s), 0);
+
+            // Evicts the statement
+            AVERIFY(co_await db->exec(query, {1}));
+            AVERIFY(co_await db->exec(u8"DROP TABLE asql_fields"));
+            AVERIFY(co_await db->exec(u8"CREATE TEMP TABLE asql_fields (b int4, a int4)"));
+            AVERIFY(co_await db->exec(u8"INSERT INTO asql_fields VALUES (2, 1)"));
+            auto after = co_await db->exec(select);
+            AVERIFY(after);
+            ACOMPARE_EQ(after->indexOfField(u"a"_s), 1);
+            ACOMPARE_EQ((*after)[0][u"a"_s].toInt(), 1);
+            ACOMPARE_EQ(before->indexOfField(u"a"_s), 0);
+            AVERIFY(co_await db->exec(u8"DROP TABLE asql_fields"));
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testPreparedDescribe()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            // Nulls leave the parameter types for the server to infer
+            const APreparedQuery query(u"SELECT $1::int8 AS n, $2::timestamptz AS at"_s);
+            auto first = co_await db->exec(query, {QVariant{}, QVariant{}});
+            AVERIFY(first);
+            AVERIFY((*first)[0][0].isNull());
+            ACOMPARE_EQ(first->indexOfField(u"at"_s), 1);
+
+            // Values are then sent in the types the statement was described with
+            const QDateTime local(QDate(2024, 2, 29), QTime(13, 45, 7), QTimeZone::LocalTime);
+            auto second = co_await db->exec(query, {7, local});
+            AVERIFY(second);
+            ACOMPARE_EQ((*second)[0][u"n"_s].toLongLong(), 7);
+            ACOMPARE_EQ((*second)[0][u"at"_s].toDateTime().toMSecsSinceEpoch(),
+                        local.toMSecsSinceEpoch());
+
+            auto third = co_await db->exec(query, {u"42"_s, QVariant{}});
+            AVERIFY(third);
+            ACOMPARE_EQ((*third)[0][0].toLongLong(), 42);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPg::testCursor()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            auto cursor =
+                co_await db->cursor(u"SELECT generate_series(1, $1::int4) AS n"_s, {2500}, 1000);
+            AVERIFY(cursor);
+            AVERIFY(cursor->isActive());
+            AVERIFY(cursor->transaction().isActive());
+
+            QList<int> pages;
+            qint64 sum = 0;
+            while (!cursor->atEnd()) {
+                auto page = co_await cursor->fetch();
+                AVERIFY(page);
+                pages.append(page->size());
+                for (auto row : *page) {
+                    sum += row[u"n"_s].toLongLong();
+                }
+            }
+            ACOMPARE_EQ(pages, QList<int>({1000, 1000, 500}));
+            ACOMPARE_EQ(sum, Q_INT64_C(3126250));
+
+            auto empty = co_await cursor->fetch();
+            AVERIFY(empty);
+            ACOMPARE_EQ(empty->size(), 0);
+
+            auto closed = co_await cursor->close();
+            AVERIFY(closed);
+            AVERIFY(!cursor->isActive());
+            AVERIFY(!co_await cursor->fetch());
+
+            // The transaction of the caller is left running
+            auto transaction = co_await db->begin();
+            AVERIFY(transaction);
+            auto inTransaction =
+                co_await db->cursor(*transaction, u"SELECT generate_series(1, 10)"_s, {}, 4);
+            AVERIFY(inTransaction);
+            auto page = co_await inTransaction->fetch();
+            AVERIFY(page);
+            ACOMPARE_EQ(page->size(), 4);
+            AVERIFY(co_await inTransaction->close());
+            AVERIFY(transaction->isActive());
+
+            // Releasing the cursor doesn't end it either
+            {
+                auto released = co_await db->cursor(*transaction, u"SELECT 1"_s);
+                AVERIFY(released);
+                AVERIFY(released->transaction().isActive());
+            }
+            AVERIFY(transaction->isActive());
+            AVERIFY(co_await transaction->commit());
+
+            auto failed = co_await db->cursor(u"SELECT * FROM missing_table"_s);
+            AVERIFY(!failed);
+        }(finished);
+    }
+    loop.exec();
+}
+
+QTEST_MAIN(TestPg)
+#include "pg_tst.moc"
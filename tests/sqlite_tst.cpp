@@ -11,6 +11,7 @@
 #include <QJsonObject>
 #include <QObject>
 #include <QStandardPaths>
+#include <QTemporaryDir>
 #include <QTest>
 #include <QUrl>
 
@@ -35,6 +36,10 @@ private Q_SLOTS:
     void testPoolBeginRollback();
     void testDatabaseBeginCommit();
     void testDatabaseBeginRollback();
+    void testQueryTimeout();
+    void testPoolFailover();
+    void testPoolLoadBalancing();
+    void testFieldLookup();
 };
 
 void TestSqlite::initTest()
@@ -651,6 +656,166 @@ void TestSqlite::testDatabaseBeginRollback()
     loop.exec();
 }
 
+void TestSqlite::testQueryTimeout()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        auto queryTimeout = [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            APool::setQueryTimeout(std::chrono::milliseconds{200});
+            auto restore = qScopeGuard([] { APool::setQueryTimeout({}); });
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+            ACOMPARE_EQ(db->queryTimeout(), std::chrono::milliseconds{200});
+
+            // The second query times out while waiting for the first one
+            auto runaway = db->exec(u"WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL "
+                                    "SELECT x + 1 FROM c) SELECT count(*) FROM c"_s);
+            auto queued  = db->exec(u"SELECT ?"_s, {1});
+
+            auto runawayResult = co_await runaway;
+            AVERIFY(!runawayResult);
+            ACOMPARE_EQ(runawayResult.error(), u"Query timed out"_s);
+
+            auto queuedResult = co_await queued;
+            AVERIFY(!queuedResult);
+            ACOMPARE_EQ(queuedResult.error(), u"Query timed out"_s);
+
+            // The connection is still usable
+            db->setQueryTimeout({});
+            auto select = co_await db->exec(u"SELECT 42"_s);
+            AVERIFY(select);
+            ACOMPARE_EQ((*select)[0][0].toInt(), 42);
+        };
+        queryTimeout(finished);
+    }
+    loop.exec();
+}
+
+void TestSqlite::testPoolFailover()
+{
+    const QString poolName = u"failover"_s;
+    APool::create(std::vector<APoolEndpoint>{
+                      {.factory = ASqlite::factory(u"sqlite:///no/such/asql/path/db.sqlite?READONLY"_s)},
+                      {.factory = ASqlite::factory(u"sqlite://?MEMORY"_s),
+                       .role    = APoolEndpoint::Role::Standby},
+                  },
+                  poolName);
+
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished, QStringView poolName) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            // The primary fails to open, the standby is used instead
+            auto db = co_await APool::database(nullptr, poolName);
+            AVERIFY(db);
+            ACOMPARE_EQ(db->driver()->connectionInfo(), u"sqlite://?MEMORY"_s);
+
+            auto result = co_await db->exec(u8"SELECT 42");
+            AVERIFY(result);
+            ACOMPARE_EQ((*result)[0][0].toInt(), 42);
+
+            // While the primary is down new connections go straight to the standby
+            auto other = co_await APool::database(nullptr, poolName);
+            AVERIFY(other);
+            ACOMPARE_EQ(other->driver()->connectionInfo(), u"sqlite://?MEMORY"_s);
+            ACOMPARE_EQ(APool::currentConnections(poolName), 2);
+        }(finished, poolName);
+    }
+    loop.exec();
+
+    APool::remove(poolName);
+}
+
+void TestSqlite::testPoolLoadBalancing()
+{
+    // Each run starts from a fresh database
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const QString poolName = u"balanced"_s;
+    QUrl fileUrl           = QUrl::fromLocalFile(dir.filePath(u"balanced.db"_s));
+    fileUrl.setScheme(u"sqlite"_s);
+
+    APool::create(std::vector<APoolEndpoint>{
+                      {.factory = ASqlite::factory(u"sqlite://?MEMORY"_s)},
+                      {.factory = ASqlite::factory(fileUrl.toString())},
+                  },
+                  poolName);
+    APool::setMaxIdleConnections(5, poolName);
+
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished,
+           QStringView poolName,
+           QString fileInfo) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto first = co_await APool::database(nullptr, poolName);
+            AVERIFY(first);
+            auto second = co_await APool::database(nullptr, poolName);
+            AVERIFY(second);
+
+            // Both endpoints are idle, so connections are spread among them
+            QStringList infos{first->driver()->connectionInfo(),
+                              second->driver()->connectionInfo()};
+            infos.sort();
+            ACOMPARE_EQ(infos, (QStringList{fileInfo, u"sqlite://?MEMORY"_s}));
+        }(finished, poolName, fileUrl.toString());
+    }
+    loop.exec();
+
+    APool::remove(poolName);
+}
+
+void TestSqlite::testFieldLookup()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto result = co_await APool::exec(
+                u8"SELECT 1 a, 2 b, 3 a, 4 c, 5 d, 6 e, 7 f, 8 g, 9 h, 10 i, 11 j, 12 ação");
+            AVERIFY(result);
+
+            // Duplicated names resolve to the first column
+            ACOMPARE_EQ(result->indexOfField(u"a"_s), 0);
+            ACOMPARE_EQ(result->indexOfField(u"b"), 1);
+            ACOMPARE_EQ(result->indexOfField(u"j"), 10);
+            ACOMPARE_EQ(result->indexOfField(u"ação"_s), 11);
+            ACOMPARE_EQ(result->indexOfField(u"missing"_s), -1);
+
+            auto row = (*result)[0];
+            ACOMPARE_EQ(row[u"c"_s].toInt(), 4);
+            ACOMPARE_EQ(row[QLatin1String("h")].toInt(), 9);
+            ACOMPARE_EQ(row.value(QStringView(u"ação")).toInt(), 12);
+
+            // Lookups are not cached across results with a different column order
+            auto swapped = co_await APool::exec(u8"SELECT 2 b, 1 a");
+            AVERIFY(swapped);
+            ACOMPARE_EQ(AColumnIndex((*result), u"b"_s), 1);
+            ACOMPARE_EQ(AColumnIndex((*swapped), u"b"_s), 0);
+        }(finished);
+    }
+    loop.exec();
+}
+
 QTEST_MAIN(TestSqlite)
 #include "sqlite_tst.moc"
 
@@ -0,0 +1,352 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#include "CoverageObject.hpp"
+#include "acoroexpected.h"
+#include "adatabase.h"
+#include "apg.h"
+#include "apgnative.h"
+#include "apool.h"
+#include "apreparedquery.h"
+
+#include <QBuffer>
+#include <QObject>
+#include <QTest>
+
+using namespace ASql;
+using namespace Qt::Literals::StringLiterals;
+
+class TestPgNative : public CoverageObject
+{
+    Q_OBJECT
+public:
+    void initTest() override;
+    void cleanupTest() override;
+
+private Q_SLOTS:
+    void testSameResultsAsLibpq();
+    void testPipelinedQueries();
+    void testPipelineMode();
+    void testPrepared();
+    void testCopy();
+    void testChunkedRows();
+    void testLargeRows();
+};
+
+void TestPgNative::initTest()
+{
+    if (!qEnvironmentVariableIsSet("ASQL_PG_TEST_DB")) {
+        QSKIP("ASQL_PG_TEST_DB not set; skipping native PostgreSQL tests");
+    }
+    const QString url = qEnvironmentVariable("ASQL_PG_TEST_DB", u"postgresql:///"_s);
+    APool::create(APgNative::factory(url));
+    APool::setMaxIdleConnections(2);
+    APool::setMaxConnections(5);
+
+    APool::create(APg::factory(url), u"libpq"_s);
+}
+
+void TestPgNative::cleanupTest()
+{
+    APool::remove();
+    APool::remove(u"libpq"_s);
+}
+
+void TestPgNative::testSameResultsAsLibpq()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto native = co_await APool::database();
+            AVERIFY(native);
+            auto libpq = co_await APool::database(nullptr, u"libpq"_s);
+            AVERIFY(libpq);
+
+            const QString query =
+                u"SELECT g AS id, g * 1.5::float8 AS half, 'row ' || g AS name, "
+                "CASE WHEN g % 3 = 0 THEN NULL ELSE g % 2 = 0 END AS even, "
+                "'2024-02-29'::date + g AS day, '{\"a\": 1}'::jsonb AS doc, "
+                "'\\x00ff'::bytea AS data, 'a2b5d1e4-1c2d-4e5f-8a9b-0c1d2e3f4a5b'::uuid AS id2 "
+                "FROM generate_series(1, $1::int4) g"_s;
+
+            for (auto format : {ADatabase::ResultFormat::Text, ADatabase::ResultFormat::Binary}) {
+                native->setResultFormat(format);
+                libpq->setResultFormat(format);
+
+                auto expected = co_await libpq->exec(query, {50});
+                AVERIFY(expected);
+                auto result = co_await native->exec(query, {50});
+                AVERIFY(result);
+
+                ACOMPARE_EQ(result->size(), expected->size());
+                ACOMPARE_EQ(result->fields(), expected->fields());
+                ACOMPARE_EQ(result->numRowsAffected(), expected->numRowsAffected());
+                for (int column = 0; column < result->fields(); ++column) {
+                    ACOMPARE_EQ(result->fieldName(column), expected->fieldName(column));
+                }
+                for (int row = 0; row < result->size(); ++row) {
+                    for (int column = 0; column < result->fields(); ++column) {
+                        const auto value     = (*result)[row][column];
+                        const auto reference = (*expected)[row][column];
+                        ACOMPARE_EQ(value.isNull(), reference.isNull());
+                        ACOMPARE_EQ(value.value(), reference.value());
+                        ACOMPARE_EQ(value.toString(), reference.toString());
+                    }
+                }
+            }
+
+            native->setResultFormat(ADatabase::ResultFormat::Text);
+            libpq->setResultFormat(ADatabase::ResultFormat::Text);
+
+            auto failed = co_await native->exec(u"SELECT * FROM missing_table"_s);
+            AVERIFY(!failed);
+            AVERIFY(failed.error().contains(u"missing_table"));
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPgNative::testPipelinedQueries()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            // All queries are written right away, errors do not affect the others
+            std::vector<AExpectedResult> queries;
+            for (int i = 0; i < 100; ++i) {
+                if (i == 50) {
+                    queries.emplace_back(db->exec(u"SELECT 1/0"_s));
+                } else {
+                    queries.emplace_back(db->exec(u"SELECT $1::int4"_s, {i}));
+                }
+            }
+            auto multi = db->execMulti(u"SELECT 1; SELECT 2"_s);
+
+            for (int i = 0; i < 100; ++i) {
+                auto result = co_await queries[i];
+                if (i == 50) {
+                    AVERIFY(!result);
+                    continue;
+                }
+                AVERIFY(result);
+                ACOMPARE_EQ((*result)[0][0].toInt(), i);
+            }
+
+            auto multiResult = co_await multi;
+            AVERIFY(multiResult);
+            ACOMPARE_EQ((*multiResult)[0][0].toInt(), 1);
+            AVERIFY(!multiResult->lastResultSet());
+            multiResult = co_await multi;
+            AVERIFY(multiResult);
+            ACOMPARE_EQ((*multiResult)[0][0].toInt(), 2);
+            AVERIFY(multiResult->lastResultSet());
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPgNative::testPipelineMode()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            AVERIFY(db->enterPipelineMode());
+            ACOMPARE_EQ(db->pipelineStatus(), ADatabase::PipelineStatus::On);
+
+            // An error aborts the queries up to the next sync
+            auto first   = db->exec(u"SELECT $1::int4"_s, {1});
+            auto failed  = db->exec(u"SELECT 1/0"_s);
+            auto skipped = db->exec(u"SELECT $1::int4"_s, {3});
+            AVERIFY(db->pipelineSync());
+            auto last = db->exec(u"SELECT $1::int4"_s, {4});
+            AVERIFY(db->pipelineSync());
+
+            auto firstResult = co_await first;
+            AVERIFY(firstResult);
+            ACOMPARE_EQ((*firstResult)[0][0].toInt(), 1);
+            AVERIFY(!co_await failed);
+            AVERIFY(!co_await skipped);
+
+            auto lastResult = co_await last;
+            AVERIFY(lastResult);
+            ACOMPARE_EQ((*lastResult)[0][0].toInt(), 4);
+
+            AVERIFY(db->exitPipelineMode());
+            ACOMPARE_EQ(db->pipelineStatus(), ADatabase::PipelineStatus::Off);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPgNative::testPrepared()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            // The statement is prepared once, even when used before it completes
+            auto first  = db->exec(APreparedQueryLiteral(u"SELECT $1::int4 AS n, $2::text"_s),
+                                  {1, u"one"_s});
+            auto second = db->exec(APreparedQueryLiteral(u"SELECT $1::int4 AS n, $2::text"_s),
+                                   {2, QVariant{}});
+
+            auto firstResult = co_await first;
+            AVERIFY(firstResult);
+            ACOMPARE_EQ((*firstResult)[0][u"n"].toInt(), 1);
+            ACOMPARE_EQ((*firstResult)[0][1].toString(), u"one"_s);
+
+            auto secondResult = co_await second;
+            AVERIFY(secondResult);
+            ACOMPARE_EQ((*secondResult)[0][u"n"].toInt(), 2);
+            AVERIFY((*secondResult)[0][1].isNull());
+
+            // Failing to prepare does not leave a broken statement behind
+            for (int i = 0; i < 2; ++i) {
+                auto failed = co_await db->exec(
+                    APreparedQueryLiteral(u"SELECT * FROM missing_table WHERE id = $1"_s), {i});
+                AVERIFY(!failed);
+            }
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPgNative::testCopy()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            AVERIFY(co_await db->exec(
+                u"CREATE TEMPORARY TABLE native_copy (id int4, name text)"_s));
+
+            auto copy = co_await db->copyIn(u"COPY native_copy (id, name) FROM STDIN"_s);
+            AVERIFY(copy);
+            for (int i = 1; i <= 1000; ++i) {
+                AVERIFY(copy->writeRow({i, u"name %1"_s.arg(i)}));
+            }
+            auto copied = co_await copy->finish();
+            AVERIFY(copied);
+            ACOMPARE_EQ(copied->numRowsAffected(), 1000);
+
+            QBuffer buffer;
+            AVERIFY(buffer.open(QIODevice::WriteOnly));
+            auto out = co_await db->copyOut(
+                u"COPY (SELECT * FROM native_copy WHERE id <= 2 ORDER BY id) TO STDOUT"_s,
+                &buffer);
+            AVERIFY(out);
+            ACOMPARE_EQ(out->numRowsAffected(), 2);
+            ACOMPARE_EQ(buffer.data(), QByteArray("1\tname 1\n2\tname 2\n"));
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPgNative::testChunkedRows()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            auto stream = db->execStream(
+                u"SELECT generate_series(1, $1::int4) AS n"_s, {1050}, 100);
+            int rows   = 0;
+            qint64 sum = 0;
+            while (true) {
+                auto batch = co_await stream;
+                AVERIFY(batch);
+                AVERIFY(batch->size() <= 100);
+                for (auto row : *batch) {
+                    ++rows;
+                    sum += row[0].toLongLong();
+                }
+                if (batch->lastResultSet()) {
+                    break;
+                }
+            }
+            ACOMPARE_EQ(rows, 1050);
+            ACOMPARE_EQ(sum, Q_INT64_C(551775));
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestPgNative::testLargeRows()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+
+            // Rows larger than the receive buffers and results spanning many of them
+            auto result = co_await db->exec(
+                u"SELECT g, repeat('x', g * 1000) FROM generate_series(1, 300) g"_s);
+            AVERIFY(result);
+            ACOMPARE_EQ(result->size(), 300);
+            for (auto row : *result) {
+                ACOMPARE_EQ(row[1].toString().size(), row[0].toInt() * 1000);
+            }
+
+            // Results kept alive are not overwritten by the following ones
+            auto kept = co_await db->exec(u"SELECT repeat('a', 1000)"_s);
+            AVERIFY(kept);
+            for (int i = 0; i < 200; ++i) {
+                AVERIFY(co_await db->exec(u"SELECT repeat('b', 1000)"_s));
+            }
+            ACOMPARE_EQ((*kept)[0][0].toString(), QString(1000, u'a'));
+        }(finished);
+    }
+    loop.exec();
+}
+
+QTEST_MAIN(TestPgNative)
+#include "tst_PgNative.moc"
@@ -0,0 +1,186 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+ * SPDX-License-Identifier: MIT
+ */
+#include "apgtemporal.h"
+
+#include <QObject>
+#include <QTest>
+#include <QTimeZone>
+
+using namespace ASql;
+using namespace Qt::Literals::StringLiterals;
+
+namespace {
+
+// The text decoding done before the dedicated parser existed
+QDateTime isoDateTime(QByteArrayView text)
+{
+    QString value    = QString::fromLatin1(text);
+    const QChar sign = value[value.size() - 3];
+    if (sign == u'-' || sign == u'+') {
+        value += u":00";
+    }
+    return QDateTime::fromString(value, Qt::ISODate);
+}
+
+} // namespace
+
+class TestPgTemporal : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testDate_data();
+    void testDate();
+    void testTime_data();
+    void testTime();
+    void testDateTime_data();
+    void testDateTime();
+    void testUnsupported_data();
+    void testUnsupported();
+    void benchmarkDateTime_data();
+    void benchmarkDateTime();
+};
+
+void TestPgTemporal::testDate_data()
+{
+    QTest::addColumn<QByteArray>("text");
+    QTest::addColumn<QDate>("expected");
+
+    QTest::newRow("date") << "2024-02-29"_ba << QDate(2024, 2, 29);
+    QTest::newRow("first") << "0001-01-01"_ba << QDate(1, 1, 1);
+    QTest::newRow("last") << "9999-12-31"_ba << QDate(9999, 12, 31);
+}
+
+void TestPgTemporal::testDate()
+{
+    QFETCH(QByteArray, text);
+    QFETCH(QDate, expected);
+
+    const auto date = PgTypes::parseDate(text);
+    QVERIFY(date);
+    QCOMPARE(*date, expected);
+    QCOMPARE(*date, QDate::fromString(QString::fromLatin1(text), Qt::ISODate));
+}
+
+void TestPgTemporal::testTime_data()
+{
+    QTest::addColumn<QByteArray>("text");
+    QTest::addColumn<QTime>("expected");
+
+    QTest::newRow("time") << "13:45:07"_ba << QTime(13, 45, 7);
+    QTest::newRow("msecs") << "13:45:07.25"_ba << QTime(13, 45, 7, 250);
+    QTest::newRow("usecs") << "13:45:07.123456"_ba << QTime(13, 45, 7, 123);
+    QTest::newRow("rounded") << "13:45:07.000999"_ba << QTime(13, 45, 7, 1);
+    QTest::newRow("no rollover") << "23:59:59.9999"_ba << QTime(23, 59, 59, 999);
+    QTest::newRow("timetz") << "13:45:07+05:30"_ba << QTime(13, 45, 7);
+}
+
+void TestPgTemporal::testTime()
+{
+    QFETCH(QByteArray, text);
+    QFETCH(QTime, expected);
+
+    const auto time = PgTypes::parseTime(text);
+    QVERIFY(time);
+    QCOMPARE(*time, expected);
+}
+
+void TestPgTemporal::testDateTime_data()
+{
+    QTest::addColumn<QByteArray>("text");
+    QTest::addColumn<QDateTime>("expected");
+
+    QTest::newRow("date") << "2024-02-29"_ba
+                          << QDateTime(QDate(2024, 2, 29), QTime(0, 0), QTimeZone::LocalTime);
+    QTest::newRow("timestamp")
+        << "2024-02-29 13:45:07"_ba
+        << QDateTime(QDate(2024, 2, 29), QTime(13, 45, 7), QTimeZone::LocalTime);
+    QTest::newRow("timestamp usecs")
+        << "2024-02-29 13:45:07.5"_ba
+        << QDateTime(QDate(2024, 2, 29), QTime(13, 45, 7, 500), QTimeZone::LocalTime);
+    QTest::newRow("timestamptz utc")
+        << "2024-02-29 13:45:07.123+00"_ba
+        << QDateTime(QDate(2024, 2, 29), QTime(13, 45, 7, 123), QTimeZone::UTC);
+    QTest::newRow("timestamptz negative")
+        << "2024-02-29 13:45:07-03"_ba
+        << QDateTime(QDate(2024, 2, 29), QTime(16, 45, 7), QTimeZone::UTC);
+    QTest::newRow("timestamptz minutes")
+        << "2024-02-29 13:45:07+05:30"_ba
+        << QDateTime(QDate(2024, 2, 29), QTime(8, 15, 7), QTimeZone::UTC);
+}
+
+void TestPgTemporal::testDateTime()
+{
+    QFETCH(QByteArray, text);
+    QFETCH(QDateTime, expected);
+
+    const auto dateTime = PgTypes::parseDateTime(text);
+    QVERIFY(dateTime);
+    QCOMPARE(*dateTime, expected);
+    if (text.size() > 10) {
+        // The old decoding mistook the day of plain dates for an offset
+        QCOMPARE(*dateTime, isoDateTime(text));
+    }
+}
+
+void TestPgTemporal::testUnsupported_data()
+{
+    QTest::addColumn<QByteArray>("text");
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("infinity") << "infinity"_ba;
+    QTest::newRow("bc") << "0044-03-15 BC"_ba;
+    QTest::newRow("big year") << "10000-01-01 00:00:00"_ba;
+    QTest::newRow("invalid date") << "2023-02-29 00:00:00"_ba;
+    QTest::newRow("end of day") << "2024-02-29 24:00:00"_ba;
+    QTest::newRow("other datestyle") << "Thu Feb 29 13:45:07 2024"_ba;
+    QTest::newRow("trailing") << "2024-02-29 13:45:07+00x"_ba;
+    QTest::newRow("empty fraction") << "2024-02-29 13:45:07."_ba;
+}
+
+void TestPgTemporal::testUnsupported()
+{
+    QFETCH(QByteArray, text);
+
+    QVERIFY(!PgTypes::parseDateTime(text));
+}
+
+void TestPgTemporal::benchmarkDateTime_data()
+{
+    QTest::addColumn<bool>("parser");
+
+    QTest::newRow("parseDateTime") << true;
+    QTest::newRow("QDateTime::fromString") << false;
+}
+
+void TestPgTemporal::benchmarkDateTime()
+{
+    QFETCH(bool, parser);
+
+    const QByteArrayList values{
+        "2024-02-29 13:45:07.123456+00"_ba,
+        "2024-03-01 00:00:00+05:30"_ba,
+        "2024-03-02 23:59:59.5"_ba,
+        "2024-03-03 12:00:00-03"_ba,
+    };
+
+    qint64 total = 0;
+    if (parser) {
+        QBENCHMARK {
+            for (const QByteArray &value : values) {
+                total += PgTypes::parseDateTime(value)->toMSecsSinceEpoch();
+            }
+        }
+    } else {
+        QBENCHMARK {
+            for (const QByteArray &value : values) {
+                total += isoDateTime(value).toMSecsSinceEpoch();
+            }
+        }
+    }
+    QVERIFY(total != 0);
+}
+
+QTEST_MAIN(TestPgTemporal)
+#include "tst_PgTemporal.moc"
@@ -7,8 +7,13 @@
 #include "apool.h"
 #include "tst_types_common.h"
 
+#include <span>
+
 #include <QJsonDocument>
+#include <QJsonObject>
 #include <QTest>
+#include <QTimeZone>
+#include <QUuid>
 
 using namespace ASql;
 using namespace Qt::Literals::StringLiterals;
@@ -23,6 +28,10 @@ public:
 
 private Q_SLOTS:
     void testJsonbToByteArray();
+    void testBinaryResults();
+    void testBinaryParams();
+    void testArrayParams();
+    void testArrayColumns();
 };
 
 void TestTypesPostgres::initTest()
@@ -64,5 +73,210 @@ void TestTypesPostgres::testJsonbToByteArray()
     loop.exec();
 }
 
+void TestTypesPostgres::testBinaryResults()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+            db->setResultFormat(ADatabase::ResultFormat::Binary);
+            auto restore =
+                qScopeGuard([db]() mutable { db->setResultFormat(ADatabase::ResultFormat::Text); });
+            ACOMPARE_EQ(db->resultFormat(), ADatabase::ResultFormat::Binary);
+
+            auto result = co_await db->exec(
+                u"SELECT true, 42::int2, -123456::int4, 9876543210::int8, 1.5::float4, "
+                "-2.25::float8, 12345.6789::numeric, -0.001::numeric, "
+                "'a2b5d1e4-1c2d-4e5f-8a9b-0c1d2e3f4a5b'::uuid, '2024-02-29'::date, "
+                "'13:45:30.250'::time, '2024-02-29 13:45:30.250'::timestamp, "
+                "'2024-02-29 13:45:30.250+00'::timestamptz, '\\x00ff'::bytea, "
+                "'{\"a\": 1}'::jsonb, 'text'::text, NULL::int4"_s);
+            AVERIFY(result);
+            AVERIFY(!result->hasError());
+            AVERIFY(result->size() == 1);
+
+            const auto row = (*result)[0];
+            ACOMPARE_EQ(row[0].toBool(), true);
+            ACOMPARE_EQ(row[1].toInt(), 42);
+            ACOMPARE_EQ(row[2].toInt(), -123456);
+            ACOMPARE_EQ(row[3].toLongLong(), Q_INT64_C(9876543210));
+            ACOMPARE_EQ(row[4].toDouble(), 1.5);
+            ACOMPARE_EQ(row[5].toDouble(), -2.25);
+            ACOMPARE_EQ(row[6].toDouble(), 12345.6789);
+            ACOMPARE_EQ(row[6].toString(), u"12345.6789"_s);
+            ACOMPARE_EQ(row[7].toString(), u"-0.001"_s);
+            ACOMPARE_EQ(row[8].toUuid(), QUuid(u"a2b5d1e4-1c2d-4e5f-8a9b-0c1d2e3f4a5b"_s));
+            ACOMPARE_EQ(row[9].toDate(), QDate(2024, 2, 29));
+            ACOMPARE_EQ(row[10].toTime(), QTime(13, 45, 30, 250));
+            ACOMPARE_EQ(row[11].toDateTime().date(), QDate(2024, 2, 29));
+            ACOMPARE_EQ(row[11].toDateTime().time(), QTime(13, 45, 30, 250));
+            ACOMPARE_EQ(row[12].toDateTime(),
+                        QDateTime(QDate(2024, 2, 29), QTime(13, 45, 30, 250), QTimeZone::UTC));
+            ACOMPARE_EQ(row[13].toByteArray(), QByteArray("\x00\xff", 2));
+            ACOMPARE_EQ(row[14].toJsonValue().toObject().value(u"a").toInt(), 1);
+            ACOMPARE_EQ(row[15].toString(), u"text"_s);
+            AVERIFY(row[16].isNull());
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestTypesPostgres::testBinaryParams()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            const QDate date(2024, 2, 29);
+            const QTime time(13, 45, 10, 123);
+            const QDateTime utc(QDate(1999, 12, 31), QTime(23, 59, 59, 500), QTimeZone::UTC);
+            const QDateTime local(date, time, QTimeZone::LocalTime);
+            const QUuid uuid = QUuid::fromString(u"3f2504e0-4f89-11d3-9a0c-0305e82c3301"_s);
+
+            auto result = co_await APool::exec(
+                u"SELECT pg_typeof($1)::text, $1, pg_typeof($2)::text, $2, pg_typeof($3)::text, "
+                "$3, $4 = '2024-02-29'::date, $5 = '13:45:10.123'::time, "
+                "$6 = '1999-12-31 23:59:59.5+00'::timestamptz, "
+                "$7 = '2024-02-29 13:45:10.123'::timestamp, $8::text, $9::text, $10::text, "
+                "$11::text, $12::date IS NULL, $13::text"_s,
+                {-2.5,
+                 1.25f,
+                 Q_UINT64_C(18446744073709551615),
+                 date,
+                 time,
+                 utc,
+                 local,
+                 Q_UINT64_C(100000000),
+                 Q_UINT64_C(0),
+                 QVariant::fromValue(qint16(-7)),
+                 uuid,
+                 QDate(),
+                 u"ação"_s});
+            AVERIFY(result);
+            ACOMPARE_EQ(result->size(), 1);
+            auto row = (*result)[0];
+            ACOMPARE_EQ(row[0].toString(), u"double precision"_s);
+            ACOMPARE_EQ(row[1].toDouble(), -2.5);
+            ACOMPARE_EQ(row[2].toString(), u"real"_s);
+            ACOMPARE_EQ(row[3].toDouble(), 1.25);
+            ACOMPARE_EQ(row[4].toString(), u"numeric"_s);
+            ACOMPARE_EQ(row[5].toString(), u"18446744073709551615"_s);
+            AVERIFY(row[6].toBool());
+            AVERIFY(row[7].toBool());
+            AVERIFY(row[8].toBool());
+            AVERIFY(row[9].toBool());
+            ACOMPARE_EQ(row[10].toString(), u"100000000"_s);
+            ACOMPARE_EQ(row[11].toString(), u"0"_s);
+            ACOMPARE_EQ(row[12].toString(), u"-7"_s);
+            ACOMPARE_EQ(row[13].toString(), uuid.toString(QUuid::WithoutBraces));
+            AVERIFY(row[14].toBool());
+            ACOMPARE_EQ(row[15].toString(), u"ação"_s);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestTypesPostgres::testArrayParams()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            const QUuid uuid = QUuid::fromString(u"3f2504e0-4f89-11d3-9a0c-0305e82c3301"_s);
+            const std::vector<int> keys{2, 4, 100};
+
+            auto result = co_await APool::exec(
+                u"SELECT pg_typeof($1)::text, $1::text, $2::text, $3::text, $4::text, $5::text, "
+                "$6::text, $7::text, (SELECT count(*) FROM generate_series(1, 10) g "
+                "WHERE g = ANY($8))"_s,
+                {QVariant::fromValue(QList<int>{1, 2, 3}),
+                 QStringList{u"a"_s, u"b c"_s, QString{}},
+                 QVariant::fromValue(QList<QUuid>{uuid}),
+                 QVariant::fromValue(std::vector<qint64>{Q_INT64_C(9876543210), -1}),
+                 QVariant::fromValue(QList<int>{}),
+                 QVariant::fromValue(QList<double>{1.5, -0.25}),
+                 QVariant::fromValue(QList<bool>{true, false}),
+                 arrayParam(std::span<const int>(keys))});
+            AVERIFY(result);
+            auto row = (*result)[0];
+            ACOMPARE_EQ(row[0].toString(), u"integer[]"_s);
+            ACOMPARE_EQ(row[1].toString(), u"{1,2,3}"_s);
+            ACOMPARE_EQ(row[2].toString(), u"{a,\"b c\",NULL}"_s);
+            ACOMPARE_EQ(row[3].toString(), u"{3f2504e0-4f89-11d3-9a0c-0305e82c3301}"_s);
+            ACOMPARE_EQ(row[4].toString(), u"{9876543210,-1}"_s);
+            ACOMPARE_EQ(row[5].toString(), u"{}"_s);
+            ACOMPARE_EQ(row[6].toString(), u"{1.5,-0.25}"_s);
+            ACOMPARE_EQ(row[7].toString(), u"{t,f}"_s);
+            ACOMPARE_EQ(row[8].toInt(), 2);
+        }(finished);
+    }
+    loop.exec();
+}
+
+void TestTypesPostgres::testArrayColumns()
+{
+    QEventLoop loop;
+    {
+        auto finished = std::make_shared<QObject>();
+        connect(finished.get(), &QObject::destroyed, &loop, &QEventLoop::quit);
+
+        [](std::shared_ptr<QObject> finished) -> ACoroTerminator {
+            auto _ = qScopeGuard([finished] {});
+
+            auto db = co_await APool::database();
+            AVERIFY(db);
+            auto restore =
+                qScopeGuard([db]() mutable { db->setResultFormat(ADatabase::ResultFormat::Text); });
+
+            for (auto format : {ADatabase::ResultFormat::Text, ADatabase::ResultFormat::Binary}) {
+                db->setResultFormat(format);
+
+                auto result = co_await db->exec(
+                    u"SELECT '{1,2,NULL}'::int4[], ARRAY['a', 'b \"c\"', NULL, 'd,e'], "
+                    "'{{1,2},{3,4}}'::int8[], '{}'::int4[], NULL::int4[], "
+                    "'{2024-02-29}'::date[], (SELECT array_agg(g) FROM generate_series(1, 5) g), "
+                    "'[0:1]={t,f}'::bool[]"_s);
+                AVERIFY(result);
+                const auto row = (*result)[0];
+
+                ACOMPARE_EQ(row[0].as<std::vector<std::optional<int>>>(),
+                            (std::vector<std::optional<int>>{1, 2, std::nullopt}));
+                ACOMPARE_EQ(row[0].as<QList<int>>(), (QList<int>{1, 2, 0}));
+
+                const QVariantList texts = row[1].toList();
+                ACOMPARE_EQ(texts.size(), 4);
+                ACOMPARE_EQ(texts[1].toString(), u"b \"c\""_s);
+                AVERIFY(texts[2].isNull());
+                ACOMPARE_EQ(texts[3].toString(), u"d,e"_s);
+
+                const QVariantList matrix = row[2].toList();
+                ACOMPARE_EQ(matrix.size(), 2);
+                ACOMPARE_EQ(matrix[1].toList().value(0).toLongLong(), 3);
+
+                AVERIFY(row[3].as<std::vector<int>>().empty());
+                AVERIFY(row[4].toList().isEmpty());
+                ACOMPARE_EQ(row[5].as<QList<QDate>>(), (QList<QDate>{QDate(2024, 2, 29)}));
+                ACOMPARE_EQ(row[6].as<std::vector<int>>(), (std::vector<int>{1, 2, 3, 4, 5}));
+                ACOMPARE_EQ(row[7].as<QList<bool>>(), (QList<bool>{true, false}));
+            }
+        }(finished);
+    }
+    loop.exec();
+}
+
 QTEST_MAIN(TestTypesPostgres)
 #include "tst_TypesPostgres.moc"